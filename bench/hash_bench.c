@@ -0,0 +1,257 @@
+// Microbenchmarks of the hash maps of tuples (src/hash_tuples.c), see
+// `make bench-hash`.
+//
+// Two kinds of keys are measured, matching the uses of TupleMaps in
+// IronMask:
+//
+//   - "comb": packed tuples of up to 5 elements with a count (the
+//     failures of RPE.c),
+//   - "rank": 128-bit numberings of tuples with a pointer (the
+//     failures of failures_from_incompr.c).
+//
+// For each of them, the throughput of insertions, successful and
+// failed lookups, iterations, removals, merges and parallel
+// insertions is printed, as well as the throughput of insertions and
+// lookups in a chained hash map with a node per key and a fixed
+// number of buckets, like the maps that TupleMaps replaced.
+//
+//   bench/hash_bench [-n keys] [-r repeat] [-j threads]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "hash_tuples.h"
+
+static double now() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint64_t rng_state = 0x853C49E6748FEA9BULL;
+
+static uint64_t rng() {
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 7;
+  rng_state ^= rng_state << 17;
+  return rng_state;
+}
+
+// Fills |keys| with |count| distinct keys of kind |kind|.
+static void gen_keys(const char* kind, char* keys, int key_size, uint64_t count) {
+  TupleMap* seen = make_tuple_map(key_size, 0, NULL);
+  uint64_t i = 0;
+  while (i < count) {
+    char* key = keys + i * key_size;
+    if (strcmp(kind, "comb") == 0) {
+      // Sorted tuples of 1 to 5 elements among 200 variables.
+      int len = 1 + rng() % 5;
+      Comb comb[5];
+      for (int j = 0; j < len; j++) {
+        Comb v = rng() % 200;
+        int k = j;
+        while (k > 0 && comb[k-1] > v) { comb[k] = comb[k-1]; k--; }
+        comb[k] = v;
+      }
+      comb_key_pack(key, key_size, comb, len);
+    } else {
+      uint128_t rank = ((uint128_t)(rng() >> 24) << 64) | rng();
+      memcpy(key, &rank, sizeof(rank));
+    }
+    bool inserted;
+    tuple_map_insert(seen, key, &inserted);
+    if (inserted) i++;
+  }
+  free_tuple_map(seen);
+}
+
+
+/* Chained hash map with a fixed number of buckets, used as a
+   reference. */
+
+#define CHAINED_BUCKETS (1 << 20)
+
+typedef struct _chained_node {
+  struct _chained_node* next;
+  uint64_t value;
+  char key[];
+} ChainedNode;
+
+typedef struct {
+  ChainedNode** buckets;
+  int key_size;
+} ChainedMap;
+
+static ChainedMap* make_chained(int key_size) {
+  ChainedMap* map = malloc(sizeof(*map));
+  map->buckets = calloc(CHAINED_BUCKETS, sizeof(*map->buckets));
+  map->key_size = key_size;
+  return map;
+}
+
+static void free_chained(ChainedMap* map) {
+  for (int i = 0; i < CHAINED_BUCKETS; i++) {
+    ChainedNode* node = map->buckets[i];
+    while (node) {
+      ChainedNode* next = node->next;
+      free(node);
+      node = next;
+    }
+  }
+  free(map->buckets);
+  free(map);
+}
+
+static ChainedNode* chained_find(ChainedMap* map, const void* key) {
+  uint64_t hash = tuple_map_hash(key, map->key_size);
+  ChainedNode* node = map->buckets[hash & (CHAINED_BUCKETS-1)];
+  while (node) {
+    if (memcmp(node->key, key, map->key_size) == 0) return node;
+    node = node->next;
+  }
+  return NULL;
+}
+
+static void chained_insert(ChainedMap* map, const void* key) {
+  if (chained_find(map, key)) return;
+  uint64_t hash = tuple_map_hash(key, map->key_size);
+  ChainedNode* node = malloc(sizeof(*node) + map->key_size);
+  memcpy(node->key, key, map->key_size);
+  node->value = 0;
+  node->next = map->buckets[hash & (CHAINED_BUCKETS-1)];
+  map->buckets[hash & (CHAINED_BUCKETS-1)] = node;
+}
+
+
+/* Benchmarks */
+
+static void report(const char* kind, const char* op, uint64_t ops, double seconds) {
+  printf("%-6s %-22s %10.1f Mops/s %8.1f ns/op\n", kind, op,
+         ops / seconds / 1e6, seconds * 1e9 / ops);
+}
+
+static bool remove_odd(const TupleMap* map, void* slot, void* data) {
+  (void) data;
+  return *(char*)tuple_map_value(map, slot) & 1;
+}
+
+static void bench_kind(const char* kind, uint64_t count, int repeat, int cores) {
+  int key_size = strcmp(kind, "comb") == 0 ? comb_key_size(5) : sizeof(uint128_t);
+  int value_size = strcmp(kind, "comb") == 0 ? sizeof(int) : sizeof(void*);
+  char* keys = malloc(2 * count * key_size);
+  gen_keys(kind, keys, key_size, 2 * count);
+  // keys[0..count) are inserted, keys[count..2*count) are absent.
+  char* absent = keys + count * key_size;
+
+  // Best time of each measurement, in the order of |names|.
+  const char* names[] = { "insert", "lookup (hit)", "lookup (miss)", "iterate",
+                          "merge", "remove_if", "parallel insert",
+                          "chained insert", "chained lookup (hit)" };
+  uint64_t ops[] = { count, count, count, count, count, count + count / 2,
+                     count, count, count };
+  double best[9];
+  for (int i = 0; i < 9; i++) best[i] = 1e30;
+  uint64_t sink = 0;
+
+  for (int r = 0; r < repeat; r++) {
+    TupleMap* map = make_tuple_map(key_size, value_size, NULL);
+    double start = now();
+    for (uint64_t i = 0; i < count; i++) {
+      void* slot = tuple_map_insert(map, keys + i * key_size, NULL);
+      (*(char*)tuple_map_value(map, slot)) += i & 1;
+    }
+    double t_insert = now();
+    for (uint64_t i = 0; i < count; i++) {
+      sink += tuple_map_find(map, keys + i * key_size) != NULL;
+    }
+    double t_hit = now();
+    for (uint64_t i = 0; i < count; i++) {
+      sink += tuple_map_find(map, absent + i * key_size) != NULL;
+    }
+    double t_miss = now();
+    uint64_t it = 0;
+    void* slot;
+    while ((slot = tuple_map_next(map, &it))) sink += *(char*)slot;
+    double t_iter = now();
+
+    TupleMap* other = make_tuple_map(key_size, value_size, NULL);
+    for (uint64_t i = count / 2; i < count + count / 2; i++) {
+      tuple_map_insert(other, keys + i * key_size, NULL);
+    }
+    double t_merge_start = now();
+    tuple_map_merge(map, other, NULL, NULL);
+    double t_merge = now();
+    tuple_map_remove_if(map, remove_odd, NULL);
+    double t_remove = now();
+    free_tuple_map(other);
+    free_tuple_map(map);
+
+    map = make_tuple_map(key_size, value_size, NULL);
+    double t_par_start = now();
+    sink += tuple_map_insert_parallel(map, keys, NULL, count, cores);
+    double t_par = now();
+    free_tuple_map(map);
+
+    ChainedMap* chained = make_chained(key_size);
+    double t_chained_start = now();
+    for (uint64_t i = 0; i < count; i++) {
+      chained_insert(chained, keys + i * key_size);
+    }
+    double t_chained_insert = now();
+    for (uint64_t i = 0; i < count; i++) {
+      sink += chained_find(chained, keys + i * key_size) != NULL;
+    }
+    double t_chained_hit = now();
+    free_chained(chained);
+
+    double times[9] = {
+      t_insert - start, t_hit - t_insert, t_miss - t_hit, t_iter - t_miss,
+      t_merge - t_merge_start, t_remove - t_merge, t_par - t_par_start,
+      t_chained_insert - t_chained_start, t_chained_hit - t_chained_insert
+    };
+    for (int i = 0; i < 9; i++) {
+      if (times[i] < best[i]) best[i] = times[i];
+    }
+  }
+
+  for (int i = 0; i < 9; i++) {
+    char name[64];
+    if (i == 6) {
+      snprintf(name, sizeof(name), "%s (-j %d)", names[i], cores);
+    } else {
+      snprintf(name, sizeof(name), "%s", names[i]);
+    }
+    report(kind, name, ops[i], best[i]);
+  }
+  if (sink == 42) printf(" ");
+  free(keys);
+}
+
+int main(int argc, char** argv) {
+  uint64_t count = 1000000;
+  int repeat = 3;
+  int cores = sysconf(_SC_NPROCESSORS_ONLN);
+  int opt;
+  while ((opt = getopt(argc, argv, "n:r:j:")) != -1) {
+    switch (opt) {
+      case 'n': count = strtoull(optarg, NULL, 10); break;
+      case 'r': repeat = atoi(optarg); break;
+      case 'j': cores = atoi(optarg); break;
+      default:
+        fprintf(stderr, "Usage: %s [-n keys] [-r repeat] [-j threads]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+  }
+  if (cores < 1) cores = 1;
+  if (repeat < 1) repeat = 1;
+
+  printf("%lu keys, best of %d runs\n\n", (unsigned long)count, repeat);
+  bench_kind("comb", count, repeat, cores);
+  printf("\n");
+  bench_kind("rank", count, repeat, cores);
+  return 0;
+}
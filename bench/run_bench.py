@@ -0,0 +1,218 @@
+#!/usr/bin/env python3
+
+# Runs the benchmarks of matrix.txt, and compares their wall time and
+# peak memory against a stored baseline. Run from anywhere; paths are
+# relative to the root of the repository.
+#
+#   python3 bench/run_bench.py                    # run and compare
+#   python3 bench/run_bench.py --update-baseline  # run and store as baseline
+#   python3 bench/run_bench.py --filter RPE       # only benchmarks matching RPE
+#
+# The exit status is 1 if a benchmark fails or regresses.
+
+import argparse
+import json
+import os
+import platform
+import re
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BENCH_DIR = os.path.join(ROOT, "bench")
+BASELINE_VERSION = 1
+
+
+def parse_matrix(filename):
+  entries = []
+  names = set()
+  with open(filename) as f:
+    for line_number, line in enumerate(f, 1):
+      line = line.strip()
+      if not line or line.startswith("#"):
+        continue
+      fields = line.split()
+      if len(fields) < 3:
+        sys.exit("%s:%d: expected a name and ironmask arguments" % (filename, line_number))
+      if fields[0] in names:
+        sys.exit("%s:%d: duplicate benchmark '%s'" % (filename, line_number, fields[0]))
+      names.add(fields[0])
+      entries.append((fields[0], fields[1:]))
+  return entries
+
+
+def cpu_model():
+  try:
+    with open("/proc/cpuinfo") as f:
+      for line in f:
+        if line.startswith("model name"):
+          return line.split(":", 1)[1].strip()
+  except OSError:
+    pass
+  return platform.processor() or "unknown"
+
+
+# Runs ironmask once on |args|; returns the measurements, or None if
+# it failed.
+def run_once(ironmask, args, timeout):
+  with tempfile.TemporaryDirectory() as tmp:
+    stats_file = os.path.join(tmp, "stats.json")
+    start = time.monotonic()
+    try:
+      proc = subprocess.run([ironmask] + args + ["--stats-json", stats_file],
+                            cwd=ROOT, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, timeout=timeout)
+    except subprocess.TimeoutExpired:
+      return None, "timeout after %d s" % timeout
+    wall_time = time.monotonic() - start
+    if proc.returncode != 0:
+      error = proc.stderr.decode(errors="replace").strip().splitlines()
+      return None, "exit status %d%s" % (proc.returncode, ": " + error[-1] if error else "")
+    with open(stats_file) as f:
+      stats = json.load(f)
+  return {
+    "wall_time": round(wall_time, 3),
+    "tuples_checked": stats["tuples_checked"],
+    "tuples_per_second": round(stats["tuples_checked"] / wall_time) if wall_time > 0 else 0,
+    "peak_rss_kb": stats["peak_rss_kb"],
+  }, None
+
+
+# Runs a benchmark |repeat| times and keeps the fastest run (the least
+# disturbed by the rest of the machine).
+def run_benchmark(ironmask, args, repeat, timeout):
+  best = None
+  for _ in range(repeat):
+    result, error = run_once(ironmask, args, timeout)
+    if error:
+      return None, error
+    if best is None or result["wall_time"] < best["wall_time"]:
+      best = result
+  return best, None
+
+
+# Returns the list of regressions of |result| with respect to |base|,
+# and a list of notes.
+def compare(result, base, opts):
+  regressions, notes = [], []
+  time_limit = base["wall_time"] * (1 + opts.time_tolerance) + opts.time_slack
+  if result["wall_time"] > time_limit:
+    regressions.append("time %+.0f%%" % (100 * (result["wall_time"] / base["wall_time"] - 1)))
+  elif result["wall_time"] < base["wall_time"] * (1 - opts.time_tolerance) - opts.time_slack:
+    notes.append("faster")
+  mem_limit = base["peak_rss_kb"] * (1 + opts.mem_tolerance) + opts.mem_slack
+  if result["peak_rss_kb"] > mem_limit:
+    regressions.append("memory %+.0f%%" %
+                       (100 * (result["peak_rss_kb"] / base["peak_rss_kb"] - 1)))
+  if result["tuples_checked"] != base["tuples_checked"]:
+    notes.append("tuples checked %d -> %d" % (base["tuples_checked"], result["tuples_checked"]))
+  return regressions, notes
+
+
+def main():
+  parser = argparse.ArgumentParser(description="Runs the IronMask benchmark matrix.")
+  parser.add_argument("--ironmask", default=os.path.join(ROOT, "src", "ironmask"),
+                      help="ironmask binary (default: src/ironmask)")
+  parser.add_argument("--matrix", default=os.path.join(BENCH_DIR, "matrix.txt"))
+  parser.add_argument("--baseline", default=os.path.join(BENCH_DIR, "baseline.json"))
+  parser.add_argument("--output", default=os.path.join(BENCH_DIR, "results.json"),
+                      help="where to write the measurements (default: bench/results.json)")
+  parser.add_argument("--filter", default=None,
+                      help="only runs the benchmarks whose name matches this regex")
+  parser.add_argument("--repeat", type=int, default=3,
+                      help="runs of each benchmark; the fastest is kept (default: 3)")
+  parser.add_argument("--timeout", type=int, default=600,
+                      help="timeout of each run, in seconds (default: 600)")
+  parser.add_argument("--time-tolerance", type=float, default=0.25,
+                      help="allowed relative increase of the wall time (default: 0.25)")
+  parser.add_argument("--time-slack", type=float, default=0.05,
+                      help="allowed absolute increase of the wall time, in seconds, "
+                      "which absorbs the noise of short benchmarks (default: 0.05)")
+  parser.add_argument("--mem-tolerance", type=float, default=0.10,
+                      help="allowed relative increase of the peak RSS (default: 0.10)")
+  parser.add_argument("--mem-slack", type=int, default=2048,
+                      help="allowed absolute increase of the peak RSS, in KB (default: 2048)")
+  parser.add_argument("--update-baseline", action="store_true",
+                      help="stores the measurements as the new baseline")
+  opts = parser.parse_args()
+
+  if not os.access(opts.ironmask, os.X_OK):
+    sys.exit("Cannot execute '%s'; run 'make' first." % opts.ironmask)
+
+  entries = parse_matrix(opts.matrix)
+  if opts.filter:
+    entries = [e for e in entries if re.search(opts.filter, e[0])]
+
+  baseline = {}
+  if not opts.update_baseline and not os.path.exists(opts.baseline):
+    print("No baseline '%s': the benchmarks are only measured.\n"
+          "Measure one on this machine with 'make bench-baseline'.\n"
+          % os.path.relpath(opts.baseline))
+  elif not opts.update_baseline:
+    with open(opts.baseline) as f:
+      content = json.load(f)
+    if content.get("version") != BASELINE_VERSION:
+      sys.exit("Baseline '%s' has an unsupported version." % opts.baseline)
+    baseline = content["benchmarks"]
+    if content.get("cpu") != cpu_model():
+      print("Warning: the baseline was measured on '%s', this machine is '%s'.\n"
+            "Timings are only comparable on the same machine; "
+            "regenerate it with 'make bench-baseline'.\n" % (content.get("cpu"), cpu_model()))
+
+  print("%-26s %10s %10s %8s %14s %10s  %s" %
+        ("benchmark", "base (s)", "time (s)", "delta", "tuples/s", "RSS (MB)", "status"))
+  results = {}
+  failed = 0
+  for name, args in entries:
+    result, error = run_benchmark(opts.ironmask, args, opts.repeat, opts.timeout)
+    if error:
+      print("%-26s %10s %10s %8s %14s %10s  FAILED (%s)" % (name, "", "", "", "", "", error))
+      failed += 1
+      continue
+    results[name] = dict(result, args=" ".join(args))
+
+    base = baseline.get(name)
+    status = "no baseline"
+    base_time, delta = "", ""
+    if base:
+      regressions, notes = compare(result, base, opts)
+      if regressions:
+        failed += 1
+        status = "REGRESSION (" + ", ".join(regressions) + ")"
+      else:
+        status = "ok"
+      if notes:
+        status += " [" + "; ".join(notes) + "]"
+      base_time = "%.3f" % base["wall_time"]
+      if base["wall_time"] > 0:
+        delta = "%+.1f%%" % (100 * (result["wall_time"] / base["wall_time"] - 1))
+    print("%-26s %10s %10.3f %8s %14d %10.1f  %s" %
+          (name, base_time, result["wall_time"], delta, result["tuples_per_second"],
+           result["peak_rss_kb"] / 1024, status))
+
+  # Updating the baseline of some benchmarks only (--filter) keeps the
+  # others.
+  if opts.update_baseline and opts.filter and os.path.exists(opts.baseline):
+    with open(opts.baseline) as f:
+      results = dict(json.load(f)["benchmarks"], **results)
+  content = {
+    "version": BASELINE_VERSION,
+    "cpu": cpu_model(),
+    "date": time.strftime("%Y-%m-%d"),
+    "benchmarks": results,
+  }
+  output = opts.baseline if opts.update_baseline else opts.output
+  with open(output, "w") as f:
+    json.dump(content, f, indent=2, sort_keys=True)
+    f.write("\n")
+  print("\nMeasurements written to '%s'." % os.path.relpath(output))
+
+  if failed:
+    print("%d benchmark(s) failed or regressed." % failed)
+    sys.exit(1)
+
+
+if __name__ == "__main__":
+  main()
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include <assert.h>
 #include <inttypes.h>
@@ -32,8 +33,12 @@ static int generate_names(ParsedFile * pf, char *** names_ptr){
   while(o){
     for(int i=0; i< pf->shares; i++){
       for(int j=0; j< pf->nb_duplications; j++){
-        outputs[idx] = malloc(10 * sizeof(*outputs[idx]));
-        sprintf(outputs[idx], "%s%d_%d", o->key, i, j);
+        // +1 for '\0' and +1 for "_" and +11 for each of the two numbers
+        outputs[idx] = malloc((strlen(o->key) + 24) * sizeof(*outputs[idx]));
+        if (pf->nb_duplications <= 1)
+          sprintf(outputs[idx], "%s%d", o->key, i);
+        else
+          sprintf(outputs[idx], "%s%d_%d", o->key, i, j);
         idx++;
       }
     }
@@ -85,7 +90,7 @@ static int generate_names(ParsedFile * pf, char *** names_ptr){
   }
   free(outputs);
 
-  return length;
+  return idx;
 }
 
 static void display_failure(const Circuit* c, Comb* comb, int comb_len, SecretDep* secret_deps,
@@ -127,6 +132,8 @@ int compute_CNI(ParsedFile * pf, int cores, int t, int k, bool set) {
   bool has_random = true;
   struct callback_data data = { .ni_order = t, .faults = k };
 
+  CircuitBase* base = make_circuit_base(pf, pf->glitch, pf->transition);
+
   for(int i=1; i<=k; i++){
 
     fv->length = i;
@@ -151,7 +158,7 @@ int compute_CNI(ParsedFile * pf, int cores, int t, int k, bool set) {
 
       fv->vars = v;
 
-      Circuit * c = gen_circuit(pf, pf->glitch, pf->transition, fv);
+      Circuit * c = gen_faulted_circuit(base, fv);
       //print_circuit(c);
       DimRedData* dim_red_data = remove_elementary_wires(c, false);
       
@@ -197,6 +204,7 @@ int compute_CNI(ParsedFile * pf, int cores, int t, int k, bool set) {
       if(has_failure){
         printf("------\n");
         printf("################\n\n");
+        free_circuit_base(base);
         return has_failure;
       }
 
@@ -215,6 +223,7 @@ int compute_CNI(ParsedFile * pf, int cores, int t, int k, bool set) {
   free(names);
 
   free(fv);
+  free_circuit_base(base);
 
   if(!has_failure){
     printf("Gadget is (%d,%d)-CNI\n", data.ni_order, data.faults);
@@ -2,7 +2,9 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <assert.h>
+#include <string.h>
 #include <inttypes.h>
+#include <unistd.h>
 #include <gmp.h>
 
 #include "CRP.h"
@@ -14,11 +16,13 @@
 #include "verification_rules.h"
 #include "dimensions.h"
 #include "constructive.h"
+#include "checkpoint.h"
+#include "sweep.h"
 
 
 
 struct callback_data {
-  uint64_t* coeffs;
+  CoeffsData coeffs_data; // Must come first (see coeffs_accumulator)
   bool dimension_reduction;
   Circuit* init_circuit;
   int* new_to_old_mapping;
@@ -92,13 +96,17 @@ static void update_coeffs(const Circuit* c, Comb* comb, int comb_len, SecretDep*
                           void* data_void) {
   struct callback_data* data = (struct callback_data*) data_void;
   (void) secret_deps;
-  uint64_t* coeffs = data->coeffs;
+  Coeff* coeffs = data->coeffs_data.coeffs;
 
   /* printf("[ "); */
   /* for (int i = 0; i < comb_len; i++) printf("%d ", comb[i]); */
   /* printf("]\n"); */
 
-  update_coeff_c_single(c, coeffs, comb, comb_len);
+  if (data->coeffs_data.histogram) {
+    coeff_histogram_add(data->coeffs_data.histogram, c, comb, comb_len);
+  } else {
+    update_coeff_c_single(c, coeffs, comb, comb_len);
+  }
 }
 
 static void get_filename(ParsedFile * pf, int coeff_max, int k, char **name, bool set){
@@ -107,6 +115,20 @@ static void get_filename(ParsedFile * pf, int coeff_max, int k, char **name, boo
 }
 
 
+// Appends the coefficients |coeffs| of a scenario to |coeffs_file|,
+// and clears them for the next scenario. The last step of the
+// scenario is only marked as done afterwards, so that checkpoints
+// never contain a completed scenario whose coefficients have not been
+// written. |written_size| is set to the size of the file.
+static void write_scenario_coeffs(FILE* coeffs_file, Coeff* coeffs, int total_wires,
+                                  uint64_t* written_size) {
+  write_coeffs(coeffs_file, coeffs, total_wires+1);
+  fflush(coeffs_file);
+  *written_size = ftell(coeffs_file);
+  clear_coeffs(coeffs, total_wires+1);
+  checkpoint_step_done();
+}
+
 void compute_CRP_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, bool set) {
 
   char ** names;
@@ -130,11 +152,40 @@ void compute_CRP_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, bool s
   Faults * fv = malloc(sizeof(*fv));
   fv->length = k;
 
+  // Each scenario is made of one checkpoint step per size. The
+  // coefficients of the current scenario and the size of the
+  // scenarios already written to |coeffs_file| are saved in the
+  // checkpoints (the size of a scenario depends on its coefficients).
+  char params[64];
+  sprintf(params, "coeff_max=%d k=%d set=%d", coeff_max, k, set ? 1 : 0);
+  checkpoint_begin("CRP", params);
+  Coeff * coeffs = calloc(total_wires+1, sizeof(*coeffs));
+  uint64_t written_size = 0;
+  checkpoint_vector("coeffs", coeffs, total_wires+1);
+  checkpoint_counter("written_size", &written_size);
+
   char * filename;
   get_filename(pf, coeff_max, k, &filename, set);
-  FILE * coeffs_file = fopen(filename, "wb");
+  FILE * coeffs_file;
+  if (written_size == 0) {
+    coeffs_file = fopen(filename, "wb");
+    write_coeffs_header(coeffs_file);
+  } else {
+    // Resuming: dropping the scenarios written after the checkpoint.
+    coeffs_file = fopen(filename, "r+b");
+    if (!coeffs_file ||
+        ftruncate(fileno(coeffs_file), written_size) != 0 ||
+        fseek(coeffs_file, 0, SEEK_END) != 0 ||
+        (uint64_t)ftell(coeffs_file) != written_size) {
+      fprintf(stderr, "Cannot resume: file %s does not contain the coefficients "
+              "saved before the checkpoint. Exiting.\n", filename);
+      exit(EXIT_FAILURE);
+    }
+  }
   free(filename);
 
+  CircuitBase* base = make_circuit_base(pf, pf->glitch, pf->transition);
+
   int cpt_ignored = 0;
   for(int i=1; i<=k; i++){
 
@@ -166,18 +217,24 @@ void compute_CRP_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, bool s
         goto skip;
       }
 
-      uint64_t * coeffs = calloc(total_wires+1, sizeof(*coeffs));
-      Circuit * circuit = gen_circuit(pf, pf->glitch, pf->transition, fv);
+      if(checkpoint_skip_steps(coeff_max_main_loop+1)){
+        printf("Already checked before the checkpoint.\n");
+        goto skip;
+      }
+
+      Circuit * circuit = gen_faulted_circuit(base, fv);
       // print_circuit(c);
       DimRedData* dim_red_data = remove_elementary_wires(circuit, false);
 
       struct callback_data data = {
-        .coeffs = coeffs,
+        .coeffs_data = { .size = sizeof(data), .coeffs = coeffs,
+                         .coeffs_len = total_wires+1 },
       };
 
       // Computing coefficients
       // printf("f(p) = [ "); fflush(stdout);
       for (int size = 0; size <= coeff_max_main_loop; size++) {
+        if (checkpoint_skip_steps(1)) continue;
 
         find_all_failures(circuit,
                           cores,
@@ -193,7 +250,9 @@ void compute_CRP_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, bool s
                           false, // PINI
                           NULL,
                           update_coeffs,
-                          (void*)&data);
+                          (void*)&data,
+                          &coeffs_accumulator);
+        if (size < coeff_max_main_loop) checkpoint_step_done();
 
         // A failure of size 0 is not possible. However, we still want to
         // iterate in the loop with |size| = 0 to generate the tuples with
@@ -204,9 +263,8 @@ void compute_CRP_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, bool s
         // }
       }
 
-      fwrite(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
+      write_scenario_coeffs(coeffs_file, coeffs, total_wires, &written_size);
       free_circuit(circuit);
-      free(coeffs);
 
       skip:;
 
@@ -222,19 +280,26 @@ void compute_CRP_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, bool s
   }
   free(names);
   free(fv);
+  free_circuit_base(base);
 
   // add non faulty circuit
-  uint64_t * coeffs = calloc(total_wires+1, sizeof(*coeffs));
+  if(checkpoint_skip_steps(coeff_max_main_loop+1)){
+    printf("################ Cheking CRP without faults\n");
+    printf("Already checked before the checkpoint.\n");
+    goto end;
+  }
   Circuit * circuit = gen_circuit(pf, pf->glitch, pf->transition, NULL);
   // print_circuit(c);
   DimRedData* dim_red_data = remove_elementary_wires(circuit, false);
   struct callback_data data = {
-    .coeffs = coeffs,
+    .coeffs_data = { .size = sizeof(data), .coeffs = coeffs,
+                     .coeffs_len = total_wires+1 },
   };
 
   // Computing coefficients
   printf("################ Cheking CRP without faults\n");
   for (int size = 0; size <= coeff_max_main_loop; size++) {
+    if (checkpoint_skip_steps(1)) continue;
 
     find_all_failures(circuit,
                       cores,
@@ -250,13 +315,17 @@ void compute_CRP_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, bool s
                       false, // PINI
                       NULL,
                       update_coeffs,
-                      (void*)&data);
+                      (void*)&data,
+                      &coeffs_accumulator);
+    if (size < coeff_max_main_loop) checkpoint_step_done();
   }
-  fwrite(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
+  write_scenario_coeffs(coeffs_file, coeffs, total_wires, &written_size);
   free_circuit(circuit);
-  free(coeffs);
 
+  end:
   fclose(coeffs_file);
+  checkpoint_end();
+  free(coeffs);
 
   printf("Ignored %d combs\n", cpt_ignored);
   free_faults_combs(fc);
@@ -279,9 +348,10 @@ void compute_CRP_val(ParsedFile * pf, int coeff_max, int k, double pleak, double
     fprintf(stderr, "file %s not found...", filename);
     exit(EXIT_FAILURE);
   }
+  int version = read_coeffs_header(coeffs_file, filename);
   free(filename);
 
-  uint64_t * coeffs = calloc(total_wires+1, sizeof(*coeffs));
+  Coeff * coeffs = calloc(total_wires+1, sizeof(*coeffs));
   mpf_t epsilon, mu, epsilon_max, mu_max;
   mpf_init(epsilon);
   mpf_init(mu);
@@ -296,6 +366,11 @@ void compute_CRP_val(ParsedFile * pf, int coeff_max, int k, double pleak, double
   Faults * fv = malloc(sizeof(*fv));
   fv->length = k;
 
+  // In sweep mode, the scenarios are only summed here, and evaluated
+  // over all leakage and fault rates at the end.
+  CombinedSweep * sweep = sweep_enabled() ?
+    make_combined_sweep(length, total_wires+1, k) : NULL;
+
   int cpt = 0;
   int cpt_ignored = 0;
   for(int i=1; i<=k; i++){
@@ -316,16 +391,24 @@ void compute_CRP_val(ParsedFile * pf, int coeff_max, int k, double pleak, double
       fv->vars = v;
 
       if(ignore_faulty_scenario(fv, fc)){
-        compute_combined_intermediate_mu(i, length, pfault, mu);
-        compute_combined_intermediate_mu(i, length, pfault, mu_max);
+        if(sweep){
+          combined_sweep_add_ignored(sweep, i);
+        } else{
+          compute_combined_intermediate_mu(i, length, pfault, mu);
+          compute_combined_intermediate_mu(i, length, pfault, mu_max);
+        }
         cpt_ignored++;
         goto skip;
       }
 
-      fread(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
+      read_coeffs(coeffs_file, version, coeffs, total_wires+1);
       // get_failure_proba(coeffs, total_wires+1, pleak);
-      compute_combined_intermediate_leakage_proba(coeffs, i, length, total_wires+1, pleak, pfault, epsilon, -1);
-      compute_combined_intermediate_leakage_proba(coeffs, i, length, total_wires+1, pleak, pfault, epsilon_max, coeff_max);
+      if(sweep){
+        combined_sweep_add(sweep, i, coeffs);
+      } else{
+        compute_combined_intermediate_leakage_proba(coeffs, i, length, total_wires+1, pleak, pfault, epsilon, -1);
+        compute_combined_intermediate_leakage_proba(coeffs, i, length, total_wires+1, pleak, pfault, epsilon_max, coeff_max);
+      }
       cpt++;
 
       skip:;
@@ -333,16 +416,28 @@ void compute_CRP_val(ParsedFile * pf, int coeff_max, int k, double pleak, double
     }while(incr_comb_in_place(comb, i, length));
   }
 
-  fread(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
+  read_coeffs(coeffs_file, version, coeffs, total_wires+1);
   // get_failure_proba(coeffs, total_wires+1, pleak);
-  compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon, -1);
-  compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon_max, coeff_max);
+  if(sweep){
+    combined_sweep_add(sweep, 0, coeffs);
+  } else{
+    compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon, -1);
+    compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon_max, coeff_max);
+  }
 
   fclose(coeffs_file);
 
   // printf("Ignored %d combs\n", cpt_ignored);
   free_faults_combs(fc);
 
+  if(sweep){
+    write_combined_sweep(&sweep, 1, coeff_max);
+    free_combined_sweep(sweep);
+    mpf_clears(epsilon, epsilon_max, mu, mu_max, NULL);
+    free(coeffs);
+    return;
+  }
+
   compute_combined_mu_max(k, length, pfault, mu_max);
 
   mpf_t tmp;
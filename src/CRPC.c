@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <stdint.h>
 #include <assert.h>
 #include <inttypes.h>
@@ -14,10 +15,11 @@
 #include "verification_rules.h"
 #include "dimensions.h"
 #include "constructive.h"
+#include "sweep.h"
 
 
 struct callback_data {
-  uint64_t* coeffs;
+  CoeffsData coeffs_data; // Must come first (see coeffs_accumulator)
   int t;
   int nb_duplications;
 };
@@ -55,7 +57,13 @@ static void update_coeffs(const Circuit* c, Comb* comb, int comb_len, SecretDep*
   int t = data->t;
   int nb_duplications = data->nb_duplications;
 
-  update_coeff_c_single(c, data->coeffs, &comb[t*nb_duplications], comb_len-(t*nb_duplications));
+  Comb* failure = &comb[t*nb_duplications];
+  int failure_len = comb_len-(t*nb_duplications);
+  if (data->coeffs_data.histogram) {
+    coeff_histogram_add(data->coeffs_data.histogram, c, failure, failure_len);
+  } else {
+    update_coeff_c_single(c, data->coeffs_data.coeffs, failure, failure_len);
+  }
 }
 
 void construct_output_prefix(Circuit * c, StrMap * out, Comb * out_comb, Comb * out_comb_res, int t){
@@ -63,8 +71,13 @@ void construct_output_prefix(Circuit * c, StrMap * out, Comb * out_comb, Comb *
   char ** names = malloc(t*c->nb_duplications * sizeof(*names));
   for(int i=0; i<t; i++){
     for(int j=0; j<c->nb_duplications; j++){
-      names[i*c->nb_duplications + j] = malloc(10 * sizeof(*names[i*c->nb_duplications + j]));
-      sprintf(names[i*c->nb_duplications + j], "%s%d_%d", out->head->key, out_comb[i], j);
+      // +1 for '\0' and +1 for "_" and +11 for each of the two numbers
+      names[i*c->nb_duplications + j] = malloc((strlen(out->head->key) + 24) *
+                                               sizeof(*names[i*c->nb_duplications + j]));
+      if (c->nb_duplications <= 1)
+        sprintf(names[i*c->nb_duplications + j], "%s%d", out->head->key, out_comb[i]);
+      else
+        sprintf(names[i*c->nb_duplications + j], "%s%d_%d", out->head->key, out_comb[i], j);
     }
   }
   DependencyList * deps = c->deps;
@@ -138,13 +151,18 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
                              .max_size = t*pf->nb_duplications, 
                              .content = NULL };
 
-  struct callback_data data = { .t = t, .coeffs = NULL, .nb_duplications = pf->nb_duplications };
+  struct callback_data data = { .coeffs_data = { .size = sizeof(data), .coeffs = NULL,
+                                                 .coeffs_len = total_wires + 1 },
+                                .t = t, .nb_duplications = pf->nb_duplications };
 
   char * filename;
   get_filename(pf, coeff_max, t, k, set, &filename);
   FILE * coeffs_file = fopen(filename, "wb");
+  write_coeffs_header(coeffs_file);
   free(filename);
 
+  CircuitBase* base = make_circuit_base(pf, pf->glitch, pf->transition);
+
   for(int i=0; i< nb_input_combs+1; i++){
     int size_input_comb;
     FaultedVar ** v_inps = NULL;
@@ -222,9 +240,9 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
       }
       printf("...\n");
 
-      Circuit * circuit = gen_circuit(pf, pf->glitch, pf->transition, fv);
-      uint64_t * coeffs = calloc(total_wires+1, sizeof(*coeffs));
-      uint64_t** coeffs_out_comb;
+      Circuit * circuit = gen_faulted_circuit(base, fv);
+      Coeff * coeffs = calloc(total_wires+1, sizeof(*coeffs));
+      Coeff** coeffs_out_comb;
       coeffs_out_comb = malloc(out_comb_len * sizeof(*coeffs_out_comb));
       for (unsigned i = 0; i < out_comb_len; i++) {
         coeffs_out_comb[i] = calloc((total_wires + 1),  sizeof(*coeffs_out_comb[i]));
@@ -235,7 +253,7 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
         for (unsigned int l = 0; l < out_comb_len; l++) {
           construct_output_prefix(circuit, pf->out, out_comb_arr[l], out_comb, t);
           verif_prefix.content = out_comb;
-          data.coeffs = coeffs_out_comb[l];
+          data.coeffs_data.coeffs = coeffs_out_comb[l];
 
           find_all_failures(circuit,
                         cores,
@@ -251,25 +269,27 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
                         false, // PINI
                         NULL, // incompr_tuples
                         update_coeffs,
-                        (void*)&data);
+                        (void*)&data,
+                        &coeffs_accumulator);
         }
       }
 
-      #define max(a,b) ((a) > (b) ? (a) : (b))
       for (int m = 0; m <= circuit->total_wires; m++) {
         for (unsigned j = 0; j < out_comb_len; j++) {
-          coeffs[m] = max(coeffs[m], coeffs_out_comb[j][m]);
+          coeff_set_max(&coeffs[m], coeffs_out_comb[j][m]);
         }
         // printf("%"PRId64", ", coeffs[m]);
       }
       // printf("\n");
       for (unsigned i = 0; i < out_comb_len; i++) {
+        clear_coeffs(coeffs_out_comb[i], total_wires+1);
         free(coeffs_out_comb[i]);
       }
       free(coeffs_out_comb);
 
 
-      fwrite(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
+      write_coeffs(coeffs_file, coeffs, total_wires+1);
+      clear_coeffs(coeffs, total_wires+1);
       free(coeffs);
       free_circuit(circuit);
 
@@ -317,11 +337,11 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
         fv->length = f+size_input_comb;
         
 
-        Circuit * circuit = gen_circuit(pf, pf->glitch, pf->transition, fv);
+        Circuit * circuit = gen_faulted_circuit(base, fv);
 
-        uint64_t * coeffs = calloc(total_wires+1, sizeof(*coeffs));
+        Coeff * coeffs = calloc(total_wires+1, sizeof(*coeffs));
 
-        uint64_t** coeffs_out_comb;
+        Coeff** coeffs_out_comb;
         coeffs_out_comb = malloc(out_comb_len * sizeof(*coeffs_out_comb));
         for (unsigned i = 0; i < out_comb_len; i++) {
           coeffs_out_comb[i] = calloc((total_wires + 1),  sizeof(*coeffs_out_comb[i]));
@@ -332,7 +352,7 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
           for (unsigned int l = 0; l < out_comb_len; l++) {
             construct_output_prefix(circuit, pf->out, out_comb_arr[l], out_comb, t);
             verif_prefix.content = out_comb;
-            data.coeffs = coeffs_out_comb[l];
+            data.coeffs_data.coeffs = coeffs_out_comb[l];
 
             find_all_failures(circuit,
                           cores,
@@ -348,25 +368,27 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
                           false, // PINI
                           NULL, // incompr_tuples
                           update_coeffs,
-                          (void*)&data);
+                          (void*)&data,
+                          &coeffs_accumulator);
           }
         }
 
-        #define max(a,b) ((a) > (b) ? (a) : (b))
         for (int m = 0; m <= circuit->total_wires; m++) {
           for (unsigned j = 0; j < out_comb_len; j++) {
-            coeffs[m] = max(coeffs[m], coeffs_out_comb[j][m]);
+            coeff_set_max(&coeffs[m], coeffs_out_comb[j][m]);
           }
           // printf("%"PRId64", ", coeffs[m]);
         }
         // printf("\n");
         for (unsigned i = 0; i < out_comb_len; i++) {
+          clear_coeffs(coeffs_out_comb[i], total_wires+1);
           free(coeffs_out_comb[i]);
         }
         free(coeffs_out_comb);
 
 
-        fwrite(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
+        write_coeffs(coeffs_file, coeffs, total_wires+1);
+        clear_coeffs(coeffs, total_wires+1);
         free(coeffs);
         free_circuit(circuit);
 
@@ -391,6 +413,7 @@ void compute_CRPC_coeffs(ParsedFile * pf, int cores, int coeff_max, int k, int t
   
     free_faults_combs(sfc);
   }
+  free_circuit_base(base);
 
   fclose(coeffs_file);
   fclose(faulty_combs_file);
@@ -450,11 +473,22 @@ void compute_CRPC_val(ParsedFile * pf, int coeff_max, int k, int t, double pleak
   char * filename;
   get_filename(pf, coeff_max, t, k, set, &filename);
   FILE * coeffs_file = fopen(filename, "rb");
+  int version = read_coeffs_header(coeffs_file, filename);
   free(filename);
 
+  // In sweep mode, the scenarios of each input fault are only summed
+  // here, and evaluated over all leakage and fault rates at the end.
+  CombinedSweep ** sweeps = NULL;
+  if(sweep_enabled()){
+    sweeps = malloc((nb_input_combs+1) * sizeof(*sweeps));
+  }
+
   for(int i=0; i< nb_input_combs+1; i++){
 
     mpf_inits(epsilon[i], epsilon_max[i], mu[i], mu_max[i], gamma[i], gamma_max[i], NULL);
+    if(sweeps){
+      sweeps[i] = make_combined_sweep(length, total_wires+1, k);
+    }
 
     // Constructing input faults prefix
     int size_input_comb;
@@ -508,13 +542,21 @@ void compute_CRPC_val(ParsedFile * pf, int coeff_max, int k, int t, double pleak
      // No internal faults
     if(i < nb_input_combs){
       if(!no_internal_faults_scenario_fails){
-        uint64_t * coeffs = calloc(total_wires+1, sizeof(*coeffs));
-        fread(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
-
-        compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon[i], -1);
-        compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon_max[i], coeff_max);
+        Coeff * coeffs = calloc(total_wires+1, sizeof(*coeffs));
+        read_coeffs(coeffs_file, version, coeffs, total_wires+1);
+
+        if(sweeps){
+          combined_sweep_add(sweeps[i], 0, coeffs);
+        } else{
+          compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon[i], -1);
+          compute_combined_intermediate_leakage_proba(coeffs, 0, length, total_wires+1, pleak, pfault, epsilon_max[i], coeff_max);
+        }
+        clear_coeffs(coeffs, total_wires+1);
         free(coeffs);
       }
+      else if(sweeps){
+        combined_sweep_add_ignored(sweeps[i], 0);
+      }
       else{
         compute_combined_intermediate_mu(0, length, pfault, mu[i]);
         compute_combined_intermediate_mu(0, length, pfault, mu_max[i]);
@@ -537,16 +579,25 @@ void compute_CRPC_val(ParsedFile * pf, int coeff_max, int k, int t, double pleak
         fv->length = f;
 
         if(ignore_faulty_scenario(fv, sfc)){
-          compute_combined_intermediate_mu(f, length, pfault, mu[i]);
-          compute_combined_intermediate_mu(f, length, pfault, mu_max[i]);
+          if(sweeps){
+            combined_sweep_add_ignored(sweeps[i], f);
+          } else{
+            compute_combined_intermediate_mu(f, length, pfault, mu[i]);
+            compute_combined_intermediate_mu(f, length, pfault, mu_max[i]);
+          }
           goto skip;
         }
         
-        uint64_t * coeffs = calloc(total_wires+1, sizeof(*coeffs));
-        fread(coeffs, sizeof(*coeffs), total_wires+1, coeffs_file);
-
-        compute_combined_intermediate_leakage_proba(coeffs, f, length, total_wires+1, pleak, pfault, epsilon[i], -1);
-        compute_combined_intermediate_leakage_proba(coeffs, f, length, total_wires+1, pleak, pfault, epsilon_max[i], coeff_max);
+        Coeff * coeffs = calloc(total_wires+1, sizeof(*coeffs));
+        read_coeffs(coeffs_file, version, coeffs, total_wires+1);
+
+        if(sweeps){
+          combined_sweep_add(sweeps[i], f, coeffs);
+        } else{
+          compute_combined_intermediate_leakage_proba(coeffs, f, length, total_wires+1, pleak, pfault, epsilon[i], -1);
+          compute_combined_intermediate_leakage_proba(coeffs, f, length, total_wires+1, pleak, pfault, epsilon_max[i], coeff_max);
+        }
+        clear_coeffs(coeffs, total_wires+1);
         free(coeffs);
 
         // gmp_printf("%.10Ff\n", epsilon[i]);
@@ -571,6 +622,7 @@ void compute_CRPC_val(ParsedFile * pf, int coeff_max, int k, int t, double pleak
     
     free_faults_combs(sfc);
 
+    if(sweeps) continue;
 
     compute_combined_mu_max(k, length, pfault, mu_max[i]);
 
@@ -596,6 +648,14 @@ void compute_CRPC_val(ParsedFile * pf, int coeff_max, int k, int t, double pleak
   }
 
   int idx_max = 0;
+  if(sweeps){
+    write_combined_sweep(sweeps, nb_input_combs+1, coeff_max);
+    for(int i=0; i<nb_input_combs+1; i++){
+      free_combined_sweep(sweeps[i]);
+    }
+    free(sweeps);
+    goto end;
+  }
   for(int i=1; i<nb_input_combs+1; i++){
     if(mpf_cmp(gamma[i], gamma[idx_max]) > 0){
       idx_max = i;
@@ -603,7 +663,7 @@ void compute_CRPC_val(ParsedFile * pf, int coeff_max, int k, int t, double pleak
   }
 
   printf("\n\n");
-  gmp_printf("pfault = %.10Ff, pleak = %.10Ff:\n\n", pfault, pleak);  
+  printf("pfault = %.10f, pleak = %.10f:\n\n", pfault, pleak);  
 
   gmp_printf("epsilon min = %.10Ff\n", epsilon[idx_max]);
   gmp_printf("mu min = %.10Ff\n", mu[idx_max]);
@@ -613,6 +673,7 @@ void compute_CRPC_val(ParsedFile * pf, int coeff_max, int k, int t, double pleak
   gmp_printf("mu max = %.10Ff\n", mu_max[idx_max]);
   gmp_printf("gamma max = %.10Ff\n", gamma_max[idx_max]);
 
+  end:
   fclose(coeffs_file);
   fclose(faulty_combs_file);
   for(int i=0; i<length; i++){
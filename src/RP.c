@@ -14,10 +14,12 @@
 #include "verification_rules.h"
 #include "dimensions.h"
 #include "constructive_arith.h"
+#include "shard.h"
+#include "sweep.h"
 
 
 struct callback_data {
-  uint64_t* coeffs;
+  CoeffsData coeffs_data; // Must come first (see coeffs_accumulator)
   bool dimension_reduction;
   Circuit* init_circuit;
   int* new_to_old_mapping;
@@ -28,19 +30,67 @@ static void update_coeffs(const Circuit* c, Comb* comb, int comb_len, SecretDep*
                           void* data_void) {
   struct callback_data* data = (struct callback_data*) data_void;
   (void) secret_deps;
-  uint64_t* coeffs = data->coeffs;
+  Coeff* coeffs = data->coeffs_data.coeffs;
 
   /* printf("[ "); */
   /* for (int i = 0; i < comb_len; i++) printf("%d ", comb[i]); */
   /* printf("]\n"); */
 
-  update_coeff_c_single(c, coeffs, comb, comb_len);
+  if (data->coeffs_data.histogram) {
+    coeff_histogram_add(data->coeffs_data.histogram, c, comb, comb_len);
+  } else {
+    update_coeff_c_single(c, coeffs, comb, comb_len);
+  }
 }
 
+// Prints the coefficients of |coeffs| starting from |first| (the
+// previous ones have already been printed), followed by the
+// corresponding bounds on the leakage probability.
+static void print_RP_coeffs(Coeff* coeffs, int first, int total_wires,
+                            int coeff_max, int coeff_max_main_loop) {
+  for (int i = first; i < total_wires; i++) {
+    fprint_coeff(stdout, coeffs[i]);
+    printf(", ");
+  }
+  fprint_coeff(stdout, coeffs[total_wires]);
+  printf(" ]\n");
+
+  double p_min = compute_leakage_proba(coeffs, coeff_max,
+                                       total_wires+1,
+                                       1, // minimax
+                                       false); // square root
+  double p_max = compute_leakage_proba(coeffs, coeff_max,
+                                       total_wires+1,
+                                       -1, // minimax
+                                       false); // square root
+
+  printf("\n");
+  printf("pmax = %.10f -- log2(pmax) = %.10f\n", p_max, log2(p_max));
+  printf("pmin = %.10f -- log2(pmin) = %.10f\n", p_min, log2(p_min));
+  printf("\n");
+
+  get_failure_proba(coeffs, total_wires+1, 0.01, coeff_max_main_loop);
+
+  if (sweep_enabled()) {
+    write_failure_proba_sweep(coeffs, total_wires+1, coeff_max_main_loop);
+  }
+}
+
+void merge_RP_shards(const ShardResult* result) {
+  int count;
+  Coeff** coeffs = get_shard_vectors(result, "f", &count);
+  if (count != 1) {
+    fprintf(stderr, "Invalid RP shards: expected a single coefficient vector. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  printf("f(p) = [ ");
+  print_RP_coeffs(coeffs[0], 1, result->total_wires,
+                  result->coeff_max, result->coeff_max_main_loop);
+}
 
 void compute_RP_coeffs(Circuit* circuit, int cores, int coeff_max, int opt_incompr) {
   // Initializing coefficients
-  uint64_t coeffs[circuit->total_wires+1];
+  Coeff coeffs[circuit->total_wires+1];
   for (int i = 0; i <= circuit->total_wires; i++) {
     coeffs[i] = 0;
   }
@@ -62,12 +112,16 @@ void compute_RP_coeffs(Circuit* circuit, int cores, int coeff_max, int opt_incom
     Trie* incompr_tuples = opt_incompr ? make_trie(circuit->length) : NULL;
 
     struct callback_data data = {
-      .coeffs = coeffs,
+      .coeffs_data = { .size = sizeof(data), .coeffs = coeffs,
+                       .coeffs_len = circuit->total_wires+1 },
     };
 
 
     // Computing coefficients
-    printf("f(p) = [ "); fflush(stdout);
+    bool sharded = is_sharded();
+    if (!sharded) {
+      printf("f(p) = [ "); fflush(stdout);
+    }
     for (int size = 0; size <= coeff_max_main_loop; size++) {
 
       find_all_failures(circuit,
@@ -84,37 +138,32 @@ void compute_RP_coeffs(Circuit* circuit, int cores, int coeff_max, int opt_incom
                         false, // PINI
                         incompr_tuples,
                         update_coeffs,
-                        (void*)&data);
+                        (void*)&data,
+                        &coeffs_accumulator);
 
       // A failure of size 0 is not possible. However, we still want to
       // iterate in the loop with |size| = 0 to generate the tuples with
       // only elementary shares (which, because of the dimension
       // reduction, are never generated otherwise).
-      if (size > 0) {
-        printf("%"PRIu64", ", coeffs[size]); fflush(stdout);
+      if (size > 0 && !sharded) {
+        fprint_coeff(stdout, coeffs[size]);
+        printf(", "); fflush(stdout);
       }
     } 
 
-    for (int i = coeff_max_main_loop+1; i < dim_red_data->old_circuit->total_wires; i++) {
-      printf("%"PRIu64", ", coeffs[i]);
+    if (sharded) {
+      // The coefficients only account for the tuples of this shard:
+      // they are saved, and will be printed once all shards are merged.
+      ShardResult* result = init_shard_result("RP", circuit, coeff_max, coeff_max_main_loop,
+                                              -1, -1); // t, t_output
+      add_shard_vector(result, "f", coeffs);
+      write_shard_result(result);
+      free_shard_result(result);
+    } else {
+      print_RP_coeffs(coeffs, coeff_max_main_loop+1, circuit->total_wires,
+                      coeff_max, coeff_max_main_loop);
     }
-    printf("%"PRIu64" ]\n", coeffs[circuit->total_wires]);
-
-    double p_min = compute_leakage_proba(coeffs, coeff_max,
-                                         circuit->total_wires+1,
-                                         1, // minimax
-                                         false); // square root
-    double p_max = compute_leakage_proba(coeffs, coeff_max,
-                                         circuit->total_wires+1,
-                                         -1, // minimax
-                                         false); // square root
-
-    printf("\n");
-    printf("pmax = %.10f -- log2(pmax) = %.10f\n", p_max, log2(p_max));
-    printf("pmin = %.10f -- log2(pmin) = %.10f\n", p_min, log2(p_min));
-    printf("\n");
-
-    get_failure_proba(coeffs, circuit->total_wires+1, 0.01, coeff_max_main_loop);
+
     free_dim_red_data(dim_red_data);
   }
 }
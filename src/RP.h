@@ -1,5 +1,10 @@
 #pragma once
 
 #include "circuit.h"
+#include "shard.h"
 
 void compute_RP_coeffs(Circuit* circuit, int cores, int coeff_max, int opt_incompr);
+
+// Prints the RP coefficients and leakage probabilities of the merged
+// shards |result|.
+void merge_RP_shards(const ShardResult* result);
@@ -13,10 +13,13 @@
 #include "coeffs.h"
 #include "verification_rules.h"
 #include "constructive_arith.h"
+#include "shard.h"
+
+#define max(a,b) ((a) > (b) ? (a) : (b))
 
 struct callback_data {
+  CoeffsData coeffs_data; // Must come first (see coeffs_accumulator)
   int t;
-  uint64_t* coeffs;
 };
 
 
@@ -26,7 +29,41 @@ static void update_coeffs(const Circuit* c, Comb* comb, int comb_len, SecretDep*
   struct callback_data* data = (struct callback_data*) data_void;
   int t = data->t;
 
-  update_coeff_c_single(c, data->coeffs, &comb[t], comb_len-t);
+  if (data->coeffs_data.histogram) {
+    coeff_histogram_add(data->coeffs_data.histogram, c, &comb[t], comb_len-t);
+  } else {
+    update_coeff_c_single(c, data->coeffs_data.coeffs, &comb[t], comb_len-t);
+  }
+}
+
+// Prints the coefficients of |coeffs| starting from |first| (the
+// previous ones have already been printed), followed by the
+// corresponding bounds on the leakage probability.
+static void print_RPC_coeffs(Coeff* coeffs, int first, int total_wires, int coeff_max) {
+  for (int i = first; i <= coeff_max; i++) {
+    fprint_coeff(stdout, coeffs[i]);
+    printf(", ");
+  }
+  for (int i = max(first, coeff_max+1); i <= total_wires; i++) {
+    fprint_coeff(stdout, coeffs[i]);
+    printf("%s ", i == total_wires ? "" : ",");
+  }
+  printf("]\n");
+
+
+  double p_min = compute_leakage_proba(coeffs, coeff_max,
+                                       total_wires+1,
+                                       1, // minimax
+                                       false); // square root
+  double p_max = compute_leakage_proba(coeffs, coeff_max,
+                                       total_wires+1,
+                                       -1, // minimax
+                                       false); // square root
+
+  printf("\n");
+  printf("pmax = %.10f -- log2(pmax) = %.10f\n", p_max, log2(p_max));
+  printf("pmin = %.10f -- log2(pmin) = %.10f\n", p_min, log2(p_min));
+  printf("\n");
 }
 
 void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
@@ -36,7 +73,7 @@ void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
   }
   else {
     // Initializing coefficients
-    uint64_t coeffs[circuit->total_wires+1];
+    Coeff coeffs[circuit->total_wires+1];
     for (int i = 0; i <= circuit->total_wires; i++) {
       coeffs[i] = 0;
     }
@@ -57,7 +94,7 @@ void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
       }
     }
 
-    uint64_t** coeffs_out_comb;
+    Coeff** coeffs_out_comb;
     coeffs_out_comb = malloc(out_comb_len * sizeof(*coeffs_out_comb));
     for (unsigned i = 0; i < out_comb_len; i++) {
       coeffs_out_comb[i] = calloc(circuit->total_wires + 1, sizeof(*coeffs_out_comb[i]));
@@ -65,16 +102,21 @@ void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
 
     VarVector verif_prefix = { .length = t_output, .max_size = t_output, .content = NULL };
 
-    struct callback_data data = { .t = t_output, .coeffs = NULL };
+    struct callback_data data = { .coeffs_data = { .size = sizeof(data), .coeffs = NULL,
+                                                   .coeffs_len = circuit->total_wires + 1 },
+                                  .t = t_output };
 
 
     // Computing coefficients
-    printf("f(p) = [ "); fflush(stdout);
+    bool sharded = is_sharded();
+    if (!sharded) {
+      printf("f(p) = [ "); fflush(stdout);
+    }
     for (int size = 0; size <= coeff_max; size++) {
 
       for (unsigned int i = 0; i < out_comb_len; i++) {
         verif_prefix.content = out_comb_arr[i];
-        data.coeffs = coeffs_out_comb[i];
+        data.coeffs_data.coeffs = coeffs_out_comb[i];
 
         find_all_failures(circuit,
                           cores,
@@ -90,39 +132,39 @@ void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
                           false, // PINI
                           incompr_tuples, // incompr_tuples
                           update_coeffs,
-                          (void*)&data);
-  
-  #define max(a,b) ((a) > (b) ? (a) : (b))
-        coeffs[size] = max(coeffs[size], coeffs_out_comb[i][size]);
+                          (void*)&data,
+                          &coeffs_accumulator);
+
+        coeff_set_max(&coeffs[size], coeffs_out_comb[i][size]);
       }
 
-      printf("%"PRIu64", ", coeffs[size]);
-      fflush(stdout);
+      if (!sharded) {
+        fprint_coeff(stdout, coeffs[size]);
+        printf(", ");
+        fflush(stdout);
+      }
     }
 
-    // Printing the remaining coefficients
-    for (int i = coeff_max+1; i <= circuit->total_wires; i++) {
-      for (unsigned j = 0; j < out_comb_len; j++) {
-        coeffs[i] = max(coeffs[i], coeffs_out_comb[j][i]);
+    if (sharded) {
+      // The max over the output combinations can only be taken once
+      // all shards are merged: the coefficients of each output
+      // combination are thus saved separately.
+      ShardResult* result = init_shard_result("RPC", circuit, coeff_max, coeff_max,
+                                              t, t_output);
+      for (unsigned i = 0; i < out_comb_len; i++) {
+        add_shard_vector(result, "out", coeffs_out_comb[i]);
+      }
+      write_shard_result(result);
+      free_shard_result(result);
+    } else {
+      // Printing the remaining coefficients
+      for (int i = coeff_max+1; i <= circuit->total_wires; i++) {
+        for (unsigned j = 0; j < out_comb_len; j++) {
+          coeff_set_max(&coeffs[i], coeffs_out_comb[j][i]);
+        }
       }
-      printf("%"PRIu64"%s ", coeffs[i], i == circuit->total_wires ? "" : ",");
+      print_RPC_coeffs(coeffs, coeff_max+1, circuit->total_wires, coeff_max);
     }
-    printf("]\n");
-
-
-    double p_min = compute_leakage_proba(coeffs, coeff_max,
-                                       circuit->total_wires+1,
-                                       1, // minimax
-                                       false); // square root
-    double p_max = compute_leakage_proba(coeffs, coeff_max,
-                                       circuit->total_wires+1,
-                                       -1, // minimax
-                                       false); // square root
-
-    printf("\n");
-    printf("pmax = %.10f -- log2(pmax) = %.10f\n", p_max, log2(p_max));
-    printf("pmin = %.10f -- log2(pmin) = %.10f\n", p_min, log2(p_min));
-    printf("\n");
 
     // get_failure_proba(coeffs, circuit->total_wires+1, 0.01, -1);
     // get_failure_proba(coeffs, circuit->total_wires+1, 0.01, coeff_max);
@@ -131,6 +173,7 @@ void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
     // Freeing stuffs
     for (unsigned i = 0; i < out_comb_len; i++) {
       free(out_comb_arr[i]);
+      clear_coeffs(coeffs_out_comb[i], circuit->total_wires+1);
       free(coeffs_out_comb[i]);
     }
     free(out_comb_arr);
@@ -138,3 +181,19 @@ void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
     if (incompr_tuples) free_trie(incompr_tuples);
   }
 }
+
+void merge_RPC_shards(const ShardResult* result) {
+  int out_comb_len;
+  Coeff** coeffs_out_comb = get_shard_vectors(result, "out", &out_comb_len);
+
+  Coeff coeffs[result->total_wires+1];
+  for (int i = 0; i <= result->total_wires; i++) {
+    coeffs[i] = 0;
+    for (int j = 0; j < out_comb_len; j++) {
+      coeff_set_max(&coeffs[i], coeffs_out_comb[j][i]);
+    }
+  }
+
+  printf("f(p) = [ ");
+  print_RPC_coeffs(coeffs, 0, result->total_wires, result->coeff_max);
+}
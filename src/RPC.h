@@ -1,6 +1,11 @@
 #pragma once
 
 #include "circuit.h"
+#include "shard.h"
 
 void compute_RPC_coeffs(Circuit* circuit, int cores, int coeff_max,
                         int opt_incompr, int t, int t_output);
+
+// Prints the RPC coefficients and leakage probabilities of the merged
+// shards |result|.
+void merge_RPC_shards(const ShardResult* result);
@@ -8,12 +8,16 @@
 
 #include "RPE.h"
 #include "config.h"
+#include "hash_tuples.h"
 #include "circuit.h"
 #include "list_tuples.h"
 #include "combinations.h"
 #include "coeffs.h"
 #include "verification_rules.h"
 #include "constructive_arith.h"
+#include "shard.h"
+#include "checkpoint.h"
+#include "stats.h"
 
 #define COEFFS_COUNT    4
 #define I1_or_I2        0
@@ -28,6 +32,44 @@
 
 #define max(a,b) ((a) > (b) ? (a) : (b))
 #define min(a,b) ((a) < (b) ? (a) : (b))
+
+static const char* coeffs_names[COEFFS_COUNT] = {
+  [I1_or_I2]  = I1_or_I2_STR,
+  [I1]        = I1_STR,
+  [I2]        = I2_STR,
+  [I1_and_I2] = I1_and_I2_STR
+};
+
+// Prints the |coeffs_count| arrays of coefficients |coeffs| computed
+// for the property |name| (RPE1, RPE2, RPE12 or RPE21).
+static void print_RPE_coeffs(const char* name, Coeff** coeffs, int coeffs_count,
+                             int total_wires) {
+  for (int i = 0; i < coeffs_count; i++) {
+    printf("%s- %s: [ ", name, coeffs_names[i]);
+    for (int j = 0; j < total_wires; j++) {
+      fprint_coeff(stdout, coeffs[i][j]);
+      printf(", ");
+    }
+    printf("]\n");
+  }
+  printf("\n");
+}
+
+// Returns the max over the |out_comb_len| output combinations of the
+// |coeffs_count| arrays of coefficients |coeffs_out_comb|.
+static Coeff** max_out_combs(Coeff*** coeffs_out_comb, uint64_t out_comb_len,
+                              int coeffs_count, int coeffs_len) {
+  Coeff** coeffs = malloc(coeffs_count * sizeof(*coeffs));
+  for (int i = 0; i < coeffs_count; i++) {
+    coeffs[i] = calloc(coeffs_len, sizeof(*coeffs[i]));
+    for (unsigned j = 0; j < out_comb_len; j++) {
+      for (int size = 0; size < coeffs_len; size++) {
+        coeff_set_max(&coeffs[i][size], coeffs_out_comb[j][i][size]);
+      }
+    }
+  }
+  return coeffs;
+}
 static double min_arr(double* arr, int len) {
   double min_val = arr[0];
   for (int i = 1; i < len; i++) min_val = min(min_val, arr[i]);
@@ -37,196 +79,65 @@ static double min_arr(double* arr, int len) {
 
 /*************************************************
 
-   HashTable implementation, used for RPE2
-
-
-  TODO: make this implementation more generic so that it can be used
-  by failures_from_incompr as well.
+   Hash maps of failures, used for RPE2
 
 **************************************************/
 
-
-
-#define HASH_MASK 0x1ffffff // 500M -> times 8 (sizeof a pointer) = 4GB table
-#define HASH_SIZE (HASH_MASK+1)
-
-// Computes a hash for integer |x|.
-// Hash function for integers from https://stackoverflow.com/a/12996028/4990392
-static unsigned int hash_int(unsigned int x) {
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = (x >> 16) ^ x;
-  return x;
+// The failures are stored in TupleMaps (see hash_tuples.h) whose keys
+// are the packed failures (see comb_key_pack), of length at most
+// |max_len|, and whose payloads are the number of times each failure
+// was found.
+static TupleMap* init_hash(int max_len) {
+  return make_tuple_map(comb_key_size(max_len), sizeof(int), NULL);
 }
 
-// Computes a hash for |comb| by summing the hashes of each of its elements.
-static unsigned int hash_comb(Comb* comb, int comb_len) {
-  unsigned int hash = 0;
-  for (int i = 0; i < comb_len; i++) {
-    hash += hash_int(comb[i]);
-  }
-  return hash & HASH_MASK;
+static inline int* failure_count(TupleMap* map, void* slot) {
+  return tuple_map_value(map, slot);
 }
 
-typedef struct _hashnode {
-  Comb* comb;
-  int comb_len;
-  int count;
-  struct _hashnode* next;
-} HashNode;
-
-typedef struct _hashmap {
-  HashNode** content;
-  int count; // The number of elements that are in this hashmap
-  int collisions; // The number of collisions
-} HashMap;
-
-// Allocates and initializes an empty hash map.
-static HashMap* init_hash() {
-  HashMap* map    = malloc(sizeof(*map));
-  map->content    = calloc(HASH_SIZE, sizeof(*(map->content)));
-  map->count      = 0;
-  map->collisions = 0;
-  return map;
+// Adds the failure |key| (whose hash is |hash|) to |map|, or
+// increments its count if it is already in |map|.
+static void add_to_hash(TupleMap* map, void* key, uint64_t hash) {
+  void* slot = tuple_map_insert_hashed(map, key, hash, NULL);
+  (*failure_count(map, slot))++;
 }
 
-
-static HashNode* hash_contains_keyed(HashMap* map, Comb* comb, int comb_len, int hash) {
-  HashNode* node = map->content[hash];
-  while (node) {
-    if (comb_len == node->comb_len &&
-        memcmp(node->comb, comb, comb_len * sizeof(*comb)) == 0) {
-      return node;
-    }
-    node = node->next;
-  }
-  return NULL;
+static bool count_is_1(const TupleMap* map, void* slot, void* data) {
+  (void) data;
+  return *(int*)tuple_map_value(map, slot) == 1;
 }
 
-// Adds |comb| to |map|.
-static Comb* add_to_hash_keyed(HashMap* map, Comb* comb, int comb_len, int hash,
-                               int realloc_comb) {
-  HashNode* node = hash_contains_keyed(map, comb, comb_len, hash);
-  if (node) {
-    node->count++;
-    return node->comb;
-  } else {
-    node = malloc(sizeof(*node));
-    Comb* comb_copy = comb;
-    if (realloc_comb) {
-      comb_copy = malloc(comb_len * sizeof(*comb_copy));
-      memcpy(comb_copy, comb, comb_len * sizeof(*comb_copy));
-    }
-    node->comb = comb_copy;
-    node->comb_len = comb_len;
-    node->count = 1;
-    node->next = map->content[hash];
-    map->content[hash] = node;
-    return comb_copy;
-  }
+static bool count_is_not(const TupleMap* map, void* slot, void* data) {
+  return *(int*)tuple_map_value(map, slot) != *(int*)data;
 }
 
-// Adds |comb| to |map|. If |realloc_comb| is true, then another comb
-// is malloced before adding it to the hash. Otherwise, |comb| is
-// directly added in the hash. This is useful because for RPE2, combs
-// can be put in at most 4 hashes: I1_or_I2, I1, I2 and
-// I1_and_I2. It's thus less time-consuming and less memory-consuming
-// to only malloc the comb once for I1_or_I2 and reuse it as is in the
-// other tables.
-static Comb* add_to_hash(HashMap* map, Comb* comb, int comb_len, int realloc_comb) {
-  unsigned int hash = hash_comb(comb, comb_len);
-  return add_to_hash_keyed(map, comb, comb_len, hash, realloc_comb);
+static bool len_is(const TupleMap* map, void* slot, void* data) {
+  (void) map;
+  return comb_key_len(slot) == *(int*)data;
 }
 
-// Removes from |map| all element whose count is 1. If |free_comb| is
-// true, then each comb's ->comb member is freed, otherwise they
-// aren't.
-static void remove_count_1(HashMap* map, int free_comb) {
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* prev = NULL;
-    HashNode* node = map->content[i];
-    while (node) {
-      HashNode* next = node->next;
-      if (node->count == 1) {
-        if (free_comb) free(node->comb);
-        if (prev) {
-          prev->next = next;
-        } else {
-          map->content[i] = next;
-        }
-        free(node);
-      } else {
-        prev = node;
-      }
-      node = next;
-    }
-  }
+// Removes from |map| all element whose count is 1.
+static void remove_count_1(TupleMap* map) {
+  stats_record_size("RPE_failures_hash", map->count);
+  tuple_map_remove_if(map, count_is_1, NULL);
 }
 
-// Removes from |map| all element whose count is |target|. If
-// |free_comb| is true, then each comb's ->comb member is freed,
-// otherwise they aren't.
-static void remove_count_diff(HashMap* map, int target, int free_comb) {
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* prev = NULL;
-    HashNode* node = map->content[i];
-    while (node) {
-      HashNode* next = node->next;
-      if (node->count != target) {
-        if (free_comb) free(node->comb);
-        if (prev) {
-          prev->next = next;
-        } else {
-          map->content[i] = next;
-        }
-        free(node);
-      } else {
-        prev = node;
-      }
-      node = next;
-    }
-  }
+// Removes from |map| all element whose count is not |target|.
+static void remove_count_diff(TupleMap* map, int target) {
+  stats_record_size("RPE_failures_hash", map->count);
+  tuple_map_remove_if(map, count_is_not, &target);
 }
 
-// Removes from |map| all elements whose length is |n|. If |free_comb|
-// is true, then each comb's ->comb member is freed, otherwise they
-// aren't.
-static void remove_len_n(HashMap* map, int n, int free_comb) {
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* prev = NULL;
-    HashNode* node = map->content[i];
-    while (node) {
-      HashNode* next = node->next;
-      if (node->comb_len == n) {
-        if (free_comb) free(node->comb);
-        if (prev) {
-          prev->next = next;
-        } else {
-          map->content[i] = next;
-        }
-        free(node);
-      } else {
-        prev = node;
-      }
-      node = next;
-    }
-  }
+// Removes from |map| all elements whose length is |n|.
+static void remove_len_n(TupleMap* map, int n) {
+  stats_record_size("RPE_failures_hash", map->count);
+  tuple_map_remove_if(map, len_is, &n);
 }
 
-// Empties |map| without freeing |map| itself or its ->content
-// member. If |free_comb| is true, then each comb's ->comb member is
-// freed, otherwise they aren't.
-static void empty_hash(HashMap* map, int free_comb) {
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* node = map->content[i];
-    while (node) {
-      HashNode* next = node->next;
-      if (free_comb) free(node->comb);
-      free(node);
-      node = next;
-    }
-    map->content[i] = NULL;
-  }
+// Empties |map| without freeing it.
+static void empty_hash(TupleMap* map) {
+  stats_record_size("RPE_failures_hash", map->count);
+  tuple_map_clear(map);
 }
 
 
@@ -238,39 +149,100 @@ static void empty_hash(HashMap* map, int free_comb) {
 
 struct callback_data_RPE1 {
   int t;
-  uint64_t** coeff_c;
+  Coeff** coeff_c;
+  CoeffHistogram** histograms; // Count the failures in each array of
+                               // |coeff_c| (only in the copies of the
+                               // threads, NULL otherwise)
+  int coeffs_count; // Number of arrays in |coeff_c|
+  int coeffs_len;   // Length of each array of |coeff_c|
 };
 
+// Adds the failure |comb| to |coeffs[i]|, through |histograms[i]| if
+// |histograms| is not NULL.
+static void add_failure(const Circuit* c, Coeff** coeffs,
+                        CoeffHistogram** histograms, int i,
+                        Comb* comb, int comb_len) {
+  if (histograms) {
+    coeff_histogram_add(histograms[i], c, comb, comb_len);
+  } else {
+    update_coeff_c_single(c, coeffs[i], comb, comb_len);
+  }
+}
+
+// Creates the |coeffs_count| arrays of coefficients of a thread (see
+// make_thread_coeffs), and sets *|histograms| to their histograms.
+static Coeff** make_thread_coeff_arrays(int coeffs_count, int coeffs_len,
+                                        CoeffHistogram*** histograms) {
+  Coeff** coeffs = malloc(coeffs_count * sizeof(*coeffs));
+  *histograms = malloc(coeffs_count * sizeof(**histograms));
+  for (int i = 0; i < coeffs_count; i++) {
+    coeffs[i] = make_thread_coeffs(coeffs_len, &(*histograms)[i]);
+  }
+  return coeffs;
+}
+
+static void merge_thread_coeff_arrays(Coeff** coeffs, Coeff** thread_coeffs,
+                                      CoeffHistogram** histograms,
+                                      int coeffs_count, int coeffs_len) {
+  for (int i = 0; i < coeffs_count; i++) {
+    merge_thread_coeffs(coeffs[i], thread_coeffs[i], histograms[i], coeffs_len);
+  }
+  free(thread_coeffs);
+  free(histograms);
+}
+
 static void update_coeffs_RPE(const Circuit* c, Comb* comb, int comb_len,
                               SecretDep* secret_deps,
                               void* data_void) {
   struct callback_data_RPE1* data = (struct callback_data_RPE1*) data_void;
   int t = data->t;
-  uint64_t** coeff_c = data->coeff_c;
+  Coeff** coeff_c = data->coeff_c;
 
   int secret_count = c->secret_count;
   assert(secret_count <= 2);
   // I1_or_I2 can be updated without checking |secret_deps|, since at
   // least one has to be true, or |comb| would not be a failure and
   // this function would not be called.
-  update_coeff_c_single(c, coeff_c[I1_or_I2], &comb[t], comb_len-t);
+  add_failure(c, coeff_c, data->histograms, I1_or_I2, &comb[t], comb_len-t);
 
   if (secret_count > 1) {
 
     if (secret_deps[0]) {
-      update_coeff_c_single(c, coeff_c[I1], &comb[t], comb_len-t);
+      add_failure(c, coeff_c, data->histograms, I1, &comb[t], comb_len-t);
     }
 
     if (secret_deps[1]) {
-      update_coeff_c_single(c, coeff_c[I2], &comb[t], comb_len-t);
+      add_failure(c, coeff_c, data->histograms, I2, &comb[t], comb_len-t);
     }
 
     if (secret_deps[0] && secret_deps[1]) {
-      update_coeff_c_single(c, coeff_c[I1_and_I2], &comb[t], comb_len-t);
+      add_failure(c, coeff_c, data->histograms, I1_and_I2, &comb[t], comb_len-t);
     }
   }
 }
 
+static void* make_thread_data_RPE1(void* data_void) {
+  struct callback_data_RPE1* data = (struct callback_data_RPE1*) data_void;
+  struct callback_data_RPE1* thread_data = malloc(sizeof(*thread_data));
+  *thread_data = *data;
+  thread_data->coeff_c = make_thread_coeff_arrays(data->coeffs_count, data->coeffs_len,
+                                                  &thread_data->histograms);
+  return thread_data;
+}
+
+static void merge_thread_data_RPE1(void* data_void, void* thread_data_void) {
+  struct callback_data_RPE1* data = (struct callback_data_RPE1*) data_void;
+  struct callback_data_RPE1* thread_data = (struct callback_data_RPE1*) thread_data_void;
+  merge_thread_coeff_arrays(data->coeff_c, thread_data->coeff_c, thread_data->histograms,
+                            data->coeffs_count, data->coeffs_len);
+  free(thread_data);
+}
+
+static const FailureAccumulator coeffs_accumulator_RPE1 = {
+  .make  = make_thread_data_RPE1,
+  .merge = merge_thread_data_RPE1
+};
+
 // RPE1:
 //
 //
@@ -288,16 +260,15 @@ static void update_coeffs_RPE(const Circuit* c, Comb* comb, int comb_len,
 //  - failure for both inputs
 //  - (not used in official definition, mostly for debuging): failure for either input.
 //
-uint64_t** compute_RPE1(Circuit* circuit, DimRedData* dim_red_data,
-                        int cores, int coeff_max, int t, int t_output) {
+// If |shard| is not NULL, the coefficients of each output combination
+// are added to |shard| rather than printed.
+//
+Coeff** compute_RPE1(Circuit* circuit, DimRedData* dim_red_data,
+                      int cores, int coeff_max, int t, int t_output,
+                      ShardResult* shard) {
   int secret_count = circuit->secret_count;
   int coeffs_count = secret_count == 1 ? 1 : COEFFS_COUNT;
 
-  uint64_t** coeffs = malloc(coeffs_count * sizeof(*coeffs));
-  for (int i = 0; i < coeffs_count; i++) {
-    coeffs[i] = calloc(circuit->total_wires+1, sizeof(*coeffs[i]));
-  }
-
   int coeff_max_main_loop = coeff_max == -1 ? circuit->length :
     coeff_max > circuit->length ? circuit->length : coeff_max;
 
@@ -351,7 +322,7 @@ uint64_t** compute_RPE1(Circuit* circuit, DimRedData* dim_red_data,
     t_output *= 2;
   }
 
-  uint64_t*** coeffs_out_comb;
+  Coeff*** coeffs_out_comb;
   coeffs_out_comb = malloc(out_comb_len * sizeof(*coeffs_out_comb));
   for (unsigned i = 0; i < out_comb_len; i++) {
     coeffs_out_comb[i] = malloc(coeffs_count * sizeof(*coeffs_out_comb[i]));
@@ -360,12 +331,23 @@ uint64_t** compute_RPE1(Circuit* circuit, DimRedData* dim_red_data,
     }
   }
 
-  struct callback_data_RPE1 data = { .t = t_output, .coeff_c = NULL };
+  struct callback_data_RPE1 data = { .t = t_output, .coeff_c = NULL,
+                                     .coeffs_count = coeffs_count,
+                                     .coeffs_len = circuit->total_wires + 1 };
   VarVector verif_prefix = { .length = t_output, .max_size = t_output, .content = NULL };
 
+  char name[32];
+  for (unsigned i = 0; i < out_comb_len; i++) {
+    for (int j = 0; j < coeffs_count; j++) {
+      sprintf(name, "RPE1.%u.%d", i, j);
+      checkpoint_vector(name, coeffs_out_comb[i][j], circuit->total_wires + 1);
+    }
+  }
+
   for (int size = 0; size <= coeff_max_main_loop; size++) {
 
     for (unsigned int i = 0; i < out_comb_len; i++) {
+      if (checkpoint_skip_steps(1)) continue;
       verif_prefix.content = out_comb_arr[i];
       data.coeff_c = coeffs_out_comb[i];
 
@@ -383,52 +365,39 @@ uint64_t** compute_RPE1(Circuit* circuit, DimRedData* dim_red_data,
                         false, // PINI
                         NULL, // incompr_tuples
                         update_coeffs_RPE,
-                        (void*)&data);
-    }
-
-    for (int i = 0; i < coeffs_count; i++) {
-      for (unsigned j = 0; j < out_comb_len; j++) {
-#define max(a,b) ((a) > (b) ? (a) : (b))
-        coeffs[i][size] = max(coeffs[i][size], coeffs_out_comb[j][i][size]);
-      }
+                        (void*)&data,
+                        &coeffs_accumulator_RPE1);
+      checkpoint_step_done();
     }
   }
 
-  for (int size = coeff_max_main_loop+1; size <= circuit->total_wires; size++) {
-    for (int i = 0; i < coeffs_count; i++) {
-      for (unsigned j = 0; j < out_comb_len; j++) {
-        coeffs[i][size] = max(coeffs[i][size], coeffs_out_comb[j][i][size]);
+  // From now on, the checkpoints contain the max over the output
+  // combinations (and, when sharded, the vectors of |shard|) rather
+  // than the coefficients of each output combination.
+  Coeff** coeffs = max_out_combs(coeffs_out_comb, out_comb_len, coeffs_count,
+                                    circuit->total_wires + 1);
+  for (int i = 0; i < coeffs_count; i++) {
+    sprintf(name, "RPE1.%d", i);
+    checkpoint_vector(name, coeffs[i], circuit->total_wires + 1);
+  }
+  if (shard) {
+    for (unsigned j = 0; j < out_comb_len; j++) {
+      for (int i = 0; i < coeffs_count; i++) {
+        add_shard_vector(shard, "RPE1", coeffs_out_comb[j][i]);
       }
     }
+  } else {
+    print_RPE_coeffs("RPE1", coeffs, coeffs_count, circuit->total_wires);
   }
 
-  printf("RPE1- I1_or_I2: [ ");
-  for (int i = 0; i < circuit->total_wires; i++)
-    printf("%"PRIu64", ", coeffs[I1_or_I2][i]);
-  printf("]\n");
-
-  if (coeffs_count > 1) {
-    printf("RPE1- I1: [ ");
-    for (int i = 0; i < circuit->total_wires; i++)
-      printf("%"PRIu64", ", coeffs[I1][i]);
-    printf("]\n");
-    printf("RPE1- I2: [ ");
-    for (int i = 0; i < circuit->total_wires; i++)
-      printf("%"PRIu64", ", coeffs[I2][i]);
-    printf("]\n");
-    printf("RPE1- I1_and_I2: [ ");
-    for (int i = 0; i < circuit->total_wires; i++)
-      printf("%"PRIu64", ", coeffs[I1_and_I2][i]);
-    printf("]\n");
-  }
-  printf("\n");
-
   for (unsigned i = 0; i < out_comb_len; i++) {
     free(out_comb_arr[i]);
   }
   free(out_comb_arr);
   for (unsigned i = 0; i < out_comb_len; i++) {
     for (int j = 0; j < coeffs_count; j++) {
+      checkpoint_forget(coeffs_out_comb[i][j]);
+      clear_coeffs(coeffs_out_comb[i][j], circuit->total_wires + 1);
       free(coeffs_out_comb[i][j]);
     }
     free(coeffs_out_comb[i]);
@@ -454,16 +423,20 @@ uint64_t** compute_RPE1(Circuit* circuit, DimRedData* dim_red_data,
 
 struct callback_data_RPE2 {
   int base_size;
-  HashMap** failures;
+  TupleMap** failures;
   int count;
-  bool low_memory;
-  // The variables below are used only if |low_memory| is true.
+  // The variables below are only used by compute_RPE2 (the failures
+  // are then checked against all output combinations right away rather
+  // than saved in |failures|).
   Circuit* circuit;
   DimRedData* dim_red_data;
   int t_in;
   uint64_t out_comb_len;
   Comb** out_comb_arr;
-  uint64_t** coeffs;
+  Coeff** coeffs;
+  CoeffHistogram** histograms; // Same as in callback_data_RPE1
+  int coeffs_count; // Number of arrays in |coeffs|
+  int coeffs_len;   // Length of each array of |coeffs|
 };
 
 void save_failure_to_map(const Circuit* c, Comb* comb, int comb_len,
@@ -471,7 +444,7 @@ void save_failure_to_map(const Circuit* c, Comb* comb, int comb_len,
                          void* data_void) {
   struct callback_data_RPE2* data = (struct callback_data_RPE2*) data_void;
   int base_size = data->base_size;
-  HashMap** failures = data->failures;
+  TupleMap** failures = data->failures;
   int count = data->count;
   int secret_count = c->secret_count;
 
@@ -480,53 +453,40 @@ void save_failure_to_map(const Circuit* c, Comb* comb, int comb_len,
   // when inserting in failures[I1_or_I2], we know that one of the 2
   // is a failure (and we don't care which one).
 
-  if (count == 0) {
-    Comb* comb_malloced = add_to_hash(failures[I1_or_I2], &comb[base_size],
-                                      comb_len-base_size, 1);
-    if (secret_count > 1) {
-      if (secret_deps[0]) {
-        add_to_hash(failures[I1], comb_malloced, comb_len-base_size, 0);
-      }
-      if (secret_deps[1]) {
-        add_to_hash(failures[I2], comb_malloced, comb_len-base_size, 0);
-      }
-      if (secret_deps[0] && secret_deps[1]) {
-        add_to_hash(failures[I1_and_I2], comb_malloced, comb_len-base_size, 0);
-      }
+  // All maps have the same keys: the failure is packed and hashed
+  // once.
+  int key_size = failures[I1_or_I2]->key_size;
+  char key[key_size];
+  comb_key_pack(key, key_size, &comb[base_size], comb_len-base_size);
+  uint64_t hash = tuple_map_key_hash(failures[I1_or_I2], key);
+
+  if (count != 0 && !tuple_map_find_hashed(failures[I1_or_I2], key, hash)) {
+    // Not already in the hash, no need to add it; nothing to do
+    return;
+  }
+  add_to_hash(failures[I1_or_I2], key, hash);
+  if (secret_count > 1) {
+    if (secret_deps[0]) {
+      add_to_hash(failures[I1], key, hash);
     }
-  } else {
-    int hash = hash_comb(&comb[base_size], comb_len-base_size);
-    if (hash_contains_keyed(failures[I1_or_I2], &comb[base_size], comb_len-base_size, hash)) {
-      Comb* comb_malloced = add_to_hash_keyed(failures[I1_or_I2], &comb[base_size],
-                                              comb_len-base_size, hash, 1);
-      if (secret_count > 1) {
-        if (secret_deps[0]) {
-          add_to_hash_keyed(failures[I1], comb_malloced, comb_len-base_size, hash, 0);
-        }
-        if (secret_deps[1]) {
-          add_to_hash_keyed(failures[I2], comb_malloced, comb_len-base_size, hash, 0);
-        }
-        if (secret_deps[0] && secret_deps[1]) {
-          add_to_hash_keyed(failures[I1_and_I2], comb_malloced, comb_len-base_size, hash, 0);
-        }
-      }
-    } else {
-      // Not already in the hash, no need to add it; nothing to do
+    if (secret_deps[1]) {
+      add_to_hash(failures[I2], key, hash);
+    }
+    if (secret_deps[0] && secret_deps[1]) {
+      add_to_hash(failures[I1_and_I2], key, hash);
     }
   }
 }
 
-void update_coeffs_from_maps(Circuit* c, uint64_t** coeff_c, HashMap** maps,
+void update_coeffs_from_maps(Circuit* c, Coeff** coeff_c, TupleMap** maps,
                               int comb_len, int coeffs_count) {
   for (int i = 0; i < coeffs_count; i++) {
-    HashMap* map = maps[i];
-    for (int j = 0; j < HASH_SIZE; j++) {
-      HashNode* node = map->content[j];
-      while (node) {
-        if (node->comb_len == comb_len) {
-          update_coeff_c_single(c, coeff_c[i], node->comb, comb_len);
-        }
-        node = node->next;
+    TupleMap* map = maps[i];
+    uint64_t it = 0;
+    void* slot;
+    while ((slot = tuple_map_next(map, &it))) {
+      if (comb_key_len(slot) == comb_len) {
+        update_coeff_c_single(c, coeff_c[i], comb_key_comb(slot), comb_len);
       }
     }
   }
@@ -540,7 +500,7 @@ void check_failure_and_update_coeffs(const Circuit* c, Comb* comb, int comb_len,
   int base_size = data->base_size;
   int secret_count = c->secret_count;
 
-  uint64_t** coeffs = data->coeffs;
+  Coeff** coeffs = data->coeffs;
   uint64_t out_comb_len = data->out_comb_len;
   Comb** out_comb_arr = data->out_comb_arr;
   SecretDep secret_deps_other[2];
@@ -567,20 +527,48 @@ void check_failure_and_update_coeffs(const Circuit* c, Comb* comb, int comb_len,
   if (! (secret_deps[0] || secret_deps[1])) {
     return;
   }
-  update_coeff_c_single(c, coeffs[I1_or_I2], &comb[base_size], comb_len-base_size);
+  add_failure(c, coeffs, data->histograms, I1_or_I2, &comb[base_size],
+                comb_len-base_size);
   if (secret_count > 1) {
     if (secret_deps[0]) {
-      update_coeff_c_single(c, coeffs[I1], &comb[base_size], comb_len-base_size);
+      add_failure(c, coeffs, data->histograms, I1, &comb[base_size],
+                comb_len-base_size);
     }
     if (secret_deps[1]) {
-      update_coeff_c_single(c, coeffs[I2], &comb[base_size], comb_len-base_size);
+      add_failure(c, coeffs, data->histograms, I2, &comb[base_size],
+                comb_len-base_size);
     }
     if (secret_deps[0] && secret_deps[1]) {
-      update_coeff_c_single(c, coeffs[I1_and_I2], &comb[base_size], comb_len-base_size);
+      add_failure(c, coeffs, data->histograms, I1_and_I2, &comb[base_size],
+                comb_len-base_size);
     }
   }
 }
 
+// Only used by compute_RPE2: compute_RPE_copy saves the failures in
+// hash maps that cannot be merged that easily.
+static void* make_thread_data_RPE2(void* data_void) {
+  struct callback_data_RPE2* data = (struct callback_data_RPE2*) data_void;
+  struct callback_data_RPE2* thread_data = malloc(sizeof(*thread_data));
+  *thread_data = *data;
+  thread_data->coeffs = make_thread_coeff_arrays(data->coeffs_count, data->coeffs_len,
+                                                 &thread_data->histograms);
+  return thread_data;
+}
+
+static void merge_thread_data_RPE2(void* data_void, void* thread_data_void) {
+  struct callback_data_RPE2* data = (struct callback_data_RPE2*) data_void;
+  struct callback_data_RPE2* thread_data = (struct callback_data_RPE2*) thread_data_void;
+  merge_thread_coeff_arrays(data->coeffs, thread_data->coeffs, thread_data->histograms,
+                            data->coeffs_count, data->coeffs_len);
+  free(thread_data);
+}
+
+static const FailureAccumulator coeffs_accumulator_RPE2 = {
+  .make  = make_thread_data_RPE2,
+  .merge = merge_thread_data_RPE2
+};
+
 
 
 // RPE2:
@@ -595,23 +583,27 @@ void check_failure_and_update_coeffs(const Circuit* c, Comb* comb, int comb_len,
 // Note that once again, we distinguish failures on one input, one the
 // other one and on both.
 //
-// Because we have to store all failures when checking RPE, memory
-// consumption quickly becomes an issue. This, we use batching to only
-// check batches of |BATCH_SIZE| tuples (|BATCH_SIZE| is defined in
-// config.h, at the time of writting, it's 1 million). At most, we
-// thus have to keep only 1 million tuples in the hashes, which should
-// not be too much.
+// Storing all failures would quickly make memory consumption an
+// issue. Instead, tuples are exhaustively considered for the first
+// output combination only, and each failure is checked against all
+// other output combinations as soon as it is found (see
+// check_failure_and_update_coeffs).
 //
-uint64_t** compute_RPE2(Circuit* circuit, DimRedData* dim_red_data,
-                        int cores, int coeff_max, int t, int low_memory) {
-  (void) cores; // Due to the batching, multithreading cannot be used.
+// If |shard| is not NULL, the coefficients are added to |shard| rather
+// than printed.
+Coeff** compute_RPE2(Circuit* circuit, DimRedData* dim_red_data,
+                      int cores, int coeff_max, int t,
+                      ShardResult* shard) {
   int secret_count = circuit->secret_count;
   int coeffs_count = secret_count == 1 ? 1 : COEFFS_COUNT;
   int t_output = circuit->share_count - 1;
 
-  uint64_t** coeffs = malloc(coeffs_count * sizeof(*coeffs));
+  Coeff** coeffs = malloc(coeffs_count * sizeof(*coeffs));
   for (int i = 0; i < coeffs_count; i++) {
     coeffs[i] = calloc(circuit->total_wires+1, sizeof(*coeffs[i]));
+    char name[32];
+    sprintf(name, "RPE2.%d", i);
+    checkpoint_vector(name, coeffs[i], circuit->total_wires+1);
   }
 
 
@@ -668,135 +660,62 @@ uint64_t** compute_RPE2(Circuit* circuit, DimRedData* dim_red_data,
     t_output *= 2;
   }
 
-  if (low_memory) {
-    // Updating all combinations of |out_comb_arr| (except the 1st
-    // one) with indices of wires before dimension reduction.
-    for (unsigned i = 1; i < out_comb_len; i++) {
-      for (int j = 0; j < t_output; j++) {
-        out_comb_arr[i][j] = dim_red_data->new_to_old_mapping[out_comb_arr[i][j]];
-      }
+  // Updating all combinations of |out_comb_arr| (except the 1st
+  // one) with indices of wires before dimension reduction.
+  for (unsigned i = 1; i < out_comb_len; i++) {
+    for (int j = 0; j < t_output; j++) {
+      out_comb_arr[i][j] = dim_red_data->new_to_old_mapping[out_comb_arr[i][j]];
     }
   }
 
-  HashMap* all_failures[coeffs_count];
-  for (int i = 0; i < coeffs_count; i++) {
-    all_failures[i] = init_hash();
-  }
-
   struct callback_data_RPE2 data = {
     .base_size = t_output,
-    .failures = all_failures,
-    .low_memory = low_memory,
     .t_in = t,
     .circuit = circuit,
     .dim_red_data = dim_red_data,
     .out_comb_len = out_comb_len,
     .out_comb_arr = out_comb_arr,
-    .coeffs = coeffs
+    .coeffs = coeffs,
+    .coeffs_count = coeffs_count,
+    .coeffs_len = circuit->total_wires + 1
   };
   VarVector verif_prefix = { .length = t_output, .max_size = t_output, .content = NULL };
 
   for (int size = 0; size <= coeff_max_main_loop; size++) {
-
-    if (low_memory) {
-      // If |low_memory| is true, then tuples are exhaustively
-      // considered for the first output combination only
-      // (|out_comb_arr[0]|), and check_failure_and_update_coeffs will
-      // check if the failures are failures for all other elements of
-      // |out_comb_arr| before updating the coefficients.
-      verif_prefix.content = out_comb_arr[0];
-      data.count = 0;
-
-      find_all_failures(circuit,
-                        cores,
-                        t, // t_in
-                        &verif_prefix, // prefix
-                        size+verif_prefix.length, // comb_len
-                        coeff_max+verif_prefix.length, //max_len
-                        dim_red_data, // dim_red_data
-                        true,         // has_random
-                        NULL,         // first_tuple
-                        NULL,         // include_outputs
-                        0,            // shares_to_ignore
-                        false,        // PINI
-                        NULL,         // incompr_tuples
-                        check_failure_and_update_coeffs,
-                        (void*)&data);
-    } else {
-
-      uint64_t total_combs = n_choose_k(size, circuit->length);
-
-      for (uint64_t current_comb_idx = 0; current_comb_idx < total_combs;
-           current_comb_idx += BATCH_SIZE) {
-        printf("  + current_comb_idx = %"PRIu64" / %"PRIu64"\n", current_comb_idx, total_combs);
-        Comb* current_comb = unrank(circuit->length, size, current_comb_idx);
-
-        for (unsigned int i = 0; i < out_comb_len; i++) {
-          printf("    - i = %d / %"PRIu64"\n", i, out_comb_len);
-          verif_prefix.content = out_comb_arr[i];
-          data.count = i;
-
-          _verify_tuples(circuit,
-                         t, // t_in
-                         &verif_prefix, // prefix
-                         size+verif_prefix.length, // comb_len
-                         coeff_max+verif_prefix.length, //max_len
-                         dim_red_data, // dim_red_data
-                         true,         // has_random
-                         current_comb, // first_tuple
-                         BATCH_SIZE,   // tuple_count
-                         NULL,         // include_outputs
-                         0,            // shares_to_ignore
-                         false,        // PINI
-                         0,            // stop_at_first_failure
-                         0,            // only_one_tuple
-                         NULL,         // secret_deps_out
-                         NULL,         // incompr_tuples
-                         save_failure_to_map,
-                         (void*)&data);
-        }
-
-        for (int i = 0; i < coeffs_count; i++) {
-          remove_count_diff(all_failures[i], out_comb_len, i == 0);
-        }
-        for (int i = size; i <= size+verif_prefix.length; i++) {
-          update_coeffs_from_maps(circuit, coeffs, all_failures, i, coeffs_count);
-        }
-        for (int i = 0; i < coeffs_count; i++) {
-          empty_hash(all_failures[i], i == 0);
-        }
-
-        free(current_comb);
-      }
-    }
-  }
-
-  for (int i = 0; i < coeffs_count; i++) {
-    empty_hash(all_failures[i], i == 0);
-    free(all_failures[i]->content);
-    free(all_failures[i]);
+    if (checkpoint_skip_steps(1)) continue;
+    // Tuples are exhaustively considered for the first output
+    // combination only (|out_comb_arr[0]|), and
+    // check_failure_and_update_coeffs checks if the failures are
+    // failures for all other elements of |out_comb_arr| before
+    // updating the coefficients.
+    verif_prefix.content = out_comb_arr[0];
+
+    find_all_failures(circuit,
+                      cores,
+                      t, // t_in
+                      &verif_prefix, // prefix
+                      size+verif_prefix.length, // comb_len
+                      coeff_max+verif_prefix.length, //max_len
+                      dim_red_data, // dim_red_data
+                      true,         // has_random
+                      NULL,         // first_tuple
+                      NULL,         // include_outputs
+                      0,            // shares_to_ignore
+                      false,        // PINI
+                      NULL,         // incompr_tuples
+                      check_failure_and_update_coeffs,
+                      (void*)&data,
+                      &coeffs_accumulator_RPE2);
+    checkpoint_step_done();
   }
 
-  printf("RPE2- I1_or_I2: [ ");
-  for (int i = 0; i < circuit->total_wires; i++)
-    printf("%"PRIu64", ", coeffs[I1_or_I2][i]);
-  printf("]\n");
-
-  if (coeffs_count > 1) {
-    printf("RPE2- I1: [ ");
-    for (int i = 0; i < circuit->total_wires; i++)
-      printf("%"PRIu64", ", coeffs[I1][i]);
-    printf("]\n");
-    printf("RPE2- I2: [ ");
-    for (int i = 0; i < circuit->total_wires; i++)
-      printf("%"PRIu64", ", coeffs[I2][i]);
-    printf("]\n");
-    printf("RPE2- I1_and_I2: [ ");
-    for (int i = 0; i < circuit->total_wires; i++)
-      printf("%"PRIu64", ", coeffs[I1_and_I2][i]);
-    printf("]\n");
+  if (shard) {
+    for (int i = 0; i < coeffs_count; i++) {
+      add_shard_vector(shard, "RPE2", coeffs[i]);
+    }
+  } else {
+    print_RPE_coeffs("RPE2", coeffs, coeffs_count, circuit->total_wires);
   }
-  printf("\n");
 
   for (unsigned i = 0; i < out_comb_len; i++) {
     free(out_comb_arr[i]);
@@ -819,16 +738,17 @@ uint64_t** compute_RPE2(Circuit* circuit, DimRedData* dim_red_data,
 //
 // If |first_output| == 0, then the 2nd output is considered first,
 // otherwise the first one is.
-uint64_t** compute_RPE_copy(Circuit* circuit, DimRedData* dim_red_data,
-                            int cores, int coeff_max, int t, int first_output) {
+//
+// If |shard| is not NULL, the coefficients of each combination of the
+// first output are added to |shard| rather than printed.
+//
+Coeff** compute_RPE_copy(Circuit* circuit, DimRedData* dim_red_data,
+                          int cores, int coeff_max, int t, int first_output,
+                          ShardResult* shard) {
   assert(circuit->secret_count == 1);
   int coeffs_count = 1;
   int t_output = circuit->share_count - 1;
-
-  uint64_t** coeffs = malloc(coeffs_count * sizeof(*coeffs));
-  for (int i = 0; i < coeffs_count; i++) {
-    coeffs[i] = calloc(circuit->total_wires+1, sizeof(*coeffs[i]));
-  }
+  const char* name = first_output ? "RPE12" : "RPE21";
 
 
   int coeff_max_main_loop = coeff_max == -1 ? circuit->length :
@@ -856,21 +776,34 @@ uint64_t** compute_RPE_copy(Circuit* circuit, DimRedData* dim_red_data,
     }
   }
 
-  HashMap* all_failures[1] = { init_hash() };
+  TupleMap* all_failures[1] = { init_hash(coeff_max + t + t_output) };
 
   struct callback_data_RPE2 data = {
     .base_size = t + t_output,
-    .failures = all_failures,
-    .low_memory = false
-    // No need to set the other elements since low_memory is false
+    .failures = all_failures
+    // No need to set the other elements, which are only used by compute_RPE2
   };
   VarVector verif_prefix = { .length = t_output+t, .max_size = t_output+t,
     .content = malloc((t+t_output) * sizeof(*verif_prefix.content)) };
 
-  uint64_t* local_coeffs = alloca((circuit->total_wires + 1) * sizeof(*local_coeffs));
+  // Coefficients for each combination of the first output
+  Coeff*** coeffs_out_comb = malloc(out_comb_len_1 * sizeof(*coeffs_out_comb));
+  for (unsigned i = 0; i < out_comb_len_1; i++) {
+    coeffs_out_comb[i] = malloc(coeffs_count * sizeof(*coeffs_out_comb[i]));
+    coeffs_out_comb[i][0] = calloc(circuit->total_wires + 1, sizeof(*coeffs_out_comb[i][0]));
+    char vector_name[32];
+    sprintf(vector_name, "%s.%u", name, i);
+    checkpoint_vector(vector_name, coeffs_out_comb[i][0], circuit->total_wires + 1);
+  }
+
   for (unsigned int i = 0; i < out_comb_len_1; i++) {
+    // |all_failures| cannot be saved in checkpoints: they are only
+    // saved between two combinations of the first output.
+    if (checkpoint_skip_steps((coeff_max_main_loop+1) * out_comb_len_2)) continue;
+    checkpoint_hold();
+
     memcpy(verif_prefix.content, out_comb_arr_1[i], t * sizeof(**out_comb_arr_1));
-    memset(local_coeffs, 0, (circuit->total_wires + 1) * sizeof(*local_coeffs));
+    Coeff* local_coeffs = coeffs_out_comb[i][0];
 
     for (int size = 0; size <= coeff_max_main_loop; size++) {
 
@@ -891,32 +824,38 @@ uint64_t** compute_RPE_copy(Circuit* circuit, DimRedData* dim_red_data,
                           false, // PINI
                           NULL, // incompr_tuples
                           save_failure_to_map,
-                          (void*)&data);
+                          (void*)&data,
+                          NULL); // accumulator
+        checkpoint_step_done();
 
         if (j == 1) {
-          remove_count_1(all_failures[0], 1);
+          remove_count_1(all_failures[0]);
         }
       }
 
-      remove_count_diff(all_failures[0], out_comb_len_2, 1);
+      remove_count_diff(all_failures[0], out_comb_len_2);
       update_coeffs_from_maps(circuit, &local_coeffs, all_failures, size, coeffs_count);
 
       // Removing failures of size |size| to keep the memory and the
       // collisions as low as possible.
-      remove_len_n(all_failures[0], size, 1);
-    }
-
-    for (int c = 0; c < circuit->total_wires+1; c++) {
-      coeffs[0][c] = max(coeffs[0][c], local_coeffs[c]);
+      remove_len_n(all_failures[0], size);
     }
 
-    empty_hash(all_failures[0], 1);
+    empty_hash(all_failures[0]);
+    checkpoint_release();
   }
+  free_tuple_map(all_failures[0]);
 
-  printf("RPE%d%d- I1_or_I2: [ ", first_output ? 1 : 2, first_output ? 2 : 1);
-  for (int i = 0; i < circuit->total_wires; i++)
-    printf("%"PRIu64", ", coeffs[0][i]);
-  printf("]\n\n");
+  Coeff** coeffs = max_out_combs(coeffs_out_comb, out_comb_len_1, coeffs_count,
+                                    circuit->total_wires + 1);
+  checkpoint_vector(name, coeffs[0], circuit->total_wires + 1);
+  if (shard) {
+    for (unsigned i = 0; i < out_comb_len_1; i++) {
+      add_shard_vector(shard, name, coeffs_out_comb[i][0]);
+    }
+  } else {
+    print_RPE_coeffs(name, coeffs, coeffs_count, circuit->total_wires);
+  }
 
   for (unsigned i = 0; i < out_comb_len_1; i++) {
     free(out_comb_arr_1[i]);
@@ -926,6 +865,13 @@ uint64_t** compute_RPE_copy(Circuit* circuit, DimRedData* dim_red_data,
     free(out_comb_arr_2[i]);
   }
   free(out_comb_arr_2);
+  for (unsigned i = 0; i < out_comb_len_1; i++) {
+    checkpoint_forget(coeffs_out_comb[i][0]);
+    clear_coeffs(coeffs_out_comb[i][0], circuit->total_wires + 1);
+    free(coeffs_out_comb[i][0]);
+    free(coeffs_out_comb[i]);
+  }
+  free(coeffs_out_comb);
 
   return coeffs;
 }
@@ -935,38 +881,27 @@ uint64_t** compute_RPE_copy(Circuit* circuit, DimRedData* dim_red_data,
 
 
 
-void compute_RPE_coeffs(Circuit* circuit, int cores, int coeff_max, int t, int t_output) {
-
-  if (circuit->characteristic != 2){
-    return compute_RPE_coeffs_incompr_arith(circuit, coeff_max, true , t_output, 
-                                      cores, 0);
-  }
-
-  DimRedData* dim_red_data = remove_elementary_wires(circuit, true);
-
-  uint64_t** coeffs_RPE1 = compute_RPE1(circuit, dim_red_data, cores, coeff_max, t, t_output);
-  uint64_t** coeffs_RPE2 = compute_RPE2(circuit, dim_red_data, cores, coeff_max, t, true);
-
-  uint64_t **coeffs_RPE12 = NULL, **coeffs_RPE21 = NULL;
-  if (circuit->output_count == 2) {
-    coeffs_RPE12 = compute_RPE_copy(circuit, dim_red_data, cores, coeff_max, t, 1);
-    coeffs_RPE21 = compute_RPE_copy(circuit, dim_red_data, cores, coeff_max, t, 0);
-  }
-
+// Prints the amplification order and the bounds on the leakage
+// probability corresponding to the RPE1, RPE2 (and, for copy gadgets,
+// RPE12 and RPE21) coefficients.
+static void print_RPE_bounds(int secret_count, int output_count, int total_wires,
+                             int coeff_max,
+                             Coeff** coeffs_RPE1, Coeff** coeffs_RPE2,
+                             Coeff** coeffs_RPE12, Coeff** coeffs_RPE21) {
   // Compute amplification order
   int d1 = 0, d2 = 0, d12 = 0;
   double c_d1 = 0, c_d2 = 0, c_d12 = 0;
-  for (int i = 0; i < circuit->total_wires+1; i++) {
+  for (int i = 0; i < total_wires+1; i++) {
     if (d1 && d2 && d12) break;
-    if (d1 && circuit->secret_count == 1) break;
+    if (d1 && secret_count == 1) break;
 
-    if (circuit->secret_count == 1) {
+    if (secret_count == 1) {
       if (coeffs_RPE1[I1_or_I2][i] || coeffs_RPE2[I1_or_I2][i]) {
         d1 = i;
-        c_d1 = max(coeffs_RPE1[I1_or_I2][i], coeffs_RPE2[I1_or_I2][i]);
+        c_d1 = max(coeff_get_ld(coeffs_RPE1[I1_or_I2][i]), coeff_get_ld(coeffs_RPE2[I1_or_I2][i]));
         break;
       }
-      if (circuit->output_count == 2) {
+      if (output_count == 2) {
         if (coeffs_RPE1[I1_or_I2][i] || coeffs_RPE2[I1_or_I2][i] ||
             coeffs_RPE12[I1_or_I2][i] || coeffs_RPE21[I1_or_I2][i]) {
           d1 = i;
@@ -976,16 +911,17 @@ void compute_RPE_coeffs(Circuit* circuit, int cores, int coeff_max, int t, int t
     } else { // secret_count == 2 (add or mult)
       if (!d1 && (coeffs_RPE1[I1][i] || coeffs_RPE2[I1][i])) {
         d1 = i;
-        c_d1 = max(coeffs_RPE1[I1][i], coeffs_RPE2[I1][i]);
+        c_d1 = max(coeff_get_ld(coeffs_RPE1[I1][i]), coeff_get_ld(coeffs_RPE2[I1][i]));
       }
-      if (circuit->secret_count == 2) {
+      if (secret_count == 2) {
         if (!d2 && (coeffs_RPE1[I2][i] || coeffs_RPE2[I2][i])) {
           d2 = i;
-          c_d2 = max(coeffs_RPE1[I2][i], coeffs_RPE2[I2][i]);
+          c_d2 = max(coeff_get_ld(coeffs_RPE1[I2][i]), coeff_get_ld(coeffs_RPE2[I2][i]));
         }
         if (!d12 && (coeffs_RPE1[I1_and_I2][i] || coeffs_RPE2[I1_and_I2][i])) {
           d12 = i;
-          c_d12 = sqrt(max(coeffs_RPE1[I1_and_I2][i], coeffs_RPE2[I1_and_I2][i]));
+          c_d12 = sqrt(max(coeff_get_ld(coeffs_RPE1[I1_and_I2][i]),
+                           coeff_get_ld(coeffs_RPE2[I1_and_I2][i])));
         }
       }
     }
@@ -993,13 +929,13 @@ void compute_RPE_coeffs(Circuit* circuit, int cores, int coeff_max, int t, int t
   int d = 0;
   double cd = 0;
   int div_by_2 = 0;
-  if (circuit->secret_count == 1 && circuit->output_count == 2) { // copy
+  if (secret_count == 1 && output_count == 2) { // copy
     d = d1;
     cd = 0;
-  } else if (circuit->secret_count == 1 && circuit->output_count == 1) { // refresh
+  } else if (secret_count == 1 && output_count == 1) { // refresh
     d = d1;
     cd = c_d1;
-  } else if (circuit->secret_count == 2 && circuit->output_count == 1) { // add/mult
+  } else if (secret_count == 2 && output_count == 1) { // add/mult
     if (d1 < d2) {
       d = d1;
       cd = c_d1;
@@ -1024,64 +960,64 @@ void compute_RPE_coeffs(Circuit* circuit, int cores, int coeff_max, int t, int t
   }
 
   printf("Amplification order d = %d%s\n", d, div_by_2 ? "/2" : "");
-  if (circuit->output_count == 1) {
+  if (output_count == 1) {
     printf("Coeff c%d%s = %f\n", d, div_by_2 ? "/2" : "", cd);
   }
   printf("\n");
 
-  if (coeff_max == -1) {
-    coeff_max = dim_red_data->old_circuit->length;
-  }
-
   // Computing leakage probability from coefficients
   double p[2];
   for (int i = 0; i < 2; i++) {
     // i == 0 --> replace last coeffs by 0
     // i == 1 --> replace last coeffs by (n choose k)
     int min_max = i == 0 ? -1 : 1;
-    if (circuit->secret_count == 2) {
+    if (secret_count == 2) {
       double p_arr[6] = {
         compute_leakage_proba(coeffs_RPE1[I1], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE1[I2], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE1[I1_and_I2], coeff_max,
-                              circuit->total_wires+1, min_max, true),
+                              total_wires+1, min_max, true),
         compute_leakage_proba(coeffs_RPE2[I1], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE2[I2], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE2[I1_and_I2], coeff_max,
-                              circuit->total_wires+1, min_max, true) };
+                              total_wires+1, min_max, true) };
       p[i] = min_arr(p_arr, 6);
-    } else if (circuit->output_count == 2) {
+    } else if (output_count == 2) {
       double p_arr[4] = {
         compute_leakage_proba(coeffs_RPE1[I1_or_I2], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE2[I1_or_I2], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE12[I1_or_I2], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE21[I1_or_I2], coeff_max,
-                              circuit->total_wires+1, min_max, false) };
+                              total_wires+1, min_max, false) };
       p[i] = min_arr(p_arr, 4);
     } else {
       double p_arr[2] = {
         compute_leakage_proba(coeffs_RPE1[I1_or_I2], coeff_max,
-                              circuit->total_wires+1, min_max, false),
+                              total_wires+1, min_max, false),
         compute_leakage_proba(coeffs_RPE2[I1_or_I2], coeff_max,
-                              circuit->total_wires+1, min_max, false) };
+                              total_wires+1, min_max, false) };
       p[i] = min_arr(p_arr, 2);
     }
   }
   printf("pmax = %.10f -- log2(pmax) = %.10f\n", p[0], log2(p[0]));
   printf("pmin = %.10f -- log2(pmin) = %.10f\n", p[1], log2(p[1]));
   printf("\n");
+}
 
+static void free_RPE_coeffs(int secret_count, int output_count,
+                            Coeff** coeffs_RPE1, Coeff** coeffs_RPE2,
+                            Coeff** coeffs_RPE12, Coeff** coeffs_RPE21) {
   free(coeffs_RPE1[I1_or_I2]);
   free(coeffs_RPE2[I1_or_I2]);
 
-  if (circuit->secret_count == 2) {
+  if (secret_count == 2) {
     free(coeffs_RPE1[I1]);
     free(coeffs_RPE1[I2]);
     free(coeffs_RPE1[I1_and_I2]);
@@ -1093,16 +1029,121 @@ void compute_RPE_coeffs(Circuit* circuit, int cores, int coeff_max, int t, int t
   free(coeffs_RPE1);
   free(coeffs_RPE2);
 
-  if (circuit->output_count == 2) {
+  if (output_count == 2) {
     free(coeffs_RPE12[0]);
     free(coeffs_RPE21[0]);
     free(coeffs_RPE12);
     free(coeffs_RPE21);
   }
+}
+
+void compute_RPE_coeffs(Circuit* circuit, int cores, int coeff_max, int t, int t_output) {
+
+  if (circuit->characteristic != 2){
+    return compute_RPE_coeffs_incompr_arith(circuit, coeff_max, true , t_output, 
+                                      cores, 0);
+  }
+
+  DimRedData* dim_red_data = remove_elementary_wires(circuit, true);
+
+  char params[64];
+  sprintf(params, "coeff_max=%d t=%d t_output=%d", coeff_max, t, t_output);
+  checkpoint_begin("RPE", params);
+
+  // When sharded, the coefficients computed below only account for the
+  // tuples of this shard: they are saved, and the amplification order
+  // and leakage probability are only computed once all shards are merged.
+  ShardResult* shard = NULL;
+  if (is_sharded()) {
+    int coeff_max_main_loop = coeff_max == -1 ? circuit->length :
+      coeff_max > circuit->length ? circuit->length : coeff_max;
+    shard = init_shard_result("RPE", circuit,
+                              coeff_max == -1 ? dim_red_data->old_circuit->length : coeff_max,
+                              coeff_max_main_loop, t, t_output);
+  }
+
+  Coeff** coeffs_RPE1 = compute_RPE1(circuit, dim_red_data, cores, coeff_max, t, t_output,
+                                        shard);
+  Coeff** coeffs_RPE2 = compute_RPE2(circuit, dim_red_data, cores, coeff_max, t,
+                                        shard);
+
+  Coeff **coeffs_RPE12 = NULL, **coeffs_RPE21 = NULL;
+  if (circuit->output_count == 2) {
+    coeffs_RPE12 = compute_RPE_copy(circuit, dim_red_data, cores, coeff_max, t, 1, shard);
+    coeffs_RPE21 = compute_RPE_copy(circuit, dim_red_data, cores, coeff_max, t, 0, shard);
+  }
+
+  if (coeff_max == -1) {
+    coeff_max = dim_red_data->old_circuit->length;
+  }
+
+  if (shard) {
+    write_shard_result(shard);
+    free_shard_result(shard);
+  } else {
+    print_RPE_bounds(circuit->secret_count, circuit->output_count, circuit->total_wires,
+                     coeff_max, coeffs_RPE1, coeffs_RPE2, coeffs_RPE12, coeffs_RPE21);
+  }
+  checkpoint_end();
 
+  free_RPE_coeffs(circuit->secret_count, circuit->output_count,
+                  coeffs_RPE1, coeffs_RPE2, coeffs_RPE12, coeffs_RPE21);
   free_dim_red_data(dim_red_data);
 }
 
+void merge_RPE_shards(const ShardResult* result) {
+  int coeffs_count = result->secret_count == 1 ? 1 : COEFFS_COUNT;
+  int coeffs_len = result->total_wires + 1;
+
+  int RPE1_count, RPE2_count;
+  Coeff** RPE1_vectors = get_shard_vectors(result, "RPE1", &RPE1_count);
+  Coeff** RPE2_vectors = get_shard_vectors(result, "RPE2", &RPE2_count);
+  if (RPE1_count == 0 || RPE1_count % coeffs_count != 0 || RPE2_count != coeffs_count) {
+    fprintf(stderr, "Invalid RPE shards: unexpected number of coefficient arrays. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // RPE1: one vector per output combination and array of coefficients.
+  uint64_t out_comb_len = RPE1_count / coeffs_count;
+  Coeff** coeffs_out_comb[out_comb_len];
+  for (unsigned j = 0; j < out_comb_len; j++) {
+    coeffs_out_comb[j] = &RPE1_vectors[j * coeffs_count];
+  }
+  Coeff** coeffs_RPE1 = max_out_combs(coeffs_out_comb, out_comb_len, coeffs_count, coeffs_len);
+  print_RPE_coeffs("RPE1", coeffs_RPE1, coeffs_count, result->total_wires);
+
+  // RPE2: the coefficients of all output combinations are already combined.
+  Coeff** coeffs_RPE2 = max_out_combs(&RPE2_vectors, 1, coeffs_count, coeffs_len);
+  print_RPE_coeffs("RPE2", coeffs_RPE2, coeffs_count, result->total_wires);
+
+  // RPE12 and RPE21: one vector per combination of the first output.
+  Coeff **coeffs_RPE12 = NULL, **coeffs_RPE21 = NULL;
+  if (result->output_count == 2) {
+    const char* names[2] = { "RPE12", "RPE21" };
+    Coeff*** coeffs_copy[2] = { &coeffs_RPE12, &coeffs_RPE21 };
+    for (int k = 0; k < 2; k++) {
+      int copy_count;
+      Coeff** copy_vectors = get_shard_vectors(result, names[k], &copy_count);
+      if (copy_count == 0) {
+        fprintf(stderr, "Invalid RPE shards: missing %s coefficients. Exiting.\n", names[k]);
+        exit(EXIT_FAILURE);
+      }
+      Coeff** coeffs_copy_comb[copy_count];
+      for (int j = 0; j < copy_count; j++) {
+        coeffs_copy_comb[j] = &copy_vectors[j];
+      }
+      *coeffs_copy[k] = max_out_combs(coeffs_copy_comb, copy_count, 1, coeffs_len);
+      print_RPE_coeffs(names[k], *coeffs_copy[k], 1, result->total_wires);
+    }
+  }
+
+  print_RPE_bounds(result->secret_count, result->output_count, result->total_wires,
+                   result->coeff_max, coeffs_RPE1, coeffs_RPE2, coeffs_RPE12, coeffs_RPE21);
+
+  free_RPE_coeffs(result->secret_count, result->output_count,
+                  coeffs_RPE1, coeffs_RPE2, coeffs_RPE12, coeffs_RPE21);
+}
+
 
 // Test of compute_leakage_proba_max.
 // Should find (more or less):
@@ -1,5 +1,10 @@
 #pragma once
 
 #include "circuit.h"
+#include "shard.h"
 
 void compute_RPE_coeffs(Circuit* circuit, int cores, int coeff_max, int t, int t_output);
+
+// Prints the RPE coefficients, amplification order and leakage
+// probabilities of the merged shards |result|.
+void merge_RPE_shards(const ShardResult* result);
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+#include "stats.h"
+#include "config.h"
+
+
+struct _arena_block {
+  struct _arena_block* next;
+  size_t size; // Size of the block, header included
+};
+
+// The data of a block starts right after its header.
+#define BLOCK_HEADER_SIZE \
+  ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+// Empty tuples still get a chunk of their own.
+static inline size_t round_size(size_t size) {
+  if (size == 0) return ARENA_ALIGNMENT;
+  return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+Arena* make_arena(const char* name) {
+  Arena* arena = calloc(1, sizeof(*arena));
+  arena->name = name;
+  arena->next_block_size = ARENA_MIN_BLOCK_SIZE;
+  return arena;
+}
+
+// Allocates a new block that can hold at least |size| bytes, and
+// makes it the current block.
+static void new_block(Arena* arena, size_t size) {
+  size_t block_size = arena->next_block_size;
+  if (block_size < size + BLOCK_HEADER_SIZE) {
+    block_size = size + BLOCK_HEADER_SIZE;
+  }
+  ArenaBlock* block = malloc(block_size);
+  if (!block) {
+    fprintf(stderr, "Cannot allocate %zu bytes for arena '%s'. Exiting.\n",
+            block_size, arena->name);
+    exit(EXIT_FAILURE);
+  }
+  block->size = block_size;
+  block->next = arena->blocks;
+  arena->blocks = block;
+  arena->next = (char*)block + BLOCK_HEADER_SIZE;
+  arena->end = (char*)block + block_size;
+  arena->block_count++;
+  arena->block_bytes += block_size;
+  if (arena->next_block_size < ARENA_MAX_BLOCK_SIZE) {
+    arena->next_block_size *= 2;
+  }
+}
+
+void* arena_alloc(Arena* arena, size_t size) {
+  size = round_size(size);
+  arena->allocations++;
+  if (size <= ARENA_MAX_RECYCLED_SIZE) {
+    void** chunk = arena->free_chunks[size / ARENA_ALIGNMENT - 1];
+    if (chunk) {
+      arena->free_chunks[size / ARENA_ALIGNMENT - 1] = *chunk;
+      arena->reused++;
+      return chunk;
+    }
+  }
+  if ((size_t)(arena->end - arena->next) < size) {
+    new_block(arena, size);
+  }
+  void* ptr = arena->next;
+  arena->next += size;
+  return ptr;
+}
+
+void* arena_calloc(Arena* arena, size_t size) {
+  void* ptr = arena_alloc(arena, size);
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+void arena_free(Arena* arena, void* ptr, size_t size) {
+  size = round_size(size);
+  if (size > ARENA_MAX_RECYCLED_SIZE) return;
+  *(void**)ptr = arena->free_chunks[size / ARENA_ALIGNMENT - 1];
+  arena->free_chunks[size / ARENA_ALIGNMENT - 1] = ptr;
+}
+
+// Adds the counters of |arena| to the statistics, and resets them.
+static void flush_stats(Arena* arena) {
+  if (arena->allocations) {
+    stats_record_arena(arena->name, arena->allocations, arena->reused,
+                       arena->block_count, arena->block_bytes);
+  }
+  arena->allocations = arena->reused = 0;
+  arena->block_count = arena->block_bytes = 0;
+}
+
+void arena_reset(Arena* arena) {
+  flush_stats(arena);
+  memset(arena->free_chunks, 0, sizeof(arena->free_chunks));
+  if (!arena->blocks) return;
+
+  ArenaBlock* block = arena->blocks->next;
+  while (block) {
+    ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  arena->blocks->next = NULL;
+  arena->next = (char*)arena->blocks + BLOCK_HEADER_SIZE;
+}
+
+void free_arena(Arena* arena) {
+  flush_stats(arena);
+  ArenaBlock* block = arena->blocks;
+  while (block) {
+    ArenaBlock* next = block->next;
+    free(block);
+    block = next;
+  }
+  free(arena);
+}
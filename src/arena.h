@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+
+// Allocations are rounded up to a multiple of ARENA_ALIGNMENT bytes,
+// which is enough for the structures allocated in arenas (pointers,
+// integers and tuples).
+#define ARENA_ALIGNMENT 8
+
+// Chunks of at most ARENA_MAX_RECYCLED_SIZE bytes given back with
+// arena_free are reused by later allocations of the same size.
+#define ARENA_MAX_RECYCLED_SIZE 512
+
+/* Arenas
+
+   An arena allocates memory by bumping a pointer in large blocks
+   obtained with malloc, and releases all of it at once, in a time
+   that only depends on the number of blocks (see arena_reset and
+   free_arena). They are meant for structures made of many small
+   nodes that are built and destroyed together during a phase of a
+   verification (tries, lists of tuples, hash maps of failures):
+   compared to a malloc per node, this saves the per-allocation
+   overhead of the allocator (both in time and in memory), as well as
+   the traversals needed to free the nodes one by one.
+
+   Structures that remove some of their nodes before the end of the
+   phase can give them back with arena_free: they are then reused by
+   the next allocations of the same size.
+
+   Arenas are not thread-safe: an arena should only be used by one
+   thread at a time.
+
+   When statistics are enabled (see stats.h), the number of
+   allocations served by the arenas of each name, and the number of
+   blocks they malloc'ed, are part of the report.
+*/
+
+typedef struct _arena_block ArenaBlock;
+
+typedef struct _arena {
+  const char* name;     // Name of the arena in the statistics report
+  ArenaBlock* blocks;   // Blocks allocated, the current one first
+  size_t next_block_size;
+  char* next;           // Free space of the current block: [next, end)
+  char* end;
+  void* free_chunks[ARENA_MAX_RECYCLED_SIZE / ARENA_ALIGNMENT]; // By size
+  uint64_t allocations; // Number of calls to arena_alloc/arena_calloc
+  uint64_t reused;      // Allocations served by a chunk given back
+  uint64_t block_count; // Number of blocks allocated
+  uint64_t block_bytes; // Total size of the blocks allocated
+} Arena;
+
+// Creates an empty arena; no memory is allocated until the first
+// call to arena_alloc. |name| should be a string literal.
+Arena* make_arena(const char* name);
+
+// Allocates |size| bytes in |arena|.
+void* arena_alloc(Arena* arena, size_t size);
+
+// Same as arena_alloc, but the memory is set to zero.
+void* arena_calloc(Arena* arena, size_t size);
+
+// Gives back the chunk |ptr| of |size| bytes (the size with which it
+// was allocated) to |arena|, so that it can be reused.
+void arena_free(Arena* arena, void* ptr, size_t size);
+
+// Releases everything that was allocated in |arena|. The last block
+// is kept to serve the next allocations.
+void arena_reset(Arena* arena);
+
+// Releases everything that was allocated in |arena|, as well as
+// |arena| itself.
+void free_arena(Arena* arena);
@@ -18,7 +18,7 @@
 struct env_tout_cRPC_args {
   Circuit* c;
   int share_count; 
-  uint64_t ***final_env; 
+  Coeff ***final_env; 
   Tuple *output_tuple;  
   int coeff_max; 
   int tout;
@@ -113,7 +113,7 @@ int output_count_tuple(Tuple *curr_tuple, int first_index_output){
   return output_count;
 }
 
-void compute_coeffs_tuple(Circuit *c, Tuple *curr_tuple, uint64_t *coeffs){
+void compute_coeffs_tuple(Circuit *c, Tuple *curr_tuple, Coeff *coeffs){
   Comb comb[curr_tuple->length];
   memcpy(comb, curr_tuple->content, curr_tuple->length * sizeof(*comb));
   update_coeff_c_single(c, coeffs, comb, curr_tuple->length);
@@ -123,7 +123,7 @@ void compute_coeffs_tuple(Circuit *c, Tuple *curr_tuple, uint64_t *coeffs){
 void update_env_cRPC (Circuit *c, Tuple *curr_tuple, int start_index, 
                       Dependency** gauss_deps, Dependency* gauss_rands,
                       int gauss_length, int share_count, 
-                      uint64_t *env[][share_count + 1], int revealed_secret, 
+                      Coeff *env[][share_count + 1], int revealed_secret, 
                       int coeff_max, int tout){
   
   if (curr_tuple->length == coeff_max)
@@ -192,14 +192,18 @@ void update_env_cRPC (Circuit *c, Tuple *curr_tuple, int start_index,
   }
 }
 
-void print_coeffs_env (Circuit * c, uint64_t ***env){  
+void print_coeffs_env (Circuit * c, Coeff ***env){  
   for (int tin = 0; tin < c->share_count + 1; tin++){
     for(int tout = 0; tout < c->share_count + 1; tout++){
       printf("tin = %d, tout = %d\n f(p) = [", tin, tout);
       for (int i = 0; i < c->total_wires; i++){
-        printf(" %lu,", env[tin][tout][i]);
+        printf(" ");
+        fprint_coeff(stdout, env[tin][tout][i]);
+        printf(",");
       }
-      printf(" %lu]\n\n", env[tin][tout][c->total_wires]);
+      printf(" ");
+      fprint_coeff(stdout, env[tin][tout][c->total_wires]);
+      printf("]\n\n");
     }
   }
 }
@@ -227,8 +231,8 @@ bool update_output_tuple(Tuple *output_tuple, int *start_output_index,
 }
 
 
-void max_coeffs(int tin, int tout, int share_count, uint64_t ***final_env, 
-                uint64_t *env[][share_count + 1], int max_coeff){
+void max_coeffs(int tin, int tout, int share_count, Coeff ***final_env, 
+                Coeff *env[][share_count + 1], int max_coeff){
   
   //Debug
   //if(tout == 1 && tin == 1) {
@@ -244,29 +248,24 @@ void max_coeffs(int tin, int tout, int share_count, uint64_t ***final_env,
     //final_env[tin][tout][i] = max(final_env[tin][tout][i], env[tin][tout][i]);
   bool to_change = false;
   for (int i = 0; i <= max_coeff; i++){
-    if (final_env[tin][tout][i] == env[tin][tout][i])
+    int cmp = coeff_cmp(final_env[tin][tout][i], env[tin][tout][i]);
+    if (cmp == 0)
       continue;
-    if (!final_env[tin][tout][i] && env[tin][tout][i]){
-      to_change = true;
-      break;
-    }
-    if (final_env[tin][tout][i] && !env[tin][tout][i])
-      break;
-    
-    to_change = final_env[tin][tout][i]  < env[tin][tout][i];
+
+    to_change = cmp < 0;
     break;  
   }
   
   if (to_change){
     for (int i = 0; i <= max_coeff; i++){
-      final_env[tin][tout][i] = env[tin][tout][i];
+      coeff_set(&final_env[tin][tout][i], env[tin][tout][i]);
     }
   }  
 }
 
 void env_tout_cRPC(Circuit *c, int share_count, 
-                  uint64_t ***final_env, 
-                  uint64_t *env[][share_count + 1], Dependency **gauss_deps, 
+                  Coeff ***final_env, 
+                  Coeff *env[][share_count + 1], Dependency **gauss_deps, 
                   Dependency *gauss_rands, Tuple *curr_tuple, int coeff_max, 
                    int tout, int cores){
   
@@ -339,8 +338,8 @@ void env_tout_cRPC(Circuit *c, int share_count,
   }
 }
 
-void env_tout_cRPC_parallel(Circuit *c, int share_count, uint64_t ***final_env, 
-                            uint64_t *env[][share_count + 1], 
+void env_tout_cRPC_parallel(Circuit *c, int share_count, Coeff ***final_env, 
+                            Coeff *env[][share_count + 1], 
                             Dependency **gauss_deps, Dependency *gauss_rands, 
                             Tuple *curr_tuple, int coeff_max, int tout, 
                             int cores, int *threads_used, pthread_t *threads, 
@@ -442,14 +441,14 @@ void env_cRPC(Circuit *c, int coeff_max, int cores){
   Tuple* curr_tuple = Tuple_make_size(max_deps_length);
   int share_count = c->share_count;
   
-  uint64_t *env[share_count + 1][share_count + 1];
+  Coeff *env[share_count + 1][share_count + 1];
   for (int tin = 0; tin < share_count + 1; tin++){
     for (int tout = 0; tout < share_count + 1; tout++){
       env[tin][tout] = calloc((c->total_wires + 1), sizeof(*env[tin][tout]));
     }
   }
   
-  uint64_t ***final_env = malloc((share_count + 1) * sizeof(*final_env));
+  Coeff ***final_env = malloc((share_count + 1) * sizeof(*final_env));
   for (int tin = 0; tin < share_count + 1; tin++){
     final_env[tin] = malloc((share_count + 1) * sizeof(**final_env));
     for (int tout = 0; tout < share_count + 1; tout++){
@@ -530,7 +529,7 @@ void *start_thread_env_tout_cRPC(void *void_args){
   }
   Dependency* gauss_rands = malloc(max_deps_length * sizeof(*gauss_rands));
 
-  uint64_t *env[args->share_count + 1][args->share_count + 1];
+  Coeff *env[args->share_count + 1][args->share_count + 1];
   for (int tin = 0; tin < args->share_count + 1; tin++){
     for (int tout = 0; tout < args->share_count + 1; tout++){
       env[tin][tout] = calloc((args->c->total_wires + 1), 
@@ -0,0 +1,364 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "checkpoint.h"
+#include "shard.h"
+#include "config.h"
+
+#define CHECKPOINT_FILE_MAGIC "IRONMASK-CHECKPOINT"
+#define CHECKPOINT_NAME_MAX_LEN 64
+#define CHECKPOINT_LINE_MAX_LEN 4096
+
+
+/***********************************************************
+                 Current checkpoint settings
+ ***********************************************************/
+
+static const char* checkpoint_file = NULL;
+static const char* checkpoint_circuit_file = NULL;
+static bool checkpoint_resume = false;
+static int checkpoint_interval = CHECKPOINT_INTERVAL;
+
+void set_checkpoint(const char* filename, bool resume, const char* circuit_file) {
+  checkpoint_file = filename;
+  checkpoint_resume = resume;
+  checkpoint_circuit_file = circuit_file;
+}
+
+bool checkpoint_enabled() {
+  return checkpoint_file != NULL;
+}
+
+void set_checkpoint_interval(int seconds) {
+  checkpoint_interval = seconds;
+}
+
+
+/***********************************************************
+                  State of the verification
+ ***********************************************************/
+
+// A registered vector or counter. The entries read from a checkpoint
+// are all vectors (counters being vectors of length 1).
+typedef struct _checkpoint_entry {
+  char* name;
+  Coeff* values;     // NULL for counters
+  uint64_t* counter; // NULL for vectors
+  int len;
+} CheckpointEntry;
+
+typedef struct _checkpoint_entries {
+  int length;
+  int max_length;
+  CheckpointEntry* content;
+} CheckpointEntries;
+
+static char* property = NULL;
+static char* params = NULL;
+static uint64_t steps_done = 0;  // Number of completed steps
+static uint64_t rank_done = 0;   // Rank reached in the current step
+static int hold_count = 0;
+static time_t last_save_time;
+static CheckpointEntries registered = { 0, 0, NULL };
+
+// State read from the checkpoint we are resuming from. |saved_steps|
+// is the number of steps that had been completed.
+static uint64_t saved_steps = 0;
+static uint64_t saved_rank = 0;
+static CheckpointEntries saved = { 0, 0, NULL };
+
+
+static void add_entry(CheckpointEntries* entries, const char* name, Coeff* values,
+                      uint64_t* counter, int len) {
+  if (entries->length == entries->max_length) {
+    entries->max_length = entries->max_length ? entries->max_length * 2 : 16;
+    entries->content = realloc(entries->content,
+                               entries->max_length * sizeof(*entries->content));
+  }
+  entries->content[entries->length++] = (CheckpointEntry) {
+    .name = strdup(name), .values = values, .counter = counter, .len = len
+  };
+}
+
+static CheckpointEntry* find_entry(const CheckpointEntries* entries, const char* name) {
+  for (int i = 0; i < entries->length; i++) {
+    if (strcmp(entries->content[i].name, name) == 0) {
+      return &entries->content[i];
+    }
+  }
+  return NULL;
+}
+
+// Frees |entries|; the values are freed only if |free_values| is true
+// (registered values belong to the verification).
+static void free_entries(CheckpointEntries* entries, bool free_values) {
+  for (int i = 0; i < entries->length; i++) {
+    free(entries->content[i].name);
+    if (free_values) free(entries->content[i].values);
+  }
+  free(entries->content);
+  *entries = (CheckpointEntries) { 0, 0, NULL };
+}
+
+
+/***********************************************************
+                  Writing/reading checkpoints
+ ***********************************************************/
+
+// Writes the current state to a temporary file, which is then renamed
+// to |checkpoint_file|, so that an interruption while saving does not
+// corrupt the previous checkpoint.
+static void save_checkpoint() {
+  char tmp_file[strlen(checkpoint_file) + 5];
+  sprintf(tmp_file, "%s.tmp", checkpoint_file);
+
+  FILE* f = fopen(tmp_file, "w");
+  if (!f) {
+    fprintf(stderr, "Cannot open checkpoint file '%s'. Exiting.\n", tmp_file);
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(f, "%s %d\n", CHECKPOINT_FILE_MAGIC, CHECKPOINT_FILE_VERSION);
+  fprintf(f, "property %s\n", property);
+  fprintf(f, "circuit %s\n", checkpoint_circuit_file ? checkpoint_circuit_file : "-");
+  fprintf(f, "params %s\n", params);
+  fprintf(f, "steps %"PRIu64"\n", steps_done);
+  fprintf(f, "rank %"PRIu64"\n", rank_done);
+  fprintf(f, "entries %d\n", registered.length);
+  for (int i = 0; i < registered.length; i++) {
+    CheckpointEntry* entry = &registered.content[i];
+    fprintf(f, "%s %d", entry->name, entry->len);
+    if (entry->counter) {
+      fprintf(f, " %"PRIu64, *entry->counter);
+    }
+    for (int j = 0; entry->values && j < entry->len; j++) {
+      fprintf(f, " ");
+      fprint_coeff(f, entry->values[j]);
+    }
+    fprintf(f, "\n");
+  }
+  fprintf(f, "end\n");
+
+  if (fclose(f) != 0 || rename(tmp_file, checkpoint_file) != 0) {
+    fprintf(stderr, "Error while writing checkpoint file '%s'. Exiting.\n", checkpoint_file);
+    exit(EXIT_FAILURE);
+  }
+
+  last_save_time = time(NULL);
+}
+
+static void maybe_save_checkpoint() {
+  if (hold_count == 0 && time(NULL) - last_save_time >= checkpoint_interval) {
+    save_checkpoint();
+  }
+}
+
+static void read_error(const char* what) {
+  fprintf(stderr, "Invalid checkpoint file '%s': %s. Exiting.\n", checkpoint_file, what);
+  exit(EXIT_FAILURE);
+}
+
+// Reads the field |name| of a checkpoint file, which spans the end of
+// the line, into |value|.
+static void read_line_field(FILE* f, const char* name, char* value) {
+  char key[CHECKPOINT_NAME_MAX_LEN];
+  if (fscanf(f, " %63s %4095[^\n]", key, value) != 2 || strcmp(key, name) != 0) {
+    char what[CHECKPOINT_NAME_MAX_LEN + 32];
+    snprintf(what, sizeof(what), "expected field '%s'", name);
+    read_error(what);
+  }
+}
+
+static void mismatch_error(const char* what, const char* expected, const char* found) {
+  fprintf(stderr, "Checkpoint file '%s' was saved by a different verification "
+          "(%s: '%s' instead of '%s'). Exiting.\n", checkpoint_file, what, found, expected);
+  exit(EXIT_FAILURE);
+}
+
+// Reads |checkpoint_file| into |saved_steps|, |saved_rank| and
+// |saved|. Returns false if the file does not exist.
+static bool read_checkpoint() {
+  FILE* f = fopen(checkpoint_file, "r");
+  if (!f) return false;
+
+  char magic[CHECKPOINT_NAME_MAX_LEN];
+  int version;
+  if (fscanf(f, "%63s %d", magic, &version) != 2 ||
+      strcmp(magic, CHECKPOINT_FILE_MAGIC) != 0) {
+    read_error("not a checkpoint file");
+  }
+  if (version != CHECKPOINT_FILE_VERSION) {
+    fprintf(stderr, "Checkpoint file '%s' has version %d, but this version of ironmask "
+            "only reads version %d. Exiting.\n", checkpoint_file, version,
+            CHECKPOINT_FILE_VERSION);
+    exit(EXIT_FAILURE);
+  }
+
+  char value[CHECKPOINT_LINE_MAX_LEN];
+  read_line_field(f, "property", value);
+  if (strcmp(value, property) != 0) mismatch_error("property", property, value);
+  read_line_field(f, "circuit", value);
+  const char* circuit = checkpoint_circuit_file ? checkpoint_circuit_file : "-";
+  if (strcmp(value, circuit) != 0) mismatch_error("circuit", circuit, value);
+  read_line_field(f, "params", value);
+  if (strcmp(value, params) != 0) mismatch_error("parameters", params, value);
+
+  int entry_count;
+  if (fscanf(f, " steps %"SCNu64, &saved_steps) != 1) read_error("expected field 'steps'");
+  if (fscanf(f, " rank %"SCNu64, &saved_rank) != 1) read_error("expected field 'rank'");
+  if (fscanf(f, " entries %d", &entry_count) != 1 || entry_count < 0) {
+    read_error("expected field 'entries'");
+  }
+
+  for (int i = 0; i < entry_count; i++) {
+    char name[CHECKPOINT_NAME_MAX_LEN];
+    int len;
+    if (fscanf(f, "%63s %d", name, &len) != 2 || len < 0) {
+      read_error("truncated entries");
+    }
+    Coeff* values = malloc(len * sizeof(*values));
+    for (int j = 0; j < len; j++) {
+      if (!fscan_coeff(f, &values[j])) {
+        read_error("truncated entries");
+      }
+    }
+    add_entry(&saved, name, values, NULL, len);
+  }
+
+  char end[CHECKPOINT_NAME_MAX_LEN];
+  if (fscanf(f, "%63s", end) != 1 || strcmp(end, "end") != 0) {
+    read_error("missing 'end' marker");
+  }
+
+  fclose(f);
+  return true;
+}
+
+
+/***********************************************************
+                 Checkpointed verifications
+ ***********************************************************/
+
+void checkpoint_begin(const char* property_name, const char* params_desc) {
+  if (!checkpoint_enabled()) return;
+
+  property = strdup(property_name);
+  // The shard is part of the parameters: the ranks saved in the
+  // checkpoint are those of the window of the shard.
+  int shard_index, shard_count;
+  get_shard(&shard_index, &shard_count);
+  params = malloc(strlen(params_desc) + 32);
+  sprintf(params, "%s shard=%d/%d", params_desc, shard_index, shard_count);
+
+  steps_done = rank_done = 0;
+  saved_steps = saved_rank = 0;
+  hold_count = 0;
+  last_save_time = time(NULL);
+
+  if (checkpoint_resume) {
+    if (read_checkpoint()) {
+      printf("Resuming from checkpoint '%s' (%"PRIu64" step(s) completed).\n\n",
+             checkpoint_file, saved_steps);
+    } else {
+      printf("No checkpoint '%s' found: starting from scratch.\n\n", checkpoint_file);
+    }
+  }
+}
+
+void checkpoint_end() {
+  if (!checkpoint_enabled()) return;
+
+  free_entries(&registered, false);
+  free_entries(&saved, true);
+  free(property);
+  free(params);
+  property = params = NULL;
+  remove(checkpoint_file);
+}
+
+// Registers the vector |vector| or the counter |counter|, and returns
+// the entry saved under |name| in the checkpoint we are resuming from
+// (or NULL).
+static const CheckpointEntry* register_entry(const char* name, Coeff* vector,
+                                             uint64_t* counter, int len) {
+  if (find_entry(&registered, name)) {
+    fprintf(stderr, "Checkpoint entry '%s' registered twice. Exiting.\n", name);
+    exit(EXIT_FAILURE);
+  }
+  add_entry(&registered, name, vector, counter, len);
+
+  // Entries that were not registered when the checkpoint was saved
+  // keep their initial value.
+  CheckpointEntry* saved_entry = find_entry(&saved, name);
+  if (saved_entry && saved_entry->len != len) read_error("entry with an unexpected length");
+  return saved_entry;
+}
+
+void checkpoint_vector(const char* name, Coeff* vector, int len) {
+  if (!checkpoint_enabled()) return;
+
+  const CheckpointEntry* saved_entry = register_entry(name, vector, NULL, len);
+  if (saved_entry) {
+    copy_coeffs(vector, saved_entry->values, len);
+  }
+}
+
+void checkpoint_counter(const char* name, uint64_t* counter) {
+  if (!checkpoint_enabled()) return;
+
+  const CheckpointEntry* saved_entry = register_entry(name, NULL, counter, 1);
+  if (saved_entry) {
+    if (saved_entry->values[0] > UINT64_MAX) read_error("counter out of range");
+    *counter = saved_entry->values[0];
+  }
+}
+
+void checkpoint_forget(const void* ptr) {
+  if (!checkpoint_enabled()) return;
+
+  for (int i = 0; i < registered.length; i++) {
+    if (registered.content[i].values == ptr || registered.content[i].counter == ptr) {
+      free(registered.content[i].name);
+      registered.content[i] = registered.content[--registered.length];
+      return;
+    }
+  }
+}
+
+bool checkpoint_skip_steps(int count) {
+  if (!checkpoint_enabled() || steps_done + count > saved_steps) return false;
+  steps_done += count;
+  return true;
+}
+
+void checkpoint_step_done() {
+  if (!checkpoint_enabled()) return;
+  steps_done++;
+  rank_done = 0;
+  maybe_save_checkpoint();
+}
+
+uint64_t checkpoint_resume_rank() {
+  if (!checkpoint_enabled() || steps_done != saved_steps) return 0;
+  return saved_rank;
+}
+
+void checkpoint_progress(uint64_t rank) {
+  rank_done = rank;
+  maybe_save_checkpoint();
+}
+
+void checkpoint_hold() {
+  if (!checkpoint_enabled()) return;
+  hold_count++;
+}
+
+void checkpoint_release() {
+  if (!checkpoint_enabled()) return;
+  hold_count--;
+  maybe_save_checkpoint();
+}
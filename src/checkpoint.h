@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "coeffs.h"
+
+// Version of the format of the checkpoint files. It should be
+// incremented every time this format changes, so that an older
+// checkpoint is not silently misinterpreted when resuming.
+#define CHECKPOINT_FILE_VERSION 2
+
+/* Checkpoints
+
+   A verification that supports checkpoints (RPE and CRP for now) is
+   seen as a deterministic sequence of steps, each step being the
+   enumeration of the tuples of a given size (typically, one call to
+   find_all_failures). The state of the verification is thus made of:
+
+     - the number of completed steps,
+     - the rank up to which the tuples of the current step have been
+       verified (see _verify_tuples_parallel),
+     - the coefficient vectors and counters that the verification
+       registered (see checkpoint_vector and checkpoint_counter).
+
+   When resuming, the verification runs again from the start, but
+   checkpoint_skip_steps tells it which steps were already completed,
+   the current step starts at the saved rank, and the registered
+   vectors and counters are restored to their saved values.
+*/
+
+// Enables checkpoints, which are saved to |filename|. If |resume| is
+// true and |filename| exists, the verification resumes from this
+// checkpoint. |circuit_file| is recorded in the checkpoint to check
+// that it is resumed on the same gadget.
+void set_checkpoint(const char* filename, bool resume, const char* circuit_file);
+
+bool checkpoint_enabled();
+
+// Sets the minimal delay between two checkpoints, in seconds
+// (CHECKPOINT_INTERVAL by default). With 0, a checkpoint is saved
+// every time the verification makes progress.
+void set_checkpoint_interval(int seconds);
+
+// Starts the checkpointed verification of |property|. |params|
+// describes the parameters of the verification (coeff_max, t...); it
+// must be identical when resuming.
+void checkpoint_begin(const char* property, const char* params);
+
+// Ends the checkpointed verification: forgets the registered vectors
+// and counters, and removes the checkpoint file.
+void checkpoint_end();
+
+// Registers the |len| coefficients |vector| to be saved in the
+// checkpoints, and restores them if resuming. |name| must not contain
+// spaces, and must be unique among the registered vectors.
+void checkpoint_vector(const char* name, Coeff* vector, int len);
+
+// Same as checkpoint_vector for a single counter.
+void checkpoint_counter(const char* name, uint64_t* counter);
+
+// Unregisters the vector or counter |ptr|.
+void checkpoint_forget(const void* ptr);
+
+// Returns true (and skips them) if the |count| next steps were all
+// completed before the checkpoint we resumed from.
+bool checkpoint_skip_steps(int count);
+
+// Marks the current step as completed (and saves a checkpoint if
+// needed).
+void checkpoint_step_done();
+
+// Returns the rank from which the tuples of the current step should
+// be enumerated: non-zero only for the step that was in progress when
+// the checkpoint we resumed from was saved.
+uint64_t checkpoint_resume_rank();
+
+// Records that the tuples of the current step have been verified up
+// to |rank| (excluded), and that their failures have been added to
+// the registered vectors (and saves a checkpoint if needed).
+void checkpoint_progress(uint64_t rank);
+
+// While held, no checkpoint is saved; this is used when a
+// verification accumulates results in structures that are not
+// registered (eg, hash maps). checkpoint_release saves a checkpoint
+// if one is due.
+void checkpoint_hold();
+void checkpoint_release();
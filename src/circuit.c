@@ -7,31 +7,68 @@
 #include "circuit.h"
 #include "vectors.h"
 
-BitDep * init_bit_dep(){
-  BitDep * bit_dep = malloc(sizeof(*bit_dep));
-  bit_dep->constant = 0;
-  bit_dep->out = 0;
-  bit_dep->secrets[0] = bit_dep->secrets[1] = 0;
+// Computes the sizes of the bitvectors of the BitDeps of |c|.
+BitDepLayout get_bit_dep_layout(const Circuit* c) {
+  int mult_count = c->deps->mult_deps->length;
+  int corr_outputs_count = c->deps->correction_outputs->length;
+  int dup_count = c->secret_count * c->share_count;
+
+  BitDepLayout layout;
+  layout.rand_len = 1 + c->random_count / 64;
+  layout.mult_len = (mult_count == 0) ? 0 :  1 + mult_count / 64;
+  layout.corr_len = (corr_outputs_count == 0) ? 0 : 1 + corr_outputs_count / 64;
+  layout.dup_len  = (dup_count * sizeof(Dependency) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+  if (layout.rand_len > RANDOMS_MAX_LEN || layout.mult_len > BITMULT_MAX_LEN) {
+    fprintf(stderr, "Circuit too large: at most %d randoms and %d multiplications are supported. Exiting.\n",
+            64 * RANDOMS_MAX_LEN - 1, 64 * BITMULT_MAX_LEN - 1);
+    exit(EXIT_FAILURE);
+  }
 
-  memset(bit_dep->duplicate_secrets, 0, BITDUPLICATE_SECRETS_MAX_LEN*sizeof(*bit_dep->duplicate_secrets));
-  memset(bit_dep->randoms, 0, RANDOMS_MAX_LEN*sizeof(*bit_dep->randoms));
-  memset(bit_dep->mults, 0, BITMULT_MAX_LEN*sizeof(*bit_dep->mults));
-  memset(bit_dep->correction_outputs, 0, BITCORRECTION_OUTPUTS_MAX_LEN*sizeof(*bit_dep->correction_outputs));
+  int len = layout.rand_len + layout.mult_len + layout.corr_len + layout.dup_len;
+  layout.bits_len = (len + BITDEP_ALIGN_WORDS - 1) / BITDEP_ALIGN_WORDS * BITDEP_ALIGN_WORDS;
+  return layout;
+}
 
+// Size in bytes of a BitDep with layout |layout|, rounded up to a
+// multiple of 32 bytes so that BitDeps can be stored contiguously.
+size_t bit_dep_size(const BitDepLayout* layout) {
+  size_t size = sizeof(BitDep) + layout->bits_len * sizeof(uint64_t);
+  return (size + 31) & ~(size_t)31;
+}
+
+// Initializes an empty BitDep in |mem|, which must be at least
+// bit_dep_size(layout) bytes large.
+BitDep * init_bit_dep_at(void* mem, const BitDepLayout* layout) {
+  BitDep* bit_dep = (BitDep*) mem;
+  bit_dep->bits_len = layout->bits_len;
+  bit_dep->randoms = bit_dep->bits;
+  bit_dep->mults = bit_dep->randoms + layout->rand_len;
+  bit_dep->correction_outputs = bit_dep->mults + layout->mult_len;
+  bit_dep->duplicate_secrets = (Dependency*) (bit_dep->correction_outputs + layout->corr_len);
+  set_bit_dep_zero(bit_dep);
   return bit_dep;
+}
 
+BitDep * init_bit_dep(const BitDepLayout* layout){
+  BitDep * bit_dep = aligned_alloc(32, bit_dep_size(layout));
+  return init_bit_dep_at(bit_dep, layout);
 }
 
 void set_bit_dep_zero(BitDep* bit_dep){
   bit_dep->constant = 0;
   bit_dep->out = 0;
   bit_dep->secrets[0] = bit_dep->secrets[1] = 0;
+  memset(bit_dep->bits, 0, bit_dep->bits_len * sizeof(*bit_dep->bits));
+}
 
-  memset(bit_dep->duplicate_secrets, 0, BITDUPLICATE_SECRETS_MAX_LEN*sizeof(*bit_dep->duplicate_secrets));
-  memset(bit_dep->randoms, 0, RANDOMS_MAX_LEN*sizeof(*bit_dep->randoms));
-  memset(bit_dep->mults, 0, BITMULT_MAX_LEN*sizeof(*bit_dep->mults));
-  memset(bit_dep->correction_outputs, 0, BITCORRECTION_OUTPUTS_MAX_LEN*sizeof(*bit_dep->correction_outputs));
-
+// Copies |src| into |dst|. Both must have the same layout.
+void copy_bit_dep(BitDep* dst, const BitDep* src) {
+  dst->secrets[0] = src->secrets[0];
+  dst->secrets[1] = src->secrets[1];
+  dst->out = src->out;
+  dst->constant = src->constant;
+  memcpy(dst->bits, src->bits, src->bits_len * sizeof(*src->bits));
 }
 
 // Count the total number of wires based on the array |c->weights|,
@@ -403,12 +440,17 @@ void _update_contained_secrets(Dependency** contained_secrets, int idx, Dependen
 
 
 // Computes |c->deps->contained_secrets|, ie, which secret shares are
-// in each variable.
+// in each variable. If |c->deps->shared_rows| is set, then
+// |c->deps->contained_secrets| must already be allocated and filled
+// for the shared rows: only the other ones are computed.
 void compute_contained_secrets(Circuit* c, int ** temporary_mult_idx) {
   int non_mult_deps_count = c->deps->first_mult_idx;
+  bool* shared_rows = c->deps->shared_rows;
 
-  Dependency** contained_secrets = malloc(c->deps->length * sizeof(*contained_secrets));
+  Dependency** contained_secrets = shared_rows ? c->deps->contained_secrets :
+    malloc(c->deps->length * sizeof(*contained_secrets));
   for (int i = 0; i < c->deps->length; i++) {
+    if (shared_rows && shared_rows[i]) continue;
     // Allocating arrays of size 2 instead of size |c->secret_count|
     // so that we can always access the 2nd element without undefined
     // behavior, which removes the need for some "if (secret_count ==
@@ -506,9 +548,12 @@ void compute_contained_secrets_arith(Circuit* c) {
 
 
 // Creates the BitDeps corresponding to the DependencyList in |circuit|.
+// As for compute_contained_secrets, the BitDeps of the shared rows (if
+// any) must already be in |circuit->deps->bit_deps|.
 void compute_bit_deps(Circuit* circuit, int ** temporary_mult_idx) {
   DependencyList* deps = circuit->deps;
-  BitDepVector** bit_deps = malloc(deps->length * sizeof(*bit_deps));
+  BitDepVector** bit_deps = deps->shared_rows ? deps->bit_deps :
+    malloc(deps->length * sizeof(*bit_deps));
 
   int secret_count = circuit->secret_count;
   int random_count = circuit->random_count;
@@ -523,12 +568,14 @@ void compute_bit_deps(Circuit* circuit, int ** temporary_mult_idx) {
   int bit_rand_len = 1 + random_count / 64;
   int bit_mult_len = (mult_count == 0) ? 0 :  1 + mult_count / 64;
   int bit_correction_outputs_len = (corr_outputs_count == 0) ? 0 : 1 + corr_outputs_count / 64;
+  BitDepLayout layout = get_bit_dep_layout(circuit);
 
   for (int i = 0; i < deps->length; i++) {
+    if (deps->shared_rows && deps->shared_rows[i]) continue;
     DepArrVector* dep = deps->deps[i];
     bit_deps[i] = BitDepVector_make();
     for (int j = 0; j < dep->length; j++) {
-      BitDep* bit_dep = init_bit_dep();
+      BitDep* bit_dep = init_bit_dep(&layout);
 
       for(int k=0; k< secret_count; k++){
         bit_dep->secrets[k] = dep->content[j][k];
@@ -587,7 +634,7 @@ void compute_bit_deps(Circuit* circuit, int ** temporary_mult_idx) {
       DepArrVector* dep = correction_outputs_deps[i];
       correction_outputs_deps_bits[i] = BitDepVector_make();
       for (int j = 0; j < dep->length; j++) {
-        BitDep* bit_dep = init_bit_dep();
+        BitDep* bit_dep = init_bit_dep(&layout);
 
         for(int k=0; k< secret_count; k++){
           bit_dep->secrets[k] = dep->content[j][k];
@@ -704,10 +751,11 @@ void compute_total_correction_bit_deps(Circuit * circuit){
   int bit_correction_outputs_len = (corr_outputs_count == 0) ? 0 : 1 + corr_outputs_count / 64;
   BitDepVector ** correction_outputs_deps_bits = circuit->deps->correction_outputs->correction_outputs_deps_bits;
   BitDep ** total_deps = malloc(corr_outputs_count * sizeof(*total_deps));
+  BitDepLayout layout = get_bit_dep_layout(circuit);
 
   for (int i = 0; i < corr_outputs_count; i++) {
     BitDepVector* dep = correction_outputs_deps_bits[i];
-    total_deps[i] = init_bit_dep();
+    total_deps[i] = init_bit_dep(&layout);
 
     for (int j = 0; j < dep->length; j++) {
       BitDep* bit_dep = dep->content[j];
@@ -958,6 +1006,7 @@ void free_circuit(Circuit* c) {
   free(c->deps->mult_deps->deps);
   free(c->deps->mult_deps);
   for (int i = 0; i < c->deps->length; i++) {
+    if (c->deps->shared_rows && c->deps->shared_rows[i]) continue;
     DepArrVector_free(c->deps->deps[i]);
     free(c->deps->deps_exprs[i]);
     free(c->deps->names[i]);
@@ -971,6 +1020,7 @@ void free_circuit(Circuit* c) {
   free(c->deps->contained_secrets);
   if (characteristic == 2) 
     free(c->deps->bit_deps);
+  free(c->deps->shared_rows);
   free(c->deps);
   free(c->weights);
   if (c->contains_mults){
@@ -16,27 +16,44 @@ typedef DEPENDENCY_TYPE Dependency;
 #define RANDOMS_MAX_LEN 5 // Enough to store 64*5 = 320 randoms
 #define BITMULT_MAX_LEN 7 // Enough to store 64*7 = 448 = 21*21 -->
                           // multiplication gadgets up to order 21
-#define BITCORRECTION_OUTPUTS_MAX_LEN 7
-#define BITDUPLICATE_SECRETS_MAX_LEN 20 // Enough for gadgets with 2 inputs of 10 shares,
-                                        // this field is only useful in case of faults and
-                                        // correction gadgets, so we can't verify gadgets this
-                                        // big anyway
 
 // The BitDep structure is a more compact representation of
 // dependencies: instead of using a array of Dependency, where most
 // elements (randoms and multiplications) can only be 0 or 1, BitDep
 // uses Dependency only for secrets and bitvectors for randoms and
 // multiplications.
+//
+// The bitvectors are stored contiguously in |bits|, whose size
+// depends on the circuit (see BitDepLayout), so that the rows of the
+// Gaussian elimination are as small as possible and can be xored
+// with a single loop. |randoms|, |mults|, |correction_outputs| and
+// |duplicate_secrets| point inside |bits|: a BitDep must thus be
+// created with init_bit_dep (or init_bit_dep_at) and copied with
+// copy_bit_dep, never with memcpy.
 typedef struct _bitDep {
   Dependency secrets[2];
-  Dependency duplicate_secrets[BITDUPLICATE_SECRETS_MAX_LEN];
-  uint64_t randoms[RANDOMS_MAX_LEN];
-  uint64_t mults[BITMULT_MAX_LEN];
-  uint64_t correction_outputs[BITCORRECTION_OUTPUTS_MAX_LEN];
   Dependency out;
   Dependency constant;
+  uint64_t* randoms;
+  uint64_t* mults;
+  uint64_t* correction_outputs;
+  Dependency* duplicate_secrets;
+  int bits_len; // Number of words of |bits| (multiple of BITDEP_ALIGN_WORDS)
+  uint64_t bits[];
 } BitDep;
 
+// Rows are padded to 32 bytes, to be processed with AVX2.
+#define BITDEP_ALIGN_WORDS 4
+
+// Sizes (in 64-bit words) of the bitvectors of the BitDeps of a circuit.
+typedef struct _bitDepLayout {
+  int rand_len; // Words of |randoms|
+  int mult_len; // Words of |mults|
+  int corr_len; // Words of |correction_outputs|
+  int dup_len;  // Words of |duplicate_secrets|
+  int bits_len; // Total (padded) length of |bits|
+} BitDepLayout;
+
 
 typedef struct _multDep {
   /* |left_ptr| and |right_ptr| provide pointers
@@ -87,6 +104,10 @@ typedef struct _dependencyList {
                                   // secret shares contained in each DepArrVector
                                   // of |deps|.
   struct _BitDepVector_vector** bit_deps; // bitvector-based representation of |deps|
+  bool* shared_rows; // NULL, or array of size |length|: rows at true
+                     // are borrowed from the base circuit they were
+                     // derived from (see gen_faulted_circuit), and are
+                     // thus neither recomputed nor freed.
   MultDependencyList* mult_deps;
   CorrectionOutputs * correction_outputs;
 } DependencyList;
@@ -141,8 +162,12 @@ typedef struct _faults_struct{
 }Faults;
 
 
-BitDep * init_bit_dep();
+BitDepLayout get_bit_dep_layout(const Circuit* c);
+size_t bit_dep_size(const BitDepLayout* layout);
+BitDep * init_bit_dep(const BitDepLayout* layout);
+BitDep * init_bit_dep_at(void* mem, const BitDepLayout* layout);
 void set_bit_dep_zero(BitDep* bit_dep);
+void copy_bit_dep(BitDep* dst, const BitDep* src);
 void compute_total_wires(Circuit* c);
 void compute_rands_usage(Circuit* c);
 void compute_rands_usage_arith(Circuit* c);
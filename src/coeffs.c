@@ -3,7 +3,11 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <math.h>
+#include <float.h>
 #include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <pthread.h>
 #include <gmp.h>
 
 #include "coeffs.h"
@@ -12,9 +16,294 @@
 #include "combinations.h"
 
 
-#define table_coeff_size 65 // above 67, binomial coefficients will overflow 64-bit integers
-static uint64_t table_coeff[table_coeff_size][table_coeff_size];
-static uint64_t table_pow[table_coeff_size][table_coeff_size];
+/* Spilled coefficients */
+
+// The pool of spilled values is made of chunks that are never moved,
+// so that a value can be accessed while another thread spills a new
+// one (only the allocation of indices is protected by
+// |spill_mutex|). The indices released by clear_coeffs are kept in
+// |spill_free|, with their mpz_t still initialized, and are reused
+// before new ones are allocated.
+#define COEFF_SPILL_CHUNK_SIZE 1024
+#define COEFF_SPILL_MAX_CHUNKS (1 << 16)
+
+static mpz_t* spill_chunks[COEFF_SPILL_MAX_CHUNKS];
+static uint64_t spill_count = 0;
+static uint64_t* spill_free = NULL;
+static uint64_t spill_free_count = 0;
+static uint64_t spill_free_capacity = 0;
+static pthread_mutex_t spill_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static mpz_ptr spilled_value(Coeff c) {
+  uint64_t idx = (uint64_t)(c & ~COEFF_SPILLED);
+  return spill_chunks[idx / COEFF_SPILL_CHUNK_SIZE][idx % COEFF_SPILL_CHUNK_SIZE];
+}
+
+// Returns a new spilled coefficient holding a copy of |value|.
+static Coeff new_spill(const mpz_t value) {
+  pthread_mutex_lock(&spill_mutex);
+  if (spill_free_count) {
+    Coeff c = COEFF_SPILLED | spill_free[--spill_free_count];
+    pthread_mutex_unlock(&spill_mutex);
+    mpz_set(spilled_value(c), value);
+    return c;
+  }
+  uint64_t idx = spill_count++;
+  uint64_t chunk = idx / COEFF_SPILL_CHUNK_SIZE;
+  if (chunk == COEFF_SPILL_MAX_CHUNKS) {
+    fprintf(stderr, "Too many coefficients larger than 2^127. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (idx % COEFF_SPILL_CHUNK_SIZE == 0) {
+    spill_chunks[chunk] = malloc(COEFF_SPILL_CHUNK_SIZE * sizeof(*spill_chunks[chunk]));
+  }
+  pthread_mutex_unlock(&spill_mutex);
+
+  Coeff c = COEFF_SPILLED | idx;
+  mpz_init_set(spilled_value(c), value);
+  return c;
+}
+
+// Sets |res| to the 128-bit integer |v|.
+static void mpz_set_128(mpz_t res, uint128_t v) {
+  uint64_t words[2] = { (uint64_t)v, (uint64_t)(v >> 64) };
+  mpz_import(res, 2, -1, sizeof(words[0]), 0, 0, words);
+}
+
+// Returns the coefficient holding |value| (spilled if needed).
+static Coeff coeff_from_mpz(const mpz_t value) {
+  if (mpz_sizeinbase(value, 2) >= 128) {
+    return new_spill(value);
+  }
+  uint64_t words[2] = { 0, 0 };
+  mpz_export(words, NULL, -1, sizeof(words[0]), 0, 0, value);
+  Coeff c = ((Coeff)words[1] << 64) | words[0];
+  return coeff_is_spilled(c) ? new_spill(value) : c;
+}
+
+void coeff_get_mpz(mpz_t res, Coeff c) {
+  if (coeff_is_spilled(c)) {
+    mpz_set(res, spilled_value(c));
+  } else {
+    mpz_set_128(res, c);
+  }
+}
+
+// Adds |value| to *|dst|.
+static void coeff_add_mpz(Coeff* dst, const mpz_t value) {
+  if (coeff_is_spilled(*dst)) {
+    mpz_ptr spilled = spilled_value(*dst);
+    mpz_add(spilled, spilled, value);
+    return;
+  }
+  mpz_t sum;
+  mpz_init(sum);
+  mpz_set_128(sum, *dst);
+  mpz_add(sum, sum, value);
+  *dst = coeff_from_mpz(sum);
+  mpz_clear(sum);
+}
+
+void coeff_add_slow(Coeff* dst, Coeff src) {
+  if (coeff_is_spilled(*dst) && !coeff_is_spilled(src) && (src >> 64) == 0) {
+    mpz_ptr spilled = spilled_value(*dst);
+    mpz_add_ui(spilled, spilled, (uint64_t)src);
+    return;
+  }
+  mpz_t value;
+  mpz_init(value);
+  coeff_get_mpz(value, src);
+  coeff_add_mpz(dst, value);
+  mpz_clear(value);
+}
+
+void coeff_add_mul(Coeff* dst, uint64_t count, Coeff src) {
+  Coeff product;
+  if (!coeff_is_spilled(src) && !__builtin_mul_overflow(src, (Coeff)count, &product) &&
+      !coeff_is_spilled(product)) {
+    coeff_add(dst, product);
+    return;
+  }
+  mpz_t value;
+  mpz_init(value);
+  coeff_get_mpz(value, src);
+  mpz_mul_ui(value, value, count);
+  coeff_add_mpz(dst, value);
+  mpz_clear(value);
+}
+
+void coeff_set(Coeff* dst, Coeff src) {
+  *dst = coeff_is_spilled(src) ? new_spill(spilled_value(src)) : src;
+}
+
+int coeff_cmp(Coeff a, Coeff b) {
+  if (coeff_is_spilled(a) && coeff_is_spilled(b)) {
+    return mpz_cmp(spilled_value(a), spilled_value(b));
+  }
+  // A spilled coefficient is larger than any other one.
+  return (a > b) - (a < b);
+}
+
+void coeff_set_max(Coeff* dst, Coeff src) {
+  if (coeff_cmp(src, *dst) <= 0) return;
+  if (coeff_is_spilled(*dst)) {
+    // |src| is larger, so it is spilled as well.
+    mpz_set(spilled_value(*dst), spilled_value(src));
+  } else {
+    coeff_set(dst, src);
+  }
+}
+
+void copy_coeffs(Coeff* dst, const Coeff* src, int len) {
+  for (int i = 0; i < len; i++) {
+    coeff_set(&dst[i], src[i]);
+  }
+}
+
+void add_coeffs(Coeff* dst, const Coeff* src, int len) {
+  for (int i = 0; i < len; i++) {
+    coeff_add(&dst[i], src[i]);
+  }
+}
+
+void coeff_init_mpf(mpf_t res, Coeff c) {
+  if ((c >> 64) == 0) {
+    mpf_init_set_ui(res, (uint64_t)c);
+    return;
+  }
+  mpz_t value;
+  mpz_init(value);
+  coeff_get_mpz(value, c);
+  mpf_init(res);
+  mpf_set_z(res, value);
+  mpz_clear(value);
+}
+
+long double coeff_get_ld(Coeff c) {
+  if (!coeff_is_spilled(c)) return c;
+  long exp;
+  double mantissa = mpz_get_d_2exp(&exp, spilled_value(c));
+  return ldexpl(mantissa, exp);
+}
+
+void fprint_coeff(FILE* f, Coeff c) {
+  if ((c >> 64) == 0) {
+    fprintf(f, "%"PRIu64, (uint64_t)c);
+    return;
+  }
+  mpz_t value;
+  mpz_init(value);
+  coeff_get_mpz(value, c);
+  mpz_out_str(f, 10, value);
+  mpz_clear(value);
+}
+
+bool fscan_coeff(FILE* f, Coeff* c) {
+  mpz_t value;
+  mpz_init(value);
+  bool ok = mpz_inp_str(value, f, 10) != 0 && mpz_sgn(value) >= 0;
+  if (ok) *c = coeff_from_mpz(value);
+  mpz_clear(value);
+  return ok;
+}
+
+void clear_coeffs(Coeff* coeffs, int len) {
+  pthread_mutex_lock(&spill_mutex);
+  for (int i = 0; i < len; i++) {
+    if (coeff_is_spilled(coeffs[i])) {
+      if (spill_free_count == spill_free_capacity) {
+        spill_free_capacity = spill_free_capacity ? 2 * spill_free_capacity : 64;
+        spill_free = realloc(spill_free, spill_free_capacity * sizeof(*spill_free));
+      }
+      spill_free[spill_free_count++] = (uint64_t)(coeffs[i] & ~COEFF_SPILLED);
+    }
+    coeffs[i] = 0;
+  }
+  pthread_mutex_unlock(&spill_mutex);
+}
+
+void free_coeff_spills() {
+  for (uint64_t idx = 0; idx < spill_count; idx++) {
+    mpz_clear(spilled_value(COEFF_SPILLED | idx));
+  }
+  for (uint64_t chunk = 0; chunk * COEFF_SPILL_CHUNK_SIZE < spill_count; chunk++) {
+    free(spill_chunks[chunk]);
+  }
+  spill_count = 0;
+  free(spill_free);
+  spill_free = NULL;
+  spill_free_count = spill_free_capacity = 0;
+}
+
+
+/* Coefficient files */
+
+#define COEFFS_FILE_MAGIC "IronMask-coeffs"
+
+void write_coeffs_header(FILE* f) {
+  fprintf(f, "%s %d\n", COEFFS_FILE_MAGIC, COEFFS_FILE_VERSION);
+}
+
+int read_coeffs_header(FILE* f, const char* filename) {
+  char magic[sizeof(COEFFS_FILE_MAGIC)] = { 0 };
+  int version;
+  if (fread(magic, 1, sizeof(magic) - 1, f) != sizeof(magic) - 1 ||
+      strcmp(magic, COEFFS_FILE_MAGIC) != 0) {
+    // Files without header only contain coefficients.
+    rewind(f);
+    return COEFFS_FILE_LEGACY_VERSION;
+  }
+  if (fscanf(f, " %d", &version) != 1 || fgetc(f) != '\n') {
+    fprintf(stderr, "Invalid coefficients file '%s'. Exiting.\n", filename);
+    exit(EXIT_FAILURE);
+  }
+  if (version != COEFFS_FILE_VERSION) {
+    fprintf(stderr, "Coefficients file '%s' has version %d, but this version of "
+            "ironmask only reads versions %d and %d. Exiting.\n", filename, version,
+            COEFFS_FILE_LEGACY_VERSION, COEFFS_FILE_VERSION);
+    exit(EXIT_FAILURE);
+  }
+  return version;
+}
+
+void write_coeffs(FILE* f, const Coeff* coeffs, int len) {
+  for (int i = 0; i < len; i++) {
+    fwrite(&coeffs[i], sizeof(coeffs[i]), 1, f);
+    if (coeff_is_spilled(coeffs[i])) {
+      mpz_out_raw(f, spilled_value(coeffs[i]));
+    }
+  }
+}
+
+bool read_coeffs(FILE* f, int version, Coeff* coeffs, int len) {
+  clear_coeffs(coeffs, len);
+  for (int i = 0; i < len; i++) {
+    if (version == COEFFS_FILE_LEGACY_VERSION) {
+      uint64_t c;
+      if (fread(&c, sizeof(c), 1, f) != 1) return false;
+      coeffs[i] = c;
+      continue;
+    }
+    if (fread(&coeffs[i], sizeof(coeffs[i]), 1, f) != 1) return false;
+    if (coeff_is_spilled(coeffs[i])) {
+      mpz_t value;
+      mpz_init(value);
+      bool ok = mpz_inp_raw(value, f) != 0;
+      coeffs[i] = ok ? coeff_from_mpz(value) : 0;
+      mpz_clear(value);
+      if (!ok) return false;
+    }
+  }
+  return true;
+}
+
+
+/* Expansion of failures */
+
+// table_coeff[n][k] = n choose k, for the weights of the failures
+// expanded in 128-bit integers by compute_tree2.
+#define table_coeff_size COEFF_FAST_WEIGHT
+static Coeff table_coeff[table_coeff_size][table_coeff_size];
 static bool table_coeff_initialized;
 
 // Using a custom Array structure instead of a intVector (of
@@ -25,17 +314,62 @@ typedef struct _array {
   uint64_t* content;
 } Array;
 
-void compute_tree2(Array current_uple, uint64_t* coeffs, int nb_occ_tuple) {
+// Sets the |nb_occ_tuple|+1 integers |lst| (which must be
+// initialized) to the coefficients of the failure |current_uple| (of
+// total weight |nb_occ_tuple|), as compute_tree2 does, with GMP
+// integers.
+static void expand_failure_gmp(Array current_uple, int nb_occ_tuple, mpz_t* lst) {
+  // The coefficients are those of \prod_k ((1+x)^w_k - 1), where the
+  // w_k are the weights of the variables of the failure.
+  mpz_t binomials[nb_occ_tuple+1];
+  for (int i = 0; i <= nb_occ_tuple; i++) {
+    mpz_init(binomials[i]);
+    mpz_set_ui(lst[i], 0);
+  }
+  mpz_set_ui(lst[0], 1);
+  int degree = 0;
+  for (int k = 0; k < current_uple.length; k++) {
+    int elem = current_uple.content[k];
+    for (int i = 1; i <= elem; i++) {
+      mpz_bin_uiui(binomials[i], elem, i);
+    }
+    // lst[j] only depends on the lst[j-i] with i >= 1, which are
+    // updated afterwards.
+    for (int j = degree + elem; j >= 0; j--) {
+      mpz_set_ui(lst[j], 0);
+      for (int i = 1; i <= elem && i <= j; i++) {
+        if (j - i <= degree) mpz_addmul(lst[j], binomials[i], lst[j-i]);
+      }
+    }
+    degree += elem;
+  }
+  for (int i = 0; i <= nb_occ_tuple; i++) {
+    mpz_clear(binomials[i]);
+  }
+}
+
+void compute_tree2(Array current_uple, Coeff* coeffs, int nb_occ_tuple) {
   if (nb_occ_tuple == current_uple.length) {
-    coeffs[nb_occ_tuple] += 1;
+    coeff_add(&coeffs[nb_occ_tuple], 1);
     return;
   }
   if (nb_occ_tuple == current_uple.length+1) {
-    coeffs[nb_occ_tuple]   += 2;
-    coeffs[nb_occ_tuple+1] += 1;
+    coeff_add(&coeffs[nb_occ_tuple], 2);
+    coeff_add(&coeffs[nb_occ_tuple+1], 1);
     return;
   }
-  uint64_t lst[nb_occ_tuple+1]; // TODO: is this large enough??
+  if (nb_occ_tuple >= COEFF_FAST_WEIGHT) {
+    // The coefficients of the failure may not fit on 127 bits.
+    mpz_t lst[nb_occ_tuple+1];
+    for (int i = 0; i <= nb_occ_tuple; i++) mpz_init(lst[i]);
+    expand_failure_gmp(current_uple, nb_occ_tuple, lst);
+    for (int i = 0; i <= nb_occ_tuple; i++) {
+      if (mpz_sgn(lst[i])) coeff_add_mpz(&coeffs[i], lst[i]);
+      mpz_clear(lst[i]);
+    }
+    return;
+  }
+  Coeff lst[nb_occ_tuple+1]; // TODO: is this large enough??
   int nmin = 1;
   int nmax = current_uple.content[0];
   for (int i = 1; (unsigned long)i < current_uple.content[0] + 1; i++) {
@@ -62,62 +396,159 @@ void compute_tree2(Array current_uple, uint64_t* coeffs, int nb_occ_tuple) {
     nmax = nmax + elem;
   }
   for (int k = nmin; k < nmax+1; k++) {
-    coeffs[k] += lst[k];
+    coeff_add(&coeffs[k], lst[k]);
   }
 }
 
-// Warning: this implement is not correct (yet anyways)
-void compute_tree3(Array current_uple, uint64_t* coeffs, int nb_occ_tuple) {
-  int tmp = current_uple.length;
-  if (nb_occ_tuple == current_uple.length) {
-    coeffs[nb_occ_tuple] += 1;
+void update_coeff_c_single(const Circuit* c, Coeff* coeff_c, Comb* comb, int comb_len) {
+  //assert(table_coeff_initialized); // Disabling because fairly costly
+
+  uint64_t nb_occ_tuple = 0;
+  Array uple;
+  uple.length = comb_len;
+  uple.content = alloca(comb_len * sizeof(*uple.content));
+  for (int i = 0; i < comb_len; i++) {
+    nb_occ_tuple += c->weights[comb[i]];
+    uple.content[comb_len-i-1] = c->weights[comb[i]];
+  }
+
+  compute_tree2(uple, coeff_c, (int)nb_occ_tuple);
+}
+
+/* Histograms of failures */
+
+// The signature of a failure is its size, followed by the weights of
+// its variables in decreasing order, on one byte each (weights are at
+// least 1, so that the zeros of the padding cannot be confused with
+// weights).
+#define SIGNATURE_SIZE (COEFF_HISTOGRAM_MAX_LEN + 1)
+
+CoeffHistogram* make_coeff_histogram(Coeff* coeffs) {
+  CoeffHistogram* histogram = malloc(sizeof(*histogram));
+  histogram->signatures = make_tuple_map(SIGNATURE_SIZE, sizeof(uint64_t), NULL);
+  histogram->coeffs = coeffs;
+  return histogram;
+}
+
+void coeff_histogram_add(CoeffHistogram* histogram, const Circuit* c,
+                         Comb* comb, int comb_len) {
+  Coeff* coeffs = histogram->coeffs;
+  int sum = 0, max_weight = 0;
+  for (int i = 0; i < comb_len; i++) {
+    int weight = c->weights[comb[i]];
+    sum += weight;
+    if (weight > max_weight) max_weight = weight;
+  }
+  // The two cases handled without expanding a polynomial by
+  // compute_tree2.
+  if (sum == comb_len) {
+    coeff_add(&coeffs[sum], 1);
     return;
   }
-  if (nb_occ_tuple == current_uple.length+1) {
-    coeffs[nb_occ_tuple]   += 2;
-    coeffs[nb_occ_tuple+1] += 1;
+  if (sum == comb_len + 1) {
+    coeff_add(&coeffs[comb_len], 2);
+    coeff_add(&coeffs[comb_len+1], 1);
+    return;
+  }
+  if (comb_len > COEFF_HISTOGRAM_MAX_LEN || max_weight > 255) {
+    update_coeff_c_single(c, coeffs, comb, comb_len);
     return;
   }
 
-  int n = current_uple.length;
-  int n_2 = 0, n_3 = 0;
-  for (int i = 0; i < n; i++) {
-    if (current_uple.content[i] == 2) n_2++;
-    else if (current_uple.content[i] == 3) n_3++;
+  uint8_t signature[SIGNATURE_SIZE] = { 0 };
+  signature[0] = comb_len;
+  uint8_t* weights = &signature[1];
+  for (int i = 0; i < comb_len; i++) {
+    uint8_t weight = c->weights[comb[i]];
+    int j = i;
+    while (j > 0 && weights[j-1] < weight) {
+      weights[j] = weights[j-1];
+      j--;
+    }
+    weights[j] = weight;
   }
+  void* slot = tuple_map_insert(histogram->signatures, signature, NULL);
+  (*(uint64_t*)tuple_map_value(histogram->signatures, slot))++;
+}
 
-  for (int m = 0; m <= nb_occ_tuple - current_uple.length; m++) {
+void coeff_histogram_flush(CoeffHistogram* histogram) {
+  uint64_t it = 0;
+  void* slot;
+  while ((slot = tuple_map_next(histogram->signatures, &it))) {
+    const uint8_t* signature = slot;
+    uint64_t count = *(uint64_t*)tuple_map_value(histogram->signatures, slot);
+    int comb_len = signature[0];
+    uint64_t content[comb_len];
     int sum = 0;
-    for (int i = 0; i <= n_2 && i <= m; i++) {
-      for (int j = 0; j <= n_3 && j <= m; j++) {
-        for (int k = 0; k <= n_3 && k*2 <= m; k++) {
-          if (i + j + k*2 != m) continue;
-          if (j+k > n_3) continue;
-          sum += table_coeff[n_2][i] * table_coeff[n_3][j] * table_coeff[n_3-j][k] *
-            table_pow[2][n_2-i] * table_pow[3][n_3-j-k] * table_pow[3][j];
-        }
+    for (int i = 0; i < comb_len; i++) {
+      content[i] = signature[1+i];
+      sum += content[i];
+    }
+    Array uple = { .length = comb_len, .content = content };
+    if (sum >= COEFF_FAST_WEIGHT) {
+      mpz_t lst[sum+1];
+      for (int i = 0; i <= sum; i++) mpz_init(lst[i]);
+      expand_failure_gmp(uple, sum, lst);
+      for (int i = comb_len; i <= sum; i++) {
+        mpz_mul_ui(lst[i], lst[i], count);
+        coeff_add_mpz(&histogram->coeffs[i], lst[i]);
       }
+      for (int i = 0; i <= sum; i++) mpz_clear(lst[i]);
+      continue;
+    }
+    Coeff single_coeffs[sum+2];
+    memset(single_coeffs, 0, sizeof(single_coeffs));
+    compute_tree2(uple, single_coeffs, sum);
+    for (int i = comb_len; i <= sum; i++) {
+      coeff_add_mul(&histogram->coeffs[i], count, single_coeffs[i]);
     }
-    coeffs[tmp + m] += sum;
   }
+  tuple_map_clear(histogram->signatures);
 }
 
-void update_coeff_c_single(const Circuit* c, uint64_t* coeff_c, Comb* comb, int comb_len) {
-  //assert(table_coeff_initialized); // Disabling because fairly costly
+void free_coeff_histogram(CoeffHistogram* histogram) {
+  coeff_histogram_flush(histogram);
+  free_tuple_map(histogram->signatures);
+  free(histogram);
+}
 
-  uint64_t nb_occ_tuple = 0;
-  Array uple;
-  uple.length = comb_len;
-  uple.content = alloca(comb_len * sizeof(*uple.content));
-  for (int i = 0; i < comb_len; i++) {
-    nb_occ_tuple += c->weights[comb[i]];
-    uple.content[comb_len-i-1] = c->weights[comb[i]];
-  }
+Coeff* make_thread_coeffs(int len, CoeffHistogram** histogram) {
+  Coeff* coeffs = calloc(len, sizeof(*coeffs));
+  *histogram = make_coeff_histogram(coeffs);
+  return coeffs;
+}
 
-  compute_tree2(uple, coeff_c, (int)nb_occ_tuple);
+void merge_thread_coeffs(Coeff* coeffs, Coeff* thread_coeffs,
+                         CoeffHistogram* histogram, int len) {
+  free_coeff_histogram(histogram);
+  add_coeffs(coeffs, thread_coeffs, len);
+  clear_coeffs(thread_coeffs, len);
+  free(thread_coeffs);
 }
 
-void update_coeff_c(const Circuit* c, uint64_t* coeff_c, ListComb* combs, int comb_len) {
+static void* make_thread_coeffs_data(void* data_void) {
+  CoeffsData* data = (CoeffsData*) data_void;
+  CoeffsData* thread_data = malloc(data->size);
+  memcpy(thread_data, data, data->size);
+  thread_data->coeffs = make_thread_coeffs(data->coeffs_len, &thread_data->histogram);
+  return thread_data;
+}
+
+static void merge_thread_coeffs_data(void* data_void, void* thread_data_void) {
+  CoeffsData* data = (CoeffsData*) data_void;
+  CoeffsData* thread_data = (CoeffsData*) thread_data_void;
+  merge_thread_coeffs(data->coeffs, thread_data->coeffs, thread_data->histogram,
+                      data->coeffs_len);
+  free(thread_data);
+}
+
+const FailureAccumulator coeffs_accumulator = {
+  .make  = make_thread_coeffs_data,
+  .merge = merge_thread_coeffs_data
+};
+
+
+void update_coeff_c(const Circuit* c, Coeff* coeff_c, ListComb* combs, int comb_len) {
   ListCombElem* curr = combs->head;
   Array uple;
   uple.length = comb_len;
@@ -149,12 +580,7 @@ void initialize_table_coeffs() {
   table_coeff_initialized = true;
   for (int n = 0; n < table_coeff_size; n++) {
     for (int k = 0; k < table_coeff_size; k++) {
-      table_coeff[n][k] = n_choose_k(k,n);
-    }
-  }
-  for (int n = 0; n < table_coeff_size; n++) {
-    for (int k = 0; k < table_coeff_size; k++) {
-      table_pow[k][n] = pow(k, n);
+      table_coeff[n][k] = n_choose_k_128(k,n);
     }
   }
 }
@@ -173,6 +599,166 @@ void n_choose_k_gmp(int k, int n, mpf_t res) {
 
 }
 
+/* Evaluation of the leakage polynomial
+
+   compute_leakage_proba searches p such that f(p) = p, with
+
+      f(p) = \sum_{i=1}^{len-1} coeffs[i] * p^i * (1-p)^(len-i-1)
+
+   by bisection, which evaluates f about 40 times. Evaluating f with
+   GMP costs O(len) mpf_pow_ui, which is slow for large gadgets.
+   Instead, f is evaluated in long double, with coefficients converted
+   once, and incremental powers of p and 1-p. All terms being
+   non-negative, the relative error of this evaluation is at most
+   LEAKAGE_POLY_ERROR(len), up to an absolute error coming from
+   subnormal powers (see |abs_error| below). This bound also covers
+   the error of the GMP evaluation: when f(p) and p are further apart
+   than that, comparing them in long double gives the same result as
+   with GMP. Otherwise, f(p) is computed with GMP, as before (the GMP
+   coefficients are only computed then). The results of
+   compute_leakage_proba are thus the same as with GMP only.
+*/
+
+#define LEAKAGE_POLY_ERROR(len) (((len) + 8) * 0x1p-50L)
+
+typedef struct _leakage_poly {
+  int len;
+  Coeff* exact_coeffs;       // Arguments of compute_leakage_proba
+  int last_precise_coeff;
+  int min_max;
+  mpf_t* coeffs;             // len coefficients, for the GMP evaluation
+                             // (NULL until it is needed)
+  long double* fast_coeffs;  // The same ones, as long doubles
+  long double* q_pows;       // len powers of 1-p (scratch space)
+  long double abs_error;     // Bound on the errors due to subnormals
+  bool fast;                 // false if the long doubles cannot be used
+} LeakagePoly;
+
+// Creates the polynomial used by compute_leakage_proba (see below for
+// its arguments).
+static LeakagePoly* make_leakage_poly(Coeff* coeffs, int last_precise_coeff,
+                                      int len, int min_max) {
+  LeakagePoly* poly = malloc(sizeof(*poly));
+  poly->len = len;
+  poly->exact_coeffs = coeffs;
+  poly->last_precise_coeff = last_precise_coeff;
+  poly->min_max = min_max;
+  poly->coeffs = NULL;
+  poly->fast_coeffs = malloc(len * sizeof(*poly->fast_coeffs));
+  poly->q_pows = malloc(len * sizeof(*poly->q_pows));
+
+  // Unknown coefficients are replaced by binomial coefficients, which
+  // are computed incrementally (with 2 roundings each time).
+  long double binomial = 1, max_coeff = 0;
+  for (int i = 0; i < len; i++) {
+    if (i > 0) binomial = binomial * (len - i + 1) / i;
+    if (i <= last_precise_coeff) {
+      poly->fast_coeffs[i] = coeff_get_ld(coeffs[i]);
+    } else {
+      poly->fast_coeffs[i] = min_max == 1 ? binomial : 0;
+    }
+    if (poly->fast_coeffs[i] > max_coeff) max_coeff = poly->fast_coeffs[i];
+  }
+  // Once a power of p or 1-p is subnormal, each multiplication adds an
+  // absolute error of at most LDBL_TRUE_MIN to it.
+  poly->abs_error = 2.0L * len * len * max_coeff * LDBL_TRUE_MIN;
+  poly->fast = isfinite(poly->abs_error);
+  return poly;
+}
+
+// Computes the coefficients of |poly| with GMP.
+static void leakage_poly_init_gmp(LeakagePoly* poly) {
+  int len = poly->len;
+  poly->coeffs = malloc(len * sizeof(*poly->coeffs));
+  for (int i = 0; i < poly->last_precise_coeff+1 && i < len; i++) {
+    coeff_init_mpf(poly->coeffs[i], poly->exact_coeffs[i]);
+  }
+  for (int i = poly->last_precise_coeff+1; i < len; i++) {
+    if (poly->min_max == 1) {
+      n_choose_k_gmp(i, len, poly->coeffs[i]);
+    } else {
+      mpf_init(poly->coeffs[i]);
+    }
+  }
+}
+
+static void free_leakage_poly(LeakagePoly* poly) {
+  if (poly->coeffs) {
+    for (int i = 0; i < poly->len; i++) {
+      mpf_clear(poly->coeffs[i]);
+    }
+    free(poly->coeffs);
+  }
+  free(poly->fast_coeffs);
+  free(poly->q_pows);
+  free(poly);
+}
+
+// Compares f(p) (or sqrt(f(p)) if |square_root| is true) with p using
+// GMP. Returns 1 if it is larger than p, -1 if it is smaller, and 0 if
+// they are equal.
+static int leakage_poly_compare_gmp(LeakagePoly* poly, double p,
+                                    bool square_root) {
+  int len = poly->len;
+  if (!poly->coeffs) leakage_poly_init_gmp(poly);
+  mpf_t fp;
+  mpf_init(fp);
+
+  for (int i = 1; i < len; i++) {
+    mpf_t tmp;
+    mpf_t tmp1;
+    mpf_init_set_d(tmp, p);
+    mpf_init_set_d(tmp1, 1-p);
+    mpf_pow_ui(tmp1, tmp1, len-i-1);
+    mpf_pow_ui(tmp, tmp, i);
+    mpf_mul(tmp, tmp, poly->coeffs[i]);
+    mpf_mul(tmp, tmp, tmp1);
+    mpf_add(fp, fp, tmp);
+
+    mpf_clear(tmp);
+    mpf_clear(tmp1);
+  }
+
+  if (square_root) {
+    mpf_sqrt(fp, fp);
+  }
+
+  int cmp = mpf_cmp_d(fp, p);
+  mpf_clear(fp);
+  return cmp > 0 ? 1 : cmp < 0 ? -1 : 0;
+}
+
+// Same as leakage_poly_compare_gmp, but using long doubles when the
+// result is certain.
+static int leakage_poly_compare(LeakagePoly* poly, double p, bool square_root) {
+  int len = poly->len;
+  if (poly->fast && len >= 2) {
+    double q = 1-p; // Rounded as in leakage_poly_compare_gmp
+    poly->q_pows[0] = 1;
+    for (int k = 1; k < len - 1; k++) {
+      poly->q_pows[k] = poly->q_pows[k-1] * q;
+    }
+    long double fp = 0, p_pow = 1;
+    for (int i = 1; i < len; i++) {
+      p_pow *= p;
+      fp += poly->fast_coeffs[i] * p_pow * poly->q_pows[len-i-1];
+    }
+
+    // sqrt(f(p)) is compared with p by comparing f(p) with p^2.
+    long double target = square_root ? (long double)p * p : p;
+    long double rel_error = LEAKAGE_POLY_ERROR(len);
+    if (isfinite(fp)) {
+      if (fp * (1 - rel_error) - poly->abs_error > target * (1 + rel_error)) {
+        return 1;
+      }
+      if (fp * (1 + rel_error) + poly->abs_error < target * (1 - rel_error)) {
+        return -1;
+      }
+    }
+  }
+  return leakage_poly_compare_gmp(poly, p, square_root);
+}
+
 // Computes p such that f(p) = p where f is the function defined by
 // |coeffs| as:
 //
@@ -187,71 +773,34 @@ void n_choose_k_gmp(int k, int n, mpf_t res) {
 // wires.
 // if |min_max| == 1, then replace unknown coefficients by n choose k
 // if |min_max| == -1, then replace unknown coefficients by 0
-double compute_leakage_proba(uint64_t* coeffs, int last_precise_coeff, int len,
+double compute_leakage_proba(Coeff* coeffs, int last_precise_coeff, int len,
                              int min_max, bool square_root) {
-  mpf_t coeffs_max[len];
-
-  for (int i = 0; i < last_precise_coeff+1; i++) {
-    mpf_init_set_ui(coeffs_max[i], coeffs[i]);
-  }
-
-  for (int i = last_precise_coeff+1; i < len; i++) {
-    if (min_max == 1) {
-      n_choose_k_gmp(i, len, coeffs_max[i]);
-    } else {
-      mpf_init(coeffs_max[i]);
-    }
-  }
+  LeakagePoly* poly = make_leakage_poly(coeffs, last_precise_coeff, len, min_max);
 
   // Binary search to find leakage proba p
   double p_inf = 0, p_sup = 1, epsilon = 0.000000000001;
   while ( fabs(p_inf - p_sup) > epsilon ) {
     double p = (p_inf + p_sup) / 2;
 
-    mpf_t fp;
-    mpf_init(fp);
-
-    for (int i = 1; i < len; i++) {
-      mpf_t tmp;
-      mpf_t tmp1;
-      mpf_init_set_d(tmp, p);
-      mpf_init_set_d(tmp1, 1-p);
-      mpf_pow_ui(tmp1, tmp1, len-i-1);
-      mpf_pow_ui(tmp, tmp, i);
-      mpf_mul(tmp, tmp, coeffs_max[i]);
-      mpf_mul(tmp, tmp, tmp1);
-      mpf_add(fp, fp, tmp);
-
-      mpf_clear(tmp);
-      mpf_clear(tmp1);
-    }
-
-    if (square_root) {
-      mpf_sqrt(fp, fp);
-    }
-
-    if (mpf_cmp_d(fp, p) == 0) break;
-    if (mpf_cmp_d(fp, p) == 1) { // f(p) > p
+    int cmp = leakage_poly_compare(poly, p, square_root);
+    if (cmp == 0) break;
+    if (cmp == 1) { // f(p) > p
       p_sup = p;
     } else { // f(p) < p
       p_inf = p;
     }
-
-    mpf_clear(fp);
   }
 
-  for (int i = 0; i < len; i++) {
-    mpf_clear(coeffs_max[i]);
-  }
+  free_leakage_poly(poly);
 
   return (p_inf+p_sup)/2;
 }
 
-void get_failure_proba(uint64_t* coeffs, int len, double p, int coeff_max){
+void get_failure_proba(Coeff* coeffs, int len, double p, int coeff_max){
   mpf_t coeffs_max[len];
 
   for (int i = 0; i < len; i++) {
-    mpf_init_set_ui(coeffs_max[i], coeffs[i]);
+    coeff_init_mpf(coeffs_max[i], coeffs[i]);
   }
 
   if(coeff_max != -1){
@@ -286,17 +835,50 @@ void get_failure_proba(uint64_t* coeffs, int len, double p, int coeff_max){
 }
 
 
-void compute_combined_intermediate_leakage_proba(uint64_t* coeffs, int k, int total, int coeffs_size, double p, double f, mpf_t res, int c_max){
+void eval_failure_proba_grid(const long double* coeffs, int len, int degree,
+                             int coeff_max, long double binomial_scale,
+                             const double* ps, int count, long double* res) {
+  long double* q = malloc(count * sizeof(*q));
+  long double* q_pow = malloc(count * sizeof(*q_pow));
+  for (int j = 0; j < count; j++) {
+    res[j] = 0;
+    q[j] = 1 - (long double)ps[j];
+    q_pow[j] = 1;
+  }
+
+  // With n = len-1, after the iteration i, res[j] is
+  //      \sum_{m=i}^{n} coeffs[m] * p^(m-i) * (1-p)^(n-m)
+  // and q_pow[j] is (1-p)^(n-i+1).
+  int n = len - 1;
+  long double binomial = 1; // n choose i
+  for (int i = n; i >= 0; i--) {
+    long double c = coeff_max != -1 && i > coeff_max ?
+      binomial_scale * binomial : coeffs[i];
+    for (int j = 0; j < count; j++) {
+      res[j] = res[j] * ps[j] + c * q_pow[j];
+      q_pow[j] *= q[j];
+    }
+    binomial = binomial * i / (n - i + 1);
+  }
+
+  for (int j = 0; j < count; j++) {
+    res[j] *= powl(q[j], degree - n);
+  }
+  free(q);
+  free(q_pow);
+}
+
+void compute_combined_intermediate_leakage_proba(Coeff* coeffs, int k, int total, int coeffs_size, double p, double f, mpf_t res, int c_max){
   mpf_t coeffs_mpf[coeffs_size];
 
   if(c_max == -1){
     for (int i = 0; i < coeffs_size; i++) {
-      mpf_init_set_ui(coeffs_mpf[i], coeffs[i]);
+      coeff_init_mpf(coeffs_mpf[i], coeffs[i]);
     }
   }
   else{
     for (int i = 0; i <= c_max; i++) {
-      mpf_init_set_ui(coeffs_mpf[i], coeffs[i]);
+      coeff_init_mpf(coeffs_mpf[i], coeffs[i]);
     }
     for (int i = c_max+1; i < coeffs_size; i++) {
       n_choose_k_gmp(i, coeffs_size-1, coeffs_mpf[i]);
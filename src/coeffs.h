@@ -2,23 +2,230 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
 #include <gmp.h>
 
 #include "parser.h"
 #include "list_tuples.h"
+#include "hash_tuples.h"
+#include "verification_rules.h"
+
+
+/* Coefficients
+
+   A coefficient counts sets of wires of a given size, and can thus be
+   as large as (total_wires choose size): on large gadgets, it does not
+   fit in 64 bits. Coefficients are stored as Coeff, a 128-bit integer,
+   as long as they are below COEFF_SPILLED (2^127). Larger values are
+   spilled to GMP: they are stored in a global pool of mpz_t, and the
+   Coeff is then COEFF_SPILLED | (index of the value in the pool). The
+   hot paths (coeff_add, and the expansion of failures whose total
+   weight is below COEFF_FAST_WEIGHT in compute_tree2) thus only use
+   128-bit arithmetic, and GMP is only used once a coefficient
+   actually overflows.
+
+   A spilled value belongs to the coefficient that holds it, and
+   coeff_add updates it in place: a coefficient that may be spilled
+   must thus be copied with coeff_set (or copy_coeffs) rather than
+   assigned, unless the original is not updated anymore. Coefficients
+   that may be spilled must be cleared with clear_coeffs before they
+   are freed or zeroed: their spilled values are then reused by later
+   spills, and the pool itself is only freed by free_coeff_spills, at
+   exit.
+*/
+
+typedef uint128_t Coeff;
+
+#define COEFF_SPILLED ((Coeff)1 << 127)
+
+// Failures whose weights sum to less than COEFF_FAST_WEIGHT are
+// expanded in 128-bit integers by compute_tree2: each of their
+// coefficients is at most 2^(sum of the weights).
+#define COEFF_FAST_WEIGHT 127
+
+static inline bool coeff_is_spilled(Coeff c) {
+  return c & COEFF_SPILLED;
+}
+
+// Adds |src| to *|dst| when the result or one of them is spilled.
+void coeff_add_slow(Coeff* dst, Coeff src);
+
+// Adds |src| to *|dst|.
+static inline void coeff_add(Coeff* dst, Coeff src) {
+  Coeff sum = *dst + src;
+  if (__builtin_expect(coeff_is_spilled(*dst | src | sum), 0)) {
+    coeff_add_slow(dst, src);
+  } else {
+    *dst = sum;
+  }
+}
+
+// Adds |count| * |src| to *|dst|.
+void coeff_add_mul(Coeff* dst, uint64_t count, Coeff src);
+
+// Sets *|dst| to a copy of |src|.
+void coeff_set(Coeff* dst, Coeff src);
+
+// Sets *|dst| to a copy of |src| if |src| is larger.
+void coeff_set_max(Coeff* dst, Coeff src);
+
+// Returns a negative value if |a| < |b|, 0 if they are equal, and a
+// positive value otherwise.
+int coeff_cmp(Coeff a, Coeff b);
+
+// Copies the |len| coefficients of |src| into |dst|.
+void copy_coeffs(Coeff* dst, const Coeff* src, int len);
+
+// Adds the |len| coefficients of |src| to those of |dst|.
+void add_coeffs(Coeff* dst, const Coeff* src, int len);
+
+// Sets |res| (which must be initialized) to |c|.
+void coeff_get_mpz(mpz_t res, Coeff c);
+
+// Initializes |res| and sets it to |c|.
+void coeff_init_mpf(mpf_t res, Coeff c);
+
+long double coeff_get_ld(Coeff c);
+
+// Prints |c| in decimal to |f|.
+void fprint_coeff(FILE* f, Coeff c);
+
+// Reads a coefficient written by fprint_coeff from |f| into *|c|.
+// Returns false if |f| does not contain one.
+bool fscan_coeff(FILE* f, Coeff* c);
+
+// Zeroes the |len| coefficients of |coeffs|, and returns their
+// spilled values to the pool.
+void clear_coeffs(Coeff* coeffs, int len);
+
+// Frees the spilled values; the coefficients that were spilled
+// become invalid.
+void free_coeff_spills();
+
+
+/* Coefficient files (CRP and CRPC)
+
+   The coefficients of the scenarios are written in binary, after a
+   header giving the version of the format: each coefficient takes 16
+   bytes, and spilled coefficients are followed by their value (in the
+   format of mpz_out_raw). Files written before this header existed
+   contain 8 bytes per coefficient (COEFFS_FILE_LEGACY_VERSION).
+*/
+
+#define COEFFS_FILE_VERSION 2
+#define COEFFS_FILE_LEGACY_VERSION 1
+
+// Writes the header of a coefficient file.
+void write_coeffs_header(FILE* f);
+
+// Reads the header of a coefficient file, and returns the version of
+// its format. Exits if this version is not supported.
+int read_coeffs_header(FILE* f, const char* filename);
+
+// Writes the |len| coefficients |coeffs| to |f|.
+void write_coeffs(FILE* f, const Coeff* coeffs, int len);
+
+// Reads |len| coefficients written with the format |version| from
+// |f| into |coeffs|, which are cleared first (see clear_coeffs).
+// Returns false if |f| does not contain them.
+bool read_coeffs(FILE* f, int version, Coeff* coeffs, int len);
+
+
+void update_coeff_c_single(const Circuit* c, Coeff* coeff_c, Comb* comb, int comb_len);
+void update_coeff_c(const Circuit* c, Coeff* coeff_c, ListComb* combs, int comb_len);
+
+
+/* Histograms of failures
+
+   The contribution of a failure to the coefficients (computed by
+   update_coeff_c_single) only depends on its size and on the multiset
+   of the weights of its variables (c->weights), and circuits usually
+   have few distinct weights: most failures thus share their
+   signature (size, weights) with many others. A CoeffHistogram counts
+   the failures of each signature, and the contribution of each
+   signature is computed once, multiplied by its count, when the
+   histogram is flushed.
+
+   Failures whose weights are all 1 except at most one 2 (for which
+   update_coeff_c_single is already a couple of additions), failures
+   of more than COEFF_HISTOGRAM_MAX_LEN variables, and failures
+   containing variables of weight larger than 255 update the
+   coefficients right away.
+*/
+
+#define COEFF_HISTOGRAM_MAX_LEN 15
+
+typedef struct _coeff_histogram {
+  TupleMap* signatures; // Signatures -> number of failures (uint64_t)
+  Coeff* coeffs;        // The coefficients updated by the histogram
+} CoeffHistogram;
+
+// Creates an empty histogram updating |coeffs|.
+CoeffHistogram* make_coeff_histogram(Coeff* coeffs);
+
+// Counts the failure |comb| (of size |comb_len|) in |histogram|.
+void coeff_histogram_add(CoeffHistogram* histogram, const Circuit* c,
+                         Comb* comb, int comb_len);
+
+// Adds the contributions of the failures counted in |histogram| to
+// its coefficients, and empties it.
+void coeff_histogram_flush(CoeffHistogram* histogram);
+
+// Flushes and frees |histogram|.
+void free_coeff_histogram(CoeffHistogram* histogram);
+
+// Returns the zeroed copy of |len| coefficients filled by a thread
+// when failures are accumulated by several threads (see
+// FailureAccumulator), and sets *|histogram| to a histogram updating
+// it.
+Coeff* make_thread_coeffs(int len, CoeffHistogram** histogram);
+
+// Flushes and frees |histogram|, then adds the |len| coefficients of
+// |thread_coeffs| (from make_thread_coeffs) to |coeffs| and frees
+// them.
+void merge_thread_coeffs(Coeff* coeffs, Coeff* thread_coeffs,
+                         CoeffHistogram* histogram, int len);
+
+// The coefficients updated by the failure callback of a property. It
+// must be the first member of the callback data, so that
+// coeffs_accumulator can copy the callback data for each thread.
+typedef struct _coeffs_data {
+  size_t size;               // Size of the whole callback data
+  Coeff* coeffs;
+  int coeffs_len;
+  CoeffHistogram* histogram; // Counts the failures in |coeffs| (only in the
+                             // copies of the threads, NULL otherwise)
+} CoeffsData;
+
+// Gives each thread a copy of a callback data starting with a
+// CoeffsData, with its own coefficients (see make_thread_coeffs), and
+// merges them back into the coefficients of the callback data.
+extern const FailureAccumulator coeffs_accumulator;
 
-void update_coeff_c_single(const Circuit* c, uint64_t* coeff_c, Comb* comb, int comb_len);
-void update_coeff_c(const Circuit* c, uint64_t* coeff_c, ListComb* combs, int comb_len);
 
 void initialize_table_coeffs();
 
-double compute_leakage_proba(uint64_t* coeffs, int last_precise_coeff, int len,
+double compute_leakage_proba(Coeff* coeffs, int last_precise_coeff, int len,
                              int min_max, bool square_root);
 
-void get_failure_proba(uint64_t* coeffs, int len, double p, int coeff_max);
+void get_failure_proba(Coeff* coeffs, int len, double p, int coeff_max);
+
+// Evaluates
+//
+//      f(p) = \sum_{i=0}^{len-1} coeffs[i] * p^i * (1-p)^(degree-i)
+//
+// (with |degree| >= len-1) at each of the |count| probabilities |ps|,
+// and stores the results in |res|. If |coeff_max| is not -1, the
+// coefficients after |coeff_max| are replaced by |binomial_scale| *
+// (len-1 choose i). All points are evaluated in a single pass over the
+// coefficients, with Horner's scheme.
+void eval_failure_proba_grid(const long double* coeffs, int len, int degree,
+                             int coeff_max, long double binomial_scale,
+                             const double* ps, int count, long double* res);
 
 
-void compute_combined_intermediate_leakage_proba(uint64_t* coeffs, int k, int total, int coeffs_size, double p, double f, mpf_t res, int c_max);
+void compute_combined_intermediate_leakage_proba(Coeff* coeffs, int k, int total, int coeffs_size, double p, double f, mpf_t res, int c_max);
 
 void compute_combined_intermediate_mu(int k, int total, double f, mpf_t res);
 void compute_combined_mu_max(int k, int total, double f, mpf_t res);
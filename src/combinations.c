@@ -1,47 +1,124 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdint.h>
-#include <math.h>
+#include <stddef.h>
 #include <string.h>
 
 #include "combinations.h"
 
-// Iterative approach to compute n choose k to avoid overflows
-uint64_t n_choose_k(int k, int n) {
-  double res = 1;
-  for (int i = k; i > 0; i--) {
-    res *= n--;
-    res /= k--;
+/***********************************************************
+                  Binomial coefficients
+************************************************************/
+
+// Pascal's triangle: |binomials[n][k]| = n choose k for 0 <= k <= n/2
+// and n <= |binomials_n_max| (the other coefficients are obtained by
+// symmetry). Coefficients that do not fit on 128 bits are saturated
+// to UINT128_MAX.
+static uint128_t** binomials = NULL;
+static int binomials_n_max = -1;
+
+#define UINT128_MAX (~(uint128_t)0)
+
+static uint128_t add_saturated(uint128_t a, uint128_t b) {
+  uint128_t res = a + b;
+  return res < a ? UINT128_MAX : res;
+}
+
+static uint128_t gcd_128(uint128_t a, uint128_t b) {
+  while (b) {
+    uint128_t tmp = a % b;
+    a = b;
+    b = tmp;
+  }
+  return a;
+}
+
+// Computes n choose k without the table. Each step computes
+// C(n,i+1) = C(n,i) * (n-i) / (i+1) exactly: after dividing C(n,i)
+// and i+1 by their gcd g, (i+1)/g divides n-i.
+static uint128_t n_choose_k_slow(int k, int n) {
+  uint128_t res = 1;
+  for (int i = 0; i < k; i++) {
+    uint128_t g = gcd_128(res, i+1);
+    uint128_t num = (uint128_t)(n-i) / ((i+1) / g);
+    res /= g;
+    if (res > UINT128_MAX / num) return UINT128_MAX;
+    res *= num;
+  }
+  return res;
+}
+
+void init_binomials(int n_max) {
+  free_binomials();
+  binomials = malloc((n_max+1) * sizeof(*binomials));
+  for (int n = 0; n <= n_max; n++) {
+    binomials[n] = malloc((n/2+1) * sizeof(*binomials[n]));
+    binomials[n][0] = 1;
+    for (int k = 1; k <= n/2; k++) {
+      // C(n-1,k) = C(n-1,n-1-k) when k > (n-1)/2
+      uint128_t right = k <= (n-1)/2 ? binomials[n-1][k] : binomials[n-1][n-1-k];
+      binomials[n][k] = add_saturated(binomials[n-1][k-1], right);
+    }
   }
-  return (uint64_t)round(res);
+  binomials_n_max = n_max;
+}
+
+void free_binomials() {
+  for (int n = 0; n <= binomials_n_max; n++) {
+    free(binomials[n]);
+  }
+  free(binomials);
+  binomials = NULL;
+  binomials_n_max = -1;
+}
+
+uint128_t n_choose_k_128(int k, int n) {
+  if (k < 0 || n < 0 || k > n) return 0;
+  if (k > n - k) k = n - k;
+  if (n <= binomials_n_max) return binomials[n][k];
+  return n_choose_k_slow(k, n);
 }
 
-// Returns the rank of the combination |comb|
+uint64_t n_choose_k(int k, int n) {
+  uint128_t res = n_choose_k_128(k, n);
+  return res > UINT64_MAX ? UINT64_MAX : (uint64_t)res;
+}
+
+// Returns the rank of the combination |comb| in the lexicographic
+// order (as generated by incr_comb_in_place), starting from 0.
 uint64_t rank(int n, int k, Comb* comb) {
-  uint64_t idx = n_choose_k(k,n);
+  uint128_t idx = n_choose_k_128(k,n) - 1;
   for (int m = 0; m < k; m++) {
-    idx -= n_choose_k(m+1, n-comb[k-m-1]-1);
+    idx -= n_choose_k_128(m+1, n-comb[k-m-1]-1);
   }
   return idx;
 }
 
-// Returns the combination whose rank is |idx|
+// Returns the combination whose rank is |idx| (the inverse of
+// |rank|). |idx| is first turned into the rank of the complemented
+// combination (n-1-comb[0] > ... > n-1-comb[k-1]) in the
+// combinatorial number system, whose elements are then found by
+// binary search: O(k log n).
 Comb* unrank(int n, int k, uint64_t idx) {
   Comb* comb = malloc(k * sizeof(*comb));
-  int comb_insert_idx = 0;
-  int n_orig = n;
-  int k_orig = k;
-  idx = n_choose_k(k,n) - idx;
-
-  n--;
-
-  while (comb_insert_idx != k_orig) {
-    uint64_t candidate = n_choose_k(k,n);
-    if (candidate <= idx) {
-      comb[comb_insert_idx++] = n_orig - n - 1;
-      idx -= candidate;
-      k--;
+  uint128_t remaining = n_choose_k_128(k,n) - 1 - idx;
+
+  int upper = n; // The next element is strictly less than |upper|
+  for (int i = 0; i < k; i++) {
+    int r = k - i;
+    // Largest c < upper such that C(c,r) <= remaining (C(r-1,r) = 0)
+    int lo = r - 1, hi = upper - 1;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (n_choose_k_128(r, mid) <= remaining) {
+        lo = mid;
+      } else {
+        hi = mid - 1;
+      }
     }
-    n--;
+    comb[i] = n - 1 - lo;
+    remaining -= n_choose_k_128(r, lo);
+    upper = lo;
   }
 
   return comb;
@@ -182,10 +259,15 @@ void _gen_combinations_aux(Comb** combs, int combs_idx, int j, int k, int max) {
    cannot do batching. */
 Comb** gen_combinations(uint64_t* len, int k, int max) {
   // Allocating storage
-  int total_combs = n_choose_k(k,max+1);
+  uint64_t total_combs = n_choose_k(k,max+1);
+  if (total_combs > PTRDIFF_MAX / sizeof(Comb*)) {
+    fprintf(stderr, "Too many combinations of %d elements among %d to store them. Exiting.\n",
+            k, max+1);
+    exit(EXIT_FAILURE);
+  }
   *len = total_combs;
   Comb** combs = malloc(total_combs * sizeof(*combs));
-  for (int i = 0; i < total_combs; i++)
+  for (uint64_t i = 0; i < total_combs; i++)
     combs[i] = malloc(k * sizeof(*combs[i]));
   _gen_combinations_aux(combs,0,0,k,max);
   return combs;
@@ -7,6 +7,19 @@
 
 typedef Var Comb;
 
+typedef unsigned __int128 uint128_t;
+
+// Precomputes the binomial coefficients n choose k for n <= |n_max|
+// (typically, the number of variables of the circuit), so that
+// n_choose_k, rank and unrank do not recompute them. Not thread-safe:
+// should be called before starting the verification. Coefficients
+// with n > |n_max| are still computed exactly, only slower.
+void init_binomials(int n_max);
+void free_binomials();
+
+// Exact n choose k, saturated to UINT128_MAX (resp. UINT64_MAX) if it
+// does not fit on 128 (resp. 64) bits.
+uint128_t n_choose_k_128(int k, int n);
 uint64_t n_choose_k(int k, int n);
 uint64_t rank(int n, int k, Comb* comb);
 Comb* unrank(int n, int k, uint64_t idx);
@@ -1,9 +1,38 @@
 #pragma once
 
-// Size of batches when batching is required. For now, this is only
-// used for RPE2 verification. (it should be used for RPE12 and RPE21
-// as well though; TODO)
-#define BATCH_SIZE 1000000 // 1 million
+// Without --mem-limit, the memory budget (see mem_limit.h) is
+// DEFAULT_MEM_LIMIT_PERCENT percent of the physical memory.
+#define DEFAULT_MEM_LIMIT_PERCENT 50
+
+// When verifying tuples in parallel, the tuples are split into chunks
+// that threads claim (and steal from each other) dynamically. Each
+// thread gets about WORK_CHUNKS_PER_THREAD chunks, each containing at
+// least MIN_TUPLES_PER_CHUNK tuples (so that the cost of starting a
+// chunk remains negligible).
+#define WORK_CHUNKS_PER_THREAD 16
+#define MIN_TUPLES_PER_CHUNK 1024
+
+// When checkpointing (--checkpoint), the state of the verification is
+// saved at most every CHECKPOINT_INTERVAL seconds (unless
+// --checkpoint-interval says otherwise). To allow saving in
+// the middle of the enumeration of the tuples of a given size, the
+// tuples are verified by segments of CHECKPOINT_SEGMENT_TUPLES tuples,
+// between which all threads synchronize.
+#define CHECKPOINT_INTERVAL 600 // 10 minutes
+#define CHECKPOINT_SEGMENT_TUPLES (1ULL << 24)
+
+// With --progress, a progress line is printed at most every
+// STATS_PROGRESS_INTERVAL seconds. When statistics are enabled, one
+// tuple out of STATS_TIMING_PERIOD (a power of 2) has the time spent
+// in each step of its verification measured.
+#define STATS_PROGRESS_INTERVAL 10
+#define STATS_TIMING_PERIOD 64
+
+// Arenas (see arena.h) allocate blocks of ARENA_MIN_BLOCK_SIZE bytes
+// at first, then of twice the size of the previous block, up to
+// ARENA_MAX_BLOCK_SIZE bytes.
+#define ARENA_MIN_BLOCK_SIZE 4096
+#define ARENA_MAX_BLOCK_SIZE (1 << 20)
 
 #include <stdint.h>
 
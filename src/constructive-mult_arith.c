@@ -805,8 +805,9 @@ static int tot_adds = 0;
 //
 //  |RPC| : Indicates if we are in RPC/RPE mode or not.
 //
-//  |mutex|: For parallelisation purpose. We have to lock the thread when we add
-//           tuple into |incompr_tuples|. 
+//  |mutex|: For parallelisation purpose. If not NULL, the tuples are added to
+//           the local trie of the thread (see get_local_trie) rather than to
+//           |incompr_tuples|. 
 //
 //  |debug|: if true, then some debuging information are printed.
 //
@@ -872,25 +873,21 @@ static void randoms_step(const Circuit* c,
   if (__builtin_popcount(revealed_secret) >= t_in) {
     
    
-    // If parallelisation is done, we have to lock this part. Otherwise, 
-    // we can add two failures tuples at the same time.
-    if(mutex)
-      pthread_mutex_lock(mutex);
+    // If parallelisation is done, |incompr_tuples| is read-only until all 
+    // threads are done: the tuple is added to the trie local to this thread,
+    // which is merged into |incompr_tuples| afterwards.
+    Trie* local_tuples = mutex ? get_local_trie(incompr_tuples) : NULL;
 
-    tot_adds++;
+    __atomic_add_fetch(&tot_adds, 1, __ATOMIC_RELAXED);
     
     //Check if it doesn't exist an incompressible tuple in |incompr_tuples| that 
     //contains this tuple.
-    if (!tuple_is_not_incompr(incompr_tuples, curr_tuple)) {
-      add_tuple_to_trie_arith(incompr_tuples, curr_tuple, c, secret_idx, 
-                        revealed_secret);
+    if (!tuple_is_not_incompr(incompr_tuples, curr_tuple) &&
+        !(local_tuples && tuple_is_not_incompr(local_tuples, curr_tuple))) {
+      add_tuple_to_trie_arith(local_tuples ? local_tuples : incompr_tuples, 
+                              curr_tuple, c, secret_idx, revealed_secret);
     }
     
-    //Unlock the mutex
-    if(mutex)
-      pthread_mutex_unlock(mutex);
-    
-    
     return;
   }
 
@@ -2285,6 +2282,7 @@ static Trie* build_incompr_tuples(const Circuit* c,
       }
       else 
         pthread_join(threads, NULL);
+      merge_local_tries(incompr_tuples, c->secret_count);
     }
     
     //If we only have to find one failure and incompr_tuples is not empty, 
@@ -2460,6 +2458,7 @@ static Trie* build_incompr_tuples_RPE(const Circuit* c,
                             secret_idx, curr_tuple, required_outputs, RPC, t_in,
                             mutex, debug);
       free(gauss_length_o);
+      merge_local_tries(incompr_tuples, c->secret_count);
     }
   }
   
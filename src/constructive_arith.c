@@ -407,8 +407,9 @@ int tuple_is_in_incompr_tuples(Trie* incompr_tuples, Tuple* curr_tuple) {
 //      probes that are outputs in |curr_tuple|. If you don't know why we add
 //      this boolean, just see the comments above.
 //
-//  |mutex|: A mutex to lock when we add failures tuples in |incompr_tuples|, if
-//      we are parallelizing the program.
+//  |mutex|: Not NULL if we are parallelizing the program, in which case the
+//      failure tuples are added to the local trie of the thread (see 
+//      get_local_trie) rather than to |incompr_tuples|.
 //
 //  |debug|: if true, then some debuging information are printed.
 //
@@ -444,27 +445,22 @@ void randoms_step_arith(const Circuit* c,
   // Checking if secret is revealed
   if (__builtin_popcount(revealed_secret) >= t_in) {
     
-    //Lock the mutex if we do a parallelization.
-    if (mutex)
-      pthread_mutex_lock(mutex);
+    //If we do a parallelization, |incompr_tuples| is read-only until all 
+    //threads are done: the tuple is added to the trie local to this thread, 
+    //which is merged into |incompr_tuples| afterwards (see 
+    //merge_local_tries).
+    Trie* local_tuples = mutex ? get_local_trie(incompr_tuples) : NULL;
         
-    if (tuple_is_not_incompr_arith(incompr_tuples, curr_tuple)) {
-      
-      //Unlock
-      if (mutex)
-        pthread_mutex_unlock(mutex); 
-      
+    if (tuple_is_not_incompr_arith(incompr_tuples, curr_tuple) ||
+        (local_tuples && tuple_is_not_incompr_arith(local_tuples, curr_tuple))) {
       return;
     } 
     
-    tot_adds_arith++;
+    __atomic_add_fetch(&tot_adds_arith, 1, __ATOMIC_RELAXED);
     
     //The tuple is an incompressible failure tuple, we add it in incompr_tuples.
-    add_tuple_to_trie_arith(incompr_tuples, curr_tuple, c, secret_idx,
-                            revealed_secret);
-    //Unlock
-    if (mutex)
-      pthread_mutex_unlock(mutex);
+    add_tuple_to_trie_arith(local_tuples ? local_tuples : incompr_tuples, 
+                            curr_tuple, c, secret_idx, revealed_secret);
     
     return;
   }
@@ -1581,6 +1577,8 @@ Trie* build_incompr_tuples_arith(const Circuit* c,
 
     }
     
+    if (cores != 1) merge_local_tries(incompr_tuples, c->secret_count);
+    
     //If we have to only find one failure, cehckinf if we find one !
     if (one_failure && trie_tuples_size(incompr_tuples, target_size))
       break;
@@ -1784,9 +1782,6 @@ Input :
 */
 void compute_RP_coeffs_incompr_arith(const Circuit* c, int coeff_max, int cores,
                                int verbose) {
-  //Compute the optimal HASH_MASK for the hash_table.
-  determine_HASH_MASK(c->length, coeff_max); 
-  
   //Compute the trie of incompressibles tuples.
   Trie* incompr_tuples = compute_incompr_tuples_arith(c, c->share_count,
                                                 NULL, coeff_max, false, 0, 
@@ -1812,12 +1807,12 @@ Input :
   -int len_output : The cureent size of |otuput_set|.
   -int coeff_max : The maximal coefficient that we have to compute.
   -int verbose : Set a level of verbosity.
-  -uint64_t *coeffs : The list of errors coefficients in which we will write.
+  -Coeff *coeffs : The list of errors coefficients in which we will write.
 */
 void update_coeff_output_RPC(const Circuit* c, Trie *incompr_tuples, 
                              int required_output, int last_index, 
                              int *output_set, int len_output, int coeff_max, 
-                             int verbose, uint64_t *coeffs){
+                             int verbose, Coeff *coeffs){
   if (required_output == 0){
     //Create |incompr_tuples_output| like we said above.
     Trie *incompr_tuples_output = derive_trie_from_subset (incompr_tuples, 
@@ -1829,7 +1824,7 @@ void update_coeff_output_RPC(const Circuit* c, Trie *incompr_tuples,
                                                            coeff_max);
     
     // Initializing coefficients for the set.
-    uint64_t coeffs_output[c->total_wires+1];
+    Coeff coeffs_output[c->total_wires+1];
     for (int i = 0; i <= c->total_wires; i++) {
       coeffs_output[i] = 0;
     }
@@ -1842,7 +1837,7 @@ void update_coeff_output_RPC(const Circuit* c, Trie *incompr_tuples,
     
     // We take the max of the coefficients of the different subsets in RPC.
     for (int i = 0; i <= c->total_wires; i++){
-      if (coeffs[i] < coeffs_output[i]) coeffs[i] = coeffs_output[i]; 
+      coeff_set_max(&coeffs[i], coeffs_output[i]);
     }
   
   }
@@ -1927,7 +1922,7 @@ static bool update_output_set (const Circuit *c, int required_output, int index_
 }
 
 void update_coeffs_RPC(const Circuit *c, Trie *incompr_tuples, int *output_set,
-                       int len_output, int coeff_max, uint64_t *coeffs, 
+                       int len_output, int coeff_max, Coeff *coeffs, 
                        pthread_mutex_t *mutex, int verbose){
    
   Trie *incompr_tuples_output = derive_trie_from_subset (incompr_tuples, 
@@ -1939,7 +1934,7 @@ void update_coeffs_RPC(const Circuit *c, Trie *incompr_tuples, int *output_set,
                                                          coeff_max);                                                      
   
   // Initializing coefficients for the set.
-  uint64_t coeffs_output[c->total_wires+1];
+  Coeff coeffs_output[c->total_wires+1];
   for (int i = 0; i <= c->total_wires; i++) {
     coeffs_output[i] = 0;
   }
@@ -1955,7 +1950,7 @@ void update_coeffs_RPC(const Circuit *c, Trie *incompr_tuples, int *output_set,
    
   // We take the max of the coefficients of the different subsets in RPC.
   for (int i = 0; i <= c->total_wires; i++){
-    if (coeffs[i] < coeffs_output[i]) coeffs[i] = coeffs_output[i]; 
+    coeff_set_max(&coeffs[i], coeffs_output[i]);
   }
   
   if(mutex)
@@ -1979,11 +1974,8 @@ Input :
 void compute_RPC_coeffs_incompr_arith (const Circuit* c, int coeff_max, 
                                  bool include_output, int required_output,
                                  int cores, int verbose){
-  //Compute the optimal HASH_MASK for the hash_table.
-  determine_HASH_MASK(c->length, coeff_max); 
-  
   // Initializing coefficients
-  uint64_t coeffs[c->total_wires+1];
+  Coeff coeffs[c->total_wires+1];
   for (int i = 0; i <= c->total_wires; i++) {
     coeffs[i] = 0;
   }
@@ -2009,9 +2001,11 @@ void compute_RPC_coeffs_incompr_arith (const Circuit* c, int coeff_max,
   
   printf("f(p) = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs[i]);
+    fprint_coeff(stdout, coeffs[i]);
+    printf(", ");
   }
-  printf("%lu]\n", coeffs[c->total_wires]);
+  fprint_coeff(stdout, coeffs[c->total_wires]);
+  printf("]\n");
   
   double p_min = compute_leakage_proba(coeffs, coeff_max,
                                        c->total_wires+1,
@@ -2043,13 +2037,13 @@ Input :
     -int *output_set :  The output set we are considering.
     -int len_output : The size of the output set.
     -int coeff_max : The maximal coefficient that we have to compute.
-    -uint64_t *coeffs : The coeffs we have to compute.
+    -Coeff *coeffs : The coeffs we have to compute.
     -pthread_mutex_t mutex : For parallelization purpose.
     -int verbose : Set a level of verbosity. 
 */
 void update_coeffs_RPE_inter(const Circuit *c, Trie *incompr_tuples, 
                              Trie *incompr_tuples2, int *output_set, 
-                             int len_output, int coeff_max, uint64_t *coeffs, 
+                             int len_output, int coeff_max, Coeff *coeffs, 
                              pthread_mutex_t *mutex, int verbose){
     
     
@@ -2064,7 +2058,7 @@ void update_coeffs_RPE_inter(const Circuit *c, Trie *incompr_tuples,
                                coeff_max);
     
     // Initializing coefficients for the set.
-    uint64_t coeffs_output[c->total_wires+1];
+    Coeff coeffs_output[c->total_wires+1];
     for (int i = 0; i <= c->total_wires; i++) {
       coeffs_output[i] = 0;
     }
@@ -2078,7 +2072,7 @@ void update_coeffs_RPE_inter(const Circuit *c, Trie *incompr_tuples,
       pthread_mutex_lock(mutex);
     
     for (int i = 0; i <= c->total_wires; i++){
-      if (coeffs[i] < coeffs_output[i]) coeffs[i] = coeffs_output[i]; 
+      coeff_set_max(&coeffs[i], coeffs_output[i]);
     }
     
     if (mutex)
@@ -2178,6 +2172,7 @@ Trie* build_incompr_tuples_arith_RPE(const Circuit* c,
                              0, //selected_secret_shares_count
                              secret_idx, // secret_idx
                              curr_tuple, true, mutex, debug); 
+      merge_local_tries(incompr_tuples, c->secret_count);
     }
   }
   
@@ -2200,17 +2195,17 @@ static double min_arr(double* arr, int len) {
 }
 
 /* Compute the coeffs RPE11 for the RPE case in the copy gadget.*/
-uint64_t *compute_RPE11_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose);
+Coeff *compute_RPE11_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose);
 /* Compute the coeffs RPE21 for the RPE case in the copy gadget.*/
-uint64_t *compute_RPE21_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose);
+Coeff *compute_RPE21_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose);
 /* Compute the coeffs RPE12 for the RPE case in the copy gadget.*/
-uint64_t *compute_RPE12_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose);
+Coeff *compute_RPE12_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose);
 /* Compute the coeffs RPE22 for the RPE case in the copy gadget.*/
-uint64_t *compute_RPE22_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose);
+Coeff *compute_RPE22_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose);
 
 //Struture used to parallelize the 4 function above.
 struct compute_RPEii_coeffs_args{
@@ -2227,7 +2222,7 @@ struct compute_RPEii_coeffs_args{
 void *start_thread_compute_RPEii_coeffs (void *void_args){
   struct compute_RPEii_coeffs_args *args = 
                                       (struct compute_RPEii_coeffs_args *) void_args;
-  uint64_t *coeffs;
+  Coeff *coeffs;
   if (args->number_case == 0){
     coeffs = compute_RPE11_coeffs(args->c, args->coeff_max, args->required_output,
                                   args->cores, args->verbose);
@@ -2267,10 +2262,10 @@ void compute_RPE_coeffs_incompr_copy(const Circuit *c, int coeff_max,
                                      int required_output, int cores, 
                                      int verbose){
 
-  uint64_t *coeffs_RPE11 = NULL;
-  uint64_t *coeffs_RPE12 = NULL;
-  uint64_t *coeffs_RPE21 = NULL;                                 
-  uint64_t *coeffs_RPE22 = NULL;
+  Coeff *coeffs_RPE11 = NULL;
+  Coeff *coeffs_RPE12 = NULL;
+  Coeff *coeffs_RPE21 = NULL;                                 
+  Coeff *coeffs_RPE22 = NULL;
   
   if (cores == 1){
     coeffs_RPE11 = compute_RPE11_coeffs(c, coeff_max, required_output, 
@@ -2319,17 +2314,17 @@ void compute_RPE_coeffs_incompr_copy(const Circuit *c, int coeff_max,
     if(!ret[0]){
       void *return_value;
       pthread_join(threads[0], &return_value);
-      coeffs_RPE11 = (uint64_t *) return_value;
+      coeffs_RPE11 = (Coeff *) return_value;
     }
     if(!ret[1]){
       void *return_value1;
       pthread_join(threads[1], &return_value1);
-      coeffs_RPE12 = (uint64_t *) return_value1;
+      coeffs_RPE12 = (Coeff *) return_value1;
     }
     if(!ret[2]){
       void *return_value2;
       pthread_join(threads[2], &return_value2);
-      coeffs_RPE21 = (uint64_t *) return_value2;
+      coeffs_RPE21 = (Coeff *) return_value2;
     }
   }
   
@@ -2338,30 +2333,38 @@ void compute_RPE_coeffs_incompr_copy(const Circuit *c, int coeff_max,
   printf("\nCoeffs RPE11 : \n");
   printf("I = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_RPE11[i]);
+    fprint_coeff(stdout, coeffs_RPE11[i]);
+    printf(", ");
   }
-  printf("%lu]\n", coeffs_RPE11[c->total_wires]);
+  fprint_coeff(stdout, coeffs_RPE11[c->total_wires]);
+  printf("]\n");
   
   printf("\nCoeffs RPE12 : \n");
   printf("I = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_RPE12[i]);
+    fprint_coeff(stdout, coeffs_RPE12[i]);
+    printf(", ");
   }
-  printf("%lu]\n", coeffs_RPE12[c->total_wires]);
+  fprint_coeff(stdout, coeffs_RPE12[c->total_wires]);
+  printf("]\n");
   
   printf("\nCoeffs RPE21 : \n");
   printf("I = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_RPE21[i]);
+    fprint_coeff(stdout, coeffs_RPE21[i]);
+    printf(", ");
   }
-  printf("%lu]\n", coeffs_RPE21[c->total_wires]);
+  fprint_coeff(stdout, coeffs_RPE21[c->total_wires]);
+  printf("]\n");
 
   printf("\nCoeffs RPE22 : \n");
   printf("I = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_RPE22[i]);
+    fprint_coeff(stdout, coeffs_RPE22[i]);
+    printf(", ");
   }
-  printf("%lu]\n\n", coeffs_RPE22[c->total_wires]);
+  fprint_coeff(stdout, coeffs_RPE22[c->total_wires]);
+  printf("]\n\n");
   
   // Computing leakage probability from coefficients  
   double p[2];
@@ -2392,12 +2395,12 @@ void compute_RPE_coeffs_incompr_copy(const Circuit *c, int coeff_max,
   
   
 /* Case 1 : |J1| <= t and |J2| <= t */
-uint64_t *compute_RPE11_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose){  
+Coeff *compute_RPE11_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose){  
   int nb_shares = c->share_count;
   
   //Initializing coefficients
-  uint64_t *coeffs_RPE11 = malloc((c->total_wires+1) * sizeof(uint64_t));
+  Coeff *coeffs_RPE11 = malloc((c->total_wires+1) * sizeof(Coeff));
   for (int i = 0; i <= c->total_wires; i++) {
     coeffs_RPE11[i] = 0;
   }
@@ -2442,7 +2445,7 @@ uint64_t *compute_RPE11_coeffs(const Circuit *c, int coeff_max,
       
       //Initializing coefficients for write the errors coefficients of 
       //|incompr_tuples_output|.
-      uint64_t coeffs_output[c->total_wires+1];
+      Coeff coeffs_output[c->total_wires+1];
       for (int i = 0; i <= c->total_wires; i++) {
         coeffs_output[i] = 0;
       }      
@@ -2454,7 +2457,7 @@ uint64_t *compute_RPE11_coeffs(const Circuit *c, int coeff_max,
       
       // RPE1 : Compute the max failures of all the output set.
       for (int i = 0; i <= c->total_wires; i++){
-        coeffs_RPE11[i] = max(coeffs_RPE11[i], coeffs_output[i]);
+        coeff_set_max(&coeffs_RPE11[i], coeffs_output[i]);
       }
       
       free_trie(incompr_tuples_output);
@@ -2467,13 +2470,13 @@ uint64_t *compute_RPE11_coeffs(const Circuit *c, int coeff_max,
 }
   
 /* Case 2 : |J1| <= t and |J2| = nb_shares - 1 */
-uint64_t *compute_RPE12_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose){  
+Coeff *compute_RPE12_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose){  
   int nb_shares = c->share_count;
   int var = nb_shares - 1;
   
   //Initializing coefficients
-  uint64_t *coeffs_RPE12 = malloc((c->total_wires+1) * sizeof(uint64_t));
+  Coeff *coeffs_RPE12 = malloc((c->total_wires+1) * sizeof(Coeff));
   for (int i = 0; i <= c->total_wires; i++) {
     coeffs_RPE12[i] = 0;
   }
@@ -2504,7 +2507,7 @@ uint64_t *compute_RPE12_coeffs(const Circuit *c, int coeff_max,
   do{
     //Initializing coefficients for write the errors coefficients of 
     //the property RPE2 for J2.
-    uint64_t coeffs_output_I2[c->total_wires+1];
+    Coeff coeffs_output_I2[c->total_wires+1];
     for (int i = 0; i <= c->total_wires; i++) {
       coeffs_output_I2[i] = 0;
     }
@@ -2548,7 +2551,7 @@ uint64_t *compute_RPE12_coeffs(const Circuit *c, int coeff_max,
     
     // RPE1 : Compute the max failure between all the J1 output set.
     for (int i = 0; i <= c->total_wires; i++){
-        coeffs_RPE12[i] = max(coeffs_RPE12[i], coeffs_output_I2[i]);
+        coeff_set_max(&coeffs_RPE12[i], coeffs_output_I2[i]);
     }
     
     for (int i = 0; i < var; i++){
@@ -2564,13 +2567,13 @@ uint64_t *compute_RPE12_coeffs(const Circuit *c, int coeff_max,
 } 
   
 /* Case 3 : |J1| = nb_shares - 1 and |J2| <= t */
-uint64_t *compute_RPE21_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose){ 
+Coeff *compute_RPE21_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose){ 
   int nb_shares = c->share_count;
   int var = nb_shares - 1;
   
   //Initializing coefficients
-  uint64_t *coeffs_RPE21 = malloc((c->total_wires+1) * sizeof(uint64_t));
+  Coeff *coeffs_RPE21 = malloc((c->total_wires+1) * sizeof(Coeff));
   for (int i = 0; i <= c->total_wires; i++) {
     coeffs_RPE21[i] = 0;
   }
@@ -2600,7 +2603,7 @@ uint64_t *compute_RPE21_coeffs(const Circuit *c, int coeff_max,
   do{
     //Initializing coefficients for write the errors coefficients of 
     //the property RPE2 for J1.
-    uint64_t coeffs_output_I1[c->total_wires+1];
+    Coeff coeffs_output_I1[c->total_wires+1];
     for (int i = 0; i <= c->total_wires; i++) {
       coeffs_output_I1[i] = 0;
     }
@@ -2647,7 +2650,7 @@ uint64_t *compute_RPE21_coeffs(const Circuit *c, int coeff_max,
     
     // RPE1 : Compute the max failure between all the J2 output set.
     for (int i = 0; i <= c->total_wires; i++){
-        coeffs_RPE21[i] = max(coeffs_RPE21[i], coeffs_output_I1[i]);
+        coeff_set_max(&coeffs_RPE21[i], coeffs_output_I1[i]);
     }
     
     for (int i = 0; i < var; i++){
@@ -2660,13 +2663,13 @@ uint64_t *compute_RPE21_coeffs(const Circuit *c, int coeff_max,
 } 
   
 /* Case 4 : |J1| = nb_shares - 1 and |J2| = nb_shares - 1 */  
-uint64_t *compute_RPE22_coeffs(const Circuit *c, int coeff_max, 
-                               int required_output, int cores, int verbose){   
+Coeff *compute_RPE22_coeffs(const Circuit *c, int coeff_max, 
+                            int required_output, int cores, int verbose){   
   int nb_shares = c->share_count;
   int var = nb_shares - 1;
   
   //Initializing coefficients
-  uint64_t *coeffs_RPE22 = malloc((c->total_wires+1) * sizeof(uint64_t));
+  Coeff *coeffs_RPE22 = malloc((c->total_wires+1) * sizeof(Coeff));
   for (int i = 0; i <= c->total_wires; i++){
     coeffs_RPE22[i] = 0;
   }
@@ -2763,7 +2766,7 @@ void compute_RPE_coeffs_incompr_refresh(const Circuit *c, int coeff_max,
   /* Case 1 : |J| <= t */
   
   //Initializing coefficients
-  uint64_t coeffs_RPE1[c->total_wires+1];
+  Coeff coeffs_RPE1[c->total_wires+1];
   for (int i = 0; i <= c->total_wires; i++) {
     coeffs_RPE1[i] = 0;
   }
@@ -2801,7 +2804,7 @@ void compute_RPE_coeffs_incompr_refresh(const Circuit *c, int coeff_max,
       
     //Initializing coefficients for write the errors coefficients of 
     //|incompr_tuples_output|.
-    uint64_t coeffs_output[c->total_wires+1];
+    Coeff coeffs_output[c->total_wires+1];
     for (int i = 0; i <= c->total_wires; i++) {
       coeffs_output[i] = 0;
     }      
@@ -2813,7 +2816,7 @@ void compute_RPE_coeffs_incompr_refresh(const Circuit *c, int coeff_max,
       
     // RPE1 : Compute the max failures of all the output set.
     for (int i = 0; i <= c->total_wires; i++){
-      coeffs_RPE1[i] = max(coeffs_RPE1[i], coeffs_output[i]);
+      coeff_set_max(&coeffs_RPE1[i], coeffs_output[i]);
     }
       
     free_trie(incompr_tuples_output);
@@ -2826,9 +2829,11 @@ void compute_RPE_coeffs_incompr_refresh(const Circuit *c, int coeff_max,
   printf("\nCoeffs RPE1 : \n");
   printf("I = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_RPE1[i]);
+    fprint_coeff(stdout, coeffs_RPE1[i]);
+    printf(", ");
   }
-  printf("%lu]\n", coeffs_RPE1[c->total_wires]);                
+  fprint_coeff(stdout, coeffs_RPE1[c->total_wires]);
+  printf("]\n");
   
   
   /* Case 2 : |J| = n - 1 */
@@ -2836,7 +2841,7 @@ void compute_RPE_coeffs_incompr_refresh(const Circuit *c, int coeff_max,
   int J2[nb_shares -1];
   
   //Initializing coefficients
-  uint64_t coeffs_RPE2[c->total_wires+1];
+  Coeff coeffs_RPE2[c->total_wires+1];
   for (int i = 0; i <= c->total_wires; i++){
     coeffs_RPE2[i] = 0;
   }
@@ -2888,9 +2893,11 @@ void compute_RPE_coeffs_incompr_refresh(const Circuit *c, int coeff_max,
   printf("\nCoeffs RPE2 : \n");
   printf("I = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_RPE2[i]);
+    fprint_coeff(stdout, coeffs_RPE2[i]);
+    printf(", ");
   }
-  printf("%lu]\n\n", coeffs_RPE2[c->total_wires]);
+  fprint_coeff(stdout, coeffs_RPE2[c->total_wires]);
+  printf("]\n\n");
   
   // Computing leakage probability from coefficients  
   double p[2];
@@ -2947,7 +2954,7 @@ void *start_thread_build_incompr_RPE (void *void_args){
   int *output_set;
   int len_output;
   int coeff_max; 
-  uint64_t *coeffs;
+  Coeff *coeffs;
   pthread_mutex_t mutex; 
   int verbose;  
 };
@@ -2973,7 +2980,7 @@ struct update_coeffs_RPE_inter_args {
   int *output_set;
   int len_output;
   int coeff_max; 
-  uint64_t *coeffs;
+  Coeff *coeffs;
   pthread_mutex_t mutex; 
   int verbose;  
 };
@@ -2997,27 +3004,33 @@ void *start_thread_update_coeffs_RPE_inter (void *void_args){
 // Printing the RPE1/RPE2 coefficients according to |nb_RPE| for the first 
 // secret value I1, the second secret value I2 
 // and the intersection of I1 and I2.
-void print_coeffs_RPE(const Circuit *c, uint64_t *coeffs_I1, uint64_t *coeffs_I2, 
-                      uint64_t *coeffs_I1_and_I2, int nb_RPE){
+void print_coeffs_RPE(const Circuit *c, Coeff *coeffs_I1, Coeff *coeffs_I2, 
+                      Coeff *coeffs_I1_and_I2, int nb_RPE){
   
   printf("\nCoeffs RPE%d : \n", nb_RPE);
   printf("I1 = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_I1[i]);
+    fprint_coeff(stdout, coeffs_I1[i]);
+    printf(", ");
   }
-  printf("%lu]\n", coeffs_I1[c->total_wires]);
+  fprint_coeff(stdout, coeffs_I1[c->total_wires]);
+  printf("]\n");
   
   printf("I2 = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_I2[i]);
+    fprint_coeff(stdout, coeffs_I2[i]);
+    printf(", ");
   }
-  printf("%lu]\n", coeffs_I2[c->total_wires]);
+  fprint_coeff(stdout, coeffs_I2[c->total_wires]);
+  printf("]\n");
   
   printf("I1 and I2 = [");
   for (int i = 0; i < c->total_wires; i++){
-    printf("%lu, ", coeffs_I1_and_I2[i]);
+    fprint_coeff(stdout, coeffs_I1_and_I2[i]);
+    printf(", ");
   }
-  printf("%lu]\n\n", coeffs_I1_and_I2[c->total_wires]);
+  fprint_coeff(stdout, coeffs_I1_and_I2[c->total_wires]);
+  printf("]\n\n");
 }
 
 
@@ -3032,9 +3045,9 @@ Input :
   -int cores : if cores != 1, we parallelize. 
   -int verbose : Set a level of verbosity.
 */
-uint64_t** compute_RPE1_coeffs_incompr(const Circuit *c, int coeff_max, 
-                                       bool include_output, int required_output,
-                                       int cores, int verbose){  
+Coeff** compute_RPE1_coeffs_incompr(const Circuit *c, int coeff_max, 
+                                    bool include_output, int required_output,
+                                    int cores, int verbose){  
   Trie *incompr_tuples_I1;
   Trie *incompr_tuples_I2;
   VarVector** secrets;
@@ -3046,11 +3059,11 @@ uint64_t** compute_RPE1_coeffs_incompr(const Circuit *c, int coeff_max,
   int t_in = required_output + 1;
   
   // Initializing coefficients
-  uint64_t *coeffs_RPE1_I1 = calloc((c->total_wires+1), sizeof(uint64_t));
+  Coeff *coeffs_RPE1_I1 = calloc((c->total_wires+1), sizeof(Coeff));
 
-  uint64_t *coeffs_RPE1_I2 = calloc((c->total_wires+1), sizeof(uint64_t));
+  Coeff *coeffs_RPE1_I2 = calloc((c->total_wires+1), sizeof(Coeff));
 
-  uint64_t *coeffs_RPE1_I1_and_I2 = calloc((c->total_wires+1), sizeof(uint64_t));
+  Coeff *coeffs_RPE1_I1_and_I2 = calloc((c->total_wires+1), sizeof(Coeff));
   
   
   //Case of the multiplication gadget.
@@ -3246,7 +3259,7 @@ uint64_t** compute_RPE1_coeffs_incompr(const Circuit *c, int coeff_max,
     free(randoms);
   }
   
-  uint64_t **coeffs_RPE1 = malloc(3 * sizeof(*coeffs_RPE1));
+  Coeff **coeffs_RPE1 = malloc(3 * sizeof(*coeffs_RPE1));
   coeffs_RPE1[0] = coeffs_RPE1_I1;
   coeffs_RPE1[1] = coeffs_RPE1_I2;
   coeffs_RPE1[2] = coeffs_RPE1_I1_and_I2;
@@ -3299,9 +3312,9 @@ Input :
   -int cores : if cores != 1, we parallelize. 
   -int verbose : Set a level of verbosity.
 */
-uint64_t **compute_RPE2_coeffs_incompr(const Circuit *c, int coeff_max, 
-                                       bool include_output, int required_output,
-                                       int cores, int verbose){ 
+Coeff **compute_RPE2_coeffs_incompr(const Circuit *c, int coeff_max, 
+                                    bool include_output, int required_output,
+                                    int cores, int verbose){ 
   Trie *incompr_tuples_I1;
   Trie *incompr_tuples_I2;
   VarVector** secrets;
@@ -3314,11 +3327,11 @@ uint64_t **compute_RPE2_coeffs_incompr(const Circuit *c, int coeff_max,
   int t_in = required_output + 1;
   
   // Initializing coefficients
-  uint64_t *coeffs_RPE2_I1 = calloc((c->total_wires+1), sizeof(uint64_t));
+  Coeff *coeffs_RPE2_I1 = calloc((c->total_wires+1), sizeof(Coeff));
 
-  uint64_t *coeffs_RPE2_I2 = calloc((c->total_wires+1), sizeof(uint64_t));
+  Coeff *coeffs_RPE2_I2 = calloc((c->total_wires+1), sizeof(Coeff));
   
-  uint64_t *coeffs_RPE2_I1_and_I2 = calloc((c->total_wires+1), sizeof(uint64_t));
+  Coeff *coeffs_RPE2_I1_and_I2 = calloc((c->total_wires+1), sizeof(Coeff));
    
   required_output = c->share_count - 1;
   
@@ -3522,7 +3535,7 @@ uint64_t **compute_RPE2_coeffs_incompr(const Circuit *c, int coeff_max,
   free(incompr_tuples_I1_list);
   free(incompr_tuples_I2_list);
   
-  uint64_t **coeffs_RPE2 = malloc(3 * sizeof(*coeffs_RPE2));
+  Coeff **coeffs_RPE2 = malloc(3 * sizeof(*coeffs_RPE2));
   coeffs_RPE2[0] = coeffs_RPE2_I1;
   coeffs_RPE2[1] = coeffs_RPE2_I2;
   coeffs_RPE2[2] = coeffs_RPE2_I1_and_I2;
@@ -3547,7 +3560,7 @@ struct comp_RPE_args {
 void *start_thread_comp_RPE(void *void_args){
   struct comp_RPE_args *args = (struct comp_RPE_args *) void_args;
   
-  uint64_t **coeffs;
+  Coeff **coeffs;
   coeffs = compute_RPE1_coeffs_incompr(args->c, args->coeff_max, 
                                        args->include_output, 
                                        args->required_output, args->cores, 
@@ -3575,9 +3588,6 @@ void compute_RPE_coeffs_incompr_arith (const Circuit* c, int coeff_max,
                                  bool include_output , int required_output,
                                  int cores, int verbose){
   
-  //Compute the optimal HASH_MASK for the hash_table.
-  determine_HASH_MASK(c->length, coeff_max); 
-  
   //Copy gadget or refresh gadget case.
   if (c->secret_count == 1){ 
     
@@ -3594,8 +3604,8 @@ void compute_RPE_coeffs_incompr_arith (const Circuit* c, int coeff_max,
     return;
   }
   
-  uint64_t **coeffs_RPE1;
-  uint64_t **coeffs_RPE2;
+  Coeff **coeffs_RPE1;
+  Coeff **coeffs_RPE2;
   
   if (cores == 1){
   coeffs_RPE1 = compute_RPE1_coeffs_incompr(c, coeff_max, include_output, 
@@ -3632,7 +3642,7 @@ void compute_RPE_coeffs_incompr_arith (const Circuit* c, int coeff_max,
     else{
       void *return_value;
       pthread_join(threads, &return_value);
-      coeffs_RPE1 = (uint64_t **) return_value;
+      coeffs_RPE1 = (Coeff **) return_value;
     }   
   }
   
@@ -10,6 +10,7 @@
 #include "config.h"
 #include "circuit.h"
 #include "combinations.h"
+#include "hash_tuples.h"
 
 // -----------------------------------------------------------
 //
@@ -45,134 +46,64 @@
 
 
 
-// TODO: must be able to change size dynamically
-#define HASH_MASK 0x1ffffff
-#define HASH_SIZE (HASH_MASK+1)
-
-// Computes a hash for integer |x|.
-// Hash function for integers from https://stackoverflow.com/a/12996028/4990392
-static unsigned int hash_int(unsigned int x) {
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = (x >> 16) ^ x;
-  return x;
-}
-
-// Compute the hash for |dep|. This hash is based only on the randoms inside |dep|.
-static unsigned int hash_dep(Dependency* dep, int first_rand_idx, int non_mult_deps_count) {
-  unsigned int hash = 0;
-  for (int i = first_rand_idx; i < non_mult_deps_count; i++) {
-    if (dep[i]) {
-      hash += hash_int(i);
-    }
-  }
-  return hash & HASH_MASK;
-}
-
 typedef struct _multnode {
   int length;
   uint64_t* mults;
   struct _multnode* next;
 } MultNode;
 
-typedef struct _hashnode {
-  uint64_t* rands;
-  MultNode* mult_node;
-  struct _hashnode* next;
-} HashNode;
-
-typedef struct _hashmap {
-  HashNode** content;
+// The linear combinations are stored in a TupleMap whose keys are
+// the bitmaps of their randoms, and whose payloads are the lists of
+// the bitmaps of multiplications (MultNode*) that were seen with
+// these randoms.
+typedef struct _linearcombmap {
+  TupleMap* map;
   int deps_size; // size of the Dependency* in the hash
   int first_rand_idx;
   int non_mult_deps_count;
   int mult_count;
   int mults_len; // Length of the |mults| array in MultNodes
-  int rands_len; // Length of the |rands| array in HashNodes
-  int count; // Number of elements in the hash
-} HashMap;
+  int rands_len; // Length of the |rands| keys of |map|
+} LinearCombMap;
 
 // Allocates and initializes an empty hash map.
-static HashMap* init_map(Circuit* circuit) {
+static LinearCombMap* init_map(Circuit* circuit) {
   int deps_size = circuit->deps->deps_size;
   int first_rand_idx = circuit->deps->first_rand_idx;
   int non_mult_deps_count = circuit->secret_count + circuit->random_count;
-  HashMap* map    = malloc(sizeof(*map));
-  map->content    = calloc(HASH_SIZE, sizeof(*(map->content)));
+  LinearCombMap* map = malloc(sizeof(*map));
   map->deps_size  = deps_size;
   map->first_rand_idx = first_rand_idx;
   map->non_mult_deps_count = non_mult_deps_count;
   map->mults_len = circuit->deps->mult_deps->length / 64 + 1;
   map->rands_len = (non_mult_deps_count - circuit->secret_count) / 64 + 1;
-  map->count      = 0;
   map->mult_count = circuit->deps->mult_deps->length;
+  map->map = make_tuple_map(map->rands_len * sizeof(uint64_t), sizeof(MultNode*), NULL);
   return map;
 }
 
-// Check if |map| contains |dep| at index |hash|. If it does, returns
-// its |length| field, and otherwise, return 0.
-static int hash_contains_keyed(HashMap* map, int length, int hash,
-                               uint64_t* rands, uint64_t* mults,
-                               HashNode** ret_node) {
-  int rands_len = map->rands_len;
+// Returns true if |node| contains a combination with multiplications
+// |mults| and a length less or equal to |length|.
+static int mult_nodes_contain(LinearCombMap* map, MultNode* mult_node, int length,
+                              uint64_t* mults) {
   int mults_len = map->mults_len;
-  HashNode* node = map->content[hash];
-  while (node) {
-    if (memcmp(node->rands, rands, rands_len * sizeof(*rands)) == 0) {
-      MultNode* mult_node = node->mult_node;
-      while (mult_node) {
-        if (mult_node->length <= length) {
-          int found = 1;
-          for (int i = 0; i < mults_len; i++) {
-            if ((mult_node->mults[i] & mults[i]) != mults[i]) {
-              found = 0;
-              break;
-            }
-          }
-          if (found) return 1;
+  while (mult_node) {
+    if (mult_node->length <= length) {
+      int found = 1;
+      for (int i = 0; i < mults_len; i++) {
+        if ((mult_node->mults[i] & mults[i]) != mults[i]) {
+          found = 0;
+          break;
         }
-        mult_node = mult_node->next;
       }
-      *ret_node = node;
-      return 0;
+      if (found) return 1;
     }
-    node = node->next;
+    mult_node = mult_node->next;
   }
   return 0;
 }
 
-// Adds |dep| to |map|.
-static void add_to_hash_keyed(HashMap* map, int length, int hash,
-                              uint64_t* rands, uint64_t* mults) {
-  HashNode* node = NULL;
-  if (hash_contains_keyed(map, length, hash, rands, mults, &node)) {
-    return;
-  } else {
-    int rands_len = map->rands_len;
-    int mults_len = map->mults_len;
-    map->count++;
-
-    MultNode* mult_node = malloc(sizeof(*node));
-    mult_node->length = length;
-    mult_node->mults = malloc(mults_len * sizeof(*mult_node->mults));
-    memcpy(mult_node->mults, mults, mults_len * sizeof(*mult_node->mults));
-
-    if (node) {
-      mult_node->next = node->mult_node;
-      node->mult_node = mult_node;
-    } else {
-      node = malloc(sizeof(*node));
-      node->rands = malloc(rands_len * sizeof(*node->rands));
-      memcpy(node->rands, rands, rands_len * sizeof(*node->rands));
-      node->mult_node = mult_node;
-      mult_node->next = NULL;
-      node->next = map->content[hash];
-      map->content[hash] = node;
-    }
-  }
-}
-
-static void build_rands_bitmap(HashMap* map, Dependency* dep, uint64_t* rands) {
+static void build_rands_bitmap(LinearCombMap* map, Dependency* dep, uint64_t* rands) {
   int first_rand_idx = map->first_rand_idx;
   int non_mult_deps_count = map->non_mult_deps_count;
   int rands_count = non_mult_deps_count - first_rand_idx;
@@ -189,7 +120,7 @@ static void build_rands_bitmap(HashMap* map, Dependency* dep, uint64_t* rands) {
   }
 }
 
-static void build_mults_bitmap(HashMap* map, Dependency* dep, uint64_t* mults) {
+static void build_mults_bitmap(LinearCombMap* map, Dependency* dep, uint64_t* mults) {
   int non_mult_deps_count = map->non_mult_deps_count;
   int mult_count = map->mult_count;
   int mults_len = map->mults_len;
@@ -206,26 +137,18 @@ static void build_mults_bitmap(HashMap* map, Dependency* dep, uint64_t* mults) {
 }
 
 // Returns true if |map| contains |dep| with a length less or equal to
-// |length|. Note that this function is optimized for the expected
-// case: |map| should contain |dep|. For instance, after computing
-// |hash|, we could add `if (!map->content[hash]) return 0;`, but it's
-// expected that |map| contains |dep| and thus contains a node at
-// index |hash|.
-static int hash_contains(HashMap* map, Dependency* dep, int length) {
-  unsigned int hash = hash_dep(dep, map->first_rand_idx, map->non_mult_deps_count);
-
+// |length|.
+static int hash_contains(LinearCombMap* map, Dependency* dep, int length) {
   uint64_t rands[map->rands_len];
   build_rands_bitmap(map, dep, rands);
 
   uint64_t mults[map->mults_len];
   build_mults_bitmap(map, dep, mults);
 
-  HashNode* node;
-  if (hash_contains_keyed(map, length, hash, rands, mults, &node)) {
-    return 1;
-  } else {
-    return 0;
-  }
+  void* slot = tuple_map_find(map->map, rands);
+  if (!slot) return 0;
+  MultNode* mult_node = *(MultNode**)tuple_map_value(map->map, slot);
+  return mult_nodes_contain(map, mult_node, length, mults);
 }
 
 // Adds |dep| to |map| with length |length| associated. |dep| is not
@@ -235,37 +158,42 @@ static int hash_contains(HashMap* map, Dependency* dep, int length) {
 // (which removes the need to check if there is such a |dep| with
 // larger length and remove it). Finally, note that no memory is
 // allocated unless |dep| is added to |map|.
-static void add_to_hash(HashMap* map, Dependency* dep, int length) {
-  unsigned int hash = hash_dep(dep, map->first_rand_idx, map->non_mult_deps_count);
-
+static void add_to_hash(LinearCombMap* map, Dependency* dep, int length) {
   uint64_t rands[map->rands_len];
   build_rands_bitmap(map, dep, rands);
 
   uint64_t mults[map->mults_len];
   build_mults_bitmap(map, dep, mults);
 
-  add_to_hash_keyed(map, length, hash, rands, mults);
+  void* slot = tuple_map_insert(map->map, rands, NULL);
+  MultNode** mult_nodes = tuple_map_value(map->map, slot);
+  if (mult_nodes_contain(map, *mult_nodes, length, mults)) {
+    return;
+  }
+
+  int mults_len = map->mults_len;
+  MultNode* mult_node = malloc(sizeof(*mult_node));
+  mult_node->length = length;
+  mult_node->mults = malloc(mults_len * sizeof(*mult_node->mults));
+  memcpy(mult_node->mults, mults, mults_len * sizeof(*mult_node->mults));
+  mult_node->next = *mult_nodes;
+  *mult_nodes = mult_node;
 }
 
 // Frees |map| and its content.
-static void free_hash(HashMap* map) {
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* node = map->content[i];
-    while (node) {
-      MultNode* mult_node = node->mult_node;
-      while (mult_node) {
-        free(mult_node->mults);
-        MultNode* next_mult = mult_node->next;
-        free(mult_node);
-        mult_node = next_mult;
-      }
-      free(node->rands);
-      HashNode* next = node->next;
-      free(node);
-      node = next;
+static void free_hash(LinearCombMap* map) {
+  uint64_t it = 0;
+  void* slot;
+  while ((slot = tuple_map_next(map->map, &it))) {
+    MultNode* mult_node = *(MultNode**)tuple_map_value(map->map, slot);
+    while (mult_node) {
+      free(mult_node->mults);
+      MultNode* next_mult = mult_node->next;
+      free(mult_node);
+      mult_node = next_mult;
     }
   }
-  free(map->content);
+  free_tuple_map(map->map);
   free(map);
 }
 
@@ -341,7 +269,7 @@ int can_be_removed(Circuit* circuit, VarVector* subcircuit, VarVector* remove_ca
 
   // Step 1: generate all linear combinations |linear_combs| of the
   // reduced set (|reduced_subcircuit|)
-  HashMap* linear_combs = init_map(circuit);
+  LinearCombMap* linear_combs = init_map(circuit);
   int last_idx = reduced_subcircuit->length;
   for (int size = 1; size <= reduced_subcircuit->length; size++) {
     Comb* comb = first_comb(size, 0);
@@ -621,6 +549,8 @@ void advanced_dimension_reduction(Circuit* circuit) {
   new_deps->names          = malloc(deps->length * sizeof(*new_deps->names));
   new_deps->contained_secrets = malloc(deps->length * sizeof(*new_deps->contained_secrets));
   new_deps->bit_deps       = malloc(deps->length * sizeof(*new_deps->bit_deps));
+  new_deps->shared_rows    = deps->shared_rows ?
+    malloc(deps->length * sizeof(*new_deps->shared_rows)) : NULL;
   new_deps->correction_outputs = circuit->deps->correction_outputs;
 
   for (int i = 0; i < deps->length; i++) {
@@ -631,6 +561,8 @@ void advanced_dimension_reduction(Circuit* circuit) {
       new_deps->names[insert_idx] = deps->names[i];
       new_deps->contained_secrets[insert_idx] = deps->contained_secrets[i];
       new_deps->bit_deps[insert_idx] = deps->bit_deps[i];
+      if (deps->shared_rows)
+        new_deps->shared_rows[insert_idx] = deps->shared_rows[i];
       new_deps->length++;
     }
   }
@@ -776,6 +708,8 @@ DimRedData* remove_elementary_wires(Circuit* circuit, bool print) {
   new_deps->names          = malloc(deps->length * sizeof(*new_deps->names));
   new_deps->contained_secrets = malloc(deps->length * sizeof(*new_deps->contained_secrets));
   new_deps->bit_deps       = malloc(deps->length * sizeof(*new_deps->bit_deps));
+  new_deps->shared_rows    = deps->shared_rows ?
+    malloc(deps->length * sizeof(*new_deps->shared_rows)) : NULL;
 
   new_deps->mult_deps      = deps->mult_deps;
   new_deps->correction_outputs = deps->correction_outputs;
@@ -794,6 +728,8 @@ DimRedData* remove_elementary_wires(Circuit* circuit, bool print) {
     new_deps->deps_exprs[new_deps->length] = deps->deps_exprs[i];
     new_deps->contained_secrets[new_deps->length] = deps->contained_secrets[i];
     new_deps->bit_deps[new_deps->length]   = deps->bit_deps[i];
+    if (deps->shared_rows)
+      new_deps->shared_rows[new_deps->length] = deps->shared_rows[i];
     new_deps->length++;
   }
 
@@ -843,6 +779,8 @@ void remove_randoms(Circuit* circuit) {
   new_deps->names          = malloc(deps->length * sizeof(*new_deps->names));
   new_deps->contained_secrets = malloc(deps->length * sizeof(*new_deps->contained_secrets));
   new_deps->bit_deps       = malloc(deps->length * sizeof(*new_deps->bit_deps));
+  new_deps->shared_rows    = deps->shared_rows ?
+    malloc(deps->length * sizeof(*new_deps->shared_rows)) : NULL;
 
   int non_mult_deps_count = circuit->secret_count + circuit->random_count;
 
@@ -874,6 +812,8 @@ void remove_randoms(Circuit* circuit) {
     new_deps->deps_exprs[new_deps->length] = deps->deps_exprs[i];
     new_deps->contained_secrets[new_deps->length] = deps->contained_secrets[i];
     new_deps->bit_deps[new_deps->length]   = deps->bit_deps[i];
+    if (deps->shared_rows)
+      new_deps->shared_rows[new_deps->length] = deps->shared_rows[i];
     new_deps->length++;
   }
 
@@ -10,12 +10,16 @@
 #include <limits.h>
 
 #include "constructive-mult_arith.h"
+#include "arena.h"
+#include "hash_tuples.h"
 #include "circuit.h"
 #include "combinations.h"
 #include "list_tuples.h"
 #include "verification_rules.h"
 #include "trie.h"
 #include "coeffs.h"
+#include "stats.h"
+#include "spill.h"
 
 // For debug purposes only: the number of failures that are generated
 // multiple times.
@@ -27,52 +31,8 @@ int regenerated = 0;
 
 
 
-// Small note regarding the size of the hash table. In the current
-// implementation, the whole hash table has to be iterated through to
-// compute each coefficients. This operation is a bit expensive for
-// small coefficients (iterating millions of elements to find out that
-// only 10 are non-null...). However, when the table starts to contain
-// more elements, it's important to avoid collisions as much as
-// possible, and thus to have a large table.
-//
-// Also, note that it would be a bit expansive to dynamically change
-// the size of the hash map, since it would require recomputing the
-// hash for each tuple it contains...
-
-#define HASH_SIZE (HASH_MASK+1)
-static uint64_t HASH_MASK; /* Size of the HashMap we will use */
-
-/*
-Determine the size of the HashMap we are going to use. This is the optimal 
-integer int the worst-case complexity.
-Input :
-  -int c_len : The length of the circuit we are currently studying.
-  -int coeff_max : The maximal coefficient that we have to compute.
-*/
-
-// Computes a hash for integer |x|.
-// Hash function for integers from https://stackoverflow.com/a/12996028/4990392
-/*static unsigned int hash_int(unsigned int x, int *num_quo) {
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = (x >> 16) ^ x;
-  *num_quo = (x / HASH_MASK);
-  return x % HASH_MASK;
-}*/
-
-// Computes a hash for |comb| by summing the hashes of each of its elements.
-/*static unsigned int hash_comb(Comb* comb, int comb_len, int *num_quo) {
-  unsigned int hash = 0;
-  for (int i = 0; i < comb_len; i++) {
-    int num_quo_x = 0;
-    hash += hash_int(comb[i], &num_quo_x);
-    *num_quo += num_quo_x;
-  }
-  return hash;
-}*/
-
-
-
+// The failures of each size are stored in hash maps whose keys are
+// their numberings (see num_tab_comb below), which identify them.
 
 /*
 Here I change the maneer of compute the hash. Before, we use hash_comb and 
@@ -135,45 +95,34 @@ Then, we can see how we can number the differents |comb| :
 -[7,8,9] --->119  
 
 
-In this way, all the |comb| can compute an hash who are different. Nevertheless,
-the numbering can become very big and surpass the size HASH_MASK. To prevent this 
-issue, I have to reduce the numbering used with some modular operation, with the 
-modulo HASH_MASK (TODO : why not HASH_SIZE ?). Of course, this will create 
-collision too, that's why I had a component in the hashNode structure, 
-named quo_hash, it gives the quotient of the numbering. And with the quotient 
-and the modulo, we have unicity. Therefore , for check combs, we have just to 
-compute his numbering, the modulo and the quotient.     
+In this way, all the |comb| of a given size have different numberings. The 
+numbering is thus used as the key of the |comb| in the hash maps (see 
+hash_tuples.h), and checking whether a |comb| is in a map only requires 
+computing its numbering.     
 */
 
 
 /*
 Computes the numbering for |comb|, using the method in the comments above, 
-that we will use as an hash.
+that we will use as an hash. The numbering is computed exactly on 128 bits 
+(it is lower than C(var_count, comb_len)).
+For each element comb[ind], the numbering accounts for the tuples whose 
+element at index |ind| is between comb[ind-1]+1 and comb[ind]-1; summing 
+their counts C(var_count-1-i, comb_len-1-ind) over i gives (hockey-stick 
+identity) the 2 binomial coefficients below, hence a cost in O(comb_len).
 Input :
   -Comb *comb : The tuple we wants to number.
   -int comb_len : The size of the array |comb|.
   -int var_count : The number of different index we can have in our tuple.
-  -int *num_quo : A pointer of an integer in which we will add the quotient of 
-                  the numbering of the tuple.  
 Output : The numbering of the tuple.
 */
-static int num_tab_comb(Comb *comb, int comb_len, int var_count, int *num_quo){
-  int num_tab = 0;
-  int i = 0;
-  int ind = 0;
-  while (ind < comb_len){
-    if (comb[ind] == i){
-      ind += 1;
-      i += 1;
-    }
-    
-    else{
-      
-      num_tab += n_choose_k(comb_len - 1 - ind, var_count - 1 - i);
-      *num_quo += (num_tab / HASH_SIZE);
-      num_tab %= HASH_SIZE;
-      i += 1;
-    }
+static uint128_t num_tab_comb(Comb *comb, int comb_len, int var_count){
+  uint128_t num_tab = 0;
+  int prev = -1;
+  for (int ind = 0; ind < comb_len; ind++){
+    num_tab += n_choose_k_128(comb_len - ind, var_count - 1 - prev) -
+      n_choose_k_128(comb_len - ind, var_count - comb[ind]);
+    prev = comb[ind];
   }
   return num_tab;
 }
@@ -187,12 +136,10 @@ Input :
   -int x : The integer that we will add to |comb|.
   -int index_comb : the integer who is the index in the |new_comb| build 
                     from |comb| and x at which we will add x.
-  -int *num_quo : A pointer of an integer in which we will add the quotient of 
-                  the numbering of the tuple.                  
 Output : The numbering of the tuple (|comb|, x) sorted.  
 */
-static int update_num_tab(Comb *comb, int comb_len, int var_count, int x, 
-                          int index_comb, int *num_quo){
+static uint128_t update_num_tab(Comb *comb, int comb_len, int var_count, int x, 
+                                int index_comb){
   
   //Creation of the (|comb|, x)
   Comb new_comb[comb_len + 1];
@@ -205,122 +152,71 @@ static int update_num_tab(Comb *comb, int comb_len, int var_count, int x,
     new_comb[i] = comb[i - 1];
   
   //Compute the numbering of (|comb|, x)
-  return num_tab_comb(new_comb, comb_len + 1, var_count, num_quo);
+  return num_tab_comb(new_comb, comb_len + 1, var_count);
 }
 
-// |hash| is the hash of a Comb*, and |x| an element that we would
-// like to add to that Comb*. This function returns the hash of the
-// new Comb* (without having to recompute it entirely)
-/*static unsigned int update_hash(unsigned int hash, int x, int *num_quo) {
-   return hash + hash_int(x, num_quo);
-}*/
-
-typedef struct _hashnode {
-  Comb* comb;             /* tuples */
-  unsigned int quo_hash;  /* See the comments above the function num_tab_comb 
-                             for more details.*/
-  struct _hashnode* next; /* Next element on the node */
-} HashNode;
+// Hash of the numbering |key| of a tuple: its lowest bits select the
+// slot of the tuple, so that tuples with close numberings (such as
+// the super-tuples generated by expand_tuple) are stored close to
+// each other.
+static uint64_t hash_num_tab(const void* key, int key_size) {
+  (void) key_size;
+  uint128_t num_tab;
+  memcpy(&num_tab, key, sizeof(num_tab));
+  uint64_t low = (uint64_t)num_tab ^ ((uint64_t)(num_tab >> 64) * 0x9E3779B97F4A7C15ULL);
+  return (low << 7) | ((low * 0x9E3779B97F4A7C15ULL) >> 57);
+}
 
+// The payload of each numbering is the tuple itself (sorted),
+// allocated in the arena of the map.
 typedef struct _hashmap {
-  HashNode** content;
+  TupleMap* tuples; // Numberings (uint128_t) -> tuples (Comb*)
   unsigned int comb_len; // The size of the tuples inside this hash
-  int count; // The number of elements that were added to this hashmap
+  Arena* arena; // The tuples
 } HashMap;
 
-
-/*Determine the size of the Hash Table we will use. it will be the minimum 
-between the maximum number of failure tuple we can have "theorically" 
-and a born to prevent integer overflow that I called overflow_trigger in the 
-function. 
-Input :
-    -int c_len : The length of the circuit.
-    -int coeff_max : the maximum coefficient c in the function f of random 
-                     probing security notions we are studying.
-*/
-void determine_HASH_MASK(int c_len, int coeff_max){ 
-  HASH_MASK = n_choose_k(coeff_max, c_len) - 1;
-  int size = sizeof(HashNode*);
-  /* To avoid overflow when I call calloc for map->content and let some free memory.*/
-  uint64_t overflow_trigger = (uint64_t)((INT_MAX / (4 * size)) - 2);
-  if (HASH_MASK > overflow_trigger){
-    HASH_MASK = overflow_trigger;
-  }
- 
-  printf("HASH_MASK = %lu\n", HASH_MASK);
-}
-
 // Allocates and initializes an empty hash map capable of holding
 // elements of size |comb_len|.
 static HashMap* init_hash(int comb_len) {
   HashMap* map = malloc(sizeof(*map));
-  map->content  = calloc(HASH_SIZE, sizeof(*(map->content)));
+  map->tuples   = make_tuple_map(sizeof(uint128_t), sizeof(Comb*), hash_num_tab);
   map->comb_len = comb_len;
-  map->count    = 0;
+  map->arena    = make_arena("incompr_failures_hash");
   return map;
 }
 
 // Frees all elements contained in |map|, but does not free |map| itself.
 static void empty_hash(HashMap* map, int verbose) {
-  int used_buckets = 0;
-  int collisions = 0;
-  for (int i = 0; i < (int)(HASH_SIZE); i++) {
-    HashNode* node = map->content[i];
-    if (node) used_buckets++;
-    while (node) {
-      HashNode* next = node->next;
-      free(node->comb);
-      free(node);
-      if (next) collisions++;
-      node = next;
-    }
-    map->content[i] = NULL;
-  }
-  map->count = 0;
-
+  stats_record_size("incompr_failures_hash", map->tuples->count);
   if (verbose > 5) {
-    printf("Comb_len=%d ---> map used at %d%%  ---  collisions:%d%%.\n", map->comb_len,
-           (int)(((double)used_buckets / (HASH_SIZE)) * 100),
-           (int)(((double)collisions / used_buckets) * 100));
+    printf("Comb_len=%d ---> %lu tuples in a map of %lu slots.\n", map->comb_len,
+           (unsigned long)map->tuples->count, (unsigned long)map->tuples->capacity);
   }
+  tuple_map_clear(map->tuples);
+  arena_reset(map->arena);
 }
 
 // Frees the content of |map|, as well as |map| itself.
 static void free_hash(HashMap* map, int verbose) {
   empty_hash(map, verbose);
-  free(map->content);
+  free_arena(map->arena);
+  free_tuple_map(map->tuples);
   free(map);
 }
 
-// Adds |comb| to |map| at index |hash|. Do not check whether it's
-// already in it or not.
-// Assumes that |comb| is already sorted.
-static void add_to_hash_with_key(HashMap* map, Comb* comb, unsigned int hash,
-                                 unsigned int hash_quo) {
-  HashNode* old = map->content[hash];
-  HashNode* new = malloc(sizeof(*new));
-  new->comb = comb;
-  new->quo_hash = hash_quo;
-  new->next = old;
-  map->content[hash] = new;
-  map->count++;
+// Returns the tuple stored in |slot| of |map|.
+static inline Comb* slot_comb(const HashMap* map, const void* slot) {
+  return *(Comb**)tuple_map_value(map->tuples, slot);
 }
 
-//Compute the numbering of the tuple |comb|, called |num_tab| and 
-//adds |comb| to |map| at index |num_tab|. Do not check whether it's
-//already in it or not.
-//Assumes that |comb| is already sorted.
-static void add_to_hash_num_tab(HashMap* map, Comb *comb, int comb_len, 
-                                int var_count){
-  
-  int num_quo = 0;
-  int num_tab = num_tab_comb(comb, comb_len, var_count, &num_quo);
-  unsigned int hash_quo = num_tab / HASH_SIZE;
-  hash_quo += num_quo;
-  num_tab %= HASH_SIZE;
-  
-  add_to_hash_with_key(map, comb, num_tab, hash_quo);
-
+// Adds the tuple whose numbering is |num_tab| to |map| (whose hash is
+// |hash|) if it is not already in it. Returns the slot of the tuple
+// if it was added, in which case the caller must store the tuple in
+// it, and NULL otherwise.
+static void* add_to_hash_with_key(HashMap* map, uint128_t num_tab, uint64_t hash) {
+  bool inserted;
+  void* slot = tuple_map_insert_hashed(map->tuples, &num_tab, hash, &inserted);
+  return inserted ? slot : NULL;
 }
 
 // Adds in |map| the incompressible tuples of size |size| contained in
@@ -330,16 +226,47 @@ static void add_incompr_to_map(HashMap* map, Trie* incompr, int size,
 {
   ListComb* incompr_list = list_from_trie(incompr, size);
   ListCombElem* curr = incompr_list->head;
+  Comb sorted[size > 0 ? size : 1];
   while (curr) {
-    sort_comb(curr->comb, size);
-    add_to_hash_num_tab(map, curr->comb, size, var_count);
-    
-    ListCombElem* next = curr->next;
-    // Not freeing curr->comb since it now is in the hashmap
-    free(curr);
-    curr = next;
+    memcpy(sorted, curr->comb, size * sizeof(*sorted));
+    sort_comb(sorted, size);
+    uint128_t num_tab = num_tab_comb(sorted, size, var_count);
+    void* slot = add_to_hash_with_key(map, num_tab,
+                                      hash_num_tab(&num_tab, sizeof(num_tab)));
+    if (slot) {
+      Comb* comb = arena_alloc(map->arena, size * sizeof(*comb));
+      memcpy(comb, sorted, size * sizeof(*comb));
+      *(Comb**)tuple_map_value(map->tuples, slot) = comb;
+    }
+    curr = curr->next;
+  }
+  free_list(incompr_list);
+}
+
+// Adds to |inter| a copy of the tuples that are both in |map1| and
+// in |map2|. The smaller map is iterated, and the other one queried.
+static void add_intersection_to_map(HashMap* inter, HashMap* map1,
+                                    HashMap* map2) {
+  if (map2->tuples->count < map1->tuples->count) {
+    HashMap* tmp = map1;
+    map1 = map2;
+    map2 = tmp;
+  }
+  int comb_len = inter->comb_len;
+  uint64_t it = 0;
+  void* slot;
+  while ((slot = tuple_map_next(map1->tuples, &it))) {
+    uint128_t num_tab;
+    memcpy(&num_tab, slot, sizeof(num_tab));
+    uint64_t hash = hash_num_tab(&num_tab, sizeof(num_tab));
+    if (!tuple_map_find_hashed(map2->tuples, &num_tab, hash)) continue;
+    void* new_slot = add_to_hash_with_key(inter, num_tab, hash);
+    if (new_slot) {
+      Comb* new_comb = arena_alloc(inter->arena, comb_len * sizeof(*new_comb));
+      memcpy(new_comb, slot_comb(map1, slot), comb_len * sizeof(*new_comb));
+      *(Comb**)tuple_map_value(inter->tuples, new_slot) = new_comb;
+    }
   }
-  free(incompr_list);
 }
 
 /* **************************************************************** */
@@ -347,103 +274,68 @@ static void add_incompr_to_map(HashMap* map, Trie* incompr, int size,
 /* **************************************************************** */
 
 // Update the coefficients |coeffs| with the tuples contained in |map|.
-void update_coeffs_with_hash(const Circuit* c, uint64_t* coeffs, HashMap* map) {
+void update_coeffs_with_hash(const Circuit* c, Coeff* coeffs, HashMap* map) {
   int comb_len = map->comb_len;
-  for (int i = 0; i < (int)(HASH_SIZE); i++) {
-    HashNode* node = map->content[i];
-    while (node) {
-      update_coeff_c_single(c, coeffs, node->comb, comb_len);
-      node = node->next;
-    }
-  }
-}
-
-/*
-Check if the tuple give by the hash and the quotient is in the Hash table.
-Input : 
-  -HashMap *map : The hash table in which we have to check if the tuple is in 
-                  or not.
-  -int hash : The numbering of the tuple modulo HASH_MASK.
-  -unsigned int quo_hash : The quotient of the numbering of the tuple by 
-                           HASH_MASK. 
-Output : True if the tuple is in map. False otherwise.
-*/
-bool tuple_is_in(HashMap *map, int hash, unsigned int quo_hash){
-  HashNode *node = map->content[hash];
-  while (node){
-    if (node->quo_hash == quo_hash){ 
-      //Hash and quotient are the same, so the tuple is already in map.
-      return true;
-    }
-    node = node->next;
+  uint64_t it = 0;
+  void* slot;
+  while ((slot = tuple_map_next(map->tuples, &it))) {
+    update_coeff_c_single(c, coeffs, slot_comb(map, slot), comb_len);
   }
-  return false; 
 }
 
-
 /* Update the coefficients |coeffs| with the tuples contained in |map|.
 Input :
     -const Circuit *c : The arithmetic circuit.
-    -uint64_t *coeffs : The coefficients to update.
+    -Coeff *coeffs : The coefficients to update.
     -HashMap **map : Array of pointers of map. Each map contain the failure 
                      tuple of one subset of output index.
     -int len_map : The number of different pointers of map (i.e the number of 
                    subsets of output index of a certain size).
 */
-void update_coeffs_with_hash_RPE2(const Circuit* c, uint64_t* coeffs, 
+void update_coeffs_with_hash_RPE2(const Circuit* c, Coeff* coeffs, 
                                   HashMap** map, int len_map) {
   //Browsing the failure tuple in the first map.
   int comb_len = map[0]->comb_len;
-  for (int i = 0; i < (int)(HASH_SIZE); i++) {
-    HashNode* node = map[0]->content[i];
-    while (node) {
-      Comb *comb = node->comb;
-      unsigned int hash_quo = node->quo_hash;
-      bool is_good = true;
-      // Verifying if the comb |comb| is in all the maps. If it is not the case,
-      // then, we have an output set where this comb is not a failure tuple. 
-      // By definition of RPE2, this is not a failure tuple.
-      for (int idx = 1; idx < len_map && is_good; idx++){        
-        is_good &= tuple_is_in(map[idx], i, hash_quo);
-      }
-      
-      if (is_good){
-        update_coeff_c_single(c, coeffs, comb, comb_len);
-      }
+  uint64_t it = 0;
+  void* slot;
+  while ((slot = tuple_map_next(map[0]->tuples, &it))) {
+    uint64_t hash = hash_num_tab(slot, sizeof(uint128_t));
+    bool is_good = true;
+    // Verifying if the comb |comb| is in all the maps. If it is not the case,
+    // then, we have an output set where this comb is not a failure tuple. 
+    // By definition of RPE2, this is not a failure tuple.
+    for (int idx = 1; idx < len_map && is_good; idx++){        
+      is_good &= tuple_map_find_hashed(map[idx]->tuples, slot, hash) != NULL;
+    }
       
-      node = node->next;
-    }     
+    if (is_good){
+      update_coeff_c_single(c, coeffs, slot_comb(map[0], slot), comb_len);
+    }
   }
 }
 
 
 
-// Checks if the tuple (|comb|, |x|) is in |dst| at index |hash|. If
-// not, then this tuple is added to |dst|. |comb_len| is the length of
-// |comb|.
+// Checks if the tuple (|comb|, |x|), whose numbering is |num_tab|, is
+// in |dst|. If not, then this tuple is added to |dst|. |comb_len| is
+// the length of |comb|.
 //
 // The code is somewhat not straightfoward because it does not build
 // the tuple (|comb|, |x|) to check whether its in |dst| or not (in
 // order to avoid mallocing too much).
-void check_comb_and_add(HashMap* dst, unsigned int hash,
-                        Comb* comb, int x, int comb_len, int num_quo) {
-  // Part 1: check if the tuple (|comb|, |x|) is in |dst|
-  unsigned int hash_quo = hash / HASH_SIZE;
-  hash_quo += num_quo;
-  hash %= HASH_SIZE;
-      
-  HashNode* node = dst->content[hash];
-  while (node) {
-    if (hash_quo == node->quo_hash) {
-      regenerated++;
-      return;
-    } else {
-      node = node->next;
-    }
+void check_comb_and_add(HashMap* dst, uint128_t num_tab,
+                        Comb* comb, int x, int comb_len) {
+  // Part 1: add the numbering of (|comb|, |x|) to |dst|, unless it
+  // is already in it.
+  void* slot = add_to_hash_with_key(dst, num_tab,
+                                    hash_num_tab(&num_tab, sizeof(num_tab)));
+  if (!slot) {
+    regenerated++;
+    return;
   }
   
-  // Part 2: the tuple is not already in the hash -> build it now.
-  Comb* new_comb = malloc((comb_len+1) * sizeof(*new_comb));
+  // Part 2: the tuple was not already in the hash -> build it now.
+  Comb* new_comb = arena_alloc(dst->arena, (comb_len+1) * sizeof(*new_comb));
   int i = 0;
   while (i < comb_len && comb[i] < x) {
     new_comb[i] = comb[i];
@@ -454,14 +346,7 @@ void check_comb_and_add(HashMap* dst, unsigned int hash,
     new_comb[i] = comb[i-1];
     i++;
   } 
-  
-  // Part 3: add the tuple to the hash.
-  HashNode* new_node = malloc(sizeof(*new_node));
-  new_node->comb     = new_comb;
-  new_node->quo_hash = hash_quo;
-  new_node->next     = dst->content[hash];
-  dst->content[hash]  = new_node;
-  dst->count++;
+  *(Comb**)tuple_map_value(dst->tuples, slot) = new_comb;
 }
 
 // This function considers all super-tuples of |comb| with 1 more
@@ -489,10 +374,9 @@ void expand_tuple(HashMap *dst, Comb *comb, int comb_len, int var_count){
   if (comb_len == 0){
     // Adding elements at the start
     for (int i = 0; i < var_count; i++) {
-      int num_quo = 0;
       // Creation of the hash of the super-tuple.
-      int new_num_tab = update_num_tab(comb, comb_len, var_count, i, 0, &num_quo);
-      check_comb_and_add(dst, new_num_tab, comb, i, comb_len, num_quo);
+      uint128_t new_num_tab = update_num_tab(comb, comb_len, var_count, i, 0);
+      check_comb_and_add(dst, new_num_tab, comb, i, comb_len);
     }
     return;
   }
@@ -504,26 +388,23 @@ void expand_tuple(HashMap *dst, Comb *comb, int comb_len, int var_count){
       
   // Adding elements at the start
   for (int i = 0; i < first && i < var_count; i++) {
-    int num_quo = 0;
     // Creation of the hash of the super-tuple.
-    int new_num_tab = update_num_tab(comb, comb_len, var_count, i, 0, &num_quo);
-    check_comb_and_add(dst, new_num_tab, comb, i, comb_len, num_quo);
+    uint128_t new_num_tab = update_num_tab(comb, comb_len, var_count, i, 0);
+    check_comb_and_add(dst, new_num_tab, comb, i, comb_len);
   }
   // Adding elements in the middle
   for (int j = 0; j < comb_len-1; j++) {
     for (int i = comb[j]+1; i < comb[j+1] && i < var_count; i++) {
-      int num_quo = 0;
       //Creation of the hash of the super-tuple.           
-      int new_num_tab = update_num_tab(comb, comb_len, var_count, i, j + 1, &num_quo);
-      check_comb_and_add(dst, new_num_tab, comb, i, comb_len, num_quo);
+      uint128_t new_num_tab = update_num_tab(comb, comb_len, var_count, i, j + 1);
+      check_comb_and_add(dst, new_num_tab, comb, i, comb_len);
     }
   }
   // Adding elements at the end
   for (int i = last+1; i < var_count; i++) {
-    int num_quo = 0;
     //Creation of the hash of the super-tuple.
-    int new_num_tab = update_num_tab(comb, comb_len, var_count, i, comb_len, &num_quo);
-    check_comb_and_add(dst, new_num_tab, comb, i, comb_len, num_quo);
+    uint128_t new_num_tab = update_num_tab(comb, comb_len, var_count, i, comb_len);
+    check_comb_and_add(dst, new_num_tab, comb, i, comb_len);
   }
 }
 
@@ -544,15 +425,212 @@ Input :
 */
 void expand_tuples(HashMap* curr, HashMap* next, int var_count) {
   int comb_len = curr->comb_len;
-  for (int i = 0; i < (int)(HASH_SIZE); i++) {
-    HashNode* node = curr->content[i];
-    while (node) {
-      expand_tuple(next, node->comb, comb_len, var_count);   
-      node = node->next;
+  uint64_t it = 0;
+  void* slot;
+  while ((slot = tuple_map_next(curr->tuples, &it))) {
+    expand_tuple(next, slot_comb(curr, slot), comb_len, var_count);   
+  }
+}
+
+
+/* **************************************************************** */
+/*                            Spill mode                            */
+/* **************************************************************** */
+
+// In spill mode (--spill, see spill.h), the failures of each size are
+// stored as a SpillRun of their numberings rather than in a HashMap:
+// a run is read sequentially to generate the numberings of the
+// super-tuples, which are sorted and deduplicated on disk to get the
+// run of the next size. Since runs are sorted, intersections of sets
+// of failures are computed by merging runs, without storing them.
+
+// Computes the tuple |comb| of size |comb_len| whose numbering is
+// |num_tab| (the inverse of num_tab_comb).
+static void comb_from_num_tab(uint128_t num_tab, Comb* comb, int comb_len,
+                              int var_count) {
+  int x = 0;
+  for (int ind = 0; ind < comb_len; ind++) {
+    // Skipping the C(var_count-1-x, comb_len-1-ind) tuples whose
+    // element at index |ind| is |x|, until |num_tab| falls in them.
+    while (1) {
+      uint128_t count = n_choose_k_128(comb_len - 1 - ind, var_count - 1 - x);
+      if (num_tab < count) break;
+      num_tab -= count;
+      x++;
     }
+    comb[ind] = x++;
   }
 }
 
+// Returns the run of the failures of size |comb_len|+1: the
+// super-tuples of the failures of |curr| (of size |comb_len|), and the
+// incompressible tuples of size |comb_len|+1 of |incompr|.
+// *|generated| is set to the number of numberings generated (including
+// duplicates).
+static SpillRun* expand_run(SpillRun* curr, int comb_len, Trie* incompr,
+                            int var_count, uint64_t* generated) {
+  SpillSorter* sorter = make_spill_sorter();
+
+  // Super-tuples of the failures of |curr|. Like in expand_tuple,
+  // |comb| being sorted, the position at which each element is
+  // inserted is known without building the super-tuple.
+  SpillReader reader;
+  spill_reader_init(&reader, curr);
+  Comb comb[comb_len > 0 ? comb_len : 1];
+  uint128_t num_tab;
+  while (spill_read(&reader, &num_tab)) {
+    comb_from_num_tab(num_tab, comb, comb_len, var_count);
+    int j = 0;
+    for (int i = 0; i < var_count; i++) {
+      if (j < comb_len && comb[j] == i) {
+        j++;
+        continue;
+      }
+      spill_sorter_add(sorter, update_num_tab(comb, comb_len, var_count, i, j));
+    }
+  }
+
+  // Incompressible tuples.
+  int size = comb_len + 1;
+  ListComb* incompr_list = list_from_trie(incompr, size);
+  Comb sorted[size > 0 ? size : 1];
+  for (ListCombElem* elem = incompr_list->head; elem; elem = elem->next) {
+    memcpy(sorted, elem->comb, size * sizeof(*sorted));
+    sort_comb(sorted, size);
+    spill_sorter_add(sorter, num_tab_comb(sorted, size, var_count));
+  }
+  free_list(incompr_list);
+
+  *generated = sorter->added;
+  SpillRun* next = spill_sorter_finish(sorter);
+  stats_record_size("incompr_failures_run", next->count);
+  return next;
+}
+
+// Updates |coeffs| with the tuples of size |comb_len| whose numberings
+// are in all of the |run_count| runs |runs| (like
+// update_coeffs_with_hash_RPE2).
+static void update_coeffs_with_runs(const Circuit* c, Coeff* coeffs,
+                                    SpillRun** runs, int run_count,
+                                    int comb_len, int var_count) {
+  SpillReader readers[run_count];
+  uint128_t num_tabs[run_count];
+  for (int i = 0; i < run_count; i++) {
+    spill_reader_init(&readers[i], runs[i]);
+    if (!spill_read(&readers[i], &num_tabs[i])) return;
+  }
+
+  Comb comb[comb_len > 0 ? comb_len : 1];
+  while (1) {
+    // Advancing all runs up to the largest of their current
+    // numberings, which is a failure if all of them reach it.
+    uint128_t max_num_tab = num_tabs[0];
+    for (int i = 1; i < run_count; i++) {
+      if (num_tabs[i] > max_num_tab) max_num_tab = num_tabs[i];
+    }
+    bool in_all = true;
+    for (int i = 0; i < run_count; i++) {
+      while (num_tabs[i] < max_num_tab) {
+        if (!spill_read(&readers[i], &num_tabs[i])) return;
+      }
+      in_all &= num_tabs[i] == max_num_tab;
+    }
+
+    if (in_all) {
+      comb_from_num_tab(max_num_tab, comb, comb_len, var_count);
+      update_coeff_c_single(c, coeffs, comb, comb_len);
+      for (int i = 0; i < run_count; i++) {
+        if (!spill_read(&readers[i], &num_tabs[i])) return;
+      }
+    }
+  }
+}
+
+// Spill mode version of compute_failures_from_incompressibles_RPC.
+static void compute_failures_from_incompressibles_RPC_spill(const Circuit* c,
+                                                            Trie *incompr,
+                                                            Trie *incompr2,
+                                                            int coeff_max,
+                                                            Coeff *coeffs,
+                                                            bool RPE_and) {
+  int var_count = c->length;
+  uint64_t generated;
+  SpillRun* curr[2] = { make_empty_spill_run(),
+                        RPE_and ? make_empty_spill_run() : NULL };
+  Trie* incomprs[2] = { incompr, incompr2 };
+  int chains = RPE_and ? 2 : 1;
+
+  for (int i = -1; i < coeff_max; i++) {
+    for (int k = 0; k < chains; k++) {
+      SpillRun* next = expand_run(curr[k], i, incomprs[k], var_count, &generated);
+      free_spill_run(curr[k]);
+      curr[k] = next;
+    }
+    // With |RPE_and|, the failures are the intersection of both runs.
+    update_coeffs_with_runs(c, coeffs, curr, chains, i + 1, var_count);
+  }
+
+  for (int k = 0; k < chains; k++) free_spill_run(curr[k]);
+}
+
+// Spill mode version of compute_failures_from_incompressibles_RPE2:
+// the runs of the |nb_output| output sets of the first secret come
+// first in |curr|, followed by the ones of the second secret.
+static void compute_failures_from_incompressibles_RPE2_spill(const Circuit* c,
+                                                             Trie **incompr,
+                                                             Trie **incompr2,
+                                                             int coeff_max,
+                                                             Coeff *coeffs,
+                                                             Coeff *coeffs2,
+                                                             Coeff *coeffs_and) {
+  int var_count = c->length;
+  int nb_output = c->deps->length - var_count;
+  uint64_t generated;
+  SpillRun* curr[2 * nb_output];
+  for (int j = 0; j < 2 * nb_output; j++) curr[j] = make_empty_spill_run();
+
+  for (int i = -1; i < coeff_max; i++) {
+    for (int j = 0; j < 2 * nb_output; j++) {
+      Trie* incompr_j = j < nb_output ? incompr[j] : incompr2[j - nb_output];
+      SpillRun* next = expand_run(curr[j], i, incompr_j, var_count, &generated);
+      free_spill_run(curr[j]);
+      curr[j] = next;
+    }
+    update_coeffs_with_runs(c, coeffs, curr, nb_output, i + 1, var_count);
+    update_coeffs_with_runs(c, coeffs2, curr + nb_output, nb_output, i + 1,
+                            var_count);
+    // The tuples in the intersection for all output sets are the ones
+    // in all the runs.
+    update_coeffs_with_runs(c, coeffs_and, curr, 2 * nb_output, i + 1,
+                            var_count);
+  }
+
+  for (int j = 0; j < 2 * nb_output; j++) free_spill_run(curr[j]);
+}
+
+// Spill mode version of compute_failures_from_incompressibles_RPE2_single.
+static void compute_failures_from_incompressibles_RPE2_single_spill(const Circuit* c,
+                                                                    Trie **incompr,
+                                                                    int len_incompr,
+                                                                    int coeff_max,
+                                                                    Coeff *coeffs) {
+  int var_count = c->length;
+  uint64_t generated;
+  SpillRun* curr[len_incompr];
+  for (int j = 0; j < len_incompr; j++) curr[j] = make_empty_spill_run();
+
+  for (int i = 0; i < coeff_max; i++) {
+    for (int j = 0; j < len_incompr; j++) {
+      SpillRun* next = expand_run(curr[j], i, incompr[j], var_count, &generated);
+      free_spill_run(curr[j]);
+      curr[j] = next;
+    }
+    update_coeffs_with_runs(c, coeffs, curr, len_incompr, i + 1, var_count);
+  }
+
+  for (int j = 0; j < len_incompr; j++) free_spill_run(curr[j]);
+}
+
 
 // Pseudo-code:
 //
@@ -575,7 +653,7 @@ void compute_failures_from_incompressibles(const Circuit* c, Trie* incompr,
   int var_count = c->length;
   int concise = verbose < 5;
 
-  uint64_t coeffs[c->total_wires+1];
+  Coeff coeffs[c->total_wires+1];
   for (int i = 0; i <= c->total_wires; i++) {
     coeffs[i] = 0;
   }
@@ -586,26 +664,50 @@ void compute_failures_from_incompressibles(const Circuit* c, Trie* incompr,
     fflush(stdout);
   }
 
-  HashMap* curr = init_hash(1);
-  HashMap* next = init_hash(0);
+  // In spill mode, the failures are in |curr_run| rather than in |curr|.
+  HashMap* curr = NULL;
+  HashMap* next = NULL;
+  SpillRun* curr_run = NULL;
+  if (get_spill_dir()) {
+    curr_run = make_empty_spill_run();
+  } else {
+    curr = init_hash(1);
+    next = init_hash(0);
+  }
   for (int i = 0; i < coeff_max; i++) {
-    next->comb_len = i + 1;
-    expand_tuples(curr, next, var_count);
-    add_incompr_to_map(next, incompr, i + 1, var_count);
-    
-    update_coeffs_with_hash(c, coeffs, next);
+    uint64_t count;
+    if (curr_run) {
+      uint64_t generated;
+      SpillRun* next_run = expand_run(curr_run, i, incompr, var_count, &generated);
+      update_coeffs_with_runs(c, coeffs, &next_run, 1, i + 1, var_count);
+      count = next_run->count;
+      regenerated += generated - count;
+      free_spill_run(curr_run);
+      curr_run = next_run;
+    } else {
+      next->comb_len = i + 1;
+      expand_tuples(curr, next, var_count);
+      add_incompr_to_map(next, incompr, i + 1, var_count);
+
+      update_coeffs_with_hash(c, coeffs, next);
+      count = next->tuples->count;
+    }
     if (concise) {
-      printf("%lu, ", coeffs[i + 1]);
+      fprint_coeff(stdout, coeffs[i + 1]);
+      printf(", ");
       fflush(stdout);
     } else {
-      printf("c%d = %lu\n", i+1, coeffs[i + 1]);
+      printf("c%d = ", i+1);
+      fprint_coeff(stdout, coeffs[i + 1]);
+      printf("\n");
 
       printf("Regenerated: %d%% (%d / %d)\n",
-             (int)((double)regenerated/next->count*100),
-             regenerated, next->count);
+             (int)((double)regenerated/count*100),
+             regenerated, (int)count);
       regenerated = 0;
     }
 
+    if (curr_run) continue;
     empty_hash(curr, verbose);
     HashMap* tmp = curr;
     curr = next;
@@ -614,19 +716,25 @@ void compute_failures_from_incompressibles(const Circuit* c, Trie* incompr,
 
   if (concise) {
     for (int i = coeff_max + 1; i < c->total_wires; i++) {
-      printf("%lu, ", coeffs[i]);
+      fprint_coeff(stdout, coeffs[i]);
+      printf(", ");
     }
-    printf("%lu ]\n", coeffs[c->total_wires]);
+    fprint_coeff(stdout, coeffs[c->total_wires]);
+    printf(" ]\n");
   } else {
     for (int i = coeff_max+1; i < c->total_wires; i++) {
-      printf("c%d = %lu\n", i, coeffs[i]);
+      printf("c%d = ", i);
+      fprint_coeff(stdout, coeffs[i]);
+      printf("\n");
     }
   }
   
-  free_hash(curr, verbose);
-  free_hash(next, verbose);
-
-
+  if (curr_run) {
+    free_spill_run(curr_run);
+  } else {
+    free_hash(curr, verbose);
+    free_hash(next, verbose);
+  }
 
   double p_min = compute_leakage_proba(coeffs, coeff_max,
                                        c->total_wires+1,
@@ -658,7 +766,7 @@ Input :
                     of incompressible error tuples for another secret values.                     
   -int coeff_max : The maximal coefficient that we have to compute.
   -int verbose : For the level of verbosity.
-  -uint64_t *coeffs : The array of coefficients in which we are going to write 
+  -Coeff *coeffs : The array of coefficients in which we are going to write 
                       the coefficients of error.
   -bool RPE_and : A boolean who indicates if we are computing the coefficients 
                   for the intersection of 2 secrets values or not.  
@@ -666,11 +774,17 @@ Input :
 */
 void compute_failures_from_incompressibles_RPC(const Circuit* c, Trie *incompr,
                                                Trie *incompr2, int coeff_max, 
-                                               int verbose, uint64_t *coeffs, 
+                                               int verbose, Coeff *coeffs, 
                                                bool RPE_and) {
   int var_count = c->length;
   if (coeff_max == -1) coeff_max = c->total_wires+1;
 
+  if (get_spill_dir()) {
+    compute_failures_from_incompressibles_RPC_spill(c, incompr, incompr2,
+                                                    coeff_max, coeffs, RPE_and);
+    return;
+  }
+
   // Creation and Initialisation of the HashMap.
   HashMap* curr = init_hash(1);
   HashMap* next = init_hash(0);
@@ -697,23 +811,7 @@ void compute_failures_from_incompressibles_RPC(const Circuit* c, Trie *incompr,
       expand_tuples(curr2, next2, var_count);
       add_incompr_to_map(next2, incompr2, i + 1, var_count);
       
-      for(int j = 0; j < (int)(HASH_SIZE); j++){
-        if(next->content[j] && next2->content[j]){
-          HashNode* node = next->content[j];
-          while (node){
-            HashNode* node2 = next2->content[j];
-            while (node2){
-              if (node->quo_hash == node2->quo_hash){
-                Comb *new_comb = malloc(inter->comb_len * sizeof(*new_comb));
-                memcpy(new_comb, node->comb, inter->comb_len * sizeof(*new_comb));
-                add_to_hash_with_key(inter, new_comb, j, node2->quo_hash);
-              }
-              node2 = node2->next;
-            }
-            node = node->next;
-          }
-        }
-      } 
+      add_intersection_to_map(inter, next, next2);
     }
     
     //Updating coefficients with all the rrors of size i + 1 we found.
@@ -760,23 +858,30 @@ Input :
   -Trie **incompr2 : Same as Trie **incompr but with the second secret value.
   -int coeff_max : The maximal coefficient that we have to compute.
   -int verbose : For the level of verbosity.
-  -uint64_t *coeffs : The array of coefficients in which we are going to write 
+  -Coeff *coeffs : The array of coefficients in which we are going to write 
                       the coefficients of error for the first secret value.
-  -uint64_t *coeffs2 : Same as uint64_t *coeffs but with the second secret 
+  -Coeff *coeffs2 : Same as Coeff *coeffs but with the second secret 
                        value.
-  -uint64_t *coeffs_and : Same as uint64_t *coeffs but with the intersection 
+  -Coeff *coeffs_and : Same as Coeff *coeffs but with the intersection 
                           between the first ans the second secret value.                     
 */
 void compute_failures_from_incompressibles_RPE2(const Circuit* c, Trie **incompr,
                                                 Trie **incompr2, int coeff_max, 
-                                                int verbose, uint64_t *coeffs,
-                                                uint64_t *coeffs2, 
-                                                uint64_t *coeffs_and) {
+                                                int verbose, Coeff *coeffs,
+                                                Coeff *coeffs2, 
+                                                Coeff *coeffs_and) {
   int var_count = c->length;
   int nb_output = c->deps->length - var_count;
   
   if (coeff_max == -1) coeff_max = c->total_wires+1;
 
+  if (get_spill_dir()) {
+    compute_failures_from_incompressibles_RPE2_spill(c, incompr, incompr2,
+                                                     coeff_max, coeffs, coeffs2,
+                                                     coeffs_and);
+    return;
+  }
+
   //Creation of all the HashMap.
   HashMap *curr[nb_output];
   HashMap *next[nb_output];  
@@ -808,23 +913,7 @@ void compute_failures_from_incompressibles_RPE2(const Circuit* c, Trie **incompr
       add_incompr_to_map(next2[j], incompr2[j], i + 1, var_count);
         
       inter[j]->comb_len = i + 1;
-      for (int k = 0; k < (int)(HASH_SIZE); k++){
-        if (next[j]->content[k] && next2[j]->content[k]){
-          HashNode *node = next[j]->content[k];
-          while(node){
-            HashNode *node2 = next2[j]->content[k];
-            while(node2){
-              if (node->quo_hash == node2->quo_hash){
-                Comb *new_comb = malloc(inter[j]->comb_len * sizeof(*new_comb));
-                memcpy(new_comb, node2->comb, inter[j]->comb_len * sizeof(*new_comb));
-                add_to_hash_with_key(inter[j], new_comb, k, node2->quo_hash);  
-              }
-              node2 = node2->next;
-            }
-            node = node->next;
-          }
-        }
-      }
+      add_intersection_to_map(inter[j], next[j], next2[j]);
     }
       
     //Updating the coefficients in each array(coeffs, coeffs2 and coeffs_and) 
@@ -900,23 +989,7 @@ void *start_thread_steps_i(void *void_args){
   add_incompr_to_map(next2[j], incompr2[j], i + 1, var_count);
         
   inter[j]->comb_len = i + 1;
-  for (int k = 0; k < (int)(HASH_SIZE); k++){
-    if (next[j]->content[k] && next2[j]->content[k]){
-      HashNode *node = next[j]->content[k];
-      while(node){
-        HashNode *node2 = next2[j]->content[k];
-        while(node2){
-          if (node->quo_hash == node2->quo_hash){
-            Comb *new_comb = malloc(inter[j]->comb_len * sizeof(*new_comb));
-            memcpy(new_comb, node2->comb, inter[j]->comb_len * sizeof(*new_comb));
-            add_to_hash_with_key(inter[j], new_comb, k, node2->quo_hash);  
-          }
-          node2 = node2->next;
-        }
-        node = node->next;
-      }
-    }
-  }
+  add_intersection_to_map(inter[j], next[j], next2[j]);
   
   free(args);
   return NULL;
@@ -924,7 +997,7 @@ void *start_thread_steps_i(void *void_args){
 
 struct update_coeffs_with_hash_RPE2_args{
   const Circuit* c; 
-  uint64_t* coeffs; 
+  Coeff* coeffs; 
   HashMap** map;
   int len_map;  
 };
@@ -947,11 +1020,12 @@ void compute_failures_from_incompressibles_RPE2_parallel(const Circuit* c,
                                                          Trie **incompr2, 
                                                          int coeff_max, 
                                                          int verbose, 
-                                                         uint64_t *coeffs,
-                                                         uint64_t *coeffs2, 
-                                                         uint64_t *coeffs_and,
+                                                         Coeff *coeffs,
+                                                         Coeff *coeffs2, 
+                                                         Coeff *coeffs_and,
                                                          int cores){
-  if (cores == 1 || cores == 0){
+  // The spill mode is sequential.
+  if (cores == 1 || cores == 0 || get_spill_dir()){
     compute_failures_from_incompressibles_RPE2(c, incompr, incompr2, coeff_max,
                                                verbose, coeffs, coeffs2, 
                                                coeffs_and);
@@ -1078,7 +1152,7 @@ void compute_failures_from_incompressibles_RPE2_parallel(const Circuit* c,
 
 /*
 Compute the coefficient for the property RPE2 for the copy gadget 
-(a special case) and write them in uint64_t *coeffs.
+(a special case) and write them in Coeff *coeffs.
 
 Input : 
   -const Circuit* c : The arithmetic circuit we are currently studying.
@@ -1089,7 +1163,7 @@ Input :
   -int len_incompr : the number of line of Trie **incompr.
   -int coeff_max : The maximal coefficient that we have to compute.
   -int verbose : For the level of verbosity.
-  -uint64_t *coeffs : The array of coefficients in which we are going to write 
+  -Coeff *coeffs : The array of coefficients in which we are going to write 
                       the coefficients of error for the first secret value.                   
 */
 void compute_failures_from_incompressibles_RPE2_single(const Circuit* c, 
@@ -1097,9 +1171,16 @@ void compute_failures_from_incompressibles_RPE2_single(const Circuit* c,
                                                        int len_incompr, 
                                                        int coeff_max, 
                                                        int verbose, 
-                                                       uint64_t *coeffs) {
+                                                       Coeff *coeffs) {
   int var_count = c->length;
   if (coeff_max == -1) coeff_max = c->total_wires+1;
+
+  if (get_spill_dir()) {
+    compute_failures_from_incompressibles_RPE2_single_spill(c, incompr,
+                                                            len_incompr,
+                                                            coeff_max, coeffs);
+    return;
+  }
   
   //Creation of the HashMap.
   HashMap *curr[len_incompr];
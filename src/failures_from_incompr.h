@@ -2,15 +2,14 @@
 
 #include "circuit.h"
 #include "trie.h"
-
-void determine_HASH_MASK(int c_len, int coeff_max);
+#include "coeffs.h"
 
 void compute_failures_from_incompressibles(const Circuit* c, Trie* incompr,
                                            int coeff_max, int verbose);
                                            
 void compute_failures_from_incompressibles_RPC(const Circuit* c, Trie* incompr,
                                                Trie *incompr2, int coeff_max, 
-                                               int verbose, uint64_t *coeffs,
+                                               int verbose, Coeff *coeffs,
                                                bool RPE_and);
                                                
 void compute_failures_from_incompressibles_RPE2_parallel(const Circuit* c, 
@@ -18,9 +17,9 @@ void compute_failures_from_incompressibles_RPE2_parallel(const Circuit* c,
                                                          Trie **incompr2, 
                                                          int coeff_max, 
                                                          int verbose, 
-                                                         uint64_t *coeffs,
-                                                         uint64_t *coeffs2, 
-                                                         uint64_t *coeffs_and,
+                                                         Coeff *coeffs,
+                                                         Coeff *coeffs2, 
+                                                         Coeff *coeffs_and,
                                                          int cores);
                                                 
 void compute_failures_from_incompressibles_RPE2_single(const Circuit* c, 
@@ -28,4 +27,4 @@ void compute_failures_from_incompressibles_RPE2_single(const Circuit* c,
                                                        int len_incompr,
                                                        int coeff_max, 
                                                        int verbose, 
-                                                       uint64_t *coeffs);
+                                                       Coeff *coeffs);
@@ -62,8 +62,9 @@ int compute_freeSNI(Circuit* circuit, int cores, int t) {
 
   GaussRand output_gauss_rands[circuit->share_count];
   BitDep * output_deps[circuit->share_count];
+  BitDepLayout layout = get_bit_dep_layout(circuit);
   for(int i=0; i<(circuit->share_count); i++){
-    output_deps[i] = alloca(sizeof(**output_deps));
+    output_deps[i] = init_bit_dep_at(alloca(bit_dep_size(&layout)), &layout);
   }
   int has_failure = check_output_uniformity(circuit, output_deps, output_gauss_rands);
   if(has_failure){
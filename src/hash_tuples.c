@@ -1,157 +1,479 @@
 #include <stdlib.h>
+#include <stdio.h>
 #include <stdint.h>
 #include <string.h>
+#include <pthread.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "hash_tuples.h"
 
-// TODO: it would be nice to be able to resize the hash...
-#define HASH_MASK 0x1ffffff // 500M -> times 8 (sizeof a pointer) = 4GB table
-#define HASH_SIZE (HASH_MASK+1)
+// Control byte of a slot being filled by tuple_map_insert_parallel.
+#define TUPLE_MAP_BUSY ((uint8_t)0xFD)
 
+// Below this number of keys, tuple_map_insert_parallel does not
+// bother starting threads.
+#define PARALLEL_INSERT_MIN_KEYS 4096
 
-HashMap init_hash() {
-  HashMap map;
-  map.content = calloc(HASH_SIZE, sizeof(*map.content));
-  return map;
+
+/* **************************************************************** */
+/*                         Groups of slots                          */
+/* **************************************************************** */
+
+// The functions below return a bitmask of the slots of the group
+// starting at |ctrl| whose control byte is |c| (group_match), which
+// are free (group_match_free: empty or deleted), or which hold a key
+// (group_match_full).
+
+#ifdef __SSE2__
+
+static inline uint32_t group_match(const uint8_t* ctrl, uint8_t c) {
+  __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)c)));
 }
 
-// I don't remember where I borrowed this hash function from... I'm
-// thinking maybe StackOverflow, but I'm not sure. Anyways, if you
-// (the reader) plan on reusing this hash function, don't cite me as
-// the source for it, but have a look around the web, and you should
-// easily find the actual author.
-unsigned int hash_int(unsigned int x) {
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = ((x >> 16) ^ x) * 0x45d9f3b;
-  x = (x >> 16) ^ x;
-  return x;
+static inline uint32_t group_match_free(const uint8_t* ctrl) {
+  return _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)ctrl));
 }
 
-unsigned int hash_comb(Comb* comb, int comb_len) {
-  unsigned int hash = 0;
-  for (int i = 0; i < comb_len; i++) {
-    hash += hash_int(comb[i]);
+#else
+
+static inline uint32_t group_match(const uint8_t* ctrl, uint8_t c) {
+  uint32_t mask = 0;
+  for (int i = 0; i < TUPLE_MAP_GROUP; i++) {
+    mask |= (uint32_t)(ctrl[i] == c) << i;
   }
-  return hash & HASH_MASK;
+  return mask;
+}
+
+static inline uint32_t group_match_free(const uint8_t* ctrl) {
+  uint32_t mask = 0;
+  for (int i = 0; i < TUPLE_MAP_GROUP; i++) {
+    mask |= (uint32_t)(ctrl[i] >> 7) << i;
+  }
+  return mask;
+}
+
+#endif
+
+static inline uint32_t group_match_full(const uint8_t* ctrl) {
+  return ~group_match_free(ctrl) & ((1 << TUPLE_MAP_GROUP) - 1);
 }
 
+// 7 bits of |hash| stored in the control byte of its slot; the other
+// bits select the first group to probe.
+static inline uint8_t hash_ctrl(uint64_t hash) {
+  return hash & 0x7F;
+}
+
+static inline uint64_t hash_pos(uint64_t hash) {
+  return hash >> 7;
+}
+
+static inline char* slot_at(const TupleMap* map, uint64_t idx) {
+  return map->slots + idx * map->slot_size;
+}
+
+// Sets the control byte of slot |idx|, as well as its mirror if it is
+// in the first group.
+static inline void set_ctrl(TupleMap* map, uint64_t idx, uint8_t c) {
+  map->ctrl[idx] = c;
+  if (idx < TUPLE_MAP_GROUP) map->ctrl[map->capacity + idx] = c;
+}
 
-// Returns the generation of |comb| in |map| if it exists at index |key|; 0 otherwise.
-int _hash_contains(HashMap map, Comb* comb, int comb_len, unsigned int key) {
-  HashNode* curr = map.content[key];
-  Comb* sorted_comb;
-  int is_sorted = 0;
-  while (curr != NULL) {
-    if (curr->length != comb_len) {
-      goto next;
+// A map can contain up to 7/8 of its capacity (counting the deleted
+// slots), so that probing always ends on an empty slot.
+static inline uint64_t max_load(uint64_t capacity) {
+  return capacity - capacity / 8;
+}
+
+
+/* **************************************************************** */
+/*                      Creation and resizing                       */
+/* **************************************************************** */
+
+static void alloc_tables(TupleMap* map, uint64_t capacity) {
+  map->ctrl  = malloc(capacity + TUPLE_MAP_GROUP);
+  map->slots = malloc(capacity * map->slot_size);
+  if (!map->ctrl || !map->slots) {
+    fprintf(stderr, "Cannot allocate a hash map of %lu slots of %d bytes. Exiting.\n",
+            (unsigned long)capacity, map->slot_size);
+    exit(EXIT_FAILURE);
+  }
+  memset(map->ctrl, TUPLE_MAP_EMPTY, capacity + TUPLE_MAP_GROUP);
+  map->capacity    = capacity;
+  map->count       = 0;
+  map->deleted     = 0;
+  map->growth_left = max_load(capacity);
+}
+
+TupleMap* make_tuple_map(int key_size, int value_size, TupleHash hash) {
+  TupleMap* map = malloc(sizeof(*map));
+  map->hash       = hash ? hash : tuple_map_hash;
+  map->key_size   = key_size;
+  map->value_size = value_size;
+  map->slot_size  = (key_size + value_size + 7) & ~7;
+  alloc_tables(map, TUPLE_MAP_MIN_CAPACITY);
+  return map;
+}
+
+void free_tuple_map(TupleMap* map) {
+  free(map->ctrl);
+  free(map->slots);
+  free(map);
+}
+
+void tuple_map_clear(TupleMap* map) {
+  if (map->capacity == TUPLE_MAP_MIN_CAPACITY) {
+    memset(map->ctrl, TUPLE_MAP_EMPTY, map->capacity + TUPLE_MAP_GROUP);
+    map->count       = 0;
+    map->deleted     = 0;
+    map->growth_left = max_load(map->capacity);
+  } else {
+    free(map->ctrl);
+    free(map->slots);
+    alloc_tables(map, TUPLE_MAP_MIN_CAPACITY);
+  }
+}
+
+// Returns the index of the first free slot on the probing sequence of
+// |hash|.
+static uint64_t find_free_slot(const TupleMap* map, uint64_t hash) {
+  uint64_t mask = map->capacity - 1;
+  uint64_t pos = hash_pos(hash) & mask;
+  uint64_t step = 0;
+  while (1) {
+    uint32_t free_slots = group_match_free(map->ctrl + pos);
+    if (free_slots) {
+      return (pos + __builtin_ctz(free_slots)) & mask;
     }
-    if (!is_sorted) {
-      if (is_sorted_comb(comb, comb_len)) {
-        sorted_comb = comb;
-      } else {
-        sorted_comb = alloca(comb_len * sizeof(*sorted_comb));
-        memcpy(sorted_comb, comb, comb_len * sizeof(*sorted_comb));
-        sort_comb(sorted_comb, comb_len);
+    step += TUPLE_MAP_GROUP;
+    pos = (pos + step) & mask;
+  }
+}
+
+// Moves the keys of |map| to new tables of |capacity| slots (which
+// drops the deleted slots).
+static void rehash(TupleMap* map, uint64_t capacity) {
+  uint8_t* old_ctrl = map->ctrl;
+  char* old_slots = map->slots;
+  uint64_t old_capacity = map->capacity;
+  uint64_t count = map->count;
+
+  alloc_tables(map, capacity);
+  for (uint64_t i = 0; i < old_capacity; i++) {
+    if (old_ctrl[i] & 0x80) continue;
+    char* old_slot = old_slots + i * map->slot_size;
+    uint64_t hash = tuple_map_key_hash(map, old_slot);
+    uint64_t idx = find_free_slot(map, hash);
+    set_ctrl(map, idx, hash_ctrl(hash));
+    memcpy(slot_at(map, idx), old_slot, map->slot_size);
+  }
+  map->count = count;
+  map->growth_left -= count;
+
+  free(old_ctrl);
+  free(old_slots);
+}
+
+// Returns the smallest capacity with which |count| keys fill at most
+// half of a map.
+static uint64_t capacity_for(uint64_t count) {
+  uint64_t capacity = TUPLE_MAP_MIN_CAPACITY;
+  while (max_load(capacity) / 2 < count) capacity *= 2;
+  return capacity;
+}
+
+void tuple_map_reserve(TupleMap* map, uint64_t count) {
+  if (count <= map->count + map->growth_left) return;
+  uint64_t capacity = map->capacity;
+  while (max_load(capacity) < count) capacity *= 2;
+  rehash(map, capacity);
+}
+
+// Called when |map| is full: doubles its capacity, unless it is full
+// mostly of deleted slots, in which case they are dropped.
+static void grow(TupleMap* map) {
+  if (map->count >= max_load(map->capacity) / 2) {
+    rehash(map, map->capacity * 2);
+  } else {
+    rehash(map, map->capacity);
+  }
+}
+
+
+/* **************************************************************** */
+/*                       Lookups and insertion                      */
+/* **************************************************************** */
+
+// Hash function inspired by splitmix64, on the 8-byte words of |key|.
+uint64_t tuple_map_hash(const void* key, int key_size) {
+  const unsigned char* bytes = key;
+  uint64_t hash = 0x9E3779B97F4A7C15ULL ^ key_size;
+  while (key_size > 0) {
+    uint64_t word = 0;
+    memcpy(&word, bytes, key_size >= 8 ? 8 : key_size);
+    hash = (hash ^ word) * 0xBF58476D1CE4E5B9ULL;
+    hash ^= hash >> 31;
+    bytes += 8;
+    key_size -= 8;
+  }
+  hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBULL;
+  return hash ^ (hash >> 31);
+}
+
+void* tuple_map_find_hashed(const TupleMap* map, const void* key, uint64_t hash) {
+  uint64_t mask = map->capacity - 1;
+  uint64_t pos = hash_pos(hash) & mask;
+  uint64_t step = 0;
+  uint8_t c = hash_ctrl(hash);
+  while (1) {
+    const uint8_t* group = map->ctrl + pos;
+    uint32_t matches = group_match(group, c);
+    while (matches) {
+      char* slot = slot_at(map, (pos + __builtin_ctz(matches)) & mask);
+      if (memcmp(slot, key, map->key_size) == 0) {
+        return slot;
       }
-      is_sorted = 1;
+      matches &= matches - 1;
     }
-    if (!curr->sorted) {
-      if (!is_sorted_comb(curr->comb, curr->length)) {
-        sort_comb(curr->comb, curr->length);
-      }
-      curr->sorted = 1;
+    if (group_match(group, TUPLE_MAP_EMPTY)) {
+      return NULL;
     }
-    for (int i = 0; i < comb_len; i++) {
-      if (curr->comb[i] != sorted_comb[i]) {
-        goto next;
-      }
+    step += TUPLE_MAP_GROUP;
+    pos = (pos + step) & mask;
+  }
+}
+
+void* tuple_map_find(const TupleMap* map, const void* key) {
+  return tuple_map_find_hashed(map, key, tuple_map_key_hash(map, key));
+}
+
+void* tuple_map_insert_hashed(TupleMap* map, const void* key, uint64_t hash,
+                              bool* inserted) {
+  char* slot = tuple_map_find_hashed(map, key, hash);
+  if (slot) {
+    if (inserted) *inserted = false;
+    return slot;
+  }
+
+  uint64_t idx = find_free_slot(map, hash);
+  if (map->ctrl[idx] == TUPLE_MAP_DELETED) {
+    map->deleted--;
+  } else {
+    if (map->growth_left == 0) {
+      grow(map);
+      idx = find_free_slot(map, hash);
     }
-    return curr->generation;
-
-  next:
-    curr = curr->next;
-  }
-  return 0;
-}
-
-// Returns 1 if |map| contains |comb|, 0 otherwise
-int hash_contains(HashMap map, Comb* comb, int comb_len) {
-  unsigned int key = hash_comb(comb, comb_len);
-  return _hash_contains(map, comb, comb_len, key);
-}
-
-void add_to_hash(HashMap map, Comb* comb, int comb_len, int generation) {
-  unsigned int key = hash_comb(comb, comb_len);
-  if (_hash_contains(map, comb, comb_len, key)) return;
-  Comb* comb_copy = malloc(comb_len * sizeof(*comb_copy));
-  memcpy(comb_copy, comb, comb_len * sizeof(*comb_copy));
-  HashNode* node = malloc(sizeof(*node));
-  node->length = comb_len;
-  node->sorted = 0;
-  node->comb   = comb_copy;
-  node->generation = generation;
-  node->next = map.content[key];
-  map.content[key] = node;
-}
-
-// Adds |comb| to |map|, without copying it
-void add_to_hash_no_copy(HashMap map, Comb* comb, int comb_len, int generation) {
-  unsigned int key = hash_comb(comb, comb_len);
-  HashNode* node = malloc(sizeof(*node));
-  node->length = comb_len;
-  node->sorted = 0;
-  node->comb   = comb;
-  node->generation = generation;
-  node->next = map.content[key];
-  map.content[key] = node;
-}
-
-// Adds elements from |src| into |dst|, while freeing |src| (and its content).
-// Note: this is actually pretty expensive because hashes are very
-// large... There is a tradeoff to be found between number of
-// collisions and hash size...
-void merge_hashes(HashMap dst, HashMap src) {
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* node = src.content[i];
-    while (node) {
-      if (! _hash_contains(dst, node->comb, node->length, i)) {
-        HashNode* next = node->next;
-        node->next = dst.content[i];
-        dst.content[i] = node;
-        node = next;
-      } else {
-        HashNode* next = node->next;
-        free(node->comb);
-        free(node);
-        node = next;
-      }
+    map->growth_left--;
+  }
+  set_ctrl(map, idx, hash_ctrl(hash));
+  map->count++;
+
+  slot = slot_at(map, idx);
+  memcpy(slot, key, map->key_size);
+  memset(slot + map->key_size, 0, map->slot_size - map->key_size);
+  if (inserted) *inserted = true;
+  return slot;
+}
+
+void* tuple_map_insert(TupleMap* map, const void* key, bool* inserted) {
+  return tuple_map_insert_hashed(map, key, tuple_map_key_hash(map, key), inserted);
+}
+
+void tuple_map_remove_slot(TupleMap* map, void* slot) {
+  uint64_t idx = ((char*)slot - map->slots) / map->slot_size;
+  set_ctrl(map, idx, TUPLE_MAP_DELETED);
+  map->count--;
+  map->deleted++;
+}
+
+void tuple_map_remove_if(TupleMap* map, bool (*remove)(const TupleMap* map,
+                                                        void* slot, void* data),
+                         void* data) {
+  uint64_t it = 0;
+  char* slot;
+  while ((slot = tuple_map_next(map, &it))) {
+    if (remove(map, slot, data)) {
+      tuple_map_remove_slot(map, slot);
+    }
+  }
+  // Once many keys have been removed, the map is rebuilt to drop the
+  // deleted slots, and shrunk to make iterations cheaper.
+  if (map->deleted > map->capacity / 8) {
+    rehash(map, capacity_for(map->count));
+  }
+}
+
+void* tuple_map_next(const TupleMap* map, uint64_t* it) {
+  uint64_t idx = *it;
+  while (idx < map->capacity) {
+    uint32_t full = group_match_full(map->ctrl + idx);
+    if (map->capacity - idx < TUPLE_MAP_GROUP) {
+      // Ignoring the mirror of the first group.
+      full &= (1 << (map->capacity - idx)) - 1;
+    }
+    if (full) {
+      idx += __builtin_ctz(full);
+      *it = idx + 1;
+      return slot_at(map, idx);
+    }
+    idx += TUPLE_MAP_GROUP;
+  }
+  *it = map->capacity;
+  return NULL;
+}
+
+void tuple_map_merge(TupleMap* dst, const TupleMap* src,
+                     void (*combine)(const TupleMap* map, void* dst_slot,
+                                     const void* src_slot, void* data),
+                     void* data) {
+  tuple_map_reserve(dst, dst->count + src->count);
+  uint64_t it = 0;
+  char* src_slot;
+  while ((src_slot = tuple_map_next(src, &it))) {
+    bool inserted;
+    char* dst_slot = tuple_map_insert(dst, src_slot, &inserted);
+    if (inserted) {
+      memcpy(dst_slot + dst->key_size, src_slot + src->key_size, src->value_size);
+    } else if (combine) {
+      combine(dst, dst_slot, src_slot, data);
     }
-    src.content[i] = NULL;
   }
 }
 
 
-int hash_size(HashMap map) {
-  int total = 0;
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* curr = map.content[i];
-    while (curr) {
-      total++;
-      curr = curr->next;
+/* **************************************************************** */
+/*                        Parallel insertion                        */
+/* **************************************************************** */
+
+// Each thread of tuple_map_insert_parallel inserts a range of the
+// keys. The map is reserved beforehand so that it is never resized:
+// a thread claims an empty slot by switching its control byte to
+// TUPLE_MAP_BUSY, fills it, and then publishes its control byte. A
+// thread that finds a busy slot on its probing sequence waits for it
+// to be published, since it may contain the same key.
+
+struct insert_parallel_args {
+  TupleMap* map;
+  const char* keys;
+  const char* values;
+  uint64_t begin, end; // Range of keys to insert
+  uint64_t added;      // Number of keys that the thread added
+};
+
+static bool insert_concurrent(TupleMap* map, const void* key, const void* value) {
+  uint64_t hash = tuple_map_key_hash(map, key);
+  uint64_t mask = map->capacity - 1;
+  uint64_t pos = hash_pos(hash) & mask;
+  uint64_t step = 0;
+  uint8_t c = hash_ctrl(hash);
+  while (1) {
+    for (int i = 0; i < TUPLE_MAP_GROUP; i++) {
+      uint64_t idx = (pos + i) & mask;
+      uint8_t* ctrl = &map->ctrl[idx];
+      uint8_t current = __atomic_load_n(ctrl, __ATOMIC_ACQUIRE);
+      while (1) {
+        if (current == TUPLE_MAP_BUSY) {
+          current = __atomic_load_n(ctrl, __ATOMIC_ACQUIRE);
+        } else if (current == TUPLE_MAP_EMPTY) {
+          if (__atomic_compare_exchange_n(ctrl, &current, TUPLE_MAP_BUSY, false,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+            char* slot = slot_at(map, idx);
+            memcpy(slot, key, map->key_size);
+            if (value) {
+              memcpy(slot + map->key_size, value, map->value_size);
+            } else {
+              memset(slot + map->key_size, 0, map->value_size);
+            }
+            if (idx < TUPLE_MAP_GROUP) map->ctrl[map->capacity + idx] = c;
+            __atomic_store_n(ctrl, c, __ATOMIC_RELEASE);
+            return true;
+          }
+          // |current| was updated by the failed exchange.
+        } else {
+          if (current == c && memcmp(slot_at(map, idx), key, map->key_size) == 0) {
+            return false;
+          }
+          break;
+        }
+      }
     }
+    step += TUPLE_MAP_GROUP;
+    pos = (pos + step) & mask;
   }
-  return total;
 }
 
-void free_hash(HashMap map) {
-  for (int i = 0; i < HASH_SIZE; i++) {
-    HashNode* node = map.content[i];
-    while (node) {
-      free(node->comb);
-      HashNode* next = node->next;
-      free(node);
-      node = next;
+static void* start_thread_insert_parallel(void* void_args) {
+  struct insert_parallel_args* args = void_args;
+  TupleMap* map = args->map;
+  for (uint64_t i = args->begin; i < args->end; i++) {
+    if (insert_concurrent(map, args->keys + i * map->key_size,
+                          args->values ? args->values + i * map->value_size : NULL)) {
+      args->added++;
     }
   }
-  free(map.content);
+  return NULL;
+}
+
+uint64_t tuple_map_insert_parallel(TupleMap* map, const void* keys,
+                                   const void* values, uint64_t count,
+                                   int cores) {
+  const char* key_bytes = keys;
+  const char* value_bytes = values;
+  if (cores <= 1 || count < PARALLEL_INSERT_MIN_KEYS) {
+    uint64_t added = 0;
+    for (uint64_t i = 0; i < count; i++) {
+      bool inserted;
+      char* slot = tuple_map_insert(map, key_bytes + i * map->key_size, &inserted);
+      if (inserted) {
+        added++;
+        if (values) {
+          memcpy(slot + map->key_size, value_bytes + i * map->value_size, map->value_size);
+        }
+      }
+    }
+    return added;
+  }
+
+  // Worst case: all keys are new. Deleted slots are skipped by the
+  // threads, and thus do not count as free slots.
+  tuple_map_reserve(map, map->count + map->deleted + count);
+
+  pthread_t threads[cores];
+  struct insert_parallel_args args[cores];
+  for (int i = 0; i < cores; i++) {
+    args[i] = (struct insert_parallel_args) {
+      .map = map, .keys = key_bytes, .values = value_bytes,
+      .begin = count * i / cores, .end = count * (i+1) / cores, .added = 0
+    };
+    int ret = pthread_create(&threads[i], NULL, start_thread_insert_parallel, &args[i]);
+    if (ret) {
+      fprintf(stderr, "Failed to create thread (error %d). Exiting.\n", ret);
+      exit(EXIT_FAILURE);
+    }
+  }
+  uint64_t added = 0;
+  for (int i = 0; i < cores; i++) {
+    pthread_join(threads[i], NULL);
+    added += args[i].added;
+  }
+  map->count += added;
+  map->growth_left -= added;
+  return added;
+}
+
+
+/* **************************************************************** */
+/*                          Packed tuples                           */
+/* **************************************************************** */
+
+void comb_key_pack(void* key, int key_size, const Comb* comb, int comb_len) {
+  Comb* key_comb = key;
+  key_comb[0] = comb_len;
+  memcpy(&key_comb[1], comb, comb_len * sizeof(*comb));
+  memset(&key_comb[comb_len+1], 0, key_size - (comb_len+1) * sizeof(*comb));
 }
@@ -1,37 +1,167 @@
 #pragma once
 
-// This file offers a HashMap datastructure. This HashMap is
-// implemented as an array of linked lists.
+// This file offers a generic hash map of tuples (TupleMap), on which
+// all the hash maps of IronMask are based: the failures of RPE
+// (RPE.c), the failures generated from incompressible tuples
+// (failures_from_incompr.c), and the linear combinations of the
+// dimension reduction (dimensions.c).
 //
-// In practice, we are using a few hashmaps in IronMask, but each of
-// them has it specificities, meaning that no two hashes are
-// similar. This hashmap defined in this file is not used anywhere
-// anymore, but other hashmaps are inspired by it.
+// Keys are fixed-size byte strings, stored inline in the map: packed
+// tuples (see the comb_key_* functions below), ranks of tuples, or
+// bitmaps. Each key can carry a fixed-size payload (a count, secret
+// dependencies, a pointer...), stored right after it. The map does
+// not own anything that the payloads point to.
 //
-// TODO: make this hashmap implem somewhat generic and base all hash
-// maps of IronMask on it.
+// The map uses open addressing, à la SwissTable: in addition to its
+// slots, the map has one control byte per slot, which is either
+// TUPLE_MAP_EMPTY, TUPLE_MAP_DELETED, or 7 bits of the hash of the
+// key stored in the slot. Lookups compare the control bytes of a
+// group of TUPLE_MAP_GROUP slots at once (with SSE2 when available),
+// and only compare the keys of the slots whose control byte matches.
+// Groups are probed quadratically. The map doubles its capacity when
+// it is 7/8 full, and is never smaller than TUPLE_MAP_MIN_CAPACITY.
+//
+// A TupleMap is not thread-safe, except for tuple_map_insert_parallel,
+// which inserts an array of keys using several threads.
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <stdbool.h>
 
 #include "combinations.h"
 
-typedef struct _hashnode {
-  uint8_t length;
-  uint8_t sorted; // If true, then this element is sorted, otherwire it's not
-  int generation;
-  Comb* comb;
-  struct _hashnode* next;
-} HashNode;
-
-typedef struct _hashmap {
-  HashNode** content;
-} HashMap;
-
-HashMap init_hash();
-void add_to_hash(HashMap map, Comb* comb, int comb_len, int generation);
-void add_to_hash_no_copy(HashMap map, Comb* comb, int comb_len, int generation);
-int hash_contains(HashMap map, Comb* comb, int comb_len);
-void merge_hashes(HashMap dst, HashMap src);
-int hash_size(HashMap map);
-void free_hash();
+#define TUPLE_MAP_GROUP 16
+#define TUPLE_MAP_MIN_CAPACITY 64
+
+#define TUPLE_MAP_EMPTY   ((uint8_t)0x80)
+#define TUPLE_MAP_DELETED ((uint8_t)0xFE)
+
+// A hash function for keys of |key_size| bytes. The lowest 7 bits of
+// the hash are stored in the control bytes, and the other ones select
+// the slot of the key.
+typedef uint64_t (*TupleHash)(const void* key, int key_size);
+
+typedef struct _tuple_map {
+  TupleHash hash;
+  int key_size;       // Size of the keys, in bytes
+  int value_size;     // Size of the payloads, in bytes (can be 0)
+  int slot_size;      // key_size + value_size, rounded up to 8 bytes
+  uint64_t capacity;  // Number of slots (a power of 2)
+  uint64_t count;     // Number of keys in the map
+  uint64_t deleted;   // Number of slots marked TUPLE_MAP_DELETED
+  uint64_t growth_left; // Keys that can be added before resizing
+  uint8_t* ctrl;      // capacity + TUPLE_MAP_GROUP control bytes: the
+                      // first group is mirrored at the end
+  char* slots;        // capacity * slot_size bytes
+} TupleMap;
+
+// Creates an empty map whose keys are |key_size| bytes long, each
+// with a payload of |value_size| bytes. |hash| is the hash function of
+// the keys; if it is NULL, tuple_map_hash is used.
+TupleMap* make_tuple_map(int key_size, int value_size, TupleHash hash);
+
+// Frees |map|.
+void free_tuple_map(TupleMap* map);
+
+// Removes all keys from |map|, and shrinks it back to its minimal
+// capacity.
+void tuple_map_clear(TupleMap* map);
+
+// Makes sure that |count| keys in total can be stored in |map|
+// without resizing it.
+void tuple_map_reserve(TupleMap* map, uint64_t count);
+
+// The default hash function of the keys.
+uint64_t tuple_map_hash(const void* key, int key_size);
+
+// Returns the hash of |key| in |map|. Maps with the same hash function
+// and key size can share it: it can thus be computed once to look for
+// a key in several maps (see the *_hashed functions).
+static inline uint64_t tuple_map_key_hash(const TupleMap* map, const void* key) {
+  return map->hash(key, map->key_size);
+}
+
+// Returns the slot of |key| in |map| (whose payload is at
+// tuple_map_value(map, slot)), or NULL if |map| does not contain
+// |key|. |hash| is tuple_map_key_hash(map, key).
+void* tuple_map_find_hashed(const TupleMap* map, const void* key, uint64_t hash);
+void* tuple_map_find(const TupleMap* map, const void* key);
+
+// Adds |key| to |map| if it is not already in it, and returns its
+// slot. *|inserted| (if not NULL) is set to true if |key| was added,
+// in which case its payload is set to 0. |hash| is
+// tuple_map_key_hash(map, key).
+void* tuple_map_insert_hashed(TupleMap* map, const void* key, uint64_t hash,
+                              bool* inserted);
+void* tuple_map_insert(TupleMap* map, const void* key, bool* inserted);
+
+// Removes the key of |slot| (returned by another function of this
+// file) from |map|.
+void tuple_map_remove_slot(TupleMap* map, void* slot);
+
+// Removes from |map| all keys for which |remove(slot, data)| returns
+// true.
+void tuple_map_remove_if(TupleMap* map, bool (*remove)(const TupleMap* map,
+                                                        void* slot, void* data),
+                         void* data);
+
+// Adds the keys of |src| to |dst| (which must have the same key and
+// payload sizes, and the same hash function). When a key is in both
+// maps, |combine(dst_slot, src_slot, data)| is called if it is not
+// NULL; the payload of a key only in |src| is copied.
+void tuple_map_merge(TupleMap* dst, const TupleMap* src,
+                     void (*combine)(const TupleMap* map, void* dst_slot,
+                                     const void* src_slot, void* data),
+                     void* data);
+
+// Adds to |map| the |count| keys of |keys| (stored one after the
+// other), using |cores| threads. The payloads of the keys that are
+// added are copied from |values| (|value_size| bytes per key), or set
+// to 0 if |values| is NULL; when a key appears several times, the
+// payload of one of its occurrences is kept. Returns the number of
+// keys added.
+uint64_t tuple_map_insert_parallel(TupleMap* map, const void* keys,
+                                   const void* values, uint64_t count,
+                                   int cores);
+
+// Iterates over the keys of |map|: returns the slot of the first key
+// at index *|it| or after, and sets *|it| to the index that follows,
+// or returns NULL if there are none. *|it| should be 0 initially.
+// Keys must not be added during an iteration; removing the slot that
+// was just returned (tuple_map_remove_slot) is fine.
+void* tuple_map_next(const TupleMap* map, uint64_t* it);
+
+// Returns the payload of the key stored in |slot|.
+static inline void* tuple_map_value(const TupleMap* map, const void* slot) {
+  return (char*)slot + map->key_size;
+}
+
+// Returns the number of bytes used by |map|.
+static inline uint64_t tuple_map_bytes(const TupleMap* map) {
+  return map->capacity * (map->slot_size + 1) + TUPLE_MAP_GROUP;
+}
+
+
+/* Packed tuples
+
+   A tuple of at most |max_len| elements is packed into a key of
+   comb_key_size(max_len) bytes: its length, followed by its elements,
+   followed by zeros. Tuples should be sorted, so that all
+   permutations of a tuple have the same key.
+*/
+
+static inline int comb_key_size(int max_len) {
+  return (max_len + 1) * sizeof(Comb);
+}
+
+// Packs |comb| (of length |comb_len|) into |key| (a key of
+// |key_size| bytes).
+void comb_key_pack(void* key, int key_size, const Comb* comb, int comb_len);
+
+static inline int comb_key_len(const void* key) {
+  return ((const Comb*)key)[0];
+}
+
+static inline Comb* comb_key_comb(const void* key) {
+  return (Comb*)key + 1;
+}
@@ -11,8 +11,8 @@ void delete(ListCombElem* e) {
   if (e->next) {
     e->next->prev = e->prev;
   }
-  // Not freeing e->secret_deps, because ownership is always in the trie
-  free(e);
+  // Not freeing e->secret_deps, because ownership is always in the
+  // trie. |e| itself is released with the arena of its list.
 }
 
 void delete_free_dep(ListCombElem* e) {
@@ -21,7 +21,7 @@ void delete_free_dep(ListCombElem* e) {
 }
 
 void add_with_deps(ListComb* l, Comb* arr, SecretDep* secret_deps) {
-  ListCombElem* e = malloc(sizeof(*e));
+  ListCombElem* e = arena_alloc(l->arena, sizeof(*e));
   e->comb = arr;
   e->secret_deps = secret_deps;
   e->next = l->head;
@@ -37,8 +37,7 @@ void add(ListComb* l, Comb* arr) {
 }
 
 ListComb* list_from_array(Comb** arr, uint64_t length) {
-  ListComb* l = malloc(sizeof(*l));
-  l->head = NULL;
+  ListComb* l = make_empty_list();
   for (uint64_t i = 0; i < length; i++) {
     add(l,arr[i]);
   }
@@ -48,19 +47,13 @@ ListComb* list_from_array(Comb** arr, uint64_t length) {
 ListComb* make_empty_list() {
   ListComb* l = malloc(sizeof(*l));
   l->head = NULL;
+  l->arena = make_arena("tuple_list");
   return l;
 }
 
-int free_list(ListComb* l) {
-  ListCombElem* curr = l->head;
-  int count = 0;
-  while (curr) {
-    ListCombElem* next = curr->next;
-    count++;
-    // Note: curr->comb is never owned by the list ==> not freeing it
-    free(curr);
-    curr = next;
-  }
+void free_list(ListComb* l) {
+  // Note: the combs of the elements are not owned by the list, unless
+  // they were allocated in its arena (see list_from_trie).
+  free_arena(l->arena);
   free(l);
-  return count;
 }
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <stdint.h>
 
+#include "arena.h"
 #include "combinations.h"
 
 typedef char SecretDep;
@@ -19,8 +20,11 @@ typedef struct _list_comb_elem {
   struct _list_comb_elem* prev;
 } ListCombElem;
 
+// The elements of a list are allocated in its arena, and are all
+// released by free_list (delete only unlinks an element).
 typedef struct _list_comb {
   ListCombElem* head;
+  Arena* arena;
 } ListComb;
 
 ListComb* make_empty_list();
@@ -29,4 +33,4 @@ void delete_free_dep(ListCombElem* e);
 void add_with_deps(ListComb* l, Comb* arr, SecretDep* secret_deps);
 void add(ListComb* l, Comb* arr);
 ListComb* list_from_array(Comb** arr, uint64_t length);
-int free_list(ListComb* l);
+void free_list(ListComb* l);
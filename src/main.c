@@ -29,9 +29,28 @@
 #include "CNI.h"
 #include "CRP.h"
 #include "CRPC.h"
+#include "shard.h"
+#include "checkpoint.h"
+#include "stats.h"
+#include "mem_limit.h"
+#include "spill.h"
+#include "sweep.h"
 
 #define GLITCH_OPT 1000
 #define TRANSITION_OPT 1001
+#define THREAD_REPORT_OPT 1002
+#define SHARD_OPT 1003
+#define SHARD_OUTPUT_OPT 1004
+#define CHECKPOINT_OPT 1005
+#define RESUME_OPT 1006
+#define PROGRESS_OPT 1007
+#define STATS_JSON_OPT 1008
+#define MEM_LIMIT_OPT 1009
+#define SPILL_OPT 1010
+#define SWEEP_OPT 1011
+#define SWEEP_FAULT_OPT 1012
+#define SWEEP_OUTPUT_OPT 1013
+#define CHECKPOINT_INTERVAL_OPT 1014
 
 /***********************************************************
                             Main
@@ -61,6 +80,7 @@ int is_double(char* s) {
 void usage() {
   printf("Usage:\n"
          "    ironmask [OPTIONS] [NI|SNI|freeSNI|uniformSNI|IOS|PINI|RP|RPC|RPE|cardRPC|CNI|CRP|CRPC|cardRPC] FILE\n"
+         "    ironmask merge SHARD_FILE...\n"
          "Computes the probing (NI, SNI, PINI) or random probing property (RP, RPC, RPE) or the combined fault property (CNI) for FILE\n"
          "Computes the cardinal RPC enveloppes (cardRPC) for refresh gadgets in arithmetic field.\n\n"
 
@@ -79,6 +99,42 @@ void usage() {
          "                                        not use it unless you know what you're doing)\n"
          "    --glitch                            Takes glitches into account.\n"
          "    --transition                        Takes transitions into account\n"
+         "    --thread-report                     Prints per-thread utilization statistics\n"
+         "                                        at the end of a multi-threaded verification.\n"
+         "    --shard i/N                         Only enumerates the i-th (0 <= i < N) slice of the\n"
+         "                                        tuples of each size (RP/RPC/RPE only), and saves the\n"
+         "                                        partial coefficients in a shard file. The N shard\n"
+         "                                        files are combined with 'ironmask merge'.\n"
+         "    --shard-output FILE                 Sets the shard file written by --shard\n"
+         "                                        (default: PROPERTY_shard_i_of_N.txt).\n"
+         "    --checkpoint FILE                   Periodically saves the state of the verification\n"
+         "                                        in FILE (RPE/CRP only). FILE is removed once the\n"
+         "                                        verification completes.\n"
+         "    --resume                            Resumes the verification from the checkpoint FILE\n"
+         "                                        given to --checkpoint (if it exists).\n"
+         "    --checkpoint-interval SECONDS       Sets the minimal delay between two checkpoints\n"
+         "                                        (default: 600). With 0, a checkpoint is saved every\n"
+         "                                        time the verification makes progress.\n"
+         "    --progress                          Periodically prints the progress of the enumeration\n"
+         "                                        of the tuples of each size (with an ETA) on stderr.\n"
+         "    --stats-json FILE                   Writes statistics about the verification (throughput,\n"
+         "                                        failures per size, time spent in each step, peak\n"
+         "                                        memory...) to FILE in JSON.\n"
+         "    --mem-limit SIZE                    Sets the memory budget of the verification, used to\n"
+         "                                        size the sorted runs of --spill.\n"
+         "                                        SIZE is in megabytes, or followed by K, M, G or T\n"
+         "                                        (eg, 4G). Default: half of the physical memory.\n"
+         "    --spill DIR                         Stores the failures generated from incompressible\n"
+         "                                        tuples in sorted files in DIR instead of in memory\n"
+         "                                        (arithmetic RP/RPC/RPE, constr and RP -i), using at\n"
+         "                                        most the memory budget to sort them.\n"
+         "    --sweep P0:P1:N[:log]               Evaluates the failure probability (RP) or epsilon,\n"
+         "                                        mu and gamma (CRP/CRPC, instead of -l) at N leakage\n"
+         "                                        rates from P0 to P1 (evenly spaced, or on a log\n"
+         "                                        scale with :log), and writes them as a table.\n"
+         "    --sweep-fault F0:F1:N[:log]         Same for the fault rates of CRP/CRPC (instead of -f).\n"
+         "    --sweep-output FILE                 Writes the table of --sweep to FILE (in JSON if FILE\n"
+         "                                        ends with .json, in CSV otherwise) instead of stdout.\n"
          "    -h, --help                          Prints this help information.\n\n");
 
   exit(EXIT_SUCCESS);
@@ -88,10 +144,25 @@ int main(int argc, char** argv) {
   setvbuf(stdout, NULL, _IONBF, 0);
   setlocale(LC_NUMERIC, "");
 
+  if (argc > 1 && strcmp(argv[1], "merge") == 0) {
+    merge_shards(argc - 2, &argv[2]);
+    return EXIT_SUCCESS;
+  }
+
   int verbose = 0, coeff_max = -1, t = -1, t_output = -1, opt_incompr = 0, cores = 1, k = -1;
   double pleak = -1, pfault = -1;
   bool glitch = false, transition = false;
   bool set = true;
+  int shard_index = 0, shard_count = 1;
+  char* shard_output = NULL;
+  char* checkpoint_file = NULL;
+  bool resume = false;
+  int checkpoint_interval = -1;
+  bool progress = false;
+  char* stats_json = NULL;
+  bool sweep = false, sweep_faults = false;
+  SweepRange sweep_leak, sweep_fault;
+  char* sweep_output = NULL;
   char* property = NULL;
   char* filename = NULL;
 
@@ -110,6 +181,19 @@ int main(int argc, char** argv) {
       { "incompr-opt", no_argument,       0, 'i'            },
       { "glitch",      no_argument,       0, GLITCH_OPT     },
       { "transition",  no_argument,       0, TRANSITION_OPT },
+      { "thread-report", no_argument,     0, THREAD_REPORT_OPT },
+      { "shard",       required_argument, 0, SHARD_OPT      },
+      { "shard-output", required_argument, 0, SHARD_OUTPUT_OPT },
+      { "checkpoint",  required_argument, 0, CHECKPOINT_OPT },
+      { "resume",      no_argument,       0, RESUME_OPT     },
+      { "checkpoint-interval", required_argument, 0, CHECKPOINT_INTERVAL_OPT },
+      { "progress",    no_argument,       0, PROGRESS_OPT   },
+      { "stats-json",  required_argument, 0, STATS_JSON_OPT },
+      { "mem-limit",   required_argument, 0, MEM_LIMIT_OPT  },
+      { "spill",       required_argument, 0, SPILL_OPT      },
+      { "sweep",       required_argument, 0, SWEEP_OPT      },
+      { "sweep-fault", required_argument, 0, SWEEP_FAULT_OPT },
+      { "sweep-output", required_argument, 0, SWEEP_OUTPUT_OPT },
       { 0, 0, 0, 0}
     };
 
@@ -212,6 +296,73 @@ int main(int argc, char** argv) {
       case TRANSITION_OPT:
         transition = true;
         break;
+      case THREAD_REPORT_OPT:
+        set_thread_report(true);
+        break;
+      case SHARD_OPT: {
+        char end;
+        if (sscanf(optarg, "%d/%d%c", &shard_index, &shard_count, &end) != 2 ||
+            shard_count < 1 || shard_index < 0 || shard_index >= shard_count) {
+          fprintf(stderr, "Option --shard expects i/N with 0 <= i < N. Provided: '%s'. Exiting.\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      }
+      case SHARD_OUTPUT_OPT:
+        shard_output = optarg;
+        break;
+      case CHECKPOINT_OPT:
+        checkpoint_file = optarg;
+        break;
+      case RESUME_OPT:
+        resume = true;
+        break;
+      case CHECKPOINT_INTERVAL_OPT: {
+        char end;
+        if (sscanf(optarg, "%d%c", &checkpoint_interval, &end) != 1 ||
+            checkpoint_interval < 0) {
+          fprintf(stderr, "Option --checkpoint-interval expects a number of seconds. "
+                  "Provided: '%s'. Exiting.\n", optarg);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      }
+      case PROGRESS_OPT:
+        progress = true;
+        break;
+      case STATS_JSON_OPT:
+        stats_json = optarg;
+        break;
+      case MEM_LIMIT_OPT: {
+        uint64_t mem_limit;
+        if (!parse_mem_size(optarg, &mem_limit)) {
+          fprintf(stderr, "Option --mem-limit expects a size (eg, 512M or 4G). Provided: '%s'. Exiting.\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        set_mem_limit(mem_limit);
+        break;
+      }
+      case SPILL_OPT:
+        if (access(optarg, W_OK | X_OK) != 0) {
+          fprintf(stderr, "Option --spill expects a writable directory. Provided: '%s'. Exiting.\n",
+                  optarg);
+          exit(EXIT_FAILURE);
+        }
+        set_spill_dir(optarg);
+        break;
+      case SWEEP_OPT:
+        parse_sweep_range(optarg, "--sweep", &sweep_leak);
+        sweep = true;
+        break;
+      case SWEEP_FAULT_OPT:
+        parse_sweep_range(optarg, "--sweep-fault", &sweep_fault);
+        sweep_faults = true;
+        break;
+      case SWEEP_OUTPUT_OPT:
+        sweep_output = optarg;
+        break;
       default:
         usage();
     }
@@ -291,6 +442,68 @@ int main(int argc, char** argv) {
     t_output = t;
   }
 
+  if (shard_count > 1) {
+    if ((strcmp(property, "RP")  != 0) &&
+        (strcmp(property, "RPC") != 0) &&
+        (strcmp(property, "RPE") != 0)) {
+      fprintf(stderr, "Option --shard is only supported for RP, RPC and RPE. Exiting.\n");
+      exit(EXIT_FAILURE);
+    }
+    if (opt_incompr) {
+      fprintf(stderr, "Option --shard cannot be combined with --incompr-opt. Exiting.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  if ((sweep_faults || sweep_output) && !sweep) {
+    fprintf(stderr, "Options --sweep-fault and --sweep-output require --sweep. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (sweep) {
+    if ((strcmp(property, "RP")   != 0) &&
+        (strcmp(property, "CRP")  != 0) &&
+        (strcmp(property, "CRPC") != 0)) {
+      fprintf(stderr, "Option --sweep is only supported for RP, CRP and CRPC. Exiting.\n");
+      exit(EXIT_FAILURE);
+    }
+    if (pleak != -1) {
+      fprintf(stderr, "Option --sweep cannot be combined with -l. Exiting.\n");
+      exit(EXIT_FAILURE);
+    }
+    if (strcmp(property, "RP") == 0) {
+      if (sweep_faults || pfault != -1) {
+        fprintf(stderr, "Options --sweep-fault and -f are not supported for RP. Exiting.\n");
+        exit(EXIT_FAILURE);
+      }
+      if (shard_count > 1) {
+        fprintf(stderr, "Option --sweep cannot be combined with --shard. Exiting.\n");
+        exit(EXIT_FAILURE);
+      }
+    } else if (sweep_faults == (pfault != -1)) {
+      fprintf(stderr, "Option --sweep requires either -f or --sweep-fault for %s. Exiting.\n",
+              property);
+      exit(EXIT_FAILURE);
+    }
+    set_sweep(&sweep_leak, sweep_faults ? &sweep_fault : NULL, pfault, sweep_output);
+  }
+
+  if (resume && !checkpoint_file) {
+    fprintf(stderr, "Option --resume requires --checkpoint FILE. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (checkpoint_interval != -1 && !checkpoint_file) {
+    fprintf(stderr, "Option --checkpoint-interval requires --checkpoint FILE. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (checkpoint_file) {
+    if ((strcmp(property, "RPE") != 0) &&
+        ((strcmp(property, "CRP") != 0) || (pleak != -1 && pfault != -1) || sweep)) {
+      fprintf(stderr, "Option --checkpoint is only supported for RPE and CRP (without -l/-f "
+              "or --sweep). Exiting.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+
   ParsedFile * pf = parse_file(filename);
   pf->glitch = glitch;
   pf->transition = transition;
@@ -330,6 +543,45 @@ int main(int argc, char** argv) {
     }
   }
 
+  char default_shard_output[64];
+  if (shard_count > 1) {
+    if (characteristic != 2) {
+      fprintf(stderr, "Option --shard is only supported for boolean gadgets. Exiting.\n");
+      exit(EXIT_FAILURE);
+    }
+    if (!shard_output) {
+      snprintf(default_shard_output, sizeof(default_shard_output),
+               "%s_shard_%d_of_%d.txt", property, shard_index, shard_count);
+      shard_output = default_shard_output;
+    }
+    set_shard(shard_index, shard_count, shard_output, filename);
+    printf("Shard %d/%d\n\n", shard_index, shard_count);
+  }
+
+  if (sweep && characteristic != 2) {
+    fprintf(stderr, "Option --sweep is only supported for boolean gadgets. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (checkpoint_file) {
+    if (characteristic != 2) {
+      fprintf(stderr, "Option --checkpoint is only supported for boolean gadgets. Exiting.\n");
+      exit(EXIT_FAILURE);
+    }
+    set_checkpoint(checkpoint_file, resume, filename);
+    if (checkpoint_interval != -1) {
+      set_checkpoint_interval(checkpoint_interval);
+    }
+  }
+
+  if (progress || stats_json) {
+    set_stats(progress, stats_json);
+  }
+
+  // Tuples are made of at most |circuit->deps->length| variables, and
+  // their coefficients are counted over |circuit->total_wires| wires.
+  init_binomials(circuit->deps->length > circuit->total_wires ?
+                 circuit->deps->length : circuit->total_wires);
   initialize_table_coeffs();
   time_t start, end;
   time(&start);
@@ -356,13 +608,13 @@ int main(int argc, char** argv) {
   } else if (strcmp(property, "CNI") == 0) {
     compute_CNI(pf, cores, t, k, set);
   } else if (strcmp(property, "CRP") == 0) {
-    if(pleak != -1 && pfault != -1){
+    if(sweep || (pleak != -1 && pfault != -1)){
       compute_CRP_val(pf, coeff_max, k, pleak, pfault, set);
     } else{
       compute_CRP_coeffs(pf, cores, coeff_max, k, set);
     }
   } else if (strcmp(property, "CRPC") == 0) {
-    if(pleak != -1 && pfault != -1){
+    if(sweep || (pleak != -1 && pfault != -1)){
       compute_CRPC_val(pf, coeff_max, k, t, pleak, pfault, set);
     }
     else{
@@ -377,7 +629,15 @@ int main(int argc, char** argv) {
 
   printf("\nVerification completed in %" PRIu64 " min %" PRIu64 " sec.\n",
          diff_time / 60, diff_time % 60);
+  print_thread_report();
+  write_stats_report(property, filename,
+                     cores == -1 ? CORES_TO_USE_FOR_MULTITHREADING : cores);
 
+  free_verification_resources();
+  free_stats();
+  free_sweep();
+  free_coeff_spills();
+  free_binomials();
   free_parsed_file(pf);
   free_circuit(circuit);
   return EXIT_SUCCESS;
@@ -0,0 +1,44 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include "mem_limit.h"
+#include "config.h"
+
+
+static uint64_t mem_limit = 0; // 0 if not set
+
+void set_mem_limit(uint64_t bytes) {
+  mem_limit = bytes;
+}
+
+uint64_t get_mem_limit() {
+  if (mem_limit) return mem_limit;
+  long pages = sysconf(_SC_PHYS_PAGES);
+  long page_size = sysconf(_SC_PAGE_SIZE);
+  if (pages <= 0 || page_size <= 0) {
+    // Unknown physical memory: assuming a small machine.
+    return 1ULL << 30;
+  }
+  return (uint64_t)pages * page_size / 100 * DEFAULT_MEM_LIMIT_PERCENT;
+}
+
+bool parse_mem_size(const char* str, uint64_t* bytes) {
+  char* end;
+  unsigned long long value = strtoull(str, &end, 10);
+  if (end == str || *str == '-') return false;
+  int shift;
+  switch (*end) {
+    case '\0':
+    case 'M': case 'm': shift = 20; break;
+    case 'K': case 'k': shift = 10; break;
+    case 'G': case 'g': shift = 30; break;
+    case 'T': case 't': shift = 40; break;
+    default: return false;
+  }
+  if (*end && end[1]) return false;
+  if (value == 0 || value > (UINT64_MAX >> shift)) return false;
+  *bytes = (uint64_t)value << shift;
+  return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Memory budget of a verification (--mem-limit).
+//
+// The runs of failures sorted in memory in spill mode (see spill.h)
+// are as large as this budget allows. (The other structures whose size
+// depends on the number of failures rather than on the size of the
+// circuit, such as the hash maps of failures used to compute RPE
+// coefficients, start small and grow as needed.)
+//
+// If no limit is set, the budget is DEFAULT_MEM_LIMIT_PERCENT percent
+// of the physical memory (see config.h).
+
+// Sets the memory budget to |bytes|.
+void set_mem_limit(uint64_t bytes);
+
+// Returns the memory budget, in bytes.
+uint64_t get_mem_limit();
+
+// Parses |str|, a size in megabytes, or in kilobytes, megabytes,
+// gigabytes or terabytes if it is followed by K, M, G or T (eg,
+// "512M" or "4G"). Returns false if |str| is not a valid size.
+bool parse_mem_size(const char* str, uint64_t* bytes);
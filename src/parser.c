@@ -594,28 +594,384 @@ inline void add_elem_dep(char * name, int dep_idx, Dependency d,
 }
 
 
-Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv) {
+// State shared by the computations of the dependencies of the
+// equations of a circuit (see gen_eq_dep).
+typedef struct _eq_dep_state {
+  EqList* eqs;
+  Faults* fv;
+  bool glitch;
+  bool transition;
+  DependencyList* deps;
+  int deps_size;
+  int linear_deps_size;
+  int mult_count;
+  bool* split;
+  uint64_t* fault_idx;
+  Dependency** original_deps;
+  OriginalMultPtrs** original_mult_ptrs;
+  int** temporary_mult_idx;
+  int mult_idx;        // Index of the next multiplication
+  int corr_output_idx; // Index of the next correction output
+} EqDepState;
+
+// Computes the dependency |*dep_out| of the equation |e| (at index
+// |add_idx| of the circuit), as well as its glitch/transition
+// dependencies |*dep_arr_out|. |left| and |right| are the
+// dependencies of the operands of |e|, which are at indices
+// |str_pos_left| and |str_pos_right| (-1 for constants).
+// |prev_value| is the previous value of |e->dst|, and is only used
+// with transitions.
+static void gen_eq_dep(EqDepState* s, EqListElem* e, int add_idx,
+                       DepMapElem* left, DepMapElem* right,
+                       int str_pos_left, int str_pos_right,
+                       DepMapElem* prev_value,
+                       Dependency** dep_out, DepArrVector** dep_arr_out) {
+  EqList* eqs = s->eqs;
+  Faults* fv = s->fv;
+  bool glitch = s->glitch, transition = s->transition;
+  DependencyList* deps = s->deps;
+  MultDependencyList* mult_deps = deps->mult_deps;
+  CorrectionOutputs* correction_outputs = deps->correction_outputs;
+  int deps_size = s->deps_size;
+  int linear_deps_size = s->linear_deps_size;
+  int mult_count = s->mult_count;
+  bool* split = s->split;
+  uint64_t* fault_idx = s->fault_idx;
+  Dependency** original_deps = s->original_deps;
+  OriginalMultPtrs** original_mult_ptrs = s->original_mult_ptrs;
+  int** temporary_mult_idx = s->temporary_mult_idx;
+  int mult_idx = s->mult_idx, corr_output_idx = s->corr_output_idx;
+  Dependency* dep;
+
+  split[add_idx] = false;
+  fault_idx[add_idx] = 0;
+
+  if(str_pos_left != -1){
+    split[add_idx] = split[add_idx] || split[str_pos_left];
+    fault_idx[add_idx] = fault_idx[add_idx] | fault_idx[str_pos_left];
+  }
+  if(str_pos_right != -1){
+    split[add_idx] = split[add_idx] || split[str_pos_right];
+    fault_idx[add_idx] = fault_idx[add_idx] | fault_idx[str_pos_right];
+  }
 
-  StrMap* in = pf->in;
-  StrMap* randoms = pf->randoms;
-  StrMap* out = pf->out;
-  EqList* eqs = pf->eqs;
-  int nb_duplications = pf->nb_duplications;
-  int shares = pf->shares;
+  if(!e->correction){
+    if(e->expr->op == Asgn){
+      dep = left->std_dep;
+      memcpy(original_deps[add_idx], left->original_dep, deps_size * sizeof(*original_deps[add_idx]));
+    } 
+    else if (e->expr->op == Add) {
+      dep = calloc(deps_size, sizeof(*dep));
+      for (int i = 0; i < deps_size; i++) {
+        dep[i] = left->std_dep[i] ^ right->std_dep[i];
+        original_deps[add_idx][i] = left->original_dep[i] ^ right->original_dep[i];
+      }
+    }
+    else{
+      MultDependency* mult_dep = malloc(sizeof(*mult_dep));
+      mult_dep->left_ptr  = left->std_dep;
+      mult_dep->right_ptr = right->std_dep;
+      mult_dep->name = strdup(e->dst);
+      mult_dep->name_left = strdup(e->expr->left);
+      mult_dep->name_right = strdup(e->expr->right);
+      mult_dep->contained_secrets = NULL;
+      mult_dep->idx_same_dependencies = mult_idx;
+
+      mult_deps->deps[mult_idx] = mult_dep;
+
+      dep = calloc(deps_size, sizeof(*dep));
+      dep[linear_deps_size + mult_idx] = 1;
+      original_deps[add_idx][linear_deps_size + mult_idx] = 1;
+
+      original_mult_ptrs[mult_idx]->left_original = left->original_dep;
+      original_mult_ptrs[mult_idx]->right_original = right->original_dep;
+      original_mult_ptrs[mult_idx]->idx_same_dependencies = mult_idx;
+
+      for(int k=linear_deps_size; k<linear_deps_size+mult_count; k++){
+        if(mult_dep->left_ptr[k] || mult_dep->right_ptr[k]){
+          fprintf(stderr, "Unsupported mult. variable %s. Multiplicative depth > 1. Exiting...\n", e->dst);
+          exit(EXIT_FAILURE);
+        }
+      }
+
+      temporary_mult_idx[mult_idx] = malloc(2 * sizeof(*temporary_mult_idx[mult_idx]));
+      assert((str_pos_left != -1) && (str_pos_right != -1));
+      temporary_mult_idx[mult_idx][0] = str_pos_left;
+      temporary_mult_idx[mult_idx][1] = str_pos_right;
+
+      mult_idx++;
+
+      update_same_dependencies_idx_last_mult(mult_deps, mult_idx, deps_size, original_mult_ptrs);
+
+      if(is_dep_constant(left->std_dep, deps_size)){
+        if(left->std_dep[deps_size-1]){
+          split[add_idx] = split[str_pos_right];
+        }
+        else{
+          split[add_idx] = false;
+        }
+      }
+      else if(is_dep_constant(right->std_dep, deps_size)){
+        if(right->std_dep[deps_size-1]){
+          split[add_idx] = split[str_pos_left];
+        }
+        else{
+          split[add_idx] = false;
+        }
+      }    
+    }
+  }
+  else{
+    if(e->expr->op == Asgn){
+      dep = left->std_dep;
+      memcpy(original_deps[add_idx], left->original_dep, deps_size * sizeof(*original_deps[add_idx]));
+      if(e->correction_output){
+        // fprintf(stderr, "Unsupported format for assignment correction output variable %s\n", e->dst);
+        // exit(EXIT_FAILURE);
+        handle_faulted_correction_output(eqs, fault_idx, split, 
+                                       add_idx, corr_output_idx, dep, deps,
+                                       fv, original_deps, deps_size);
+      }
+    }
+    else if (e->expr->op == Add) {
+      dep = calloc(deps_size, sizeof(*dep));
+      for (int i = 0; i < deps_size; i++) {
+        dep[i] = left->std_dep[i] ^ right->std_dep[i];
+        original_deps[add_idx][i] = left->original_dep[i] ^ right->original_dep[i];
+      }
+      if(e->correction_output){
+        handle_faulted_correction_output(eqs, fault_idx, split, 
+                                       add_idx, corr_output_idx, dep, deps,
+                                       fv, original_deps, deps_size);
+      }
+    }
+    else{
+      dep = calloc(deps_size, sizeof(*dep));
+
+      // assert(are_dep_equal(left->original_dep, right->original_dep, deps_size) ||
+      //        are_dep_equal_with_mult_original(left->original_dep, right->original_dep,
+      //        deps_size, linear_deps_size, mult_count, original_mult_ptrs));
+
+      memcpy(original_deps[add_idx], left->original_dep, deps_size * sizeof(*original_deps[add_idx]));
+
+      if(!split[add_idx]){
+        //printf("%s\n", e->dst);
+        if(are_dep_equal_with_mult(left->std_dep, right->std_dep,
+           deps_size, linear_deps_size, mult_count, mult_deps)){
+
+          memcpy(dep, left->std_dep, deps_size * sizeof(*dep));
+
+        }
+        else{
+          split[add_idx] = true;
+        }
+      }
+      else{
+        if(are_dep_equal_with_mult(left->std_dep, right->std_dep,
+           deps_size, linear_deps_size, mult_count, mult_deps)){
+
+          memcpy(dep, left->std_dep, deps_size * sizeof(*dep));
+          split[add_idx] = false;
+        }
+        else if(is_dep_constant(left->std_dep, deps_size)){
+          if(left->std_dep[deps_size-1]){
+            memcpy(dep, right->std_dep, deps_size * sizeof(*dep));
+            split[add_idx] = split[str_pos_right];
+          }
+          else{
+            memset(dep, 0, deps_size * sizeof(*dep));
+            split[add_idx] = false;
+          }
+        }
+        else if(is_dep_constant(right->std_dep, deps_size)){
+          if(right->std_dep[deps_size-1]){
+            memcpy(dep, left->std_dep, deps_size * sizeof(*dep));
+            split[add_idx] = split[str_pos_left];
+          }
+          else{
+            memset(dep, 0, deps_size * sizeof(*dep));
+            split[add_idx] = false;
+          }
+        }    
+      }
+      
+      if(e->correction_output){
+        handle_faulted_correction_output(eqs, fault_idx, split, 
+                                          add_idx, corr_output_idx, dep, deps,
+                                          fv, original_deps, deps_size);
+      }
+      
+    }
+  }
+
+  
+  // Taking glitches and transitions into account. We ignore the
+  // interaction between glitches and transitions are assume that
+  // either glitches or (exclusively) transitions are to be
+  // considered.
+  DepArrVector* dep_arr = DepArrVector_make();
+  if ((!glitch || e->anti_glitch) && (!split[add_idx])) {
+    DepArrVector_push(dep_arr, dep);
+  } else {
+    //printf("SPLITTING %s\n", e->dst);
+    for (int i = 0; i < left->glitch_trans_dep->length; i++) {
+      if (!vec_contains_dep(dep_arr, left->glitch_trans_dep->content[i], deps_size)) {
+        DepArrVector_push(dep_arr, left->glitch_trans_dep->content[i]);
+      }
+    }
+    if (right) {
+      for (int i = 0; i < right->glitch_trans_dep->length; i++) {
+        // Avoiding duplicates, which might occur if a dependency is
+        // in both operands.
+        if (!vec_contains_dep(dep_arr, right->glitch_trans_dep->content[i], deps_size)) {
+          DepArrVector_push(dep_arr, right->glitch_trans_dep->content[i]);
+        }
+      }
+    }
+  }
+  if (transition) {
+    if(fv){
+      fprintf(stderr, "Unsupported combination of transitions and faults in current implementation\n");
+      exit(EXIT_FAILURE);
+    }
+    else{
+      DepArrVector_push(dep_arr, prev_value->std_dep);
+    }
+  }
+
+  if(e->correction_output){
+    DepArrVector* dep_arr_corr = DepArrVector_make();
+
+    if(!split[add_idx]){
+      assert(!dep[deps->first_correction_idx + corr_output_idx]);
+    }
+    else{
+      assert(dep[deps->first_correction_idx + corr_output_idx]);
+      for (int i = 0; i < left->glitch_trans_dep->length; i++) {
+        if (!vec_contains_dep(dep_arr_corr, left->glitch_trans_dep->content[i], deps_size)) {
+          DepArrVector_push(dep_arr_corr, left->glitch_trans_dep->content[i]);
+        }
+      }
+      if (right) {
+        for (int i = 0; i < right->glitch_trans_dep->length; i++) {
+          if (!vec_contains_dep(dep_arr_corr, right->glitch_trans_dep->content[i], deps_size)) {
+            DepArrVector_push(dep_arr_corr, right->glitch_trans_dep->content[i]);
+          }
+        }
+      }
+    }
+
+    correction_outputs->correction_outputs_deps[corr_output_idx] = dep_arr_corr;
+    correction_outputs->correction_outputs_names[corr_output_idx] = strdup(e->dst);
+    corr_output_idx++;
+  }
+
+  if(fv){
+    for(int i=0; i<fv->length; i++){
+      if(strcmp(e->dst, fv->vars[i]->name) == 0){
+        memset(dep, 0, deps_size * sizeof(*dep));
+        dep[deps_size-1] = fv->vars[i]->set;
+
+        DepArrVector_shallow_free(dep_arr);
+        dep_arr = DepArrVector_make();
+
+        DepArrVector_push(dep_arr, dep);
+
+        split[add_idx] = false;
+        fault_idx[add_idx] |= 1ULL << i;
+
+        if(e->correction_output){
+          DepArrVector* dep_arr_corr = correction_outputs->correction_outputs_deps[corr_output_idx-1]; 
+          DepArrVector_shallow_free(dep_arr_corr);
+          correction_outputs->correction_outputs_deps[corr_output_idx-1] = DepArrVector_make();
+        }
+
+        break;
+      }
+    }
+  }
+
+  s->mult_idx        = mult_idx;
+  s->corr_output_idx = corr_output_idx;
+  *dep_out           = dep;
+  *dep_arr_out       = dep_arr;
+}
+
+// Applies the fault |f| to the dependency |dep| of an input or of a
+// random, whose glitch/transition dependencies are |dep_arr|.
+static void fault_elem_dep(FaultedVar* f, Dependency* dep, DepArrVector* dep_arr,
+                           int deps_size, int in_count, int shares) {
+  if(f->fault_on_input){
+    if(dep[0]){
+      dep[0] = 0;
+      dep[in_count+f->share] = 1ULL << f->duplicate;
+    }
+    else{
+      assert((dep[1]) && (in_count==2));
+      dep[1] = 0;
+      dep[in_count+shares+f->share] = 1ULL << f->duplicate;
+    }
+  }
+  else{
+    memset(dep, 0, deps_size * sizeof(*dep));
+    memset(dep_arr->content[0], 0, deps_size * sizeof(*dep_arr->content[0]));
+    if(f->set){
+      dep[deps_size-1] = 1;
+      dep_arr->content[0][deps_size-1] = 1;
+    }
+  }
+}
 
-  bool faults_on_inputs = false;
+static bool has_faults_on_inputs(Faults * fv) {
   if(fv){
     for(int i=0; i< fv->length; i++){
       if(fv->vars[i]->fault_on_input){
-        faults_on_inputs = true;
-        break;
+        return true;
       }
     }
   }
-  // if(faults_on_inputs){
-  //   fprintf(stderr, "There are faults on inputs, exiting...\n");
-  //   exit(EXIT_FAILURE);
-  // }
+  return false;
+}
+
+// Fault-free circuit, along with what gen_faulted_circuit needs to
+// recompute some of its rows. Unless stated otherwise, arrays are
+// indexed by the positions of the variables in the gadget, that is,
+// before the outputs are moved to the end of the circuit.
+typedef struct _circuit_layout {
+  Circuit* circuit;
+  OriginalDeps* original_deps;
+  bool* split;
+  int** temporary_mult_idx;
+  int* row_of;     // Index in |circuit->deps| of each position
+  int* left_pos;   // Positions of the operands of each equation
+  int* right_pos;  // (-1 for constants)
+  int first_eq_idx; // Position of the first equation
+  DepMapElem constants[2]; // Dependencies of "0" and "1"
+  StrMap* positions; // Position of each variable
+} CircuitLayout;
+
+struct _circuit_base {
+  ParsedFile* pf;
+  bool glitch;
+  bool transition;
+  CircuitLayout* layouts[2]; // Without and with faults on inputs
+                             // (built when first needed)
+};
+
+
+// Generates the circuit of |pf| (see gen_circuit). If |layout| is not
+// NULL, it is filled with what gen_faulted_circuit needs to derive
+// faulty variants of the circuit.
+static Circuit* build_circuit(ParsedFile * pf, bool glitch, bool transition,
+                              Faults * fv, bool faults_on_inputs,
+                              CircuitLayout* layout) {
+
+  StrMap* in = pf->in;
+  StrMap* randoms = pf->randoms;
+  StrMap* out = pf->out;
+  EqList* eqs = pf->eqs;
+  int nb_duplications = pf->nb_duplications;
+  int shares = pf->shares;
 
   Circuit* c = malloc(sizeof(*c));
 
@@ -623,7 +979,7 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
 
   int mult_count = count_mults(eqs);
   int correction_outputs_count = count_correction_outputs(eqs);
-  int linear_deps_size = in->next_val 
+  int linear_deps_size = in->next_val
                          + (faults_on_inputs ? in->next_val * shares : 0)
                          + randoms->next_val;
 
@@ -654,6 +1010,7 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
   deps->deps           = malloc(deps->length * sizeof(*deps->deps));
   deps->deps_exprs     = malloc(deps->length * sizeof(*deps->deps_exprs));
   deps->names          = malloc(deps->length * sizeof(*deps->names));
+  deps->shared_rows    = NULL;
   deps->mult_deps      = mult_deps;
 
   CorrectionOutputs * correction_outputs = malloc(sizeof(*correction_outputs));
@@ -670,13 +1027,18 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
   OriginalDeps * orig_deps_struct = init_original_deps(deps->length, mult_count, deps_size);
   Dependency ** original_deps = orig_deps_struct->original_deps;
   OriginalMultPtrs ** original_mult_ptrs = orig_deps_struct->original_mult_ptrs;
-   
+
   DepMap* deps_map = make_dep_map("Dependencies");
 
   int* weights = calloc(deps->length, sizeof(*weights));
   StrMap* positions_map = make_str_map("Positions");
 
-  int add_idx = 0, mult_idx = 0, corr_output_idx = 0;
+  if (layout) {
+    layout->left_pos  = malloc(deps->length * sizeof(*layout->left_pos));
+    layout->right_pos = malloc(deps->length * sizeof(*layout->right_pos));
+  }
+
+  int add_idx = 0;
 
   // Initializing "0" and "1" dependencies
   for(int i=0; i<2; i++){
@@ -686,6 +1048,11 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
     dep[deps_size-1] = i;
     DepArrVector* dep_arr = DepArrVector_make();
     dep_map_add(deps_map, name, dep, dep_arr, dep);
+    if (layout) {
+      layout->constants[i].std_dep          = dep;
+      layout->constants[i].glitch_trans_dep = dep_arr;
+      layout->constants[i].original_dep     = dep;
+    }
   }
 
   // Initializing dependencies with inputs
@@ -726,285 +1093,48 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
         int idx = str_map_get(positions_map, fv->vars[i]->name);
         split[idx] = false;
         fault_idx[idx] = 1ULL << i;
-
-        if(fv->vars[i]->fault_on_input){
-          if(deps->deps_exprs[idx][0]){
-            deps->deps_exprs[idx][0] = 0;
-            deps->deps_exprs[idx][in->next_val+fv->vars[i]->share] = 1ULL << fv->vars[i]->duplicate;
-          }
-          else{
-            assert((deps->deps_exprs[idx][1]) && (in->next_val==2));
-            deps->deps_exprs[idx][1] = 0;
-            deps->deps_exprs[idx][in->next_val+shares+fv->vars[i]->share] = 1ULL << fv->vars[i]->duplicate;
-          }
-        }
-        else{
-          memset(deps->deps_exprs[idx], 0, deps_size * sizeof(*deps->deps_exprs[idx]));
-          memset(deps->deps[idx]->content[0], 0, deps_size * sizeof(*deps->deps[idx]->content[0]));
-          if(fv->vars[i]->set){
-            deps->deps_exprs[idx][deps_size-1] = 1;
-            deps->deps[idx]->content[0][deps_size-1] = 1;
-          }
-        }
+        fault_elem_dep(fv->vars[i], deps->deps_exprs[idx], deps->deps[idx],
+                       deps_size, in->next_val, shares);
       }
     }
   }
 
+  EqDepState state = {
+    .eqs                = eqs,
+    .fv                 = fv,
+    .glitch             = glitch,
+    .transition         = transition,
+    .deps               = deps,
+    .deps_size          = deps_size,
+    .linear_deps_size   = linear_deps_size,
+    .mult_count         = mult_count,
+    .split              = split,
+    .fault_idx          = fault_idx,
+    .original_deps      = original_deps,
+    .original_mult_ptrs = original_mult_ptrs,
+    .temporary_mult_idx = temporary_mult_idx,
+    .mult_idx           = 0,
+    .corr_output_idx    = 0
+  };
+  int first_eq_idx = add_idx;
+
   // Adding dependencies of other instructions
-  for (EqListElem* e = eqs->head; e != NULL; e = e->next, add_idx++) {    
+  for (EqListElem* e = eqs->head; e != NULL; e = e->next, add_idx++) {
     Dependency* dep;
+    DepArrVector* dep_arr;
     DepMapElem* left  = dep_map_get(deps_map, e->expr->left);
     DepMapElem* right = e->expr->op != Asgn ? dep_map_get(deps_map, e->expr->right) : NULL;
-    split[add_idx] = false;
-    fault_idx[add_idx] = 0;
+    DepMapElem* prev_value = transition ? dep_map_get(deps_map, e->dst) : NULL;
 
     int str_pos_left = str_map_contains(positions_map, e->expr->left) ? str_map_get(positions_map, e->expr->left) : -1;
     int str_pos_right = (right != NULL) ? (str_map_contains(positions_map, e->expr->right) ? str_map_get(positions_map, e->expr->right) : -1) : -1;
-    if(str_pos_left != -1){
-      split[add_idx] = split[add_idx] || split[str_pos_left];
-      fault_idx[add_idx] = fault_idx[add_idx] | fault_idx[str_pos_left];
-    }
-    if(str_pos_right != -1){
-      split[add_idx] = split[add_idx] || split[str_pos_right];
-      fault_idx[add_idx] = fault_idx[add_idx] | fault_idx[str_pos_right];
-    }
-
-    if(!e->correction){
-      if(e->expr->op == Asgn){
-        dep = left->std_dep;
-        memcpy(original_deps[add_idx], left->original_dep, deps_size * sizeof(*original_deps[add_idx]));
-      } 
-      else if (e->expr->op == Add) {
-        dep = calloc(deps_size, sizeof(*dep));
-        for (int i = 0; i < deps_size; i++) {
-          dep[i] = left->std_dep[i] ^ right->std_dep[i];
-          original_deps[add_idx][i] = left->original_dep[i] ^ right->original_dep[i];
-        }
-      }
-      else{
-        MultDependency* mult_dep = malloc(sizeof(*mult_dep));
-        mult_dep->left_ptr  = left->std_dep;
-        mult_dep->right_ptr = right->std_dep;
-        mult_dep->name = strdup(e->dst);
-        mult_dep->name_left = strdup(e->expr->left);
-        mult_dep->name_right = strdup(e->expr->right);
-        mult_dep->contained_secrets = NULL;
-        mult_dep->idx_same_dependencies = mult_idx;
-
-        mult_deps->deps[mult_idx] = mult_dep;
-
-        dep = calloc(deps_size, sizeof(*dep));
-        dep[linear_deps_size + mult_idx] = 1;
-        original_deps[add_idx][linear_deps_size + mult_idx] = 1;
-
-        original_mult_ptrs[mult_idx]->left_original = left->original_dep;
-        original_mult_ptrs[mult_idx]->right_original = right->original_dep;
-        original_mult_ptrs[mult_idx]->idx_same_dependencies = mult_idx;
-
-        for(int k=linear_deps_size; k<linear_deps_size+mult_count; k++){
-          if(mult_dep->left_ptr[k] || mult_dep->right_ptr[k]){
-            fprintf(stderr, "Unsupported mult. variable %s. Multiplicative depth > 1. Exiting...\n", e->dst);
-            exit(EXIT_FAILURE);
-          }
-        }
-
-        temporary_mult_idx[mult_idx] = malloc(2 * sizeof(*temporary_mult_idx[mult_idx]));
-        assert((str_pos_left != -1) && (str_pos_right != -1));
-        temporary_mult_idx[mult_idx][0] = str_pos_left;
-        temporary_mult_idx[mult_idx][1] = str_pos_right;
 
-        mult_idx++;
+    gen_eq_dep(&state, e, add_idx, left, right, str_pos_left, str_pos_right,
+               prev_value, &dep, &dep_arr);
 
-        update_same_dependencies_idx_last_mult(mult_deps, mult_idx, deps_size, original_mult_ptrs);
-
-        if(is_dep_constant(left->std_dep, deps_size)){
-          if(left->std_dep[deps_size-1]){
-            split[add_idx] = split[str_pos_right];
-          }
-          else{
-            split[add_idx] = false;
-          }
-        }
-        else if(is_dep_constant(right->std_dep, deps_size)){
-          if(right->std_dep[deps_size-1]){
-            split[add_idx] = split[str_pos_left];
-          }
-          else{
-            split[add_idx] = false;
-          }
-        }    
-      }
-    }
-    else{
-      if(e->expr->op == Asgn){
-        dep = left->std_dep;
-        memcpy(original_deps[add_idx], left->original_dep, deps_size * sizeof(*original_deps[add_idx]));
-        if(e->correction_output){
-          // fprintf(stderr, "Unsupported format for assignment correction output variable %s\n", e->dst);
-          // exit(EXIT_FAILURE);
-          handle_faulted_correction_output(eqs, fault_idx, split, 
-                                         add_idx, corr_output_idx, dep, deps,
-                                         fv, original_deps, deps_size);
-        }
-      }
-      else if (e->expr->op == Add) {
-        dep = calloc(deps_size, sizeof(*dep));
-        for (int i = 0; i < deps_size; i++) {
-          dep[i] = left->std_dep[i] ^ right->std_dep[i];
-          original_deps[add_idx][i] = left->original_dep[i] ^ right->original_dep[i];
-        }
-        if(e->correction_output){
-          handle_faulted_correction_output(eqs, fault_idx, split, 
-                                         add_idx, corr_output_idx, dep, deps,
-                                         fv, original_deps, deps_size);
-        }
-      }
-      else{
-        dep = calloc(deps_size, sizeof(*dep));
-
-        // assert(are_dep_equal(left->original_dep, right->original_dep, deps_size) ||
-        //        are_dep_equal_with_mult_original(left->original_dep, right->original_dep,
-        //        deps_size, linear_deps_size, mult_count, original_mult_ptrs));
-
-        memcpy(original_deps[add_idx], left->original_dep, deps_size * sizeof(*original_deps[add_idx]));
-
-        if(!split[add_idx]){
-          //printf("%s\n", e->dst);
-          if(are_dep_equal_with_mult(left->std_dep, right->std_dep,
-             deps_size, linear_deps_size, mult_count, mult_deps)){
-
-            memcpy(dep, left->std_dep, deps_size * sizeof(*dep));
-
-          }
-          else{
-            split[add_idx] = true;
-          }
-        }
-        else{
-          if(are_dep_equal_with_mult(left->std_dep, right->std_dep,
-             deps_size, linear_deps_size, mult_count, mult_deps)){
-
-            memcpy(dep, left->std_dep, deps_size * sizeof(*dep));
-            split[add_idx] = false;
-          }
-          else if(is_dep_constant(left->std_dep, deps_size)){
-            if(left->std_dep[deps_size-1]){
-              memcpy(dep, right->std_dep, deps_size * sizeof(*dep));
-              split[add_idx] = split[str_pos_right];
-            }
-            else{
-              memset(dep, 0, deps_size * sizeof(*dep));
-              split[add_idx] = false;
-            }
-          }
-          else if(is_dep_constant(right->std_dep, deps_size)){
-            if(right->std_dep[deps_size-1]){
-              memcpy(dep, left->std_dep, deps_size * sizeof(*dep));
-              split[add_idx] = split[str_pos_left];
-            }
-            else{
-              memset(dep, 0, deps_size * sizeof(*dep));
-              split[add_idx] = false;
-            }
-          }    
-        }
-        
-        if(e->correction_output){
-          handle_faulted_correction_output(eqs, fault_idx, split, 
-                                            add_idx, corr_output_idx, dep, deps,
-                                            fv, original_deps, deps_size);
-        }
-        
-      }
-    }
-
-    
-    // Taking glitches and transitions into account. We ignore the
-    // interaction between glitches and transitions are assume that
-    // either glitches or (exclusively) transitions are to be
-    // considered.
-    DepArrVector* dep_arr = DepArrVector_make();
-    if ((!glitch || e->anti_glitch) && (!split[add_idx])) {
-      DepArrVector_push(dep_arr, dep);
-    } else {
-      //printf("SPLITTING %s\n", e->dst);
-      for (int i = 0; i < left->glitch_trans_dep->length; i++) {
-        if (!vec_contains_dep(dep_arr, left->glitch_trans_dep->content[i], deps_size)) {
-          DepArrVector_push(dep_arr, left->glitch_trans_dep->content[i]);
-        }
-      }
-      if (right) {
-        for (int i = 0; i < right->glitch_trans_dep->length; i++) {
-          // Avoiding duplicates, which might occur if a dependency is
-          // in both operands.
-          if (!vec_contains_dep(dep_arr, right->glitch_trans_dep->content[i], deps_size)) {
-            DepArrVector_push(dep_arr, right->glitch_trans_dep->content[i]);
-          }
-        }
-      }
-    }
-    if (transition) {
-      DepMapElem* prev_value = dep_map_get(deps_map, e->dst);
-
-      if(fv){
-        fprintf(stderr, "Unsupported combination of transitions and faults in current implementation\n");
-        exit(EXIT_FAILURE);
-      }
-      else{
-        DepArrVector_push(dep_arr, prev_value->std_dep);
-      }
-    }
-
-    if(e->correction_output){
-      DepArrVector* dep_arr_corr = DepArrVector_make();
-
-      if(!split[add_idx]){
-        assert(!dep[deps->first_correction_idx + corr_output_idx]);
-      }
-      else{
-        assert(dep[deps->first_correction_idx + corr_output_idx]);
-        for (int i = 0; i < left->glitch_trans_dep->length; i++) {
-          if (!vec_contains_dep(dep_arr_corr, left->glitch_trans_dep->content[i], deps_size)) {
-            DepArrVector_push(dep_arr_corr, left->glitch_trans_dep->content[i]);
-          }
-        }
-        if (right) {
-          for (int i = 0; i < right->glitch_trans_dep->length; i++) {
-            if (!vec_contains_dep(dep_arr_corr, right->glitch_trans_dep->content[i], deps_size)) {
-              DepArrVector_push(dep_arr_corr, right->glitch_trans_dep->content[i]);
-            }
-          }
-        }
-      }
-
-      correction_outputs->correction_outputs_deps[corr_output_idx] = dep_arr_corr;
-      correction_outputs->correction_outputs_names[corr_output_idx] = strdup(e->dst);
-      corr_output_idx++;
-    }
-
-    if(fv){
-      for(int i=0; i<fv->length; i++){
-        if(strcmp(e->dst, fv->vars[i]->name) == 0){
-          memset(dep, 0, deps_size * sizeof(*dep));
-          dep[deps_size-1] = fv->vars[i]->set;
-
-          DepArrVector_shallow_free(dep_arr);
-          dep_arr = DepArrVector_make();
-
-          DepArrVector_push(dep_arr, dep);
-
-          split[add_idx] = false;
-          fault_idx[add_idx] |= 1ULL << i;
-
-          if(e->correction_output){
-            DepArrVector* dep_arr_corr = correction_outputs->correction_outputs_deps[corr_output_idx-1]; 
-            DepArrVector_shallow_free(dep_arr_corr);
-            correction_outputs->correction_outputs_deps[corr_output_idx-1] = DepArrVector_make();
-          }
-
-          break;
-        }
-      }
+    if (layout) {
+      layout->left_pos[add_idx]  = str_pos_left;
+      layout->right_pos[add_idx] = str_pos_right;
     }
 
     // Updating weights
@@ -1014,7 +1144,7 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
     if (e->expr->op != Asgn) {
       if(str_pos_right != -1){
         weights[str_pos_right] += weights[str_pos_right] == 0 ? 1 : 2;
-      }      
+      }
     }
 
     // Adding to deps
@@ -1057,6 +1187,12 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
     end_idx--;
   }
 
+  // Position (before moving the outputs) of each element of |deps|
+  int* positions = malloc(deps->length * sizeof(*positions));
+  for (int i = 0; i < deps->length; i++) {
+    positions[i] = i;
+  }
+
   // Finding outputs and swapping them to the end
 #define SWAP(_type, _v1, _v2) {               \
   _type _tmp = _v1;                           \
@@ -1068,6 +1204,7 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
   SWAP(DepArrVector*, deps->deps[i1], deps->deps[i2]);            \
   SWAP(Dependency*, deps->deps_exprs[i1], deps->deps_exprs[i2]);  \
   SWAP(int, weights[i1], weights[i2]);                            \
+  SWAP(int, positions[i1], positions[i2]);                        \
 }
 
   for (int i = end_idx-1; i >= 0; i--) {
@@ -1084,6 +1221,7 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
       }
     }
   }
+#undef SWAP_DEPS
 
   // Updating weights of outputs that were not used after being
   // computed (and whose weight is thus still 0)
@@ -1101,7 +1239,7 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
   c->random_count    = randoms->next_val;
   c->weights         = weights;
   c->all_shares_mask = (1 << shares) - 1;
-  c->contains_mults  = mult_idx != 0;
+  c->contains_mults  = state.mult_idx != 0;
   c->transition      = transition;
   c->glitch          = glitch;
   c->faults_on_inputs = faults_on_inputs;
@@ -1126,17 +1264,32 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
   //print_eq_full_expr(eqs, "temp204");
   //printf("\n\n");
 
-  for(int i=0; i<mult_count; i++){
-    free(temporary_mult_idx[i]);
+  if (layout) {
+    layout->circuit            = c;
+    layout->original_deps      = orig_deps_struct;
+    layout->split              = split;
+    layout->temporary_mult_idx = temporary_mult_idx;
+    layout->first_eq_idx       = first_eq_idx;
+    layout->positions          = positions_map;
+    layout->row_of             = malloc(deps->length * sizeof(*layout->row_of));
+    for (int i = 0; i < deps->length; i++) {
+      layout->row_of[positions[i]] = i;
+    }
   }
-  free(temporary_mult_idx);
-  free(split);
+  else{
+    for(int i=0; i<mult_count; i++){
+      free(temporary_mult_idx[i]);
+    }
+    free(temporary_mult_idx);
+    free(split);
+    free_original_deps(orig_deps_struct);
+    free_str_map(positions_map);
+  }
+  free(positions);
   free(fault_idx);
-  free_original_deps(orig_deps_struct);
 
 
   free_str_map(outputs_map);
-  free_str_map(positions_map);
   free_dep_map(deps_map);
 
   //exit(EXIT_FAILURE);
@@ -1145,6 +1298,320 @@ Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv)
   return c;
 }
 
+Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv) {
+  bool faults_on_inputs = has_faults_on_inputs(fv);
+  // if(faults_on_inputs){
+  //   fprintf(stderr, "There are faults on inputs, exiting...\n");
+  //   exit(EXIT_FAILURE);
+  // }
+
+  return build_circuit(pf, glitch, transition, fv, faults_on_inputs, NULL);
+}
+
+
+/* ***************************************************** */
+/*              Faulty variants of a circuit             */
+/* ***************************************************** */
+
+CircuitBase* make_circuit_base(ParsedFile * pf, bool glitch, bool transition) {
+  CircuitBase* base = malloc(sizeof(*base));
+  base->pf         = pf;
+  base->glitch     = glitch;
+  base->transition = transition;
+  base->layouts[0] = NULL;
+  base->layouts[1] = NULL;
+  return base;
+}
+
+static CircuitLayout* get_circuit_layout(CircuitBase* base, bool faults_on_inputs) {
+  CircuitLayout** layout = &base->layouts[faults_on_inputs];
+  if (!*layout) {
+    *layout = malloc(sizeof(**layout));
+    build_circuit(base->pf, base->glitch, base->transition, NULL,
+                  faults_on_inputs, *layout);
+  }
+  return *layout;
+}
+
+// The faulty circuit is derived from the fault-free one by
+// recomputing only the rows that depend on a faulty variable, as well
+// as the correction multiplications if some multiplications stop (or
+// start) having the same operands. All other rows are borrowed from
+// the base circuit.
+Circuit* gen_faulted_circuit(CircuitBase* base, Faults * fv) {
+  ParsedFile* pf = base->pf;
+
+  // With transitions, each variable depends on its previous value,
+  // and faulting an assignment would modify the row of its operand:
+  // the circuit is fully generated in these cases.
+  if (base->transition) {
+    return gen_circuit(pf, base->glitch, base->transition, fv);
+  }
+  if (fv) {
+    for (int i = 0; i < fv->length; i++) {
+      EqListElem* e = get_eq_list(pf->eqs, fv->vars[i]->name);
+      if (e && e->expr->op == Asgn) {
+        return gen_circuit(pf, base->glitch, base->transition, fv);
+      }
+    }
+  }
+
+  CircuitLayout* layout = get_circuit_layout(base, has_faults_on_inputs(fv));
+  Circuit* base_circuit = layout->circuit;
+  DependencyList* base_deps = base_circuit->deps;
+  int length     = base_deps->length;
+  int deps_size  = base_deps->deps_size;
+  int mult_count = base_deps->mult_deps->length;
+  int correction_outputs_count = base_deps->correction_outputs->length;
+  int* row_of = layout->row_of;
+
+  // Dependencies of each position, as they would be in the |deps_map|
+  // of gen_circuit.
+  Dependency** row_deps        = malloc(length * sizeof(*row_deps));
+  DepArrVector** row_dep_arrs  = malloc(length * sizeof(*row_dep_arrs));
+  Dependency** original_deps   = malloc(length * sizeof(*original_deps));
+  bool* recomputed             = calloc(length, sizeof(*recomputed));
+  bool* split                  = malloc(length * sizeof(*split));
+  uint64_t* fault_idx          = calloc(length, sizeof(*fault_idx));
+  memcpy(split, layout->split, length * sizeof(*split));
+  for (int i = 0; i < length; i++) {
+    row_deps[i]      = base_deps->deps_exprs[row_of[i]];
+    row_dep_arrs[i]  = base_deps->deps[row_of[i]];
+    original_deps[i] = layout->original_deps->original_deps[i];
+  }
+
+  // Faulting inputs and randoms (on copies of their rows)
+  if (fv) {
+    for (int i = 0; i < fv->length; i++) {
+      char* name = fv->vars[i]->name;
+      if (!str_map_contains(layout->positions, name)) continue;
+      int idx = str_map_get(layout->positions, name);
+      if (idx >= layout->first_eq_idx) continue;
+      if (!recomputed[idx]) {
+        Dependency* dep = malloc(deps_size * sizeof(*dep));
+        memcpy(dep, row_deps[idx], deps_size * sizeof(*dep));
+        row_deps[idx] = dep;
+        row_dep_arrs[idx] = DepArrVector_make();
+        DepArrVector_push(row_dep_arrs[idx], dep);
+        recomputed[idx] = true;
+      }
+      split[idx] = false;
+      fault_idx[idx] = 1ULL << i;
+      fault_elem_dep(fv->vars[i], row_deps[idx], row_dep_arrs[idx],
+                     deps_size, pf->in->next_val, pf->shares);
+    }
+  }
+
+  DependencyList* deps = malloc(sizeof(*deps));
+  *deps = *base_deps;
+  deps->deps              = malloc(length * sizeof(*deps->deps));
+  deps->deps_exprs        = malloc(length * sizeof(*deps->deps_exprs));
+  deps->names             = malloc(length * sizeof(*deps->names));
+  deps->contained_secrets = malloc(length * sizeof(*deps->contained_secrets));
+  deps->bit_deps          = malloc(length * sizeof(*deps->bit_deps));
+  deps->shared_rows       = malloc(length * sizeof(*deps->shared_rows));
+
+  MultDependencyList* mult_deps = malloc(sizeof(*mult_deps));
+  mult_deps->length = mult_count;
+  mult_deps->deps = malloc(mult_count * sizeof(*(mult_deps->deps)));
+  deps->mult_deps = mult_deps;
+
+  CorrectionOutputs * correction_outputs = malloc(sizeof(*correction_outputs));
+  *correction_outputs = *base_deps->correction_outputs;
+  if(correction_outputs_count != 0){
+    correction_outputs->correction_outputs_deps = malloc(correction_outputs_count * sizeof(*correction_outputs->correction_outputs_deps));
+    correction_outputs->correction_outputs_names = malloc(correction_outputs_count * sizeof(*correction_outputs->correction_outputs_names));
+  }
+  deps->correction_outputs = correction_outputs;
+
+  OriginalMultPtrs* mult_ptrs = malloc(mult_count * sizeof(*mult_ptrs));
+  OriginalMultPtrs** original_mult_ptrs = malloc(mult_count * sizeof(*original_mult_ptrs));
+  int** temporary_mult_idx = malloc(mult_count * sizeof(*temporary_mult_idx));
+  bool* recomputed_mults = calloc(mult_count, sizeof(*recomputed_mults));
+  for (int i = 0; i < mult_count; i++) {
+    mult_ptrs[i] = *layout->original_deps->original_mult_ptrs[i];
+    original_mult_ptrs[i] = &mult_ptrs[i];
+  }
+
+  EqDepState state = {
+    .eqs                = pf->eqs,
+    .fv                 = fv,
+    .glitch             = base->glitch,
+    .transition         = base->transition,
+    .deps               = deps,
+    .deps_size          = deps_size,
+    .linear_deps_size   = deps->first_mult_idx,
+    .mult_count         = mult_count,
+    .split              = split,
+    .fault_idx          = fault_idx,
+    .original_deps      = original_deps,
+    .original_mult_ptrs = original_mult_ptrs,
+    .temporary_mult_idx = temporary_mult_idx,
+    .mult_idx           = 0,
+    .corr_output_idx    = 0
+  };
+
+  // |mults_recomputed| is set once a multiplication has been
+  // recomputed, and |mults_changed| once the idx_same_dependencies of
+  // a multiplication differs from the base circuit.
+  bool mults_recomputed = false, mults_changed = false;
+  int add_idx = layout->first_eq_idx;
+  for (EqListElem* e = pf->eqs->head; e != NULL; e = e->next, add_idx++) {
+    int str_pos_left  = layout->left_pos[add_idx];
+    int str_pos_right = layout->right_pos[add_idx];
+    bool is_mult = (!e->correction) && (e->expr->op == Mult);
+
+    bool recompute = (str_pos_left != -1 && recomputed[str_pos_left]) ||
+                     (str_pos_right != -1 && recomputed[str_pos_right]) ||
+                     (mults_changed && e->correction && e->expr->op == Mult);
+    for (int i = 0; fv && !recompute && i < fv->length; i++) {
+      recompute = strcmp(e->dst, fv->vars[i]->name) == 0;
+    }
+
+    if (recompute) {
+      DepMapElem operands[2];
+      char* operand_names[2] = { e->expr->left, e->expr->right };
+      int operand_pos[2] = { str_pos_left, str_pos_right };
+      for (int k = 0; k < (e->expr->op != Asgn ? 2 : 1); k++) {
+        int pos = operand_pos[k];
+        if (pos == -1) {
+          operands[k] = layout->constants[strcmp(operand_names[k], "1") == 0];
+        } else {
+          operands[k].std_dep          = row_deps[pos];
+          operands[k].glitch_trans_dep = row_dep_arrs[pos];
+          operands[k].original_dep     = original_deps[pos];
+        }
+      }
+
+      original_deps[add_idx] = calloc(deps_size, sizeof(*original_deps[add_idx]));
+      gen_eq_dep(&state, e, add_idx, &operands[0],
+                 e->expr->op != Asgn ? &operands[1] : NULL,
+                 str_pos_left, str_pos_right, NULL,
+                 &row_deps[add_idx], &row_dep_arrs[add_idx]);
+      recomputed[add_idx] = true;
+      if (is_mult) {
+        recomputed_mults[state.mult_idx-1] = true;
+        mults_recomputed = true;
+      }
+    }
+    else {
+      if (is_mult) {
+        int mult_idx = state.mult_idx++;
+        MultDependency* mult_dep = malloc(sizeof(*mult_dep));
+        *mult_dep = *base_deps->mult_deps->deps[mult_idx];
+        mult_dep->name = strdup(mult_dep->name);
+        mult_dep->name_left = strdup(mult_dep->name_left);
+        mult_dep->name_right = strdup(mult_dep->name_right);
+        mult_dep->contained_secrets = NULL;
+        mult_deps->deps[mult_idx] = mult_dep;
+        temporary_mult_idx[mult_idx] = layout->temporary_mult_idx[mult_idx];
+
+        if (mults_recomputed) {
+          mult_dep->idx_same_dependencies = mult_idx;
+          original_mult_ptrs[mult_idx]->idx_same_dependencies = mult_idx;
+          update_same_dependencies_idx_last_mult(mult_deps, mult_idx+1, deps_size,
+                                                 original_mult_ptrs);
+        }
+      }
+      if (e->correction_output) {
+        int idx = state.corr_output_idx++;
+        correction_outputs->correction_outputs_deps[idx] =
+          base_deps->correction_outputs->correction_outputs_deps[idx];
+        correction_outputs->correction_outputs_names[idx] =
+          base_deps->correction_outputs->correction_outputs_names[idx];
+      }
+    }
+
+    if (is_mult) {
+      int mult_idx = state.mult_idx-1;
+      if (mult_deps->deps[mult_idx]->idx_same_dependencies !=
+          base_deps->mult_deps->deps[mult_idx]->idx_same_dependencies) {
+        mults_changed = true;
+      }
+    }
+  }
+
+  for (int i = 0; i < length; i++) {
+    int row = row_of[i];
+    deps->deps[row]       = row_dep_arrs[i];
+    deps->deps_exprs[row] = row_deps[i];
+    deps->shared_rows[row] = !recomputed[i];
+    if (recomputed[i]) {
+      deps->names[row] = strdup(base_deps->names[row]);
+    } else {
+      deps->names[row]             = base_deps->names[row];
+      deps->contained_secrets[row] = base_deps->contained_secrets[row];
+      deps->bit_deps[row]          = base_deps->bit_deps[row];
+    }
+  }
+
+  // The secrets contained in the multiplications that were not
+  // recomputed are those of the base circuit, as long as their
+  // operands are shared as well.
+  for (int i = 0; i < mult_count; i++) {
+    MultDependency* base_mult_dep = base_deps->mult_deps->deps[i];
+    if (!recomputed_mults[i] && base_mult_dep->contained_secrets &&
+        deps->shared_rows[temporary_mult_idx[i][0]] &&
+        deps->shared_rows[temporary_mult_idx[i][1]]) {
+      Dependency* contained_secrets = calloc(2, sizeof(*contained_secrets));
+      memcpy(contained_secrets, base_mult_dep->contained_secrets,
+             base_circuit->secret_count * sizeof(*contained_secrets));
+      mult_deps->deps[i]->contained_secrets = contained_secrets;
+    }
+  }
+
+  Circuit* c = malloc(sizeof(*c));
+  *c = *base_circuit;
+  c->deps    = deps;
+  c->weights = malloc(length * sizeof(*c->weights));
+  memcpy(c->weights, base_circuit->weights, length * sizeof(*c->weights));
+
+  compute_rands_usage(c);
+  compute_contained_secrets(c, temporary_mult_idx);
+  compute_bit_deps(c, temporary_mult_idx);
+  compute_total_correction_bit_deps(c);
+
+  for (int i = 0; i < mult_count; i++) {
+    if (recomputed_mults[i]) free(temporary_mult_idx[i]);
+  }
+  for (int i = layout->first_eq_idx; i < length; i++) {
+    if (recomputed[i]) free(original_deps[i]);
+  }
+  free(temporary_mult_idx);
+  free(recomputed_mults);
+  free(original_mult_ptrs);
+  free(mult_ptrs);
+  free(row_deps);
+  free(row_dep_arrs);
+  free(original_deps);
+  free(recomputed);
+  free(split);
+  free(fault_idx);
+
+  return c;
+}
+
+void free_circuit_base(CircuitBase* base) {
+  for (int i = 0; i < 2; i++) {
+    CircuitLayout* layout = base->layouts[i];
+    if (!layout) continue;
+    int mult_count = layout->circuit->deps->mult_deps->length;
+    free_circuit(layout->circuit);
+    for (int j = 0; j < mult_count; j++) {
+      free(layout->temporary_mult_idx[j]);
+    }
+    free(layout->temporary_mult_idx);
+    free_original_deps(layout->original_deps);
+    free(layout->split);
+    free(layout->row_of);
+    free(layout->left_pos);
+    free(layout->right_pos);
+    free_str_map(layout->positions);
+    free(layout);
+  }
+  free(base);
+}
+
 
 
 
@@ -1181,6 +1648,7 @@ Circuit* gen_circuit_arith (ParsedFile * pf, int characteristic){
   deps->deps           = malloc(deps->length * sizeof(*deps->deps));
   deps->deps_exprs     = malloc(deps->length * sizeof(*deps->deps_exprs));
   deps->names          = malloc(deps->length * sizeof(*deps->names));
+  deps->shared_rows    = NULL;
   deps->mult_deps      = mult_deps;
 
   OriginalDeps * orig_deps_struct = init_original_deps(deps->length, mult_count, deps_size);
@@ -8,5 +8,19 @@ ParsedFile * parse_file(char* filename);
 void free_parsed_file(ParsedFile * parsed);
 
 Circuit* gen_circuit(ParsedFile * pf, bool glitch, bool transition, Faults * fv);
+
+// Fault-free circuit of a gadget, from which faulty variants can be
+// derived by gen_faulted_circuit without regenerating the whole
+// circuit each time.
+typedef struct _circuit_base CircuitBase;
+
+CircuitBase* make_circuit_base(ParsedFile * pf, bool glitch, bool transition);
+// Equivalent to gen_circuit(pf, glitch, transition, fv), with |pf|,
+// |glitch| and |transition| those of |base|. The rows of the returned
+// circuit that do not depend on the faults are shared with |base|,
+// which must thus be freed after the circuit.
+Circuit* gen_faulted_circuit(CircuitBase* base, Faults * fv);
+void free_circuit_base(CircuitBase* base);
+
 Circuit* gen_circuit_arith(ParsedFile * pf, int characteristic);
 
@@ -0,0 +1,334 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "shard.h"
+#include "coeffs.h"
+#include "RP.h"
+#include "RPC.h"
+#include "RPE.h"
+#include "checkpoint.h"
+
+#define SHARD_FILE_MAGIC "IRONMASK-SHARD"
+#define SHARD_NAME_MAX_LEN 64
+#define SHARD_PATH_MAX_LEN 4096
+
+
+/***********************************************************
+                   Current shard settings
+ ***********************************************************/
+
+static int shard_index = 0;
+static int shard_count = 1;
+static const char* shard_output = NULL;
+static const char* shard_circuit_file = NULL;
+
+void set_shard(int index, int count, const char* output, const char* circuit_file) {
+  shard_index = index;
+  shard_count = count;
+  shard_output = output;
+  shard_circuit_file = circuit_file;
+}
+
+bool is_sharded() {
+  return shard_count > 1;
+}
+
+void get_shard(int* index, int* count) {
+  *index = shard_index;
+  *count = shard_count;
+}
+
+void get_shard_window(uint64_t total, uint64_t* start, uint64_t* end) {
+  // 128-bit products, since |total| can be close to 2^64.
+  *start = (unsigned __int128)total * shard_index / shard_count;
+  *end   = (unsigned __int128)total * (shard_index+1) / shard_count;
+}
+
+
+/***********************************************************
+                      Shard results
+ ***********************************************************/
+
+ShardResult* init_shard_result(const char* property, const Circuit* circuit,
+                               int coeff_max, int coeff_max_main_loop,
+                               int t, int t_output) {
+  ShardResult* result = malloc(sizeof(*result));
+  *result = (ShardResult) {
+    .property            = strdup(property),
+    .circuit             = strdup(shard_circuit_file ? shard_circuit_file : "-"),
+    .shard_index         = shard_index,
+    .shard_count         = shard_count,
+    .coeff_max           = coeff_max,
+    .coeff_max_main_loop = coeff_max_main_loop,
+    .t                   = t,
+    .t_output            = t_output,
+    .secret_count        = circuit->secret_count,
+    .output_count        = circuit->output_count,
+    .total_wires         = circuit->total_wires,
+    .vector_count        = 0,
+    .vector_names        = NULL,
+    .vectors             = NULL
+  };
+  return result;
+}
+
+void add_shard_vector(ShardResult* result, const char* name, const Coeff* vector) {
+  int idx = result->vector_count++;
+  result->vector_names = realloc(result->vector_names,
+                                 result->vector_count * sizeof(*result->vector_names));
+  result->vectors = realloc(result->vectors,
+                            result->vector_count * sizeof(*result->vectors));
+  result->vector_names[idx] = strdup(name);
+  result->vectors[idx] = malloc((result->total_wires+1) * sizeof(*result->vectors[idx]));
+  if (vector) {
+    copy_coeffs(result->vectors[idx], vector, result->total_wires+1);
+  } else {
+    memset(result->vectors[idx], 0,
+           (result->total_wires+1) * sizeof(*result->vectors[idx]));
+  }
+
+  // When resuming a verification that had already added this vector
+  // (and possibly freed the data it was copied from), the vector is
+  // restored from the checkpoint.
+  char checkpoint_name[32];
+  sprintf(checkpoint_name, "shard.%d", idx);
+  checkpoint_vector(checkpoint_name, result->vectors[idx], result->total_wires+1);
+}
+
+Coeff** get_shard_vectors(const ShardResult* result, const char* name, int* count) {
+  *count = 0;
+  for (int i = 0; i < result->vector_count; i++) {
+    if (strcmp(result->vector_names[i], name) == 0) {
+      while (i + *count < result->vector_count &&
+             strcmp(result->vector_names[i + *count], name) == 0) {
+        (*count)++;
+      }
+      return &result->vectors[i];
+    }
+  }
+  return NULL;
+}
+
+void write_shard_result(const ShardResult* result) {
+  FILE* f = fopen(shard_output, "w");
+  if (!f) {
+    fprintf(stderr, "Cannot open shard output file '%s'. Exiting.\n", shard_output);
+    exit(EXIT_FAILURE);
+  }
+
+  fprintf(f, "%s %d\n", SHARD_FILE_MAGIC, SHARD_FILE_VERSION);
+  fprintf(f, "property %s\n", result->property);
+  fprintf(f, "circuit %s\n", result->circuit);
+  fprintf(f, "shard %d %d\n", result->shard_index, result->shard_count);
+  fprintf(f, "coeff_max %d\n", result->coeff_max);
+  fprintf(f, "coeff_max_main_loop %d\n", result->coeff_max_main_loop);
+  fprintf(f, "t %d\n", result->t);
+  fprintf(f, "t_output %d\n", result->t_output);
+  fprintf(f, "secret_count %d\n", result->secret_count);
+  fprintf(f, "output_count %d\n", result->output_count);
+  fprintf(f, "total_wires %d\n", result->total_wires);
+  fprintf(f, "vectors %d\n", result->vector_count);
+  for (int i = 0; i < result->vector_count; i++) {
+    fprintf(f, "%s", result->vector_names[i]);
+    for (int j = 0; j <= result->total_wires; j++) {
+      fprintf(f, " ");
+      fprint_coeff(f, result->vectors[i][j]);
+    }
+    fprintf(f, "\n");
+  }
+  fprintf(f, "end\n");
+
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Error while writing shard output file '%s'. Exiting.\n", shard_output);
+    exit(EXIT_FAILURE);
+  }
+
+  printf("Results of shard %d/%d written to '%s'.\n",
+         result->shard_index, result->shard_count, shard_output);
+}
+
+void free_shard_result(ShardResult* result) {
+  for (int i = 0; i < result->vector_count; i++) {
+    checkpoint_forget(result->vectors[i]);
+    free(result->vector_names[i]);
+    free(result->vectors[i]);
+  }
+  free(result->vector_names);
+  free(result->vectors);
+  free(result->property);
+  free(result->circuit);
+  free(result);
+}
+
+static void read_error(const char* filename, const char* what) {
+  fprintf(stderr, "Invalid shard file '%s': %s. Exiting.\n", filename, what);
+  exit(EXIT_FAILURE);
+}
+
+// Reads the field |name| of the header of a shard file.
+static void read_int_field(FILE* f, const char* filename, const char* name, int* value) {
+  char key[SHARD_NAME_MAX_LEN];
+  if (fscanf(f, "%63s %d", key, value) != 2 || strcmp(key, name) != 0) {
+    char what[SHARD_NAME_MAX_LEN + 32];
+    snprintf(what, sizeof(what), "expected field '%s'", name);
+    read_error(filename, what);
+  }
+}
+
+static ShardResult* read_shard_result(const char* filename) {
+  FILE* f = fopen(filename, "r");
+  if (!f) {
+    fprintf(stderr, "Cannot open shard file '%s'. Exiting.\n", filename);
+    exit(EXIT_FAILURE);
+  }
+
+  char magic[SHARD_NAME_MAX_LEN];
+  int version;
+  if (fscanf(f, "%63s %d", magic, &version) != 2 ||
+      strcmp(magic, SHARD_FILE_MAGIC) != 0) {
+    read_error(filename, "not a shard result file");
+  }
+  if (version != SHARD_FILE_VERSION) {
+    fprintf(stderr, "Shard file '%s' has version %d, but this version of ironmask "
+            "only reads version %d. Exiting.\n", filename, version, SHARD_FILE_VERSION);
+    exit(EXIT_FAILURE);
+  }
+
+  char property[SHARD_NAME_MAX_LEN];
+  char circuit[SHARD_PATH_MAX_LEN];
+  if (fscanf(f, " property %63s", property) != 1) {
+    read_error(filename, "expected field 'property'");
+  }
+  if (fscanf(f, " circuit %4095[^\n]", circuit) != 1) {
+    read_error(filename, "expected field 'circuit'");
+  }
+
+  ShardResult* result = malloc(sizeof(*result));
+  *result = (ShardResult) {
+    .property = strdup(property),
+    .circuit  = strdup(circuit),
+    .vector_count = 0,
+    .vector_names = NULL,
+    .vectors = NULL
+  };
+
+  if (fscanf(f, " shard %d %d", &result->shard_index, &result->shard_count) != 2) {
+    read_error(filename, "expected field 'shard'");
+  }
+  read_int_field(f, filename, "coeff_max", &result->coeff_max);
+  read_int_field(f, filename, "coeff_max_main_loop", &result->coeff_max_main_loop);
+  read_int_field(f, filename, "t", &result->t);
+  read_int_field(f, filename, "t_output", &result->t_output);
+  read_int_field(f, filename, "secret_count", &result->secret_count);
+  read_int_field(f, filename, "output_count", &result->output_count);
+  read_int_field(f, filename, "total_wires", &result->total_wires);
+  int vector_count;
+  read_int_field(f, filename, "vectors", &vector_count);
+
+  if (result->shard_count < 1 || result->shard_index < 0 ||
+      result->shard_index >= result->shard_count ||
+      result->total_wires < 0 || vector_count < 0) {
+    read_error(filename, "inconsistent header");
+  }
+
+  for (int i = 0; i < vector_count; i++) {
+    char name[SHARD_NAME_MAX_LEN];
+    if (fscanf(f, "%63s", name) != 1) {
+      read_error(filename, "truncated vectors");
+    }
+    add_shard_vector(result, name, NULL);
+    for (int j = 0; j <= result->total_wires; j++) {
+      if (!fscan_coeff(f, &result->vectors[i][j])) {
+        read_error(filename, "truncated vectors");
+      }
+    }
+  }
+
+  char end[SHARD_NAME_MAX_LEN];
+  if (fscanf(f, "%63s", end) != 1 || strcmp(end, "end") != 0) {
+    read_error(filename, "missing 'end' marker");
+  }
+
+  fclose(f);
+  return result;
+}
+
+// Returns true if |a| and |b| are shards of the same verification.
+static bool same_verification(const ShardResult* a, const ShardResult* b) {
+  if (strcmp(a->property, b->property) != 0 ||
+      a->shard_count         != b->shard_count ||
+      a->coeff_max           != b->coeff_max ||
+      a->coeff_max_main_loop != b->coeff_max_main_loop ||
+      a->t                   != b->t ||
+      a->t_output            != b->t_output ||
+      a->secret_count        != b->secret_count ||
+      a->output_count        != b->output_count ||
+      a->total_wires         != b->total_wires ||
+      a->vector_count        != b->vector_count) {
+    return false;
+  }
+  for (int i = 0; i < a->vector_count; i++) {
+    if (strcmp(a->vector_names[i], b->vector_names[i]) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void merge_shards(int count, char** filenames) {
+  if (count == 0) {
+    fprintf(stderr, "No shard file to merge. Exiting.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  ShardResult* merged = read_shard_result(filenames[0]);
+  bool seen[merged->shard_count];
+  memset(seen, 0, sizeof(seen));
+  seen[merged->shard_index] = true;
+
+  for (int i = 1; i < count; i++) {
+    ShardResult* result = read_shard_result(filenames[i]);
+    if (!same_verification(merged, result)) {
+      fprintf(stderr, "Shard files '%s' and '%s' do not come from the same verification. "
+              "Exiting.\n", filenames[0], filenames[i]);
+      exit(EXIT_FAILURE);
+    }
+    if (seen[result->shard_index]) {
+      fprintf(stderr, "Shard %d/%d is provided more than once ('%s'). Exiting.\n",
+              result->shard_index, result->shard_count, filenames[i]);
+      exit(EXIT_FAILURE);
+    }
+    seen[result->shard_index] = true;
+
+    for (int j = 0; j < merged->vector_count; j++) {
+      add_coeffs(merged->vectors[j], result->vectors[j], merged->total_wires+1);
+    }
+    free_shard_result(result);
+  }
+
+  for (int i = 0; i < merged->shard_count; i++) {
+    if (!seen[i]) {
+      fprintf(stderr, "Shard %d/%d is missing. Exiting.\n", i, merged->shard_count);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  printf("Merged %d shard(s) of the %s verification of %s\n\n",
+         merged->shard_count, merged->property, merged->circuit);
+
+  if (strcmp(merged->property, "RP") == 0) {
+    merge_RP_shards(merged);
+  } else if (strcmp(merged->property, "RPC") == 0) {
+    merge_RPC_shards(merged);
+  } else if (strcmp(merged->property, "RPE") == 0) {
+    merge_RPE_shards(merged);
+  } else {
+    fprintf(stderr, "Cannot merge shards of property %s. Exiting.\n", merged->property);
+    exit(EXIT_FAILURE);
+  }
+
+  free_shard_result(merged);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "circuit.h"
+#include "coeffs.h"
+
+// Version of the format of the shard result files. It should be
+// incremented every time this format changes, so that files written
+// by an older ironmask are not silently misinterpreted when merging.
+#define SHARD_FILE_VERSION 1
+
+// Partial result of a RP/RPC/RPE verification restricted to one
+// shard. It is made of the coefficient vectors that each property
+// accumulates before combining them (eg, before taking the max over
+// the output combinations): since each tuple is enumerated by exactly
+// one shard, these vectors are summed when merging the shards.
+typedef struct _shard_result {
+  char* property;      // "RP", "RPC" or "RPE"
+  char* circuit;       // Name of the gadget file (informative only)
+  int shard_index;
+  int shard_count;
+  int coeff_max;
+  int coeff_max_main_loop;
+  int t;
+  int t_output;
+  int secret_count;
+  int output_count;
+  int total_wires;     // Each vector contains |total_wires|+1 coefficients
+  int vector_count;
+  char** vector_names; // Vectors with the same name are contiguous
+  Coeff** vectors;
+} ShardResult;
+
+// Restricts the enumerations done by find_all_failures and
+// find_first_failure to the |index|-th of |count| slices of the
+// tuples of each size. The partial results are written to |output|;
+// |circuit_file| is only recorded in this file.
+void set_shard(int index, int count, const char* output, const char* circuit_file);
+
+bool is_sharded();
+
+// Sets |index| and |count| to the current shard (0 and 1 when not
+// sharded).
+void get_shard(int* index, int* count);
+
+// Sets [|start|, |end|) to the ranks of the |total| tuples of a
+// given size that belong to the current shard.
+void get_shard_window(uint64_t total, uint64_t* start, uint64_t* end);
+
+ShardResult* init_shard_result(const char* property, const Circuit* circuit,
+                               int coeff_max, int coeff_max_main_loop,
+                               int t, int t_output);
+
+// Appends a copy of |vector| (which contains |result->total_wires|+1
+// coefficients) to |result|.
+void add_shard_vector(ShardResult* result, const char* name, const Coeff* vector);
+
+// Returns the vectors of |result| called |name|, and sets |count| to
+// their number.
+Coeff** get_shard_vectors(const ShardResult* result, const char* name, int* count);
+
+// Writes |result| to the file given to set_shard.
+void write_shard_result(const ShardResult* result);
+
+void free_shard_result(ShardResult* result);
+
+// Reads the shard result files |filenames|, checks that they are the
+// |count| shards of the same verification, sums their vectors, and
+// prints the final result of the property.
+void merge_shards(int count, char** filenames);
@@ -0,0 +1,241 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "spill.h"
+#include "mem_limit.h"
+#include "stats.h"
+
+
+static const char* spill_dir = NULL; // NULL if disabled
+
+void set_spill_dir(const char* dir) {
+  spill_dir = dir;
+}
+
+const char* get_spill_dir() {
+  return spill_dir;
+}
+
+
+/* Runs */
+
+// Creates a run with an empty file in the spill directory. The file
+// is removed right away: it remains accessible through run->file.
+static SpillRun* make_run() {
+  const char* dir = spill_dir ? spill_dir : ".";
+  size_t path_size = strlen(dir) + 32;
+  char path[path_size];
+  snprintf(path, path_size, "%s/ironmask-spill-XXXXXX", dir);
+  int fd = mkstemp(path);
+  if (fd == -1) {
+    fprintf(stderr, "Cannot create a spill file in '%s': %s. Exiting.\n",
+            dir, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  unlink(path);
+
+  SpillRun* run = malloc(sizeof(*run));
+  run->file = fdopen(fd, "w+b");
+  if (!run->file) {
+    fprintf(stderr, "Cannot open a spill file in '%s': %s. Exiting.\n",
+            dir, strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  run->io_buffer = malloc(SPILL_IO_BUFFER);
+  setvbuf(run->file, run->io_buffer, _IOFBF, SPILL_IO_BUFFER);
+  run->count = 0;
+  return run;
+}
+
+SpillRun* make_empty_spill_run() {
+  return make_run();
+}
+
+void free_spill_run(SpillRun* run) {
+  fclose(run->file);
+  free(run->io_buffer);
+  free(run);
+}
+
+static void run_write(SpillRun* run, uint128_t rank) {
+  if (fwrite(&rank, sizeof(rank), 1, run->file) != 1) {
+    fprintf(stderr, "Cannot write to a spill file: %s. Exiting.\n",
+            strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  run->count++;
+}
+
+void spill_reader_init(SpillReader* reader, SpillRun* run) {
+  reader->run = run;
+  reader->remaining = run->count;
+  if (fseek(run->file, 0, SEEK_SET) != 0) {
+    fprintf(stderr, "Cannot read a spill file: %s. Exiting.\n",
+            strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+}
+
+bool spill_read(SpillReader* reader, uint128_t* rank) {
+  if (reader->remaining == 0) return false;
+  if (fread(rank, sizeof(*rank), 1, reader->run->file) != 1) {
+    fprintf(stderr, "Cannot read a spill file: %s. Exiting.\n",
+            feof(reader->run->file) ? "unexpected end of file" : strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+  reader->remaining--;
+  return true;
+}
+
+
+/* Merging runs */
+
+typedef struct {
+  SpillReader reader;
+  uint128_t rank; // Current rank of |reader|
+} MergeInput;
+
+// Moves down the element at index |i| of the min-heap |heap| (of
+// |size| elements) to its place.
+static void sift_down(MergeInput** heap, int size, int i) {
+  while (1) {
+    int smallest = i;
+    int left = 2 * i + 1, right = 2 * i + 2;
+    if (left < size && heap[left]->rank < heap[smallest]->rank) smallest = left;
+    if (right < size && heap[right]->rank < heap[smallest]->rank) smallest = right;
+    if (smallest == i) return;
+    MergeInput* tmp = heap[i];
+    heap[i] = heap[smallest];
+    heap[smallest] = tmp;
+    i = smallest;
+  }
+}
+
+// Merges the |count| runs |runs| into a new run (without duplicates),
+// and frees them.
+static SpillRun* merge_runs(SpillRun** runs, int count) {
+  SpillRun* out = make_run();
+  MergeInput inputs[count];
+  MergeInput* heap[count];
+  int size = 0;
+  for (int i = 0; i < count; i++) {
+    spill_reader_init(&inputs[i].reader, runs[i]);
+    if (spill_read(&inputs[i].reader, &inputs[i].rank)) {
+      heap[size++] = &inputs[i];
+    }
+  }
+  for (int i = size / 2 - 1; i >= 0; i--) sift_down(heap, size, i);
+
+  bool first = true;
+  uint128_t last = 0;
+  while (size > 0) {
+    MergeInput* min = heap[0];
+    if (first || min->rank != last) {
+      run_write(out, min->rank);
+      last = min->rank;
+      first = false;
+    }
+    if (!spill_read(&min->reader, &min->rank)) {
+      heap[0] = heap[--size];
+    }
+    sift_down(heap, size, 0);
+  }
+
+  for (int i = 0; i < count; i++) free_spill_run(runs[i]);
+  fflush(out->file);
+  return out;
+}
+
+
+/* Sorter */
+
+SpillSorter* make_spill_sorter() {
+  SpillSorter* sorter = malloc(sizeof(*sorter));
+  sorter->max_buffer_capacity = get_mem_limit() / sizeof(uint128_t);
+  if (sorter->max_buffer_capacity < SPILL_MIN_BUFFER) {
+    sorter->max_buffer_capacity = SPILL_MIN_BUFFER;
+  }
+  sorter->buffer_capacity = SPILL_MIN_BUFFER;
+  sorter->buffer = malloc(sorter->buffer_capacity * sizeof(*sorter->buffer));
+  sorter->buffer_count = 0;
+  sorter->run_capacity = 8;
+  sorter->runs = malloc(sorter->run_capacity * sizeof(*sorter->runs));
+  sorter->run_count = 0;
+  sorter->added = 0;
+  return sorter;
+}
+
+static int compare_ranks(const void* a, const void* b) {
+  uint128_t x = *(const uint128_t*)a, y = *(const uint128_t*)b;
+  return (x > y) - (x < y);
+}
+
+// Sorts the buffer of |sorter|, and writes it (without duplicates) to
+// a new run.
+static void flush_buffer(SpillSorter* sorter) {
+  qsort(sorter->buffer, sorter->buffer_count, sizeof(*sorter->buffer),
+        compare_ranks);
+  SpillRun* run = make_run();
+  for (uint64_t i = 0; i < sorter->buffer_count; i++) {
+    if (i == 0 || sorter->buffer[i] != sorter->buffer[i-1]) {
+      run_write(run, sorter->buffer[i]);
+    }
+  }
+  fflush(run->file);
+  sorter->buffer_count = 0;
+
+  if (sorter->run_count == sorter->run_capacity) {
+    sorter->run_capacity *= 2;
+    sorter->runs = realloc(sorter->runs,
+                           sorter->run_capacity * sizeof(*sorter->runs));
+  }
+  sorter->runs[sorter->run_count++] = run;
+}
+
+void spill_sorter_add(SpillSorter* sorter, uint128_t rank) {
+  if (sorter->buffer_count == sorter->buffer_capacity) {
+    if (sorter->buffer_capacity < sorter->max_buffer_capacity) {
+      sorter->buffer_capacity *= 2;
+      if (sorter->buffer_capacity > sorter->max_buffer_capacity) {
+        sorter->buffer_capacity = sorter->max_buffer_capacity;
+      }
+      sorter->buffer = realloc(sorter->buffer,
+                               sorter->buffer_capacity * sizeof(*sorter->buffer));
+    } else {
+      flush_buffer(sorter);
+    }
+  }
+  sorter->buffer[sorter->buffer_count++] = rank;
+  sorter->added++;
+}
+
+SpillRun* spill_sorter_finish(SpillSorter* sorter) {
+  if (sorter->buffer_count > 0 || sorter->run_count == 0) {
+    flush_buffer(sorter);
+  }
+  free(sorter->buffer);
+  stats_record_size("spill_runs", sorter->run_count);
+
+  // Merging the runs by groups of SPILL_MERGE_WAYS, until only one
+  // is left.
+  while (sorter->run_count > 1) {
+    int merged_count = 0;
+    for (int i = 0; i < sorter->run_count; i += SPILL_MERGE_WAYS) {
+      int count = sorter->run_count - i < SPILL_MERGE_WAYS ?
+        sorter->run_count - i : SPILL_MERGE_WAYS;
+      sorter->runs[merged_count++] = count == 1 ? sorter->runs[i] :
+        merge_runs(&sorter->runs[i], count);
+    }
+    sorter->run_count = merged_count;
+  }
+
+  SpillRun* run = sorter->runs[0];
+  free(sorter->runs);
+  free(sorter);
+  return run;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "combinations.h"
+
+/* Spill mode (--spill DIR)
+
+   Instead of keeping all the failures of a given size in hash maps,
+   failures_from_incompr.c can store them on disk, in DIR, as runs:
+   files containing sorted and deduplicated ranks of tuples (see
+   num_tab_comb in failures_from_incompr.c).
+
+   The ranks generated for a size are accumulated in a buffer, as
+   large as the memory budget allows (see mem_limit.h). Each time the
+   buffer is full, it is sorted, deduplicated and written to a run.
+   Once all ranks have been generated, the runs are merged (by groups
+   of at most SPILL_MERGE_WAYS) into a single run, which is then read
+   sequentially to compute the coefficients and to generate the ranks
+   of the next size. The memory used is thus bounded by the memory
+   budget, regardless of the number of failures, at the cost of
+   sequential I/O.
+
+   The files of the runs are removed as soon as they are created, so
+   that they do not outlive the process, even if it is interrupted.
+*/
+
+// Maximal number of runs merged at once.
+#define SPILL_MERGE_WAYS 64
+
+// Size of the I/O buffer of each run, in bytes.
+#define SPILL_IO_BUFFER (1 << 16)
+
+// Minimal number of ranks sorted in memory before writing a run.
+#define SPILL_MIN_BUFFER (1 << 16)
+
+// Enables the spill mode, with runs stored in the directory |dir|.
+void set_spill_dir(const char* dir);
+
+// Returns the directory of the runs, or NULL if the spill mode is
+// disabled.
+const char* get_spill_dir();
+
+// A sorted and deduplicated sequence of ranks, stored in a file.
+typedef struct _spill_run {
+  FILE* file;
+  char* io_buffer; // SPILL_IO_BUFFER bytes
+  uint64_t count;  // Number of ranks
+} SpillRun;
+
+// Accumulates ranks, and turns them into a SpillRun.
+typedef struct _spill_sorter {
+  uint128_t* buffer;
+  uint64_t buffer_count;
+  uint64_t buffer_capacity;
+  uint64_t max_buffer_capacity;
+  SpillRun** runs;  // Runs written so far
+  int run_count;
+  int run_capacity;
+  uint64_t added;   // Number of calls to spill_sorter_add
+} SpillSorter;
+
+// Creates an empty sorter.
+SpillSorter* make_spill_sorter();
+
+// Adds |rank| to |sorter|.
+void spill_sorter_add(SpillSorter* sorter, uint128_t rank);
+
+// Returns a run containing the ranks added to |sorter| (sorted and
+// without duplicates), and frees |sorter|.
+SpillRun* spill_sorter_finish(SpillSorter* sorter);
+
+// Returns an empty run.
+SpillRun* make_empty_spill_run();
+
+// Frees |run| (and removes its file).
+void free_spill_run(SpillRun* run);
+
+// Reads the ranks of a run sequentially.
+typedef struct _spill_reader {
+  SpillRun* run;
+  uint64_t remaining;
+} SpillReader;
+
+// Starts reading |run| from its beginning. A run can only be read by
+// one reader at a time.
+void spill_reader_init(SpillReader* reader, SpillRun* run);
+
+// Reads the next rank of |reader| into *|rank|. Returns false if
+// there are no more ranks.
+bool spill_read(SpillReader* reader, uint128_t* rank);
@@ -0,0 +1,368 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+#include <locale.h>
+#include <pthread.h>
+#include <sys/resource.h>
+
+#include "stats.h"
+#include "config.h"
+
+#define STATS_MAX_SIZES 32
+
+
+/***********************************************************
+                  Current statistics settings
+ ***********************************************************/
+
+static bool enabled = false;
+static bool progress_enabled = false;
+static const char* json_file = NULL;
+static uint64_t run_start_ns;
+static uint64_t last_progress_ns; // Time of the last progress line
+
+uint64_t stats_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void set_stats(bool progress, const char* filename) {
+  enabled = true;
+  progress_enabled = progress;
+  json_file = filename;
+  run_start_ns = last_progress_ns = stats_now_ns();
+}
+
+bool stats_enabled() {
+  return enabled;
+}
+
+// Peak resident set size, in kilobytes.
+static uint64_t get_peak_rss_kb() {
+#ifdef __linux__
+  // getrusage's maximum also covers the process that exec'd ironmask
+  // (eg, a benchmark script); VmHWM only covers ironmask.
+  FILE* f = fopen("/proc/self/status", "r");
+  if (f) {
+    char line[256];
+    uint64_t peak;
+    while (fgets(line, sizeof(line), f)) {
+      if (sscanf(line, "VmHWM: %"SCNu64, &peak) == 1) {
+        fclose(f);
+        return peak;
+      }
+    }
+    fclose(f);
+  }
+#endif
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024; // Bytes on macOS
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+
+/***********************************************************
+                     Per-thread counters
+ ***********************************************************/
+
+static pthread_mutex_t threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ThreadStats* threads_head = NULL;
+static ThreadStats** threads_tail = &threads_head;
+static __thread ThreadStats* thread_stats = NULL;
+
+ThreadStats* get_thread_stats() {
+  if (!thread_stats) {
+    thread_stats = calloc(1, sizeof(*thread_stats));
+    pthread_mutex_lock(&threads_mutex);
+    *threads_tail = thread_stats;
+    threads_tail = &thread_stats->next;
+    pthread_mutex_unlock(&threads_mutex);
+  }
+  return thread_stats;
+}
+
+
+/***********************************************************
+                   Progress of enumerations
+ ***********************************************************/
+
+static int enumeration_active = 0;
+static int enumeration_comb_len;
+static uint64_t enumeration_total;
+static uint64_t enumeration_done;
+static uint64_t enumeration_start_ns;
+static pthread_mutex_t progress_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+bool stats_begin_enumeration(int comb_len, uint64_t total) {
+  if (!enabled || __atomic_exchange_n(&enumeration_active, 1, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+  enumeration_comb_len = comb_len;
+  enumeration_total = total;
+  __atomic_store_n(&enumeration_done, 0, __ATOMIC_RELAXED);
+  enumeration_start_ns = stats_now_ns();
+  return true;
+}
+
+void stats_end_enumeration() {
+  __atomic_store_n(&enumeration_active, 0, __ATOMIC_RELEASE);
+}
+
+// Prints |seconds| as 1h02m03s, 2m03s or 3s.
+static void print_duration(FILE* f, double seconds) {
+  uint64_t s = seconds;
+  if (s >= 3600) {
+    fprintf(f, "%"PRIu64"h%02"PRIu64"m%02"PRIu64"s", s / 3600, s / 60 % 60, s % 60);
+  } else if (s >= 60) {
+    fprintf(f, "%"PRIu64"m%02"PRIu64"s", s / 60, s % 60);
+  } else {
+    fprintf(f, "%"PRIu64"s", s);
+  }
+}
+
+static void print_progress(uint64_t now) {
+  uint64_t done = __atomic_load_n(&enumeration_done, __ATOMIC_RELAXED);
+  double elapsed = (now - enumeration_start_ns) * 1e-9;
+  double rate = elapsed > 0 ? done / elapsed : 0;
+
+  fprintf(stderr, "[progress] size %d: %"PRIu64"/%"PRIu64" tuples (%.1f%%), %.0f tuples/s, ETA ",
+          enumeration_comb_len, done, enumeration_total,
+          enumeration_total ? 100.0 * done / enumeration_total : 100.0, rate);
+  if (rate > 0 && done <= enumeration_total) {
+    print_duration(stderr, (enumeration_total - done) / rate);
+  } else {
+    fprintf(stderr, "?");
+  }
+  fprintf(stderr, ", peak RSS %"PRIu64" MB\n", get_peak_rss_kb() / 1024);
+}
+
+void stats_add_progress(uint64_t count) {
+  if (!__atomic_load_n(&enumeration_active, __ATOMIC_RELAXED)) return;
+  __atomic_add_fetch(&enumeration_done, count, __ATOMIC_RELAXED);
+
+  if (!progress_enabled) return;
+  uint64_t now = stats_now_ns();
+  if (now - __atomic_load_n(&last_progress_ns, __ATOMIC_RELAXED) <
+      STATS_PROGRESS_INTERVAL * 1000000000ULL) {
+    return;
+  }
+  // Only one thread prints; the others keep verifying.
+  if (pthread_mutex_trylock(&progress_mutex) != 0) return;
+  if (now - last_progress_ns >= STATS_PROGRESS_INTERVAL * 1000000000ULL) {
+    print_progress(now);
+    __atomic_store_n(&last_progress_ns, now, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&progress_mutex);
+}
+
+
+/***********************************************************
+                   Sizes of data structures
+ ***********************************************************/
+
+static pthread_mutex_t sizes_mutex = PTHREAD_MUTEX_INITIALIZER;
+static const char* size_names[STATS_MAX_SIZES];
+static uint64_t size_peaks[STATS_MAX_SIZES];
+static int size_count = 0;
+
+void stats_record_size(const char* name, uint64_t size) {
+  if (!enabled) return;
+
+  pthread_mutex_lock(&sizes_mutex);
+  int i = 0;
+  while (i < size_count && strcmp(size_names[i], name) != 0) i++;
+  if (i == size_count) {
+    if (size_count == STATS_MAX_SIZES) {
+      pthread_mutex_unlock(&sizes_mutex);
+      return;
+    }
+    size_names[size_count] = name;
+    size_peaks[size_count++] = 0;
+  }
+  if (size > size_peaks[i]) size_peaks[i] = size;
+  pthread_mutex_unlock(&sizes_mutex);
+}
+
+
+/***********************************************************
+                    Allocations in arenas
+ ***********************************************************/
+
+typedef struct _arena_totals {
+  const char* name;
+  uint64_t allocations;
+  uint64_t reused;
+  uint64_t blocks;
+  uint64_t block_bytes;
+} ArenaTotals;
+
+static pthread_mutex_t arenas_mutex = PTHREAD_MUTEX_INITIALIZER;
+static ArenaTotals arena_totals[STATS_MAX_SIZES];
+static int arena_count = 0;
+
+void stats_record_arena(const char* name, uint64_t allocations, uint64_t reused,
+                        uint64_t blocks, uint64_t block_bytes) {
+  if (!enabled) return;
+
+  pthread_mutex_lock(&arenas_mutex);
+  int i = 0;
+  while (i < arena_count && strcmp(arena_totals[i].name, name) != 0) i++;
+  if (i == arena_count) {
+    if (arena_count == STATS_MAX_SIZES) {
+      pthread_mutex_unlock(&arenas_mutex);
+      return;
+    }
+    arena_totals[arena_count++] = (ArenaTotals) { .name = name };
+  }
+  arena_totals[i].allocations += allocations;
+  arena_totals[i].reused      += reused;
+  arena_totals[i].blocks      += blocks;
+  arena_totals[i].block_bytes += block_bytes;
+  pthread_mutex_unlock(&arenas_mutex);
+}
+
+
+/***********************************************************
+                        Final report
+ ***********************************************************/
+
+// Prints |s| as a JSON string.
+static void print_json_string(FILE* f, const char* s) {
+  fputc('"', f);
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\') {
+      fprintf(f, "\\%c", *s);
+    } else if ((unsigned char)*s < 0x20) {
+      fprintf(f, "\\u%04x", *s);
+    } else {
+      fputc(*s, f);
+    }
+  }
+  fputc('"', f);
+}
+
+void write_stats_report(const char* property, const char* circuit_file, int cores) {
+  if (!enabled || !json_file) return;
+
+  FILE* f = fopen(json_file, "w");
+  if (!f) {
+    fprintf(stderr, "Cannot open statistics file '%s'. Exiting.\n", json_file);
+    exit(EXIT_FAILURE);
+  }
+
+  // main sets LC_NUMERIC to the user's locale, whose decimal
+  // separator may not be a dot.
+  char* locale = strdup(setlocale(LC_NUMERIC, NULL));
+  setlocale(LC_NUMERIC, "C");
+
+  double wall_time = (stats_now_ns() - run_start_ns) * 1e-9;
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  ThreadStats total = { 0 };
+  int thread_count = 0;
+  for (ThreadStats* t = threads_head; t; t = t->next) {
+    total.tuples             += t->tuples;
+    total.rejected_by_shares += t->rejected_by_shares;
+    total.sampled_tuples     += t->sampled_tuples;
+    total.gauss_ns           += t->gauss_ns;
+    total.fact_ns            += t->fact_ns;
+    total.callback_ns        += t->callback_ns;
+    for (int i = 0; i <= STATS_MAX_TUPLE_SIZE; i++) {
+      total.failures[i] += t->failures[i];
+    }
+    thread_count++;
+  }
+  // The timed tuples are a sample of all tuples.
+  double scale = total.sampled_tuples ? (double)total.tuples / total.sampled_tuples : 0;
+
+  fprintf(f, "{\n");
+  fprintf(f, "  \"version\": %d,\n", STATS_REPORT_VERSION);
+  fprintf(f, "  \"property\": ");
+  print_json_string(f, property);
+  fprintf(f, ",\n  \"circuit\": ");
+  print_json_string(f, circuit_file);
+  fprintf(f, ",\n");
+  fprintf(f, "  \"cores\": %d,\n", cores);
+  fprintf(f, "  \"wall_time_seconds\": %.3f,\n", wall_time);
+  fprintf(f, "  \"user_time_seconds\": %.3f,\n",
+          usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6);
+  fprintf(f, "  \"system_time_seconds\": %.3f,\n",
+          usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6);
+  fprintf(f, "  \"peak_rss_kb\": %"PRIu64",\n", get_peak_rss_kb());
+  fprintf(f, "  \"tuples_checked\": %"PRIu64",\n", total.tuples);
+  fprintf(f, "  \"tuples_per_second\": %.0f,\n", wall_time > 0 ? total.tuples / wall_time : 0);
+  fprintf(f, "  \"tuples_rejected_by_share_count\": %"PRIu64",\n", total.rejected_by_shares);
+
+  fprintf(f, "  \"failures_per_size\": {");
+  bool first = true;
+  for (int i = 0; i <= STATS_MAX_TUPLE_SIZE; i++) {
+    if (!total.failures[i]) continue;
+    fprintf(f, "%s\"%d\": %"PRIu64, first ? " " : ", ", i, total.failures[i]);
+    first = false;
+  }
+  fprintf(f, "%s},\n", first ? "" : " ");
+
+  fprintf(f, "  \"sampled_tuples\": %"PRIu64",\n", total.sampled_tuples);
+  fprintf(f, "  \"estimated_time_seconds\": { \"gauss\": %.3f, \"factorization\": %.3f, "
+          "\"callbacks\": %.3f },\n",
+          total.gauss_ns * scale * 1e-9, total.fact_ns * scale * 1e-9,
+          total.callback_ns * scale * 1e-9);
+
+  fprintf(f, "  \"peak_sizes\": {");
+  for (int i = 0; i < size_count; i++) {
+    fprintf(f, "%s\"%s\": %"PRIu64, i ? ", " : " ", size_names[i], size_peaks[i]);
+  }
+  fprintf(f, "%s},\n", size_count ? " " : "");
+
+  // The number of mallocs that the arenas saved is the difference
+  // between their allocations and their blocks.
+  fprintf(f, "  \"arenas\": {");
+  for (int i = 0; i < arena_count; i++) {
+    fprintf(f, "%s\n    \"%s\": { \"allocations\": %"PRIu64", \"reused\": %"PRIu64", "
+            "\"blocks\": %"PRIu64", \"block_bytes\": %"PRIu64" }",
+            i ? "," : "", arena_totals[i].name, arena_totals[i].allocations,
+            arena_totals[i].reused, arena_totals[i].blocks, arena_totals[i].block_bytes);
+  }
+  fprintf(f, "%s},\n", arena_count ? "\n  " : "");
+
+  fprintf(f, "  \"threads\": [");
+  int idx = 0;
+  for (ThreadStats* t = threads_head; t; t = t->next, idx++) {
+    double busy = t->busy_ns * 1e-9;
+    fprintf(f, "%s\n    { \"tuples\": %"PRIu64", \"busy_seconds\": %.3f, "
+            "\"tuples_per_second\": %.0f }",
+            idx ? "," : "", t->tuples, busy, busy > 0 ? t->tuples / busy : 0);
+  }
+  fprintf(f, "%s]\n", thread_count ? "\n  " : "");
+  fprintf(f, "}\n");
+
+  setlocale(LC_NUMERIC, locale);
+  free(locale);
+
+  if (fclose(f) != 0) {
+    fprintf(stderr, "Error while writing statistics file '%s'. Exiting.\n", json_file);
+    exit(EXIT_FAILURE);
+  }
+  printf("Statistics written to '%s'.\n", json_file);
+}
+
+void free_stats() {
+  ThreadStats* t = threads_head;
+  while (t) {
+    ThreadStats* next = t->next;
+    free(t);
+    t = next;
+  }
+  threads_head = NULL;
+  threads_tail = &threads_head;
+  thread_stats = NULL;
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Version of the format of the JSON statistics report. It should be
+// incremented every time a field is renamed or removed, so that
+// scripts comparing reports can detect it.
+#define STATS_REPORT_VERSION 1
+
+// Failures of tuples larger than this are counted with the tuples of
+// size STATS_MAX_TUPLE_SIZE.
+#define STATS_MAX_TUPLE_SIZE 64
+
+// Number of tuples that _verify_tuples checks between two calls to
+// stats_add_progress (a power of 2).
+#define STATS_PROGRESS_BATCH 4096
+
+/* Run statistics
+
+   When enabled (--progress or --stats-json), _verify_tuples counts
+   the tuples it checks, the ones it rejects because they do not
+   contain enough shares, and the failures it finds. It also samples
+   the time spent in the Gaussian eliminations, in the factorization
+   of the multiplications and in the failure callbacks: one tuple out
+   of STATS_TIMING_PERIOD (see config.h) is timed, and the totals are
+   extrapolated from those samples, which keeps the overhead low.
+
+   The enumerations of the tuples of a given size done by
+   _verify_tuples_parallel are tracked to print progress lines (with
+   an ETA) every STATS_PROGRESS_INTERVAL seconds.
+
+   When disabled, the only overhead is a test per call to
+   _verify_tuples.
+*/
+
+// Counters of a thread. Each thread only updates its own counters,
+// which are summed when printing the report.
+typedef struct _thread_stats {
+  uint64_t tuples;             // Tuples checked
+  uint64_t rejected_by_shares; // Tuples with too few shares to be failures
+  uint64_t failures[STATS_MAX_TUPLE_SIZE+1]; // Failures found, by tuple size
+  uint64_t busy_ns;            // Time spent in top-level calls to _verify_tuples
+  uint64_t sampled_tuples;     // Tuples whose verification was timed
+  uint64_t gauss_ns;           // Timed Gaussian eliminations
+  uint64_t fact_ns;            // Timed factorizations
+  uint64_t callback_ns;        // Timed failure callbacks
+  struct _thread_stats* next;  // Next thread in the list of all threads
+} ThreadStats;
+
+// Enables the statistics: progress lines are printed (on stderr) if
+// |progress| is true, and the final report is written to |json_file|
+// (if not NULL) by write_stats_report.
+void set_stats(bool progress, const char* json_file);
+
+bool stats_enabled();
+
+// Returns the counters of the calling thread (allocated on first use).
+ThreadStats* get_thread_stats();
+
+// Monotonic time in nanoseconds.
+uint64_t stats_now_ns();
+
+// Adds the time elapsed since |*start| to |*counter|, and restarts
+// |*start| from now.
+static inline void stats_lap(uint64_t* counter, uint64_t* start) {
+  uint64_t now = stats_now_ns();
+  *counter += now - *start;
+  *start = now;
+}
+
+// Starts tracking the enumeration of |total| tuples of size
+// |comb_len|. Returns false if another enumeration is already being
+// tracked (eg, a nested verification in a failure callback), in which
+// case stats_end_enumeration should not be called.
+bool stats_begin_enumeration(int comb_len, uint64_t total);
+void stats_end_enumeration();
+
+// Records that |count| more tuples of the tracked enumeration have
+// been checked, and prints a progress line if one is due.
+void stats_add_progress(uint64_t count);
+
+// Records that the data structure |name| (a trie, a hash map...)
+// contained |size| elements; the report contains the maximum size
+// seen for each name.
+void stats_record_size(const char* name, uint64_t size);
+
+// Adds the counters of an arena named |name| (see arena.h) to the
+// totals of the arenas of that name: |allocations| allocations, of
+// which |reused| reused a chunk that had been given back, served by
+// |blocks| blocks of |block_bytes| bytes in total.
+void stats_record_arena(const char* name, uint64_t allocations, uint64_t reused,
+                        uint64_t blocks, uint64_t block_bytes);
+
+// Writes the JSON report to the file given to set_stats (if any).
+// |property| and |circuit_file| are only recorded in the report.
+void write_stats_report(const char* property, const char* circuit_file, int cores);
+
+void free_stats();
@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <locale.h>
+
+#include "sweep.h"
+#include "coeffs.h"
+
+
+static bool enabled = false;
+static double* leak_rates;
+static int leak_count;
+static double* fault_rates;
+static int fault_count;
+static const char* output_file; // NULL for stdout
+
+void parse_sweep_range(const char* spec, const char* option, SweepRange* range) {
+  char scale[8] = { 0 };
+  int end = 0;
+  int matched = sscanf(spec, "%lf:%lf:%d%n:%7s%n", &range->first, &range->last,
+                       &range->steps, &end, scale, &end);
+  range->log = matched == 4 && strcmp(scale, "log") == 0;
+  if ((matched != 3 && !range->log) || spec[end] != '\0' ||
+      range->steps < 1 || range->first < 0 || range->last > 1 ||
+      range->first > range->last || (range->log && range->first == 0)) {
+    fprintf(stderr, "Option %s expects FIRST:LAST:STEPS or FIRST:LAST:STEPS:log, "
+            "with 0 <= FIRST <= LAST <= 1 (FIRST > 0 with log) and STEPS >= 1. "
+            "Provided: '%s'. Exiting.\n", option, spec);
+    exit(EXIT_FAILURE);
+  }
+}
+
+// Returns the |range->steps| probabilities of |range|.
+static double* range_points(const SweepRange* range) {
+  double* points = malloc(range->steps * sizeof(*points));
+  for (int i = 0; i < range->steps; i++) {
+    double t = range->steps == 1 ? 0 : (double)i / (range->steps - 1);
+    if (range->log) {
+      points[i] = range->first * pow(range->last / range->first, t);
+    } else {
+      points[i] = range->first + (range->last - range->first) * t;
+    }
+  }
+  points[range->steps-1] = range->last;
+  points[0] = range->first;
+  return points;
+}
+
+void set_sweep(const SweepRange* leak, const SweepRange* fault, double pfault,
+               const char* output) {
+  enabled = true;
+  leak_rates = range_points(leak);
+  leak_count = leak->steps;
+  if (fault) {
+    fault_rates = range_points(fault);
+    fault_count = fault->steps;
+  } else {
+    fault_rates = malloc(sizeof(*fault_rates));
+    fault_rates[0] = pfault;
+    fault_count = 1;
+  }
+  output_file = output;
+}
+
+bool sweep_enabled() {
+  return enabled;
+}
+
+const double* get_sweep_leak_rates(int* count) {
+  *count = leak_count;
+  return leak_rates;
+}
+
+const double* get_sweep_fault_rates(int* count) {
+  *count = fault_count;
+  return fault_rates;
+}
+
+void write_sweep_table(const char* const* columns, int column_count,
+                       const double* values, int row_count) {
+  FILE* f = stdout;
+  if (!output_file) {
+    printf("\n");
+  } else {
+    f = fopen(output_file, "w");
+    if (!f) {
+      fprintf(stderr, "Cannot open sweep file '%s'. Exiting.\n", output_file);
+      exit(EXIT_FAILURE);
+    }
+  }
+  size_t name_len = output_file ? strlen(output_file) : 0;
+  bool json = name_len >= 5 && strcmp(output_file + name_len - 5, ".json") == 0;
+
+  // main sets LC_NUMERIC to the user's locale, whose decimal
+  // separator may not be a dot.
+  char* locale = strdup(setlocale(LC_NUMERIC, NULL));
+  setlocale(LC_NUMERIC, "C");
+
+  if (json) {
+    fprintf(f, "[\n");
+    for (int i = 0; i < row_count; i++) {
+      fprintf(f, "  { ");
+      for (int j = 0; j < column_count; j++) {
+        fprintf(f, "\"%s\": %.10e%s", columns[j], values[i * column_count + j],
+                j == column_count - 1 ? " }" : ", ");
+      }
+      fprintf(f, "%s\n", i == row_count - 1 ? "" : ",");
+    }
+    fprintf(f, "]\n");
+  } else {
+    for (int j = 0; j < column_count; j++) {
+      fprintf(f, "%s%s", columns[j], j == column_count - 1 ? "\n" : ",");
+    }
+    for (int i = 0; i < row_count; i++) {
+      for (int j = 0; j < column_count; j++) {
+        fprintf(f, "%.10e%s", values[i * column_count + j],
+                j == column_count - 1 ? "\n" : ",");
+      }
+    }
+  }
+
+  setlocale(LC_NUMERIC, locale);
+  free(locale);
+
+  if (output_file) {
+    fclose(f);
+    printf("\nSweep of %d point(s) written to %s\n", row_count, output_file);
+  }
+}
+
+void free_sweep() {
+  if (!enabled) return;
+  free(leak_rates);
+  free(fault_rates);
+  enabled = false;
+}
+
+
+/* RP */
+
+void write_failure_proba_sweep(const Coeff* coeffs, int len, int coeff_max) {
+  long double* fast_coeffs = malloc(len * sizeof(*fast_coeffs));
+  for (int i = 0; i < len; i++) {
+    fast_coeffs[i] = coeff_get_ld(coeffs[i]);
+  }
+  long double* f_min = malloc(leak_count * sizeof(*f_min));
+  long double* f_max = malloc(leak_count * sizeof(*f_max));
+  // As get_failure_proba, f(p) is of degree |len|.
+  eval_failure_proba_grid(fast_coeffs, len, len, -1, 0,
+                          leak_rates, leak_count, f_min);
+  eval_failure_proba_grid(fast_coeffs, len, len, coeff_max, 1,
+                          leak_rates, leak_count, f_max);
+
+  double* values = malloc(3 * leak_count * sizeof(*values));
+  for (int i = 0; i < leak_count; i++) {
+    values[3*i]   = leak_rates[i];
+    values[3*i+1] = f_min[i];
+    values[3*i+2] = f_max[i];
+  }
+  const char* columns[] = { "pleak", "f_min", "f_max" };
+  write_sweep_table(columns, 3, values, leak_count);
+
+  free(values);
+  free(f_min);
+  free(f_max);
+  free(fast_coeffs);
+}
+
+
+/* CRP/CRPC */
+
+CombinedSweep* make_combined_sweep(int total, int coeffs_len, int k) {
+  CombinedSweep* sweep = malloc(sizeof(*sweep));
+  sweep->total = total;
+  sweep->coeffs_len = coeffs_len;
+  sweep->k = k;
+  sweep->coeffs = malloc((k+1) * sizeof(*sweep->coeffs));
+  for (int i = 0; i <= k; i++) {
+    sweep->coeffs[i] = calloc(coeffs_len, sizeof(*sweep->coeffs[i]));
+  }
+  sweep->scenarios = calloc(k+1, sizeof(*sweep->scenarios));
+  sweep->ignored = calloc(k+1, sizeof(*sweep->ignored));
+  return sweep;
+}
+
+void free_combined_sweep(CombinedSweep* sweep) {
+  for (int i = 0; i <= sweep->k; i++) {
+    free(sweep->coeffs[i]);
+  }
+  free(sweep->coeffs);
+  free(sweep->scenarios);
+  free(sweep->ignored);
+  free(sweep);
+}
+
+void combined_sweep_add(CombinedSweep* sweep, int faults, const Coeff* coeffs) {
+  for (int i = 0; i < sweep->coeffs_len; i++) {
+    sweep->coeffs[faults][i] += coeff_get_ld(coeffs[i]);
+  }
+  sweep->scenarios[faults]++;
+}
+
+void combined_sweep_add_ignored(CombinedSweep* sweep, int faults) {
+  sweep->ignored[faults]++;
+}
+
+// Sets |weights[i]| to f^i * (1-f)^(total-i), for 0 <= i <= |max|.
+static void fault_weights(double f, int total, int max, long double* weights) {
+  for (int i = 0; i <= max; i++) {
+    weights[i] = i > total ? 0 : powl(f, i) * powl(1 - (long double)f, total - i);
+  }
+}
+
+// Fills the 6 values (epsilon, mu and gamma, min then max) of |sweep|
+// at the leakage rate of index |leak| and the fault rate whose weights
+// are |weights|, using the sums |eps_min| and |eps_max| (by number of
+// faults) computed by write_combined_sweep.
+static void combined_values(const CombinedSweep* sweep, long double** eps_min,
+                            long double** eps_max, int leak,
+                            const long double* weights, double* values) {
+  long double epsilon = 0, epsilon_max = 0, mu = 0, mu_max;
+  for (int i = 0; i <= sweep->k; i++) {
+    if (sweep->scenarios[i]) {
+      epsilon     += eps_min[i][leak] * weights[i];
+      epsilon_max += eps_max[i][leak] * weights[i];
+    }
+    mu += sweep->ignored[i] * weights[i];
+  }
+  // compute_combined_mu_max: all scenarios with more than k faults.
+  mu_max = mu;
+  long double binomial = 1; // total choose i
+  for (int i = 1; i <= sweep->total; i++) {
+    binomial = binomial * (sweep->total - i + 1) / i;
+    if (i > sweep->k) mu_max += binomial * weights[i];
+  }
+
+  values[0] = epsilon / (1 - mu);
+  values[1] = mu;
+  values[2] = mu + epsilon;
+  values[3] = epsilon_max / (1 - mu_max);
+  values[4] = mu_max;
+  values[5] = mu_max + epsilon_max;
+}
+
+void write_combined_sweep(CombinedSweep** sweeps, int count, int coeff_max) {
+  // Leakage part of epsilon, for each sweep, number of faults and
+  // leakage rate.
+  long double** eps_min[count];
+  long double** eps_max[count];
+  for (int s = 0; s < count; s++) {
+    CombinedSweep* sweep = sweeps[s];
+    eps_min[s] = malloc((sweep->k+1) * sizeof(*eps_min[s]));
+    eps_max[s] = malloc((sweep->k+1) * sizeof(*eps_max[s]));
+    for (int i = 0; i <= sweep->k; i++) {
+      eps_min[s][i] = malloc(leak_count * sizeof(*eps_min[s][i]));
+      eps_max[s][i] = malloc(leak_count * sizeof(*eps_max[s][i]));
+      if (!sweep->scenarios[i]) continue;
+      int degree = sweep->coeffs_len - 1;
+      eval_failure_proba_grid(sweep->coeffs[i], sweep->coeffs_len, degree, -1, 0,
+                              leak_rates, leak_count, eps_min[s][i]);
+      eval_failure_proba_grid(sweep->coeffs[i], sweep->coeffs_len, degree,
+                              coeff_max, sweep->scenarios[i],
+                              leak_rates, leak_count, eps_max[s][i]);
+    }
+  }
+
+  const int column_count = 8;
+  double* values = malloc(fault_count * leak_count * column_count * sizeof(*values));
+  int max_faults = sweeps[0]->total > sweeps[0]->k ? sweeps[0]->total : sweeps[0]->k;
+  long double* weights = malloc((max_faults+1) * sizeof(*weights));
+  for (int f = 0; f < fault_count; f++) {
+    fault_weights(fault_rates[f], sweeps[0]->total, max_faults, weights);
+    for (int l = 0; l < leak_count; l++) {
+      double* row = &values[(f * leak_count + l) * column_count];
+      row[0] = leak_rates[l];
+      row[1] = fault_rates[f];
+      // As with -l/-f, the values of the sweep with the largest gamma
+      // min are kept.
+      for (int s = 0; s < count; s++) {
+        double candidate[6];
+        combined_values(sweeps[s], eps_min[s], eps_max[s], l, weights, candidate);
+        if (s == 0 || candidate[2] > row[4]) {
+          memcpy(&row[2], candidate, sizeof(candidate));
+        }
+      }
+    }
+  }
+
+  const char* columns[] = { "pleak", "pfault",
+                            "epsilon_min", "mu_min", "gamma_min",
+                            "epsilon_max", "mu_max", "gamma_max" };
+  write_sweep_table(columns, column_count, values, fault_count * leak_count);
+
+  free(weights);
+  free(values);
+  for (int s = 0; s < count; s++) {
+    for (int i = 0; i <= sweeps[s]->k; i++) {
+      free(eps_min[s][i]);
+      free(eps_max[s][i]);
+    }
+    free(eps_min[s]);
+    free(eps_max[s]);
+  }
+}
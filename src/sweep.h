@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "coeffs.h"
+
+/* Probability sweeps (--sweep, --sweep-fault)
+
+   Instead of evaluating the failure probability of a gadget at a
+   single leakage rate (and fault rate for CRP/CRPC), the sweep mode
+   evaluates it over a grid of rates, and writes the results as a
+   table (CSV, or JSON if the output file ends with ".json"):
+
+     - RP: f(p) for each leakage rate p, with the coefficients as
+       computed (f_min) and with the coefficients after the last
+       precise one replaced by binomial coefficients (f_max, the value
+       printed for p = 0.01 at the end of a RP verification).
+
+     - CRP/CRPC (with -k, -s, -c, -t as for -l/-f): epsilon, mu and
+       gamma (min and max, as printed with -l/-f) for each pair of
+       leakage and fault rates.
+
+   For CRP/CRPC, the coefficients files are read once: the
+   coefficients of all scenarios with the same number of faults are
+   summed, and each sum is evaluated at all leakage rates in a single
+   pass over the coefficients (see eval_failure_proba_grid in
+   coeffs.h). The fault rates then only weight these sums.
+
+   Values are computed in long double (instead of GMP for -l/-f), and
+   printed with 10 significant digits.
+*/
+
+// |steps| probabilities from |first| to |last| (included), evenly
+// spaced, or on a logarithmic scale if |log| is true.
+typedef struct _sweep_range {
+  double first;
+  double last;
+  int steps;
+  bool log;
+} SweepRange;
+
+// Parses a range "FIRST:LAST:STEPS" or "FIRST:LAST:STEPS:log" given to
+// the option |option| into *|range|. Exits on error.
+void parse_sweep_range(const char* spec, const char* option, SweepRange* range);
+
+// Enables the sweep mode over the leakage rates |leak|, and the fault
+// rates |fault| (or the single fault rate |pfault| if |fault| is
+// NULL). The table is written to |output| (or to stdout if NULL).
+void set_sweep(const SweepRange* leak, const SweepRange* fault, double pfault,
+               const char* output);
+
+bool sweep_enabled();
+
+// Returns the leakage rates of the sweep, and sets *|count| to their
+// number.
+const double* get_sweep_leak_rates(int* count);
+
+// Returns the fault rates of the sweep, and sets *|count| to their
+// number.
+const double* get_sweep_fault_rates(int* count);
+
+// Writes the table of the sweep: |row_count| rows of |column_count|
+// values (stored row by row in |values|), with the column names
+// |columns|.
+void write_sweep_table(const char* const* columns, int column_count,
+                       const double* values, int row_count);
+
+void free_sweep();
+
+
+/* RP */
+
+// Writes the table of f(p) over the leakage rates of the sweep, where
+// f is defined by the |len| coefficients |coeffs| (see
+// get_failure_proba in coeffs.h for |coeff_max|).
+void write_failure_proba_sweep(const Coeff* coeffs, int len, int coeff_max);
+
+
+/* CRP/CRPC */
+
+// Sums of the scenarios of a CRP/CRPC verification (or of one of the
+// input faults of a CRPC verification), by number of faults.
+typedef struct _combined_sweep {
+  int total;       // Number of variables that can be faulted
+  int coeffs_len;  // Number of coefficients of each scenario
+  int k;           // Maximal number of faults
+  long double** coeffs; // k+1 sums of the coefficients of the scenarios
+  uint64_t* scenarios;  // k+1 numbers of scenarios in |coeffs|
+  uint64_t* ignored;    // k+1 numbers of ignored scenarios (which count
+                        // in mu)
+} CombinedSweep;
+
+CombinedSweep* make_combined_sweep(int total, int coeffs_len, int k);
+
+// Adds the scenario with |faults| faults and coefficients |coeffs|
+// (compute_combined_intermediate_leakage_proba in -l/-f mode).
+void combined_sweep_add(CombinedSweep* sweep, int faults, const Coeff* coeffs);
+
+// Adds an ignored scenario with |faults| faults
+// (compute_combined_intermediate_mu in -l/-f mode).
+void combined_sweep_add_ignored(CombinedSweep* sweep, int faults);
+
+// Writes the table of epsilon, mu and gamma over the leakage and fault
+// rates of the sweep. For each pair of rates, the values are those of
+// the sweep of |sweeps| (|count| of them, one per input fault for
+// CRPC) with the largest gamma min. Coefficients after |coeff_max| are
+// replaced by binomial coefficients for the max values.
+void write_combined_sweep(CombinedSweep** sweeps, int count, int coeff_max);
+
+void free_combined_sweep(CombinedSweep* sweep);
@@ -1,148 +1,416 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <string.h>
 
 #include "trie.h"
 #include "combinations.h"
+#include "stats.h"
 
 
 
+// Initial number of children allocated for an internal node.
+#define TRIE_INITIAL_CAPACITY 2
+
+// |childs| and |vars| are allocated as a single chunk of the arena:
+// the pointers first, then the variables.
+static inline size_t childs_chunk_size(int capacity) {
+  return capacity * (sizeof(TrieNode*) + sizeof(Var));
+}
+
+static void alloc_childs(Arena* arena, TrieNode* trie, int capacity) {
+  trie->childs_capacity = capacity;
+  trie->childs = arena_alloc(arena, childs_chunk_size(capacity));
+  trie->vars = (Var*)&trie->childs[capacity];
+}
+
+// Turns the leaf |trie| into an internal node without children.
+static void make_internal(Arena* arena, TrieNode* trie) {
+  alloc_childs(arena, trie, TRIE_INITIAL_CAPACITY);
+  trie->childs_count = 0;
+}
+
+// Returns the index of the child of |trie| for |var| if there is one,
+// or the index at which it should be inserted otherwise.
+static inline int child_index(const TrieNode* trie, Var var) {
+  int lo = 0, hi = trie->childs_count;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (trie->vars[mid] < var) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+// Returns the child of the internal node |trie| for |var|, or NULL.
+static inline TrieNode* get_child(const TrieNode* trie, Var var) {
+  int idx = child_index(trie, var);
+  if (idx < trie->childs_count && trie->vars[idx] == var) {
+    return trie->childs[idx];
+  }
+  return NULL;
+}
+
+// Returns the child of the internal node |trie| for |var|, creating
+// it (as a leaf) if needed.
+static TrieNode* get_or_add_child(Arena* arena, TrieNode* trie, Var var) {
+  int idx = child_index(trie, var);
+  if (idx < trie->childs_count && trie->vars[idx] == var) {
+    return trie->childs[idx];
+  }
+  if (trie->childs_count == trie->childs_capacity) {
+    TrieNode** old_childs = trie->childs;
+    Var* old_vars = trie->vars;
+    int old_capacity = trie->childs_capacity;
+    alloc_childs(arena, trie, old_capacity * 2);
+    memcpy(trie->childs, old_childs, old_capacity * sizeof(*trie->childs));
+    memcpy(trie->vars, old_vars, old_capacity * sizeof(*trie->vars));
+    arena_free(arena, old_childs, childs_chunk_size(old_capacity));
+  }
+  memmove(&trie->childs[idx+1], &trie->childs[idx],
+          (trie->childs_count - idx) * sizeof(*trie->childs));
+  memmove(&trie->vars[idx+1], &trie->vars[idx],
+          (trie->childs_count - idx) * sizeof(*trie->vars));
+  trie->childs_count++;
+  trie->vars[idx] = var;
+  trie->childs[idx] = arena_calloc(arena, sizeof(*trie->childs[idx]));
+  return trie->childs[idx];
+}
+
+/***********************************************************
+                      Subset index
+ ***********************************************************/
+
+// A tuple of the trie, as stored in the subset index.
+typedef struct _subset_entry {
+  uint64_t signature; // Bit (v % 64) is set for each variable v of |vars|
+  TrieNode* leaf;     // The leaf of the tuple in the trie
+  struct _subset_entry* size_prev; // The chain of the tuples of size |len|
+  struct _subset_entry* size_next;
+  int len;
+  Var vars[];         // The variables of the tuple, in ascending order
+} SubsetEntry;
+
+struct _subset_list {
+  SubsetEntry** entries; // In insertion order
+  int count;
+  int capacity;
+};
+
+struct _size_chain {
+  SubsetEntry* first; // In insertion order
+  SubsetEntry* last;
+  int count;
+};
+
+static inline size_t subset_entry_size(int len) {
+  return sizeof(SubsetEntry) + len * sizeof(Var);
+}
+
+static inline uint64_t comb_signature(const Comb* comb, int comb_len) {
+  uint64_t signature = 0;
+  for (int i = 0; i < comb_len; i++) {
+    signature |= 1ULL << (comb[i] & 63);
+  }
+  return signature;
+}
+
+// Adds the tuple |comb|, whose leaf is |leaf|, to the subset index of
+// |trie|. The empty tuple is not indexed: it can only be stored at
+// the head, which trie_contains_subset checks directly.
+static void index_tuple(Trie* trie, const Comb* comb, int comb_len, TrieNode* leaf) {
+  if (comb_len == 0) return;
+  Var first = comb[0];
+  if (first >= trie->index_len) {
+    int index_len = trie->index_len ? trie->index_len : 64;
+    while (index_len <= first) index_len *= 2;
+    trie->index = realloc(trie->index, index_len * sizeof(*trie->index));
+    memset(&trie->index[trie->index_len], 0,
+           (index_len - trie->index_len) * sizeof(*trie->index));
+    trie->index_len = index_len;
+  }
+  SubsetList* list = &trie->index[first];
+  if (list->count == list->capacity) {
+    list->capacity = list->capacity ? list->capacity * 2 : 4;
+    list->entries = realloc(list->entries, list->capacity * sizeof(*list->entries));
+  }
+  SubsetEntry* entry = arena_alloc(trie->arena, subset_entry_size(comb_len));
+  entry->signature = comb_signature(comb, comb_len);
+  entry->leaf = leaf;
+  entry->len = comb_len;
+  memcpy(entry->vars, comb, comb_len * sizeof(*comb));
+  list->entries[list->count++] = entry;
+
+  if (comb_len >= trie->sizes_len) {
+    int sizes_len = trie->sizes_len ? trie->sizes_len : 16;
+    while (sizes_len <= comb_len) sizes_len *= 2;
+    trie->sizes = realloc(trie->sizes, sizes_len * sizeof(*trie->sizes));
+    memset(&trie->sizes[trie->sizes_len], 0,
+           (sizes_len - trie->sizes_len) * sizeof(*trie->sizes));
+    trie->sizes_len = sizes_len;
+  }
+  SizeChain* chain = &trie->sizes[comb_len];
+  entry->size_prev = chain->last;
+  entry->size_next = NULL;
+  if (chain->last) {
+    chain->last->size_next = entry;
+  } else {
+    chain->first = entry;
+  }
+  chain->last = entry;
+  chain->count++;
+  trie->tuple_count++;
+}
+
+// Removes |entry| from the chain of the tuples of its size.
+static void unlink_from_size_chain(Trie* trie, SubsetEntry* entry) {
+  SizeChain* chain = &trie->sizes[entry->len];
+  if (entry->size_prev) {
+    entry->size_prev->size_next = entry->size_next;
+  } else {
+    chain->first = entry->size_next;
+  }
+  if (entry->size_next) {
+    entry->size_next->size_prev = entry->size_prev;
+  } else {
+    chain->last = entry->size_prev;
+  }
+  chain->count--;
+  trie->tuple_count--;
+}
+
+// Removes from the subset index of |trie| the tuples that start with
+// |comb| (all of them if |comb_len| is 0), which are about to be
+// removed from the trie.
+static void unindex_tuples_with_prefix(Trie* trie, const Comb* comb, int comb_len) {
+  int first = 0, last = trie->index_len;
+  if (comb_len) {
+    if (comb[0] >= trie->index_len) return;
+    first = comb[0];
+    last = first + 1;
+  }
+  for (int v = first; v < last; v++) {
+    SubsetList* list = &trie->index[v];
+    int kept = 0;
+    for (int i = 0; i < list->count; i++) {
+      SubsetEntry* entry = list->entries[i];
+      if (entry->len >= comb_len &&
+          memcmp(entry->vars, comb, comb_len * sizeof(*comb)) == 0) {
+        unlink_from_size_chain(trie, entry);
+        arena_free(trie->arena, entry, subset_entry_size(entry->len));
+      } else {
+        list->entries[kept++] = entry;
+      }
+    }
+    list->count = kept;
+  }
+}
+
+static int compare_entries(const void* a_void, const void* b_void) {
+  const SubsetEntry* a = *(const SubsetEntry**)a_void;
+  const SubsetEntry* b = *(const SubsetEntry**)b_void;
+  for (int i = 0; i < a->len; i++) {
+    if (a->vars[i] != b->vars[i]) return a->vars[i] < b->vars[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+// Returns the tuples of size |size| (at least 1) of |trie|, in
+// lexicographic order (ie, the order of a traversal of the trie), and
+// sets |count| to their number. The array should be freed by the
+// caller.
+static SubsetEntry** tuples_of_size(Trie* trie, int size, int* count) {
+  *count = 0;
+  if (size <= 0 || size >= trie->sizes_len || !trie->sizes[size].count) {
+    return NULL;
+  }
+  SizeChain* chain = &trie->sizes[size];
+  SubsetEntry** entries = malloc(chain->count * sizeof(*entries));
+  for (SubsetEntry* entry = chain->first; entry; entry = entry->size_next) {
+    entries[(*count)++] = entry;
+  }
+  qsort(entries, *count, sizeof(*entries), compare_entries);
+  return entries;
+}
+
+// Returns true if the sorted tuple |sub| is a subtuple of the sorted
+// tuple |comb|.
+static inline int is_sorted_subcomb(const Var* sub, int sub_len,
+                                    const Comb* comb, int comb_len) {
+  int j = 0;
+  for (int i = 0; i < sub_len; i++) {
+    while (j < comb_len && comb[j] < sub[i]) j++;
+    if (j == comb_len || comb[j] != sub[i]) return 0;
+    j++;
+  }
+  return 1;
+}
+
+// Source of the unique ids of the phases of the tries.
+static uint64_t next_phase = 1;
+
+static uint64_t new_phase() {
+  return __atomic_fetch_add(&next_phase, 1, __ATOMIC_RELAXED);
+}
+
 Trie* make_trie(int childs_len) {
   Trie* trie = malloc(sizeof(*trie));
   trie->childs_len = childs_len;
-  TrieNode* head = malloc(sizeof(*head));
-  // Mallocing the head's childs so that |trie_contains| does not
-  // return true as soon as it visits the head. (Since nodes with an
-  // empty childs array are leafs)
-  head->childs = calloc(childs_len, sizeof(*head->childs));
-  head->secret_deps = NULL;
+  trie->arena = make_arena("trie");
+  trie->owned_deps = NULL;
+  trie->owned_deps_count = trie->owned_deps_capacity = 0;
+  trie->index = NULL;
+  trie->index_len = 0;
+  trie->sizes = NULL;
+  trie->sizes_len = trie->tuple_count = 0;
+  pthread_mutex_init(&trie->locals_mutex, NULL);
+  trie->locals = NULL;
+  trie->locals_count = trie->locals_capacity = 0;
+  trie->phase = new_phase();
+  TrieNode* head = arena_calloc(trie->arena, sizeof(*head));
+  // Making the head an internal node so that |trie_contains| does
+  // not return true as soon as it visits the head. (Since nodes
+  // without childs array are leafs)
+  make_internal(trie->arena, head);
   trie->head = head;
   return trie;
 }
 
-void free_trie_node(TrieNode* trie, int childs_len) {
-  free(trie->secret_deps);
-  if (!trie->childs) {
-    free(trie);
-    return;
+// Stores |secret_deps| in the node |node| of |trie|, which takes
+// ownership of it.
+static void set_secret_deps(Trie* trie, TrieNode* node, SecretDep* secret_deps) {
+  node->secret_deps = secret_deps;
+  if (!secret_deps) return;
+  if (trie->owned_deps_count == trie->owned_deps_capacity) {
+    trie->owned_deps_capacity = trie->owned_deps_capacity ? trie->owned_deps_capacity * 2 : 16;
+    trie->owned_deps = realloc(trie->owned_deps,
+                               trie->owned_deps_capacity * sizeof(*trie->owned_deps));
   }
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      free_trie_node(trie->childs[i], childs_len);
-    }
-  }
-  free(trie->childs);
-  free(trie);
+  trie->owned_deps[trie->owned_deps_count++] = secret_deps;
 }
 
-void free_trie(Trie* trie) {
-  free_trie_node(trie->head, trie->childs_len);
-  free(trie);
+// Gives the children of |trie| (recursively) back to |arena|; |trie|
+// becomes a leaf. Their |secret_deps| are freed with the trie.
+static void free_trie_childs(Arena* arena, TrieNode* trie) {
+  if (!trie->childs) return;
+  for (int i = 0; i < trie->childs_count; i++) {
+    free_trie_childs(arena, trie->childs[i]);
+    arena_free(arena, trie->childs[i], sizeof(*trie->childs[i]));
+  }
+  arena_free(arena, trie->childs, childs_chunk_size(trie->childs_capacity));
+  trie->childs = NULL;
+  trie->vars = NULL;
+  trie->childs_count = trie->childs_capacity = 0;
 }
 
-int trie_node_size(TrieNode* trie, int childs_len) {
-  if (!trie->childs) return 1; // a leaf
-  int total = 0;
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      total += trie_node_size(trie->childs[i], childs_len);
-    }
+void free_trie(Trie* trie) {
+  if (stats_enabled()) {
+    stats_record_size("incompr_trie_tuples", trie_size(trie));
   }
-  return total;
+  for (int i = 0; i < trie->owned_deps_count; i++) {
+    free(trie->owned_deps[i]);
+  }
+  free(trie->owned_deps);
+  for (int i = 0; i < trie->index_len; i++) {
+    free(trie->index[i].entries);
+  }
+  free(trie->index);
+  free(trie->sizes);
+  for (int i = 0; i < trie->locals_count; i++) {
+    free_trie(trie->locals[i]);
+  }
+  free(trie->locals);
+  pthread_mutex_destroy(&trie->locals_mutex);
+  free_arena(trie->arena);
+  free(trie);
 }
 
+// The empty tuple is not in the subset index: when it is in the trie,
+// the head is a leaf, and the trie contains no other tuple.
 int trie_size(Trie* trie) {
-  return trie_node_size(trie->head, trie->childs_len);
-}
-
-int trie_node_tuples_size(TrieNode* trie, int childs_len, int size) {
-  if (!trie->childs) return size == 0;
-  int total = 0;
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      total += trie_node_tuples_size(trie->childs[i], childs_len, size-1);
-    }
-  }
-  return total;
+  if (!trie->head->childs) return 1;
+  return trie->tuple_count;
 }
 
 int trie_tuples_size(Trie* trie, int size) {
-  return trie_node_tuples_size(trie->head, trie->childs_len, size);
+  if (!trie->head->childs) return size == 0;
+  if (size <= 0 || size >= trie->sizes_len) return 0;
+  return trie->sizes[size].count;
 }
 
-void _insert_in_trie(TrieNode* trie, int childs_len,
-                     Comb* comb, int comb_len,
-                     SecretDep* secret_deps, int secret_deps_len) {
-  if (comb_len == 0) {
-    if (secret_deps_len && trie->secret_deps) {
-      for (int i = 0; i < secret_deps_len; i++) {
-        trie->secret_deps[i] |= secret_deps[i];
-      }
-      free(secret_deps);
-    } else {
-      trie->secret_deps = secret_deps;
-    }
-    return;
+// Moves from |trie| to its child for |var|, creating it if needed.
+// The tuple that ended at |trie|, if |trie| was a leaf, is removed
+// (its first |depth| variables are |comb|). Sets |created| to true if
+// the child was created.
+static TrieNode* insert_step(Trie* t, TrieNode* trie, Var var,
+                             Comb* comb, int depth, bool* created) {
+  if (!trie->childs) {
+    if (depth) unindex_tuples_with_prefix(t, comb, depth);
+    make_internal(t->arena, trie);
   }
-  if (! trie->childs) {
-    trie->childs = calloc(childs_len, sizeof(*trie->childs));
+  int childs_count = trie->childs_count;
+  TrieNode* child = get_or_add_child(t->arena, trie, var);
+  *created = trie->childs_count != childs_count;
+  return child;
+}
+
+static void _insert_in_trie(Trie* t, Comb* comb, int comb_len,
+                            SecretDep* secret_deps, int secret_deps_len) {
+  TrieNode* trie = t->head;
+  bool created = false;
+  for (int i = 0; i < comb_len; i++) {
+    trie = insert_step(t, trie, comb[i], comb, i, &created);
   }
-  if (!trie->childs[*comb]) {
-    trie->childs[*comb] = calloc(1, sizeof(*trie->childs[*comb]));
+  if (secret_deps_len && trie->secret_deps) {
+    for (int i = 0; i < secret_deps_len; i++) {
+      trie->secret_deps[i] |= secret_deps[i];
+    }
+    free(secret_deps);
+  } else {
+    set_secret_deps(t, trie, secret_deps);
   }
-  _insert_in_trie(trie->childs[*comb], childs_len, comb+1, comb_len-1,
-                  secret_deps, secret_deps_len);
-  return;
+  if (created) index_tuple(t, comb, comb_len, trie);
 }
 
 void insert_in_trie(Trie* trie, Comb* comb, int comb_len, SecretDep* secret_deps) {
-  _insert_in_trie(trie->head, trie->childs_len, comb, comb_len,
+  _insert_in_trie(trie, comb, comb_len,
                   secret_deps, 0);
 }
 
-void _insert_in_trie_arith(TrieNode* trie, int childs_len,
-                     Comb* comb, int comb_len,
-                     SecretDep* secret_deps, int secret_deps_len) {
-                     
-  if (comb_len == 0) {
-    if (secret_deps_len && trie->secret_deps) {
-      for (int i = 0; i < secret_deps_len; i++) {
-        trie->secret_deps[i] |= secret_deps[i];
-      }
-      free(secret_deps);
-    } else {
-      trie->secret_deps = secret_deps;
+static void _insert_in_trie_arith(Trie* t, Comb* comb, int comb_len,
+                                  SecretDep* secret_deps, int secret_deps_len) {
+  TrieNode* trie = t->head;
+  bool created = false;
+  for (int i = 0; i < comb_len; i++) {
+    trie = insert_step(t, trie, comb[i], comb, i, &created);
+  }
+  if (secret_deps_len && trie->secret_deps) {
+    for (int i = 0; i < secret_deps_len; i++) {
+      trie->secret_deps[i] |= secret_deps[i];
+    }
+    free(secret_deps);
+  } else {
+    set_secret_deps(t, trie, secret_deps);
       
-      /* To prevent bug from the form : tuple in [9,10,13,17] and I want to 
-         add [9,10,13], so I have to remove the last element 17.*/
-      if (trie->childs){  
-        for (int i = 0; i < childs_len; i++){
-          if (trie->childs[i]){
-            free_trie_node(trie->childs[i], childs_len);
-          }
-        }
-        free(trie->childs);
-        trie->childs = NULL; 
-      }
+    /* To prevent bug from the form : tuple in [9,10,13,17] and I want to 
+       add [9,10,13], so I have to remove the last element 17.*/
+    if (trie->childs) {
+      unindex_tuples_with_prefix(t, comb, comb_len);
+      free_trie_childs(t->arena, trie);
+      created = true;
     }
-    return;
-  }
-  if (!trie->childs) {
-    trie->childs = calloc(childs_len, sizeof(*trie->childs));
   }
-  if (!trie->childs[*comb]) {
-    trie->childs[*comb] = calloc(1, sizeof(*trie->childs[*comb]));
-  }
-  _insert_in_trie_arith(trie->childs[*comb], childs_len, comb+1, comb_len-1,
-                  secret_deps, secret_deps_len);
-  return;
+  if (created) index_tuple(t, comb, comb_len, trie);
 }
 
 void insert_in_trie_arith(Trie* trie, Comb* comb, int comb_len, 
                     SecretDep* secret_deps) {
   
-  _insert_in_trie_arith(trie->head, trie->childs_len, comb, comb_len,
+  _insert_in_trie_arith(trie, comb, comb_len,
                   secret_deps, 0);  
 }
 
@@ -152,35 +420,36 @@ void insert_in_trie_arith(Trie* trie, Comb* comb, int comb_len,
 
 void insert_in_trie_merge(Trie* trie, Comb* comb, int comb_len,
                           SecretDep* secret_deps, int secret_deps_len) {
-  _insert_in_trie(trie->head, trie->childs_len, comb, comb_len,
+  _insert_in_trie(trie, comb, comb_len,
                   secret_deps, secret_deps_len);
 }
 
 void insert_in_trie_merge_arith(Trie* trie, Comb* comb, int comb_len,
                           SecretDep* secret_deps, int secret_deps_len) {
-  _insert_in_trie_arith(trie->head, trie->childs_len, comb, comb_len,
+  _insert_in_trie_arith(trie, comb, comb_len,
                   secret_deps, secret_deps_len);
 }
 
 
-int _trie_contains(TrieNode* trie, Comb* comb, int comb_len) {
+static int _trie_contains(TrieNode* trie, Comb* comb, int comb_len) {
     if (!trie->childs) return 1;
     if (comb_len == 0) return 0;
-    if (!trie->childs[*comb]) return 0;
-    return _trie_contains(trie->childs[*comb], comb+1, comb_len-1);
+    TrieNode* child = get_child(trie, *comb);
+    if (!child) return 0;
+    return _trie_contains(child, comb+1, comb_len-1);
 }
 
 int trie_contains(Trie* trie, Comb* comb, int comb_len) {
   return _trie_contains(trie->head, comb, comb_len);
 }
 
-SecretDep *_is_in_trie(TrieNode *trie, Comb* comb, int comb_len){
+static SecretDep *_is_in_trie(TrieNode *trie, Comb* comb, int comb_len){
   if (trie && !trie->childs && comb_len == 0) return trie->secret_deps;
   if (comb_len == 0) return NULL;
   if (!trie->childs) return NULL;
-  if (!trie->childs[*comb]) return NULL;
-  return _is_in_trie(trie->childs[*comb], comb+1, comb_len-1);
-   
+  TrieNode* child = get_child(trie, *comb);
+  if (!child) return NULL;
+  return _is_in_trie(child, comb+1, comb_len-1);
 }
 
 SecretDep *is_in_trie (Trie *trie, Comb *comb, int comb_len){
@@ -189,27 +458,35 @@ SecretDep *is_in_trie (Trie *trie, Comb *comb, int comb_len){
 
 
 
-SecretDep* _trie_contains_subset(TrieNode* trie, Comb* comb, int comb_len) {
-  if (!trie->childs) {
-    return trie->secret_deps;
-  }
-  if (comb_len == 0) return NULL;
-  char* secret_deps = _trie_contains_subset(trie, comb+1, comb_len-1);
-  if (secret_deps) return secret_deps;
-  if (!trie->childs[*comb]) return NULL;
-  return _trie_contains_subset(trie->childs[*comb], comb+1, comb_len-1);
-}
-
+// |comb| must be sorted. The tuples of the trie are sorted as well,
+// so a subtuple of |comb| whose first variable is comb[i] can only
+// use the variables comb[i+1..].
 SecretDep* trie_contains_subset(Trie* trie, Comb* comb, int comb_len) {
-  return _trie_contains_subset(trie->head, comb, comb_len);
+  if (!trie->head->childs) {
+    return trie->head->secret_deps; // The trie contains the empty tuple
+  }
+  uint64_t signature = comb_signature(comb, comb_len);
+  for (int i = 0; i < comb_len && comb[i] < trie->index_len; i++) {
+    const SubsetList* list = &trie->index[comb[i]];
+    for (int j = 0; j < list->count; j++) {
+      const SubsetEntry* entry = list->entries[j];
+      if ((entry->signature & ~signature) || entry->len > comb_len - i) continue;
+      if (entry->leaf->secret_deps &&
+          is_sorted_subcomb(&entry->vars[1], entry->len - 1,
+                            &comb[i+1], comb_len - i - 1)) {
+        return entry->leaf->secret_deps;
+      }
+    }
+  }
+  return NULL;
 }
 
 // This function generates all combinations of |comb| of size 1 to
 // |comb_len-1|, and checks if one of them is in |trie|. Returns 1 if
 // so, 0 otherwise.
 // It is slower than |trie_contains_subset|, because the latter does
-// not actually generate combinations, but achieves a similar effect
-// through its recursion.
+// not actually generate combinations, but only looks at the tuples of
+// the subset index that start with a variable of |comb|.
 int trie_contains_subset_slow(Trie* trie, Comb* comb, int comb_len) {
   int k = 1;
   Comb indices[comb_len];
@@ -231,8 +508,8 @@ int trie_contains_subset_slow(Trie* trie, Comb* comb, int comb_len) {
   return 0;
 }
 
-void _get_all_tuples(VarVecVector* all_tuples, TrieNode* trie, int childs_len,
-                     Comb* work_comb, int work_comb_idx) {
+static void _get_all_tuples(VarVecVector* all_tuples, TrieNode* trie,
+                            Comb* work_comb, int work_comb_idx) {
   if (!trie->childs) {
     VarVector* tuple = VarVector_make_size(work_comb_idx+1);
     for (int i = 0; i < work_comb_idx; i++) {
@@ -242,12 +519,9 @@ void _get_all_tuples(VarVecVector* all_tuples, TrieNode* trie, int childs_len,
     return;
   }
 
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      work_comb[work_comb_idx] = i;
-      _get_all_tuples(all_tuples, trie->childs[i], childs_len,
-                      work_comb, work_comb_idx+1);
-    }
+  for (int i = 0; i < trie->childs_count; i++) {
+    work_comb[work_comb_idx] = trie->vars[i];
+    _get_all_tuples(all_tuples, trie->childs[i], work_comb, work_comb_idx+1);
   }
 }
 
@@ -255,7 +529,7 @@ VarVecVector* get_all_tuples(Trie* trie) {
   VarVecVector* all_tuples = VarVecVector_make();
   // Assumes that no incompressible tuple is more than 100 elements long
   Comb work_comb[100] = { 0 };
-  _get_all_tuples(all_tuples, trie->head, trie->childs_len, work_comb, 0);
+  _get_all_tuples(all_tuples, trie->head, work_comb, 0);
   return all_tuples;
 }
 
@@ -269,72 +543,34 @@ void print_comb(Comb* comb, int comb_len) {
   printf(" ]\n");
 }
 
-void _print_all_tuples(TrieNode* trie, int childs_len,
-                       Comb* work_comb, int work_comb_idx) {
+static void _print_all_tuples(TrieNode* trie, Comb* work_comb, int work_comb_idx) {
   if (!trie->childs) {
     print_comb(work_comb, work_comb_idx);
     return;
   }
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      work_comb[work_comb_idx] = i;
-      _print_all_tuples(trie->childs[i], childs_len, work_comb, work_comb_idx+1);
-    }
+  for (int i = 0; i < trie->childs_count; i++) {
+    work_comb[work_comb_idx] = trie->vars[i];
+    _print_all_tuples(trie->childs[i], work_comb, work_comb_idx+1);
   }
 }
 
 void print_all_tuples(Trie* trie) {
   // Assumes that no incompressible tuple is more than 100 elements long
   Comb work_comb[100] = { 0 };
-  _print_all_tuples(trie->head, trie->childs_len, work_comb, 0);
-}
-
-void _print_all_tuples_size(TrieNode* trie, int childs_len,
-                            Comb* work_comb, int work_comb_idx, int size) {
-  if (!trie->childs) {
-    if (size == 0) {
-      print_comb(work_comb, work_comb_idx);
-    }
-    return;
-  }
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      work_comb[work_comb_idx] = i;
-      _print_all_tuples_size(trie->childs[i], childs_len, work_comb, work_comb_idx+1, size-1);
-    }
-  }
+  _print_all_tuples(trie->head, work_comb, 0);
 }
 
 void print_all_tuples_size(Trie* trie, int size) {
-  // Assumes that no incompressible tuple is more than 100 elements long
-  Comb work_comb[100] = { 0 };
-  _print_all_tuples_size(trie->head, trie->childs_len, work_comb, 0, size);
-}
-void _list_from_trie(TrieNode* trie, int childs_len,
-                     ListComb* list,
-                     Comb* comb, int idx, int comb_len) {
-  if (!trie->childs && idx == comb_len) {
-    add_with_deps(list, comb, trie->secret_deps);
+  if (size == 0) {
+    if (!trie->head->childs) print_comb(NULL, 0);
     return;
   }
-  if (idx == comb_len || !trie->childs) {
-    return;
-  }
-  int used = 0;
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      if (used) {
-        Comb* comb_copy = malloc(comb_len * sizeof(*comb_copy));
-        memcpy(comb_copy, comb, idx * sizeof(*comb));
-        comb_copy[idx] = i;
-        _list_from_trie(trie->childs[i], childs_len, list, comb_copy, idx+1, comb_len);
-      } else {
-        used = 1;
-        comb[idx] = i;
-        _list_from_trie(trie->childs[i], childs_len, list, comb, idx+1, comb_len);
-      }
-    }
+  int count;
+  SubsetEntry** tuples = tuples_of_size(trie, size, &count);
+  for (int i = 0; i < count; i++) {
+    print_comb(tuples[i]->vars, size);
   }
+  free(tuples);
 }
 
 
@@ -345,7 +581,6 @@ condition described in the function derive_trie_from_subset. If it's the case,
 we add the tuples in |new_trie|.
 Input : 
   -TrieNode *trie : The current Node in the Trie that we want to add tuples.
-  -int childs_len : Maximal number of childs that |trie| can have.
   -int *subset : An array of index between |circuit_length| and 
                 |idx_output_end|.
   -int len_subset : The size of the array.
@@ -362,7 +597,7 @@ Input :
   -int idx_output_end : Integer that is the end index that |subset| can have 
                         in his element.   
 */
-void _derive_trie_from_subset(TrieNode *trie, int childs_len, int *subset, 
+static void _derive_trie_from_subset(TrieNode *trie, int *subset,
                               int len_subset, int circuit_length, 
                               Trie* new_trie, Comb *work_comb, 
                               int work_comb_idx, int nb_output, 
@@ -387,8 +622,9 @@ void _derive_trie_from_subset(TrieNode *trie, int childs_len, int *subset,
     return;
   }
   
-  for (int i = 0; i < childs_len; i++){
-    if (trie->childs[i]){
+  for (int c = 0; c < trie->childs_count; c++){
+    int i = trie->vars[c];
+    {
       int new_nb_output = nb_output;
       if (i >= circuit_length){
         if (i < idx_output_end){
@@ -405,7 +641,7 @@ void _derive_trie_from_subset(TrieNode *trie, int childs_len, int *subset,
       }
       
       work_comb[work_comb_idx] = i;
-      _derive_trie_from_subset(trie->childs[i], childs_len, subset, len_subset, 
+      _derive_trie_from_subset(trie->childs[c], subset, len_subset,
                                circuit_length, new_trie, work_comb, 
                                work_comb_idx + 1, new_nb_output, secret_count,
                                idx_output_end);                           
@@ -414,46 +650,38 @@ void _derive_trie_from_subset(TrieNode *trie, int childs_len, int *subset,
 }
 
 /*
-Recursive algorithm who adds tuples of size |size| existing into the node |trie| 
-to the Trie |new_trie|.
+Adds the tuples of size |size| of |trie| to the Trie |new_trie|, except those 
+that contain a tuple of |new_trie|.
 Input : 
-  -TrieNode *trie : The current Node in the Trie that we want to add tuples.
+  -Trie *trie : The Trie whose tuples we want to add.
   -Trie *new_trie : The trie in which we will be add the good tuple.
   -int size : The size of the tuples we want to add.
-  -int childs_len : Maximal number of childs that |trie| can have.
-  -Comb *work_comb : Tuple used recursively to found the tuples existing in 
-                     |trie|.
-  -int work_comb_idx : Integer used recursively with |work_comb|, 
-                       it is currently the size of |work_comb|.
   -int secret_count : Number of secret for this gadget. 
 */
-static void _add_tuples_to_trie_size(TrieNode *trie, Trie *new_trie, int size,
-                                     int childs_len, Comb *work_comb, 
-                                     int work_comb_idx, int secret_count){
-
-  if (!trie->childs){
-    //We found a |comb| existing in the original Trie. 
-    if (size == 0) {
-      //If the size is different from 0, then the tuples mustn't be add.
-      if (!trie_contains_subset(new_trie, work_comb, work_comb_idx)){
-        //If the |new_trie| contains a subset of our |comb|, then the tuples
-        //mustn't be add.  
-        SecretDep *secret_deps = calloc(secret_count, sizeof(*secret_deps)); 
-        memcpy(secret_deps, trie->secret_deps, secret_count * 
-               sizeof(*secret_deps));
-        insert_in_trie_arith(new_trie, work_comb, work_comb_idx, secret_deps);
-      }
-    }  
+static void add_tuples_to_trie_size(Trie *trie, Trie *new_trie, int size,
+                                    int secret_count){
+  if (size == 0) {
+    if (!trie->head->childs && !trie_contains_subset(new_trie, NULL, 0)) {
+      SecretDep *secret_deps = calloc(secret_count, sizeof(*secret_deps)); 
+      memcpy(secret_deps, trie->head->secret_deps, secret_count * 
+             sizeof(*secret_deps));
+      insert_in_trie_arith(new_trie, NULL, 0, secret_deps);
+    }
     return;
   }
-  
-  for (int i = 0; i < childs_len; i++) {
-    if (trie->childs[i]) {
-      work_comb[work_comb_idx] = i;
-      _add_tuples_to_trie_size(trie->childs[i], new_trie, size - 1, childs_len, 
-                               work_comb, work_comb_idx+1, secret_count);
+  int count;
+  SubsetEntry** tuples = tuples_of_size(trie, size, &count);
+  for (int i = 0; i < count; i++) {
+    //If the |new_trie| contains a subset of our |comb|, then the tuples
+    //mustn't be add.  
+    if (!trie_contains_subset(new_trie, tuples[i]->vars, size)){
+      SecretDep *secret_deps = calloc(secret_count, sizeof(*secret_deps)); 
+      memcpy(secret_deps, tuples[i]->leaf->secret_deps, secret_count * 
+             sizeof(*secret_deps));
+      insert_in_trie_arith(new_trie, tuples[i]->vars, size, secret_deps);
     }
   }
+  free(tuples);
 }
 
 /*
@@ -479,7 +707,7 @@ Trie *derive_trie_from_subset(Trie *trie, int *subset, int len_subset,
   Trie *new_trie = make_trie(trie->childs_len);
   // Assumes that no incompressible tuple is more than 100 elements long
   Comb work_comb[100] = { 0 };
-  _derive_trie_from_subset(trie->head, trie->childs_len, subset, len_subset, 
+  _derive_trie_from_subset(trie->head, subset, len_subset,
                            circuit_length, new_trie, work_comb, 0, 0, 
                            secret_count, idx_output_end);
                            
@@ -505,8 +733,7 @@ Trie *derive_trie_from_subset(Trie *trie, int *subset, int len_subset,
   
   Trie *final_trie = make_trie(trie->childs_len);
   for (int size = 0; size <= coeff_max ; size++){
-    _add_tuples_to_trie_size(new_trie->head, final_trie, size, 
-                             trie->childs_len, work_comb, 0, secret_count);
+    add_tuples_to_trie_size(new_trie, final_trie, size, secret_count);
   }
     
   free_trie(new_trie); 
@@ -518,20 +745,20 @@ ListComb* list_from_trie(Trie* trie, int comb_len) {
   ListComb* list = make_empty_list();
   TrieNode* head = trie->head;
   if (head->secret_deps && comb_len == 0){
-    Comb *comb = malloc(comb_len * sizeof(*comb));
+    Comb *comb = arena_alloc(list->arena, comb_len * sizeof(*comb));
     add_with_deps(list, comb, head->secret_deps);
   }
   else if (comb_len == 0) return list;
   
   else if (head->childs){
-    for (int i = 0; i < trie->childs_len; i++) {
-      if (head->childs[i]) {
-        Comb* comb = malloc(comb_len * sizeof(*comb));
-        comb[0] = i;
-        _list_from_trie(head->childs[i], trie->childs_len, list, comb, 1, 
-                        comb_len);            
-      }
+    int count;
+    SubsetEntry** tuples = tuples_of_size(trie, comb_len, &count);
+    for (int i = 0; i < count; i++) {
+      Comb* comb = arena_alloc(list->arena, comb_len * sizeof(*comb));
+      memcpy(comb, tuples[i]->vars, comb_len * sizeof(*comb));
+      add_with_deps(list, comb, tuples[i]->leaf->secret_deps);
     }
+    free(tuples);
   }
   return list;
 }
@@ -546,11 +773,10 @@ Input :
                      |trie|.
   -int work_comb_idx : Integer used recursively with |work_comb|, 
                        it is currently the size of |work_comb|.
-  -int childs_len : Maximal number of childs that |trie| can have.
   -int secret_count : Number of secret for this gadget.     
 */
-void _trie_copy(TrieNode *trie, Trie *trie_copy, Comb *work_comb, 
-                int work_comb_idx, int childs_len, int secret_count){
+static void _trie_copy(TrieNode *trie, Trie *trie_copy, Comb *work_comb,
+                       int work_comb_idx, int secret_count){
   if (!trie->childs){
     SecretDep *secret_deps_copy = malloc(secret_count * 
                                          sizeof(*secret_deps_copy));
@@ -562,12 +788,10 @@ void _trie_copy(TrieNode *trie, Trie *trie_copy, Comb *work_comb,
   }
   
   else {
-    for (int i = 0; i < childs_len; i++){
-      if (trie->childs[i]){
-        work_comb[work_comb_idx] = i;
-        _trie_copy(trie->childs[i], trie_copy, work_comb, work_comb_idx + 1, 
-                   childs_len, secret_count);
-      }
+    for (int i = 0; i < trie->childs_count; i++){
+      work_comb[work_comb_idx] = trie->vars[i];
+      _trie_copy(trie->childs[i], trie_copy, work_comb, work_comb_idx + 1,
+                 secret_count);
     }
   }
 }
@@ -582,12 +806,125 @@ Output : A copy of Trie *trie.
 Trie *trie_copy(Trie *trie, int secret_count){
   Trie *trie_copy = make_trie(trie->childs_len);
   Comb work_comb[100] = { 0 };
-  _trie_copy(trie->head, trie_copy, work_comb, 0, trie->childs_len, 
-             secret_count);
+  _trie_copy(trie->head, trie_copy, work_comb, 0, secret_count);
   return trie_copy;
 }
 
 
+/***********************************************************
+                 Filling a trie in parallel
+ ***********************************************************/
+
+// The local trie of the calling thread, for the trie |local_owner|
+// during its phase |local_phase|. Since phases are unique, a local
+// trie is never used after it has been merged.
+static __thread Trie* local_owner = NULL;
+static __thread uint64_t local_phase = 0;
+static __thread Trie* local_trie = NULL;
+
+Trie* get_local_trie(Trie* trie) {
+  if (local_owner == trie && local_phase == trie->phase) {
+    return local_trie;
+  }
+  Trie* local = make_trie(trie->childs_len);
+  pthread_mutex_lock(&trie->locals_mutex);
+  if (trie->locals_count == trie->locals_capacity) {
+    trie->locals_capacity = trie->locals_capacity ? trie->locals_capacity * 2 : 8;
+    trie->locals = realloc(trie->locals, trie->locals_capacity * sizeof(*trie->locals));
+  }
+  trie->locals[trie->locals_count++] = local;
+  local_phase = trie->phase;
+  pthread_mutex_unlock(&trie->locals_mutex);
+  local_owner = trie;
+  local_trie = local;
+  return local;
+}
+
+typedef struct _staged_tuple {
+  Comb* comb;
+  int comb_len;
+  int secret; // The first secret set in |secret_deps|
+  SecretDep* secret_deps;
+} StagedTuple;
+
+typedef struct _staged_tuples {
+  StagedTuple* content;
+  int length;
+  int max_length;
+  int secret_count;
+  Arena* arena; // For the combs
+} StagedTuples;
+
+static void collect_staged_tuples(TrieNode* trie, StagedTuples* staged,
+                                  Comb* work_comb, int work_comb_idx) {
+  if (!trie->childs) {
+    if (staged->length == staged->max_length) {
+      staged->max_length = staged->max_length ? staged->max_length * 2 : 64;
+      staged->content = realloc(staged->content,
+                                staged->max_length * sizeof(*staged->content));
+    }
+    StagedTuple* tuple = &staged->content[staged->length++];
+    tuple->comb = arena_alloc(staged->arena, work_comb_idx * sizeof(*tuple->comb));
+    memcpy(tuple->comb, work_comb, work_comb_idx * sizeof(*tuple->comb));
+    tuple->comb_len = work_comb_idx;
+    tuple->secret_deps = trie->secret_deps;
+    tuple->secret = 0;
+    if (trie->secret_deps) {
+      while (tuple->secret < staged->secret_count - 1 &&
+             !trie->secret_deps[tuple->secret]) {
+        tuple->secret++;
+      }
+    }
+    return;
+  }
+  for (int i = 0; i < trie->childs_count; i++) {
+    work_comb[work_comb_idx] = trie->vars[i];
+    collect_staged_tuples(trie->childs[i], staged, work_comb, work_comb_idx+1);
+  }
+}
+
+static int compare_staged_tuples(const void* a_void, const void* b_void) {
+  const StagedTuple* a = a_void;
+  const StagedTuple* b = b_void;
+  if (a->comb_len != b->comb_len) return a->comb_len - b->comb_len;
+  if (a->secret != b->secret) return a->secret - b->secret;
+  for (int i = 0; i < a->comb_len; i++) {
+    if (a->comb[i] != b->comb[i]) return a->comb[i] < b->comb[i] ? -1 : 1;
+  }
+  return 0;
+}
+
+void merge_local_tries(Trie* trie, int secret_count) {
+  StagedTuples staged = { NULL, 0, 0, secret_count, make_arena("trie_merge") };
+  // Assumes that no incompressible tuple is more than 100 elements long
+  Comb work_comb[100];
+  for (int i = 0; i < trie->locals_count; i++) {
+    collect_staged_tuples(trie->locals[i]->head, &staged, work_comb, 0);
+  }
+  qsort(staged.content, staged.length, sizeof(*staged.content), compare_staged_tuples);
+
+  for (int i = 0; i < staged.length; i++) {
+    StagedTuple* tuple = &staged.content[i];
+    if (trie_contains_subset(trie, tuple->comb, tuple->comb_len)) continue;
+    SecretDep* secret_deps = NULL;
+    if (tuple->secret_deps) {
+      secret_deps = malloc(secret_count * sizeof(*secret_deps));
+      memcpy(secret_deps, tuple->secret_deps, secret_count * sizeof(*secret_deps));
+    }
+    _insert_in_trie_arith(trie, tuple->comb, tuple->comb_len,
+                          secret_deps, secret_count);
+  }
+
+  free(staged.content);
+  free_arena(staged.arena);
+  for (int i = 0; i < trie->locals_count; i++) {
+    free_trie(trie->locals[i]);
+  }
+  trie->locals_count = 0;
+  trie->phase = new_phase();
+}
+
+
 
 
 /*
@@ -8,20 +8,71 @@
 // contain a tuple t and a tuple t' that is a subtuple of t. Thus, the
 // criteria we use to know where to stop in the sub-tries is: if
 // |childs| is NULL, then we are on a leaf.
+//
+// The children of a node are stored sparsely: |vars| contains the
+// variables of the children in ascending order, and |childs[i]| is the
+// child for |vars[i]|. Tuples are sparse over the variables of a
+// circuit, and a dense array of |childs_len| pointers per node would
+// be almost entirely made of NULL pointers.
+//
+// The nodes and their arrays of children are allocated in an arena
+// (see arena.h) owned by the trie, so that free_trie does not have to
+// traverse the trie. The |secret_deps| given to insert_in_trie* are
+// still malloc'ed by the callers; the trie keeps a list of those it
+// stores, and frees them along with the trie.
+//
+// To answer trie_contains_subset (does the trie contain a subtuple of
+// a given tuple?) without exploring all the subsequences of the
+// tuple, the trie also keeps a subset index: for each variable v, the
+// list of the tuples of the trie whose first (ie, smallest) variable
+// is v, along with a 64-bit signature of their variables (bit v % 64
+// is set for each variable v). A query for a tuple t only scans the
+// lists of the variables of t, and the signatures discard most of the
+// tuples that are not subtuples of t without looking at them.
+//
+// The tuples of the index are also chained by size, and counted, so
+// that the queries about the tuples of a given size (trie_tuples_size,
+// list_from_trie...) only cost as much as the number of such tuples,
+// rather than a traversal of the whole trie.
 
+#include <pthread.h>
+
+#include "arena.h"
 #include "combinations.h"
 #include "list_tuples.h"
 #include "vectors.h"
 
 
 typedef struct _trie_node {
-  struct _trie_node** childs;
+  struct _trie_node** childs; // NULL for leaves
+  Var* vars; // The variable of each child, in ascending order
+  int childs_count; // The number of children
+  int childs_capacity; // The allocated size of |childs| and |vars|
   SecretDep* secret_deps;
 } TrieNode;
 
+typedef struct _subset_list SubsetList;
+typedef struct _size_chain SizeChain;
+
 typedef struct _trie {
-  int childs_len;
+  int childs_len; // The number of variables (which are in [0, childs_len))
   TrieNode* head;
+  Arena* arena;   // Nodes and arrays of children
+  SecretDep** owned_deps; // The |secret_deps| stored in the nodes
+  int owned_deps_count;
+  int owned_deps_capacity;
+  SubsetList* index; // index[v]: the tuples whose first variable is v
+  int index_len;     // The number of lists in |index|
+  SizeChain* sizes;  // sizes[n]: the tuples of size n
+  int sizes_len;     // The number of chains in |sizes|
+  int tuple_count;   // The number of tuples in |index|
+  // Tries local to the threads that fill this trie in parallel (see
+  // get_local_trie below).
+  pthread_mutex_t locals_mutex;
+  struct _trie** locals;
+  int locals_count;
+  int locals_capacity;
+  uint64_t phase; // Unique id, renewed every time |locals| are merged
 } Trie;
 
 void free_trie(Trie* trie);
@@ -42,6 +93,20 @@ Trie *derive_trie_from_subset(Trie *trie, int *subset, int len_subset,
                               int circuit_length, int secret_count,
                               int idx_output_end, int coeff_max);
                               
+// The tuples of the list are allocated in the arena of the list, and
+// are freed by free_list.
 ListComb* list_from_trie(Trie* trie, int comb_len);
 VarVecVector* get_all_tuples(Trie* trie);
 Trie *trie_copy(Trie *trie, int secret_count);
+
+// Filling a trie in parallel (used by the arithmetic constructive
+// algorithms, and by _verify_tuples with --incompr-opt): during a phase (eg, the search of the incompressible
+// tuples of a given size), |trie| is only read, and each thread
+// inserts the tuples it finds in its own local trie, returned by
+// get_local_trie, without any lock. Once all threads are done,
+// merge_local_tries moves the tuples of all local tries into
+// |trie|: by increasing size, then by secret (the first secret set in
+// their |secret_deps|), a tuple is only inserted if none of its
+// subtuples is in |trie|, as the sequential algorithm would do.
+Trie* get_local_trie(Trie* trie);
+void merge_local_tries(Trie* trie, int secret_count);
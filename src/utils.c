@@ -32,6 +32,108 @@ int is_coeff (char* s, int index){
   return (is_number(s[index]) && (index == 0 || is_space(s[index - 1]) || s[index - 1] == '-'));
 }
 
+/* ***************************************************** */
+/*              String hash index                        */
+/* ***************************************************** */
+
+#define STR_INDEX_MIN_CAPACITY 16
+
+// FNV-1a
+static uint64_t str_hash(const char* str) {
+  uint64_t h = 0xcbf29ce484222325ULL;
+  for (; *str; str++) {
+    h = (h ^ (uint8_t)*str) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+void str_index_init(StrIndex* index) {
+  index->keys = NULL;
+  index->elems = NULL;
+  index->capacity = 0;
+  index->count = 0;
+}
+
+void str_index_free(StrIndex* index) {
+  free(index->keys);
+  free(index->elems);
+  str_index_init(index);
+}
+
+void str_index_clear(StrIndex* index) {
+  if (index->capacity) {
+    memset(index->keys, 0, index->capacity * sizeof(*index->keys));
+  }
+  index->count = 0;
+}
+
+// Returns the slot of |key| in |index|, or the empty slot where it
+// should be added. |index| must not be empty.
+static int str_index_slot(const StrIndex* index, const char* key) {
+  int mask = index->capacity - 1;
+  int i = str_hash(key) & mask;
+  while (index->keys[i] && strcmp(index->keys[i], key) != 0) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+static void str_index_grow(StrIndex* index) {
+  char** old_keys = index->keys;
+  void** old_elems = index->elems;
+  int old_capacity = index->capacity;
+  index->capacity = old_capacity ? 2 * old_capacity : STR_INDEX_MIN_CAPACITY;
+  index->keys = calloc(index->capacity, sizeof(*index->keys));
+  index->elems = malloc(index->capacity * sizeof(*index->elems));
+  for (int i = 0; i < old_capacity; i++) {
+    if (old_keys[i]) {
+      int slot = str_index_slot(index, old_keys[i]);
+      index->keys[slot] = old_keys[i];
+      index->elems[slot] = old_elems[i];
+    }
+  }
+  free(old_keys);
+  free(old_elems);
+}
+
+void* str_index_get(const StrIndex* index, const char* key) {
+  if (!index->count) return NULL;
+  int slot = str_index_slot(index, key);
+  return index->keys[slot] ? index->elems[slot] : NULL;
+}
+
+void str_index_set(StrIndex* index, char* key, void* elem) {
+  // Keeping the load factor below 1/2
+  if (2 * (index->count + 1) > index->capacity) str_index_grow(index);
+  int slot = str_index_slot(index, key);
+  if (!index->keys[slot]) index->count++;
+  index->keys[slot] = key;
+  index->elems[slot] = elem;
+}
+
+void str_index_remove(StrIndex* index, const char* key) {
+  if (!index->count) return;
+  int mask = index->capacity - 1;
+  int i = str_index_slot(index, key);
+  if (!index->keys[i]) return;
+  index->count--;
+  // Moving back the following keys of the cluster that would no
+  // longer be reachable (backward shift deletion).
+  int j = i;
+  while (1) {
+    index->keys[i] = NULL;
+    do {
+      j = (j + 1) & mask;
+      if (!index->keys[j]) return;
+    } while (((j - (int)(str_hash(index->keys[j]) & mask)) & mask) <
+             ((j - i) & mask));
+    index->keys[i] = index->keys[j];
+    index->elems[i] = index->elems[j];
+    i = j;
+  }
+}
+
+
 /* ***************************************************** */
 /*              String/Int map utilities                 */
 /* ***************************************************** */
@@ -41,6 +143,7 @@ StrMap* make_str_map(char* name) {
   map->name = strdup(name);
   map->head = NULL;
   map->next_val = 0;
+  str_index_init(&map->index);
   return map;
 }
 
@@ -51,6 +154,7 @@ void str_map_add_with_val(StrMap* map, char* str, int val) {
   e->val = val;
   e->next = map->head;
   map->head = e;
+  str_index_set(&map->index, e->key, e);
 }
 
 void str_map_add(StrMap* map, char* str) {
@@ -58,52 +162,34 @@ void str_map_add(StrMap* map, char* str) {
 }
 
 void str_map_remove(StrMap* map, char* str) {
-  StrMapElem* e = map->head;
-  if (!e) return;
-
-  if (strcmp(e->key, str) == 0) {
-    map->head = e->next;
-    free(e->key);
-    free(e);
-    return;
-  }
-  StrMapElem* prev = e;
-  e = e->next;
-  while (e) {
-    if (strcmp(e->key, str) == 0) {
-      prev->next = e->next;
-      free(e->key);
-      free(e);
-      return;
-    }
-    prev = e;
-    e = e->next;
+  StrMapElem* target = str_index_get(&map->index, str);
+  if (!target) return;
+
+  StrMapElem** prev = &map->head;
+  while (*prev != target) prev = &(*prev)->next;
+  *prev = target->next;
+
+  // Another element with the same key may follow |target|.
+  StrMapElem* e = target->next;
+  while (e && strcmp(e->key, str) != 0) e = e->next;
+  if (e) {
+    str_index_set(&map->index, e->key, e);
+  } else {
+    str_index_remove(&map->index, str);
   }
+  free(target->key);
+  free(target);
 }
 
 int str_map_get(StrMap* map, char* str) {
-  StrMapElem* curr = map->head;
-
-  while (curr) {
-    if (strcmp(curr->key, str) == 0) {
-      return curr->val;
-    }
-    curr = curr->next;
-  }
+  StrMapElem* e = str_index_get(&map->index, str);
+  if (e) return e->val;
   fprintf(stderr, "Elem '%s' not found in map '%s'.\n", str, map->name);
   exit(EXIT_FAILURE);
 }
 
 int str_map_contains(StrMap* map, char* str) {
-  StrMapElem* curr = map->head;
-
-  while (curr) {
-    if (strcmp(curr->key, str) == 0) {
-      return 1;
-    }
-    curr = curr->next;
-  }
-  return 0;
+  return str_index_get(&map->index, str) != NULL;
 }
 
 void free_str_map(StrMap* map) {
@@ -114,6 +200,7 @@ void free_str_map(StrMap* map) {
     free(e);
     e = next;
   }
+  str_index_free(&map->index);
   free(map->name);
   free(map);
 }
@@ -129,18 +216,24 @@ void print_str_map(StrMap* map) {
 }
 
 StrMapElem* _reverse_str_map(StrMapElem* e, StrMapElem* prev) {
-  if (!e->next) {
+  while (e) {
+    StrMapElem* next = e->next;
     e->next = prev;
-    return e;
+    prev = e;
+    e = next;
   }
-  StrMapElem* new = _reverse_str_map(e->next, e);
-  e->next = prev;
-  return new;
+  return prev;
 }
 
 void reverse_str_map(StrMap* map) {
-  StrMapElem* e = map->head;
-  map->head = _reverse_str_map(e, NULL);
+  map->head = _reverse_str_map(map->head, NULL);
+  // The first element of each key is now the one that was last.
+  str_index_clear(&map->index);
+  for (StrMapElem* e = map->head; e != NULL; e = e->next) {
+    if (!str_index_get(&map->index, e->key)) {
+      str_index_set(&map->index, e->key, e);
+    }
+  }
 }
 
 
@@ -215,6 +308,7 @@ EqList* make_eq_list() {
   EqList* l = malloc(sizeof(*l));
   l->size = 0;
   l->head = NULL;
+  str_index_init(&l->index);
   return l;
 }
 
@@ -228,6 +322,7 @@ void add_eq_list(EqList* l, char* dst, Expr* e, bool anti_glitch, bool correctio
   el->next = l->head;
   l->head = el;
   l->size++;
+  str_index_set(&l->index, el->dst, el);
 }
 
 void free_eq_list(EqList* l) {
@@ -243,6 +338,7 @@ void free_eq_list(EqList* l) {
     free(el);
     el = next;
   }
+  str_index_free(&l->index);
   free(l);
 }
 
@@ -258,14 +354,7 @@ void print_eq_list(EqList* l) {
 }
 
 EqListElem * get_eq_list(EqList* l, char* dst) {
-  EqListElem * h = l->head;
-  while(h){
-    if(strcmp(h->dst, dst) == 0){
-      return h;
-    }
-    h = h->next;
-  }
-  return NULL;
+  return str_index_get(&l->index, dst);
 }
 
 void print_eq_full_expr(EqList* l, char* dst){
@@ -296,18 +385,24 @@ void print_eq_full_expr(EqList* l, char* dst){
 }
 
 EqListElem* _reverse_eq_list(EqListElem* el, EqListElem* prev) {
-  if (!el->next) {
+  while (el) {
+    EqListElem* next = el->next;
     el->next = prev;
-    return el;
+    prev = el;
+    el = next;
   }
-  EqListElem* new = _reverse_eq_list(el->next, el);
-  el->next = prev;
-  return new;
+  return prev;
 }
 
 void reverse_eq_list(EqList* l) {
-  EqListElem* el = l->head;
-  l->head = _reverse_eq_list(el, NULL);
+  l->head = _reverse_eq_list(l->head, NULL);
+  // The first equation of each variable is now the one that was last.
+  str_index_clear(&l->index);
+  for (EqListElem* el = l->head; el != NULL; el = el->next) {
+    if (!str_index_get(&l->index, el->dst)) {
+      str_index_set(&l->index, el->dst, el);
+    }
+  }
 }
 
 
@@ -321,6 +416,7 @@ DepMap* make_dep_map(char* name) {
   DepMap* map = malloc(sizeof(*map));
   map->name = strdup(name);
   map->head = NULL;
+  str_index_init(&map->index);
   return map;
 }
 
@@ -333,17 +429,12 @@ void dep_map_add(DepMap* map, char* str, Dependency* std_dep, DepArrVector* glit
   e->original_dep = original_dep;
   e->next = map->head;
   map->head = e;
+  str_index_set(&map->index, e->key, e);
 }
 
 DepMapElem* dep_map_get(DepMap* map, char* dep) {
-  DepMapElem* curr = map->head;
-
-  while (curr) {
-    if (strcmp(curr->key, dep) == 0) {
-      return curr;
-    }
-    curr = curr->next;
-  }
+  DepMapElem* e = str_index_get(&map->index, dep);
+  if (e) return e;
   fprintf(stderr, "Elem '%s' not found in map '%s'.\n", dep, map->name);
   exit(EXIT_FAILURE);
 }
@@ -351,14 +442,7 @@ DepMapElem* dep_map_get(DepMap* map, char* dep) {
 // Same as dep_map_get, but if |dep| is not found in |map|, returns
 // NULL instead of crashing.
 DepMapElem* dep_map_get_nofail(DepMap* map, char* dep) {
-  DepMapElem* curr = map->head;
-  while (curr) {
-    if (strcmp(curr->key, dep) == 0) {
-      return curr;
-    }
-    curr = curr->next;
-  }
-  return NULL;
+  return str_index_get(&map->index, dep);
 }
 
 char* dep_get_from_expr_nofail(DependencyList* deps, int length, Dependency* dep, DepArrVector* dep_arr, int deps_size) {
@@ -391,6 +475,7 @@ void free_dep_map(DepMap* map) {
     free(e);
     e = next;
   }
+  str_index_free(&map->index);
   free(map->name);
   free(map);
 }
@@ -31,12 +31,42 @@ int is_eol(char c);
 int is_number (char c);
 int is_coeff (char* s, int index);
 
+/* ***************************************************** */
+/*              String hash index                        */
+/* ***************************************************** */
+
+// Index of the elements of a StrMap, EqList or DepMap by key: an
+// open-addressing hash table (with linear probing) from strings to
+// elements. It does not own its keys, which are those of the
+// elements. When several elements have the same key, the index
+// points to the first one in the list, which is the one that a scan
+// of the list would find.
+
+typedef struct _StrIndex {
+  char** keys;
+  void** elems;
+  int capacity; // Power of 2 (0 if nothing was ever added)
+  int count;
+} StrIndex;
+
+void str_index_init(StrIndex* index);
+void str_index_free(StrIndex* index);
+// Returns the element of |key|, or NULL if there are none.
+void* str_index_get(const StrIndex* index, const char* key);
+// Sets the element of |key| to |elem| (replacing the previous one, if
+// any). |key| must live as long as it is in |index|.
+void str_index_set(StrIndex* index, char* key, void* elem);
+void str_index_remove(StrIndex* index, const char* key);
+void str_index_clear(StrIndex* index);
+
+
 /* ***************************************************** */
 /*              String/Int map utilities                 */
 /* ***************************************************** */
 
-// For simplicity, a map is implemented using a linked-list. This is
-// far from efficient, but parsing is hardly the bottleneck of IronMask.
+// A map is a linked-list, indexed by a StrIndex: lookups are in
+// constant time, while the list preserves the order of the elements
+// (most recent first, until reversed). Removals are linear.
 
 typedef struct _StrMapElem {
   char* key;
@@ -48,6 +78,7 @@ typedef struct _StrMap {
   char* name;
   StrMapElem* head;
   int next_val;
+  StrIndex index;
 } StrMap;
 
 StrMap* make_str_map(char* name);
@@ -113,6 +144,7 @@ typedef struct _EqListElem {
 typedef struct _EqList {
   int size;
   EqListElem* head;
+  StrIndex index; // Equations by |dst|
 } EqList;
 
 EqList* make_eq_list();
@@ -140,6 +172,7 @@ typedef struct _DepMapElem {
 typedef struct _DepMap {
   char* name;
   DepMapElem* head;
+  StrIndex index;
 } DepMap;
 
 DepMap* make_dep_map(char* name);
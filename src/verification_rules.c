@@ -6,12 +6,20 @@
 #include <stdbool.h>
 #include <pthread.h>
 #include <inttypes.h>
+#include <time.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 #include "verification_rules.h"
 #include "list_tuples.h"
 #include "combinations.h"
 #include "trie.h"
 #include "vectors.h"
+#include "config.h"
+#include "shard.h"
+#include "checkpoint.h"
+#include "stats.h"
 
 /**********************************************************************
               Very high level description
@@ -249,17 +257,12 @@ int expand_tuple_to_failure(const Circuit* c,
 #endif
 
 // Returns the maximum number of secret shares of the same input in
-// |comb|, ignoring |shares_to_ignore| (used for PINI).
-int get_number_of_shares(const Circuit* c, const Comb* comb, int comb_len,
-                         Dependency shares_to_ignore, bool PINI) {
-  DependencyList* deps = c->deps;
+// a tuple containing the shares |secret_dep_1| and |secret_dep_2|,
+// ignoring |shares_to_ignore| (used for PINI).
+static int count_shares(const Circuit* c,
+                        Dependency secret_dep_1, Dependency secret_dep_2,
+                        Dependency shares_to_ignore, bool PINI) {
   int secret_count = c->secret_count;
-  Dependency secret_dep_1 = 0, secret_dep_2 = 0;
-  for (int i = 0; i < comb_len; i++) {
-    int idx = comb[i];
-    secret_dep_1 |= deps->contained_secrets[idx][0];
-    secret_dep_2 |= deps->contained_secrets[idx][1];
-  }
   if (PINI) {
     return hamming_weight((secret_dep_1 | secret_dep_2) & ~shares_to_ignore);
   }
@@ -324,6 +327,28 @@ int set_contained_shares(const Circuit * c, char* leaky_inputs, Dependency* secr
 }
 
 
+// Computes |dst| ^= |src|. Both BitDeps must have the same layout,
+// and, since |bits_len| is a multiple of BITDEP_ALIGN_WORDS, their
+// bitvectors can be xored 256 bits at a time. (Unaligned loads are
+// used since some BitDeps are allocated with alloca.)
+static inline void xor_bit_dep(BitDep* dst, const BitDep* src) {
+  dst->secrets[0] ^= src->secrets[0];
+  dst->secrets[1] ^= src->secrets[1];
+  dst->out ^= src->out;
+  dst->constant ^= src->constant;
+#ifdef __AVX2__
+  for (int j = 0; j < src->bits_len; j += BITDEP_ALIGN_WORDS) {
+    __m256i a = _mm256_loadu_si256((__m256i*) &dst->bits[j]);
+    __m256i b = _mm256_loadu_si256((const __m256i*) &src->bits[j]);
+    _mm256_storeu_si256((__m256i*) &dst->bits[j], _mm256_xor_si256(a, b));
+  }
+#else
+  for (int j = 0; j < src->bits_len; j++) {
+    dst->bits[j] ^= src->bits[j];
+  }
+#endif
+}
+
 // |gauss_deps|: the dependencies after gauss elimination up to index
 //               |idx| (excluded). Note that even if an element is
 //               fully masked by a random, we keep its other
@@ -335,48 +360,23 @@ int set_contained_shares(const Circuit * c, char* leaky_inputs, Dependency* secr
 //
 // |real_dep|: the dependency to add to |gauss_deps|, at index |idx|.
 //
-// |deps_size|: the size of the dependencies in |gauss_deps| and of |real_dep|.
-//
 // This function adds |real_dep| to |gauss_deps|, and performs a Gauss
 // elimination on this element: all previous elements of |gauss_deps|
 // have already been eliminated, and we xor them as needed with |real_dep|.
-static void gauss_step(const Circuit * c,
-                       BitDep* real_dep,
+static void gauss_step(BitDep* real_dep,
                        BitDep** gauss_deps,
                        GaussRand* gauss_rands,
-                       int bit_rand_len,
-                       int bit_mult_len,
-                       int bit_correction_outputs_len,
                        int idx) {
   BitDep* dep_target = gauss_deps[idx];
   if (dep_target != real_dep) {
-    memcpy(dep_target, real_dep, sizeof(*dep_target));
+    copy_bit_dep(dep_target, real_dep);
   }
   for (int i = 0; i < idx; i++) {
     if (!gauss_rands[i].is_set) continue;
     int r_idx  = gauss_rands[i].idx;
     uint64_t r_mask = gauss_rands[i].mask;
     if (dep_target->randoms[r_idx] & r_mask) {
-      for(int j=0; j<c->secret_count; j++){
-        dep_target->secrets[j] ^= gauss_deps[i]->secrets[j];
-      }
-      if(c->faults_on_inputs){
-        for(int j=0; j< c->secret_count*c->share_count; j++){
-          dep_target->duplicate_secrets[j] ^= gauss_deps[i]->duplicate_secrets[j];
-        }
-      }
-      for (int j = 0; j < bit_rand_len; j++) {
-        dep_target->randoms[j] ^= gauss_deps[i]->randoms[j];
-      }
-      for (int j = 0; j < bit_mult_len; j++) {
-        dep_target->mults[j] ^= gauss_deps[i]->mults[j];
-      }
-      for (int j = 0; j < bit_correction_outputs_len; j++) {
-        dep_target->correction_outputs[j] ^= gauss_deps[i]->correction_outputs[j];
-      }
-      dep_target->constant ^= gauss_deps[i]->constant;
-
-      dep_target->out ^= gauss_deps[i]->out;
+      xor_bit_dep(dep_target, gauss_deps[i]);
     }
   }
 }
@@ -453,12 +453,10 @@ static int is_failure_with_randoms(const Circuit* circuit,
   int secret_count = circuit->secret_count;
   int random_count = circuit->random_count;
   int share_count = circuit->share_count;
-  int mult_count = deps->mult_deps->length;
   int non_mult_deps_count = circuit->deps->first_mult_idx;
   int bit_rand_len = 1 + random_count / 64;
   int corr_outputs_count = deps->correction_outputs->length;
 
-  int bit_mult_len = (mult_count == 0) ? 0 :  1 + mult_count / 64;
   int bit_correction_outputs_len = (corr_outputs_count == 0) ? 0 : 1 + corr_outputs_count / 64;
 
   // Collecting all randoms of |local_deps| in the binary array |randoms|.
@@ -550,7 +548,7 @@ static int is_failure_with_randoms(const Circuit* circuit,
                              circuit->faults_on_inputs, secret_count,
                              share_count);
         } else {
-          memcpy(local_deps_copy[copy_size], local_deps[i], sizeof(*local_deps[i]));
+          copy_bit_dep(local_deps_copy[copy_size], local_deps[i]);
           for (int j = 0; j < bit_rand_len; j++) {
             local_deps_copy[copy_size]->randoms[j] = (local_deps[i]->randoms[j] & selected_randoms[j]) ^ local_deps[i]->randoms[j];
           }
@@ -559,8 +557,7 @@ static int is_failure_with_randoms(const Circuit* circuit,
       }
 
       for (int i = 0; i < copy_size; i++) {
-          gauss_step(circuit, local_deps_copy[i], local_deps_copy, gauss_rands_copy,
-                    bit_rand_len, bit_mult_len, bit_correction_outputs_len, i);
+          gauss_step(local_deps_copy[i], local_deps_copy, gauss_rands_copy, i);
           set_gauss_rand(local_deps_copy, gauss_rands_copy, i, bit_rand_len, circuit->deps->correction_outputs, bit_correction_outputs_len);
       }
 
@@ -594,6 +591,15 @@ static int is_failure_with_randoms(const Circuit* circuit,
 }
 
 
+// The factorization table of factorize_mults. |touched[i]| is true if
+// |rows[i]| has been modified since the table was last cleared: only
+// those rows need to be read and cleared after each factorization.
+typedef struct _fact_table {
+  BitDep** rows;
+  bool* touched;
+  int length;
+} FactTable;
+
 // Updates the factorization table |factorized_deps| according to the
 // dependencies of |mult|.
 //
@@ -612,11 +618,13 @@ static int is_failure_with_randoms(const Circuit* circuit,
 //
 
 static void factorize_expr(const Circuit * c,
-                           BitDep** factorized_deps, int idx,
+                           FactTable* fact_table, int idx,
                            Dependency* dep, int secret_count, 
                            int first_rand_idx,
                            int non_mult_deps_count, int corr_output_length,
                            int corr_output_first_idx, int deps_size){
+  BitDep** factorized_deps = fact_table->rows;
+  fact_table->touched[idx] = true;
 
   for (int j = 0; j < secret_count; j++) {
     if (dep[j]) {
@@ -648,7 +656,7 @@ static void factorize_expr(const Circuit * c,
 }
 
 
-void factorize_inner_mults(const Circuit* c, BitDep** factorized_deps,
+void factorize_inner_mults(const Circuit* c, FactTable* fact_table,
                            MultDependency* mult) {
   int secret_count        = c->secret_count;
   int share_count         = c->share_count;
@@ -683,13 +691,13 @@ void factorize_inner_mults(const Circuit* c, BitDep** factorized_deps,
     }
     for (int j = 0; j < share_count; j++) {
       if (left[i] & (1ULL << j)) {
-        factorize_expr(c, factorized_deps, i*share_count+j, right,
+        factorize_expr(c, fact_table, i*share_count+j, right,
                        secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                        corr_output_first_idx, c->deps->deps_size);
 
       } else if (right[i] & (1ULL << j)) {
 
-        factorize_expr(c, factorized_deps, i*share_count+j, left,
+        factorize_expr(c, fact_table, i*share_count+j, left,
                        secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                        corr_output_first_idx, c->deps->deps_size);
       }
@@ -708,11 +716,11 @@ void factorize_inner_mults(const Circuit* c, BitDep** factorized_deps,
         for(int k=0; k< c->nb_duplications; k++){
           int f_idx = duplicate_offset + i * share_count * c->nb_duplications + j * c->nb_duplications + k;
           if (left[idx] & (1ULL << k)) {
-            factorize_expr(c, factorized_deps, f_idx, right,
+            factorize_expr(c, fact_table, f_idx, right,
                        secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                        corr_output_first_idx, c->deps->deps_size);
           } else if (right[idx] & (1ULL << k)) {
-            factorize_expr(c, factorized_deps, f_idx, left,
+            factorize_expr(c, fact_table, f_idx, left,
                        secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                        corr_output_first_idx, c->deps->deps_size);
           }
@@ -730,13 +738,13 @@ void factorize_inner_mults(const Circuit* c, BitDep** factorized_deps,
     }
     if (left[i]) {
 
-      factorize_expr(c, factorized_deps, i-first_rand_idx+rand_offset, right,
+      factorize_expr(c, fact_table, i-first_rand_idx+rand_offset, right,
                      secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                      corr_output_first_idx, c->deps->deps_size);
 
     } else if (right[i]) {
 
-      factorize_expr(c, factorized_deps, i-first_rand_idx+rand_offset, left,
+      factorize_expr(c, fact_table, i-first_rand_idx+rand_offset, left,
                      secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                      corr_output_first_idx, c->deps->deps_size);
     }
@@ -751,13 +759,13 @@ void factorize_inner_mults(const Circuit* c, BitDep** factorized_deps,
     }
     if (left[i+corr_output_first_idx]) {
 
-      factorize_expr(c, factorized_deps, i+corr_output_offset, right,
+      factorize_expr(c, fact_table, i+corr_output_offset, right,
                      secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                      corr_output_first_idx, c->deps->deps_size);
 
     } else if (right[i+corr_output_first_idx]) {
 
-      factorize_expr(c, factorized_deps, i+corr_output_offset, left,
+      factorize_expr(c, fact_table, i+corr_output_offset, left,
                   secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                   corr_output_first_idx, c->deps->deps_size);
     }
@@ -767,26 +775,41 @@ void factorize_inner_mults(const Circuit* c, BitDep** factorized_deps,
   //constant term
   int const_offset = inputs_real_count + c->random_count + c->deps->correction_outputs->length;
   if (left[c->deps->deps_size-1]) {
-    factorize_expr(c, factorized_deps, const_offset, right,
+    factorize_expr(c, fact_table, const_offset, right,
                      secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                      corr_output_first_idx, c->deps->deps_size);
   } 
   const_offset++;
   if (right[c->deps->deps_size-1]) {
-    factorize_expr(c, factorized_deps, const_offset, left,
+    factorize_expr(c, fact_table, const_offset, left,
                      secret_count, first_rand_idx, non_mult_deps_count, corr_output_length,
                      corr_output_first_idx, c->deps->deps_size);
   }
 
 }
 
+// Returns the number of rows of the factorization table of |c|: one
+// per input share (including duplicated ones), random and correction
+// output, plus 2 for the constant terms on both sides.
+static int fact_table_length(const Circuit* c) {
+  int inputs_real_count = c->secret_count * c->share_count;
+  if(c->faults_on_inputs){
+    inputs_real_count += c->secret_count * c->share_count * c->nb_duplications;
+  }
+  return inputs_real_count + c->random_count + c->deps->correction_outputs->length + 2;
+}
+
 // Factorizes the dependencies in |comb|. For each element of |comb|,
 // all dependencies are unfolded (by distributing the multiplication
 // inside the additions).
+//
+// |fact_table| must be clear (all rows zero and untouched), and is
+// left clear.
 void factorize_mults(const Circuit* c, BitDep** local_deps,
                      BitDep** deps_fact,
                      int* deps_length_fact,
-                     int local_deps_len) {
+                     int local_deps_len,
+                     FactTable* fact_table) {
   DependencyList* deps    = c->deps;
   int rand_count          = c->random_count;
   int mult_count          = deps->mult_deps->length;
@@ -800,16 +823,9 @@ void factorize_mults(const Circuit* c, BitDep** local_deps,
   const uint64_t* bit_i2_rands  = c->bit_i2_rands;
   const uint64_t* bit_out_rands = c->bit_out_rands;
 
-  int inputs_real_count = c->secret_count * c->share_count;
-  if(c->faults_on_inputs){
-    inputs_real_count += c->secret_count * c->share_count * c->nb_duplications;
-  }
-  int factorized_deps_length = inputs_real_count + c->random_count + deps->correction_outputs->length + 2; // + 2 for the constant terms on both sides
-
-  BitDep* factorized_deps[factorized_deps_length];
-  for (int i = 0; i < factorized_deps_length; i++) {
-    factorized_deps[i] = alloca(sizeof(**factorized_deps));
-  }
+  int factorized_deps_length = fact_table->length;
+  BitDep** factorized_deps = fact_table->rows;
+  bool* touched = fact_table->touched;
 
   for (int i = 0; i < local_deps_len; i++) {
     BitDep* dep = local_deps[i];
@@ -876,19 +892,6 @@ void factorize_mults(const Circuit* c, BitDep** local_deps,
     //    b1: a0 ^ r1
     //    r3: a0 ^ r1
 
-    // Resetting |factorized_deps| (note that the ->mults field is
-    // never used in |factorized_deps|)
-    for (int j = 0; j < factorized_deps_length; j++) {
-      factorized_deps[j]->secrets[0] = 0;
-      factorized_deps[j]->secrets[1] = 0;
-      memset(factorized_deps[j]->duplicate_secrets, 0,
-             c->secret_count * c->share_count * sizeof(*factorized_deps[j]->duplicate_secrets));
-      memset(factorized_deps[j]->randoms, 0,
-             bit_rand_len * sizeof(*factorized_deps[j]->randoms));
-      memset(factorized_deps[j]->correction_outputs, 0,
-             bit_correction_outputs_len * sizeof(*factorized_deps[j]->correction_outputs));
-    }
-
     for (int j = 0; j < bit_mult_len; j++) {
       uint64_t mult_elem = dep->mults[j];
       while (mult_elem != 0) {
@@ -897,12 +900,15 @@ void factorize_mults(const Circuit* c, BitDep** local_deps,
         int mult_idx = j * 64 + (63-mult_idx_in_elem);
         MultDependency* mult = deps->mult_deps->deps[mult_idx];
         //printf("mult = %s\n", mult->name);
-        factorize_inner_mults(c, factorized_deps, mult);
+        factorize_inner_mults(c, fact_table, mult);
       }
     }
 
-    // We now copy the factorized exrepssions in |deps_fact|
+    // We now copy the factorized exrepssions in |deps_fact|, and
+    // clear |factorized_deps| for the next element.
     for (int i = 0; i < factorized_deps_length; i++) {
+      if (!touched[i]) continue;
+      touched[i] = false;
 
       int rand_set = 0;
       for (int j = 0; j < bit_rand_len && !rand_set; j++) {
@@ -923,6 +929,7 @@ void factorize_mults(const Circuit* c, BitDep** local_deps,
             factorized_deps[i]->secrets[1] ||
             rand_set || corr_output_set || inp_set)) {
         // This element is empty; continuing
+        set_bit_dep_zero(factorized_deps[i]);
         continue;
       }
 
@@ -938,6 +945,7 @@ void factorize_mults(const Circuit* c, BitDep** local_deps,
       memcpy(deps_fact[*deps_length_fact]->correction_outputs, factorized_deps[i]->correction_outputs,
               bit_correction_outputs_len * sizeof(*factorized_deps[i]->correction_outputs));
       (*deps_length_fact)++;
+      set_bit_dep_zero(factorized_deps[i]);
     }
   }
 
@@ -967,8 +975,7 @@ static void replace_correction_outputs_in_dep(const Circuit * c, BitDep** local_
 
       for(int dep_idx=0; dep_idx< bit_dep_arr->length; dep_idx++){
 
-        gauss_step(c, bit_dep_arr->content[dep_idx], local_deps, gauss_rands,
-                bit_rand_len, bit_mult_len, bit_correction_outputs_len, *local_deps_len);
+        gauss_step(bit_dep_arr->content[dep_idx], local_deps, gauss_rands, *local_deps_len);
         set_gauss_rand(local_deps, gauss_rands, *local_deps_len, bit_rand_len, correction_outputs, bit_correction_outputs_len);
 
         (*local_deps_len)++;
@@ -1054,6 +1061,127 @@ Comb* init_comb(Comb* first_comb, int sub_comb_len, VarVector* prefix, int max_c
   return comb;
 }
 
+/**********************************************************************
+              Scratch buffers
+
+  _verify_tuples needs a few arrays of BitDep (for the Gaussian
+  eliminations and the factorization of multiplications) whose size
+  depends on the circuit. Rather than allocating and zeroing them on
+  each call, each thread keeps them around and reuses them from one
+  call to the next. Since _verify_tuples can be called recursively
+  (typically through is_failure from a failure callback), each thread
+  has a small stack of scratch buffers.
+
+************************************************************************/
+
+typedef struct _verif_scratch {
+  int capacity; // Number of rows of each array
+  BitDepLayout layout; // Layout of the rows
+  char* rows; // Storage for the rows of the 3 arrays below
+  BitDep** local_deps;
+  BitDep** local_deps_copy;
+  BitDep** deps_fact;
+  GaussRand* gauss_rands;
+  GaussRand* gauss_rands_copy;
+  GaussRand* deps_rands_fact;
+  FactTable fact_table; // Used by factorize_mults
+  char* fact_rows; // Storage for the rows of |fact_table|
+} VerifScratch;
+
+#define VERIF_SCRATCH_MAX_DEPTH 4
+
+static __thread VerifScratch* thread_scratches[VERIF_SCRATCH_MAX_DEPTH];
+static __thread int thread_scratch_depth = 0;
+
+static void free_scratch(VerifScratch* scratch) {
+  if (!scratch) return;
+  free(scratch->rows);
+  free(scratch->local_deps);
+  free(scratch->local_deps_copy);
+  free(scratch->deps_fact);
+  free(scratch->gauss_rands);
+  free(scratch->gauss_rands_copy);
+  free(scratch->deps_rands_fact);
+  free(scratch->fact_table.rows);
+  free(scratch->fact_table.touched);
+  free(scratch->fact_rows);
+  free(scratch);
+}
+
+static VerifScratch* alloc_scratch(int capacity, int fact_length,
+                                   const BitDepLayout* layout) {
+  size_t row_size = bit_dep_size(layout);
+  VerifScratch* scratch = malloc(sizeof(*scratch));
+  scratch->capacity         = capacity;
+  scratch->layout           = *layout;
+  scratch->rows             = aligned_alloc(32, 3 * capacity * row_size);
+  scratch->local_deps       = malloc(capacity * sizeof(*scratch->local_deps));
+  scratch->local_deps_copy  = malloc(capacity * sizeof(*scratch->local_deps_copy));
+  scratch->deps_fact        = malloc(capacity * sizeof(*scratch->deps_fact));
+  scratch->gauss_rands      = malloc(capacity * sizeof(*scratch->gauss_rands));
+  scratch->gauss_rands_copy = malloc(capacity * sizeof(*scratch->gauss_rands_copy));
+  scratch->deps_rands_fact  = malloc(capacity * sizeof(*scratch->deps_rands_fact));
+  for (int i = 0; i < capacity; i++) {
+    scratch->local_deps[i] =
+      init_bit_dep_at(scratch->rows + i * row_size, layout);
+    scratch->local_deps_copy[i] =
+      init_bit_dep_at(scratch->rows + (capacity + i) * row_size, layout);
+    scratch->deps_fact[i] =
+      init_bit_dep_at(scratch->rows + (2 * capacity + i) * row_size, layout);
+  }
+
+  scratch->fact_table.length  = fact_length;
+  scratch->fact_table.rows    = malloc(fact_length * sizeof(*scratch->fact_table.rows));
+  scratch->fact_table.touched = calloc(fact_length, sizeof(*scratch->fact_table.touched));
+  scratch->fact_rows          = aligned_alloc(32, fact_length * row_size);
+  for (int i = 0; i < fact_length; i++) {
+    scratch->fact_table.rows[i] = init_bit_dep_at(scratch->fact_rows + i * row_size, layout);
+  }
+  return scratch;
+}
+
+// Returns scratch buffers of at least |capacity| rows with layout
+// |layout| for the current thread, with a factorization table of
+// |fact_length| rows. The buffers are reallocated (and thus zeroed)
+// when the layout changes. Must be paired with a call to
+// release_scratch.
+static VerifScratch* acquire_scratch(int capacity, int fact_length,
+                                     const BitDepLayout* layout) {
+  int depth = thread_scratch_depth++;
+  if (depth >= VERIF_SCRATCH_MAX_DEPTH) {
+    // Unusually deep recursion: using temporary buffers.
+    return alloc_scratch(capacity, fact_length, layout);
+  }
+
+  VerifScratch* scratch = thread_scratches[depth];
+  if (!scratch || scratch->capacity < capacity ||
+      scratch->fact_table.length != fact_length ||
+      memcmp(&scratch->layout, layout, sizeof(*layout)) != 0) {
+    free_scratch(scratch);
+    scratch = thread_scratches[depth] = alloc_scratch(capacity, fact_length, layout);
+  }
+  return scratch;
+}
+
+static void release_scratch(VerifScratch* scratch) {
+  int depth = --thread_scratch_depth;
+  if (depth >= VERIF_SCRATCH_MAX_DEPTH) {
+    free_scratch(scratch);
+  }
+}
+
+// Frees the scratch buffers of the current thread.
+static void free_thread_scratches() {
+  for (int i = 0; i < VERIF_SCRATCH_MAX_DEPTH; i++) {
+    free_scratch(thread_scratches[i]);
+    thread_scratches[i] = NULL;
+  }
+}
+
+// Number of calls to _verify_tuples in progress on the current thread
+// (they are nested when failure callbacks verify other tuples).
+static __thread int verify_depth = 0;
+
 // verify_tuples is our generic verification function. Depending on
 // its parameters, it can:
 //
@@ -1159,30 +1287,6 @@ int _verify_tuples(const Circuit* circuit, // The circuit
   /* printf("max_len = %d -- comb_len = %d ==> comb_free_space = %d\n", */
   /*        max_len, comb_len, comb_free_space); */
 
-  // Local dependencies
-  int local_deps_max_size = deps->length * 10; // sounds reasonable?
-  BitDep* local_deps[local_deps_max_size];
-  BitDep* local_deps_copy[local_deps_max_size];
-  for (int i = 0; i < local_deps_max_size; i++) {
-    local_deps[i] = alloca(sizeof(**local_deps));
-    set_bit_dep_zero(local_deps[i]);
-
-    local_deps_copy[i] = alloca(sizeof(**local_deps_copy));
-    set_bit_dep_zero(local_deps_copy[i]);
-  }
-  GaussRand gauss_rands[local_deps_max_size];
-  GaussRand gauss_rands_copy[local_deps_max_size];
-  
-  // Used when factorizing multiplications
-  BitDep* deps_fact[local_deps_max_size];
-  for (int i = 0; i < local_deps_max_size; i++) {
-    deps_fact[i] = alloca(sizeof(**deps_fact));
-    set_bit_dep_zero(deps_fact[i]);
-  }
-  int deps_length_fact = 0;
-  GaussRand deps_rands_fact[local_deps_max_size];
-
-
   SecretDep leaky_inputs[2] = { 0 }; // We could use |secret_count| instead of 2. However,
                                      // using 2 by default makes the code a bit simpler
                                      // (no need to add "if (secret_count == 2)" everywhere)
@@ -1200,6 +1304,32 @@ int _verify_tuples(const Circuit* circuit, // The circuit
     return 0;
   }
 
+  // Statistics (see stats.h). Only the top-level calls (as opposed to
+  // the ones made by failure callbacks) count in the progress of the
+  // current enumeration.
+  ThreadStats* stats = stats_enabled() ? get_thread_stats() : NULL;
+  bool top_level = verify_depth++ == 0;
+  bool report_progress = stats && top_level;
+  uint64_t call_start_ns = report_progress ? stats_now_ns() : 0;
+  uint64_t tuples_reported = 0; // Tuples already passed to stats_add_progress
+  uint64_t rejected_by_shares = 0;
+
+  // Local dependencies
+  int local_deps_max_size = deps->length * 10; // sounds reasonable?
+  BitDepLayout layout = get_bit_dep_layout(circuit);
+  VerifScratch* scratch = acquire_scratch(local_deps_max_size,
+                                          fact_table_length(circuit),
+                                          &layout);
+  BitDep** local_deps = scratch->local_deps;
+  BitDep** local_deps_copy = scratch->local_deps_copy;
+  GaussRand* gauss_rands = scratch->gauss_rands;
+  GaussRand* gauss_rands_copy = scratch->gauss_rands_copy;
+
+  // Used when factorizing multiplications
+  BitDep** deps_fact = scratch->deps_fact;
+  int deps_length_fact = 0;
+  GaussRand* deps_rands_fact = scratch->deps_rands_fact;
+
   // Stuff to perform the Gaussian elimination on the fly.
   // That quite a bit of "stuffs" because 3 Gaussian eliminations are
   // performed on the fly (in the case of multiplication gadgets): one
@@ -1219,22 +1349,56 @@ int _verify_tuples(const Circuit* circuit, // The circuit
   int local_deps_to_mult_map_fact[local_deps_max_size];
   local_deps_to_mult_map_fact[0] = 0;
 
+  // Secret shares contained in the first i+1 elements of the tuple,
+  // which only need to be updated from the first element that changed
+  // since the previous tuple.
+  Dependency prefix_secret_deps[comb_len][2];
+  int first_invalid_shares_index = 0;
+
   Comb* curr_comb = init_comb(first_tuple, sub_comb_len, prefix, max_len);
   do {
     tuples_checked++;
+    bool timed = stats &&
+      ((stats->tuples + tuples_checked) & (STATS_TIMING_PERIOD-1)) == 0;
+    uint64_t step_start_ns = 0;
+    if (timed) {
+      stats->sampled_tuples++;
+      step_start_ns = stats_now_ns();
+    }
+    if (report_progress && (tuples_checked & (STATS_PROGRESS_BATCH-1)) == 0) {
+      stats_add_progress(tuples_checked - tuples_reported);
+      tuples_reported = tuples_checked;
+    }
+
     first_invalid_local_deps_index = min(new_first_invalid_local_deps_index,
                                          first_invalid_local_deps_index);
+    first_invalid_shares_index = min(new_first_invalid_local_deps_index,
+                                     first_invalid_shares_index);
 
     /* printf("Tuple: [ "); */
     /* for (int i = 0; i < comb_len; i++) printf("%d ", curr_comb[i]); */
     /* printf("]  -- first_invalid_local_deps_index = %d\n", first_invalid_local_deps_index); */
 
-    int number_of_shares = get_number_of_shares(circuit, curr_comb, comb_len,
-                                                shares_to_ignore, PINI);
+    for (int i = first_invalid_shares_index; i < comb_len; i++) {
+      Dependency* contained_secrets = deps->contained_secrets[curr_comb[i]];
+      prefix_secret_deps[i][0] = contained_secrets[0];
+      prefix_secret_deps[i][1] = contained_secrets[1];
+      if (i != 0) {
+        prefix_secret_deps[i][0] |= prefix_secret_deps[i-1][0];
+        prefix_secret_deps[i][1] |= prefix_secret_deps[i-1][1];
+      }
+    }
+    first_invalid_shares_index = comb_len;
+
+    int number_of_shares = count_shares(circuit,
+                                        prefix_secret_deps[comb_len-1][0],
+                                        prefix_secret_deps[comb_len-1][1],
+                                        shares_to_ignore, PINI);
     /* printf("number_of_shares+comb_len = %d + %d = %d <= %d = t_in\n", */
     /*        number_of_shares, comb_free_space, number_of_shares + comb_free_space, t_in); */
     if (number_of_shares+comb_free_space <= t_in) {
       //printf(" --> That's not enough shares\n");
+      rejected_by_shares++;
       goto process_success;
     }
     /* printf(" --> Enough shares\n"); */
@@ -1260,12 +1424,12 @@ int _verify_tuples(const Circuit* circuit, // The circuit
     local_deps_len = tuple_to_local_deps_map[first_invalid_local_deps_index];
 
     // 1- Updating |local_deps| while applying a simple Gaussian elimination
+    if (timed) step_start_ns = stats_now_ns();
     for (int i = first_invalid_local_deps_index; i < comb_len; i++) {
       tuple_to_local_deps_map[i] = local_deps_len;
       BitDepVector* bit_dep_arr = bit_deps[curr_comb[i]];
       for (int dep_idx = 0; dep_idx < bit_dep_arr->length; dep_idx++) {
-        gauss_step(circuit, bit_dep_arr->content[dep_idx], local_deps, gauss_rands,
-                   bit_rand_len, bit_mult_len, bit_correction_outputs_len, local_deps_len);
+        gauss_step(bit_dep_arr->content[dep_idx], local_deps, gauss_rands, local_deps_len);
         set_gauss_rand(local_deps, gauss_rands, local_deps_len, bit_rand_len, deps->correction_outputs, bit_correction_outputs_len);
         local_deps_len++;
         replace_correction_outputs_in_dep(circuit, local_deps, local_deps_len - 1, gauss_rands, &local_deps_len, 
@@ -1276,6 +1440,7 @@ int _verify_tuples(const Circuit* circuit, // The circuit
     first_invalid_mult_index_fact = min(first_invalid_mult_index_fact,
                                         first_invalid_local_deps_index);
     first_invalid_local_deps_index = comb_len;
+    if (timed) stats_lap(&stats->gauss_ns, &step_start_ns);
 
     if (! contains_mults) {
       if (set_contained_shares(circuit, leaky_inputs, secret_deps, local_deps, gauss_rands,
@@ -1393,7 +1558,8 @@ int _verify_tuples(const Circuit* circuit, // The circuit
 
         // TODO: it's more efficient to call factorize_mults only once...
         factorize_mults(circuit, &local_deps[i], deps_fact,
-                        &deps_length_fact, 1);
+                        &deps_length_fact, 1, &scratch->fact_table);
+        if (timed) stats_lap(&stats->fact_ns, &step_start_ns);
 
         // printf("BEFORE:\n");
         // for (int h = 0; h < deps_length_fact; h++) {
@@ -1421,8 +1587,8 @@ int _verify_tuples(const Circuit* circuit, // The circuit
 
         // Apply Gauss on both tuples
         for (int l = up_to_date_deps_length_fact; l < deps_length_fact; l++) {
-          gauss_step(circuit, deps_fact[l], deps_fact, deps_rands_fact, bit_rand_len, bit_mult_len, bit_correction_outputs_len, l);
-          set_gauss_rand(deps_fact, deps_rands_fact, i, bit_rand_len, deps->correction_outputs, bit_correction_outputs_len);
+          gauss_step(deps_fact[l], deps_fact, deps_rands_fact, l);
+          set_gauss_rand(deps_fact, deps_rands_fact, l, bit_rand_len, deps->correction_outputs, bit_correction_outputs_len);
 
           //printf("%d\n",l);
           replace_correction_outputs_in_dep(circuit, deps_fact, l, deps_rands_fact, &deps_length_fact, 
@@ -1455,7 +1621,7 @@ int _verify_tuples(const Circuit* circuit, // The circuit
         // printf("\n");
 
         up_to_date_deps_length_fact = deps_length_fact;
-
+        if (timed) stats_lap(&stats->gauss_ns, &step_start_ns);
       }
 
       /*for (int i = first_invalid_mult_index_in_local_deps_fact; i < local_deps_len; i++) {
@@ -1467,7 +1633,7 @@ int _verify_tuples(const Circuit* circuit, // The circuit
 
         for (int j = up_to_date_deps_length_fact; j < deps_length_fact; j++) {
 
-          gauss_step(deps_fact[j], deps_fact, deps_rands_fact, bit_rand_len, bit_mult_len, bit_correction_outputs_len, j);
+          gauss_step(deps_fact[j], deps_fact, deps_rands_fact, j);
           set_gauss_rand(deps_fact, deps_rands_fact, j, bit_rand_len);
 
           replace_correction_outputs_in_last_dep(deps_fact, j, deps_rands_fact, &deps_length_fact, 
@@ -1495,6 +1661,7 @@ int _verify_tuples(const Circuit* circuit, // The circuit
     // The tuple is a failure
     // printf("COMB_LEN = %d\n", comb_len);
     // printf("COMB_FREE_SPACE = %d\n", comb_free_space);
+    if (timed) step_start_ns = stats_now_ns();
     if (failure_callback) {
       if (!has_random) {
         printf("A failure was found. Some randoms might be missing from the tuple you get.\n");
@@ -1510,8 +1677,17 @@ int _verify_tuples(const Circuit* circuit, // The circuit
         // failure_callback(circuit, curr_comb, comb_len, leaky_inputs, data);
       }
     }
+    if (timed) stats_lap(&stats->callback_ns, &step_start_ns);
     if (incompr_tuples) {
-      insert_in_trie(incompr_tuples, curr_comb, comb_len, leaky_inputs);
+      // |incompr_tuples| is only read while tuples are verified, possibly
+      // by several threads: the failure goes to the local trie of this
+      // thread, which _verify_tuples_parallel merges into |incompr_tuples|
+      // once all the tuples of size |comb_len| have been verified. (Since
+      // they all have the same size, none can be a subtuple of another.)
+      SecretDep* failure_deps = malloc(2 * sizeof(*failure_deps));
+      failure_deps[0] = leaky_inputs[0];
+      failure_deps[1] = leaky_inputs[1];
+      insert_in_trie(get_local_trie(incompr_tuples), curr_comb, comb_len, failure_deps);
     }
     failure_count++;
     if (stop_at_first_failure) {
@@ -1530,16 +1706,86 @@ int _verify_tuples(const Circuit* circuit, // The circuit
              next_comb(curr_comb, sub_comb_len, last_var, prefix)) >= 0) &&
            (tuple_count == -1ULL || --tuple_count != 0));
 
+  verify_depth--;
+  if (stats) {
+    stats->tuples += tuples_checked;
+    stats->rejected_by_shares += rejected_by_shares;
+    stats->failures[min(comb_len, STATS_MAX_TUPLE_SIZE)] += failure_count;
+    if (report_progress) {
+      stats_add_progress(tuples_checked - tuples_reported);
+      stats->busy_ns += stats_now_ns() - call_start_ns;
+    }
+  }
+
   // Remember that |curr_comb| is over-allocated with 2 elements at
   // the begining that are never used. Thus, the actual malloc'd
   // pointer is at index |curr_comb-2|.
   free(curr_comb-2);
+  release_scratch(scratch);
 
   return failure_count;
 }
 
 
-struct verify_tuples_args {
+/**********************************************************************
+              Parallel verification
+
+  The tuples of size |comb_len| are identified by their rank in the
+  lexicographic order. Each thread starts with a contiguous range of
+  ranks, which it consumes in chunks of |chunk_size| tuples. A thread
+  whose range is exhausted steals the upper half of the remaining
+  range of another thread. This keeps all threads busy even though
+  some regions of the tuple space are much more expensive to verify
+  than others.
+
+************************************************************************/
+
+// A range of tuple ranks [next, end), protected by |mutex|.
+struct tuple_range {
+  pthread_mutex_t mutex;
+  uint64_t next; // First rank not yet claimed
+  uint64_t end;  // One past the last rank of the range
+};
+
+// Per-thread utilization counters, reported by print_thread_report.
+struct thread_usage {
+  uint64_t tuples; // Number of tuples verified
+  uint64_t chunks; // Number of chunks verified
+  uint64_t steals; // Number of ranges stolen from other threads
+  double busy_time; // Time spent verifying tuples (in seconds)
+};
+
+static bool thread_report_enabled = false;
+static struct thread_usage* thread_report = NULL;
+static int thread_report_len = 0;
+static double thread_report_wall_time = 0;
+static uint64_t thread_report_calls = 0;
+
+void set_thread_report(bool enabled) {
+  thread_report_enabled = enabled;
+}
+
+void print_thread_report() {
+  if (!thread_report_enabled) return;
+  printf("\nThread utilization (%" PRIu64 " parallel calls, %.2f s wall time):\n",
+         thread_report_calls, thread_report_wall_time);
+  for (int i = 0; i < thread_report_len; i++) {
+    struct thread_usage* usage = &thread_report[i];
+    printf("  thread %2d: %12" PRIu64 " tuples  %8" PRIu64 " chunks  %6" PRIu64 " steals"
+           "  busy %8.2f s (%5.1f%%)\n",
+           i, usage->tuples, usage->chunks, usage->steals, usage->busy_time,
+           thread_report_wall_time > 0 ?
+           100 * usage->busy_time / thread_report_wall_time : 100.0);
+  }
+}
+
+static double get_monotonic_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+struct parallel_verify_job {
   const Circuit* circuit; // The circuit
   int t_in; // The number of shares that must be
             // leaked for a tuple to be a failure
@@ -1549,8 +1795,6 @@ struct verify_tuples_args {
   const DimRedData* dim_red_data; // Data to generate the actual tuples
                                   // after the dimension reduction
   bool has_random; // Should be false if randoms have been removed
-  Comb* first_tuple; // The first tuple
-  uint64_t tuple_count; // How many tuples to consider (-1 to consider all)
   bool include_outputs; // If true, include outputs in the tuples
   Dependency shares_to_ignore; // Shares that do not count in failures
                                // (used only for PINI)
@@ -1558,35 +1802,107 @@ struct verify_tuples_args {
   bool stop_at_first_failure; // If true, stops after the first failure
   Trie* incompr_tuples; // The trie of incompressible tuples
                         // (set to NULL to disable this optim)
-  void (*failure_callback)(const Circuit*,Comb*, int, SecretDep*, void*);
-  //     ^^^^^^^^^^^^^^^^
-  // The function to call when a failure is found
-  void* data; // additional data to pass to |failure_callback|
+
+  int vars_in_tuples; // Tuples are made of variables in [0, vars_in_tuples)
+  int sub_comb_len; // Length of the tuples without the prefix
+  uint64_t chunk_size; // Number of tuples claimed at once by a thread
+  int cores; // Number of threads
+  struct tuple_range* ranges; // The range of each thread
+  int* stop; // Set (atomically) once a failure has been found, if
+             // |stop_at_first_failure| is true.
 };
 
-void* _verify_tuples_thread_start(void* void_args) {
-  struct verify_tuples_args* args = (struct verify_tuples_args*) void_args;
-
-  _verify_tuples(args->circuit,
-                 args->t_in,
-                 args->prefix,
-                 args->comb_len,
-                 args->max_len,
-                 args->dim_red_data,
-                 args->has_random,
-                 args->first_tuple,
-                 args->tuple_count,
-                 args->include_outputs,
-                 args->shares_to_ignore,
-                 args->PINI,
-                 args->stop_at_first_failure,
-                 false, // only_one_tuple
-                 NULL, // secret_deps
-                 args->incompr_tuples,
-                 args->failure_callback,
-                 args->data
-                 );
-  free(args);
+struct thread_callback_data;
+
+struct parallel_verify_worker {
+  struct parallel_verify_job* job;
+  int id; // Index of the thread (and of its range in |job->ranges|)
+  struct thread_callback_data* callback_data; // Passed to thread_failure_callback
+  struct thread_usage usage;
+};
+
+void thread_failure_callback(const Circuit* circuit, Comb* comb, int comb_len,
+                             SecretDep* secret_deps, void* data);
+
+// Claims the next chunk of tuples for thread |id|: from its own range
+// if it isn't empty, or by stealing half of the range of another
+// thread otherwise. Returns false when there is nothing left to do.
+static bool claim_chunk(struct parallel_verify_job* job, int id,
+                        uint64_t* start, uint64_t* len, uint64_t* steals) {
+  struct tuple_range* own = &job->ranges[id];
+
+  pthread_mutex_lock(&own->mutex);
+  if (own->next < own->end) {
+    *start = own->next;
+    *len = min(job->chunk_size, own->end - own->next);
+    own->next += *len;
+    pthread_mutex_unlock(&own->mutex);
+    return true;
+  }
+  pthread_mutex_unlock(&own->mutex);
+
+  for (int i = 1; i < job->cores; i++) {
+    struct tuple_range* victim = &job->ranges[(id + i) % job->cores];
+    pthread_mutex_lock(&victim->mutex);
+    uint64_t remaining = victim->end - victim->next;
+    if (remaining == 0) {
+      pthread_mutex_unlock(&victim->mutex);
+      continue;
+    }
+    uint64_t stolen_end = victim->end;
+    uint64_t stolen_start = stolen_end - (remaining + 1) / 2;
+    victim->end = stolen_start;
+    pthread_mutex_unlock(&victim->mutex);
+
+    *start = stolen_start;
+    *len = min(job->chunk_size, stolen_end - stolen_start);
+    pthread_mutex_lock(&own->mutex);
+    own->next = stolen_start + *len;
+    own->end = stolen_end;
+    pthread_mutex_unlock(&own->mutex);
+    (*steals)++;
+    return true;
+  }
+
+  return false;
+}
+
+static void* parallel_verify_worker_start(void* void_args) {
+  struct parallel_verify_worker* worker = (struct parallel_verify_worker*) void_args;
+  struct parallel_verify_job* job = worker->job;
+
+  uint64_t start, len;
+  while (!__atomic_load_n(job->stop, __ATOMIC_RELAXED) &&
+         claim_chunk(job, worker->id, &start, &len, &worker->usage.steals)) {
+    double chunk_start_time = thread_report_enabled ? get_monotonic_time() : 0;
+
+    Comb* first_tuple = unrank(job->vars_in_tuples, job->sub_comb_len, start);
+    _verify_tuples(job->circuit,
+                   job->t_in,
+                   job->prefix,
+                   job->comb_len,
+                   job->max_len,
+                   job->dim_red_data,
+                   job->has_random,
+                   first_tuple,
+                   len, // tuple_count
+                   job->include_outputs,
+                   job->shares_to_ignore,
+                   job->PINI,
+                   job->stop_at_first_failure,
+                   false, // only_one_tuple
+                   NULL, // secret_deps
+                   job->incompr_tuples,
+                   thread_failure_callback,
+                   (void*)worker->callback_data);
+    free(first_tuple);
+
+    worker->usage.tuples += len;
+    worker->usage.chunks++;
+    if (thread_report_enabled) {
+      worker->usage.busy_time += get_monotonic_time() - chunk_start_time;
+    }
+  }
 
   // Note: The return value here doesn't matter, since
   // thread_failure_callback increments a counter of failures.
@@ -1594,41 +1910,290 @@ void* _verify_tuples_thread_start(void* void_args) {
 }
 
 struct thread_callback_data {
-  void* data; // The original data
+  void* data; // The original data (or the thread's accumulator)
   void (*failure_callback)(const Circuit*,Comb*,
                            int, SecretDep*, void*); // The original callback function
-  Trie* seen_tuples; // Failures that have already been seen
   pthread_mutex_t* mutex; // To avoid concurrence issues in |failure_callback|
-  int* failure_count; // Total number of failures
-  VarVector* prefix; // Prefix, to skip this part of the tuples in |seen_tuples|
+                          // (NULL if |data| is private to the thread)
+  int failure_count; // Number of failures found by the thread
+  bool stop_at_first_failure; // If true, only the first failure is reported
+  int* stop; // Set once a failure has been reported (if |stop_at_first_failure|)
 };
 
+// The chunks claimed by the threads are disjoint, which means that
+// each failure is found exactly once: no need to deduplicate them.
 void thread_failure_callback(const Circuit* circuit, Comb* comb, int comb_len,
                              SecretDep* secret_deps, void* data) {
   struct thread_callback_data* thread_data = (struct thread_callback_data*) data;
 
-  Comb* comb_no_prefix = comb;
-  int comb_len_no_prefix = comb_len;
-  if (thread_data->prefix && thread_data->prefix->length) {
-    comb_no_prefix = &comb_no_prefix[thread_data->prefix->length];
-    comb_len_no_prefix -= thread_data->prefix->length;
+  if (thread_data->stop_at_first_failure &&
+      __atomic_exchange_n(thread_data->stop, 1, __ATOMIC_RELAXED)) {
+    // Another thread already reported a failure
+    return;
   }
 
-  pthread_mutex_lock(thread_data->mutex);
+  if (thread_data->mutex) pthread_mutex_lock(thread_data->mutex);
 
-  if (trie_contains(thread_data->seen_tuples, comb_no_prefix, comb_len_no_prefix)) {
-    pthread_mutex_unlock(thread_data->mutex);
-    return;
+  thread_data->failure_count++;
+  if (thread_data->failure_callback) {
+    thread_data->failure_callback(circuit, comb, comb_len, secret_deps, thread_data->data);
+  }
+
+  if (thread_data->mutex) pthread_mutex_unlock(thread_data->mutex);
+}
+
+/* Worker pool
+
+   The threads used by _verify_tuples_parallel are created once and
+   reused from one call to the next: the verification of a gadget
+   typically performs one parallel call per tuple size (and, for RPE,
+   per output prefix), many of which are short enough for thread
+   creation to be noticeable. Reusing the threads also allows them to
+   keep their scratch buffers (see acquire_scratch).
+
+   The thread calling _verify_tuples_parallel takes part in the
+   computation as worker 0; the pool provides the other workers.
+*/
+
+struct worker_pool {
+  pthread_mutex_t mutex;
+  pthread_cond_t job_available; // Signaled when a new job is submitted
+  pthread_cond_t job_done; // Signaled when the last worker finishes a job
+  pthread_t* threads;
+  int size; // Number of threads in |threads|
+  uint64_t generation; // Incremented each time a job is submitted
+  int running; // Number of threads that haven't finished the current job
+  bool shutdown; // Set to stop the threads
+  struct parallel_verify_worker* workers; // Workers of the current job
+  int worker_count; // Number of workers of the current job
+};
+
+static struct worker_pool pool = {
+  .mutex = PTHREAD_MUTEX_INITIALIZER,
+  .job_available = PTHREAD_COND_INITIALIZER,
+  .job_done = PTHREAD_COND_INITIALIZER,
+};
+
+// Held while a job is being processed by the pool. Nested or
+// concurrent calls to _verify_tuples_parallel that fail to acquire it
+// run sequentially.
+static pthread_mutex_t pool_submit_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+struct pool_thread_args {
+  int id; // Index of the thread in the pool; runs worker |id+1|
+};
+
+static void* pool_thread_start(void* void_args) {
+  int id = ((struct pool_thread_args*) void_args)->id;
+  free(void_args);
+  uint64_t seen_generation = 0;
+
+  pthread_mutex_lock(&pool.mutex);
+  while (1) {
+    while (!pool.shutdown && pool.generation == seen_generation) {
+      pthread_cond_wait(&pool.job_available, &pool.mutex);
+    }
+    if (pool.shutdown) break;
+    seen_generation = pool.generation;
+    struct parallel_verify_worker* worker =
+      id + 1 < pool.worker_count ? &pool.workers[id + 1] : NULL;
+    pthread_mutex_unlock(&pool.mutex);
+
+    if (worker) parallel_verify_worker_start(worker);
+
+    pthread_mutex_lock(&pool.mutex);
+    if (--pool.running == 0) {
+      pthread_cond_signal(&pool.job_done);
+    }
+  }
+  pthread_mutex_unlock(&pool.mutex);
+
+  free_thread_scratches();
+  return NULL;
+}
+
+// Runs |workers[0..count)|: the first one on the current thread, and
+// the others on the threads of the pool (which is grown if needed).
+// Must be called while holding |pool_submit_mutex|.
+static void run_workers_in_pool(struct parallel_verify_worker* workers, int count) {
+  pthread_mutex_lock(&pool.mutex);
+  if (pool.size < count - 1) {
+    pool.threads = realloc(pool.threads, (count - 1) * sizeof(*pool.threads));
+    for (int i = pool.size; i < count - 1; i++) {
+      struct pool_thread_args* args = malloc(sizeof(*args));
+      args->id = i;
+      if (pthread_create(&pool.threads[i], NULL, pool_thread_start, args)) {
+        fprintf(stderr, "Failed to create verification thread. Exiting.\n");
+        exit(EXIT_FAILURE);
+      }
+    }
+    pool.size = count - 1;
+  }
+  pool.workers = workers;
+  pool.worker_count = count;
+  pool.running = pool.size;
+  pool.generation++;
+  pthread_cond_broadcast(&pool.job_available);
+  pthread_mutex_unlock(&pool.mutex);
+
+  parallel_verify_worker_start(&workers[0]);
+
+  pthread_mutex_lock(&pool.mutex);
+  while (pool.running != 0) {
+    pthread_cond_wait(&pool.job_done, &pool.mutex);
   }
+  pool.workers = NULL;
+  pool.worker_count = 0;
+  pthread_mutex_unlock(&pool.mutex);
+}
+
+static void shutdown_pool() {
+  pthread_mutex_lock(&pool.mutex);
+  pool.shutdown = true;
+  pthread_cond_broadcast(&pool.job_available);
+  pthread_mutex_unlock(&pool.mutex);
 
-  (*(thread_data->failure_count))++;
-  insert_in_trie(thread_data->seen_tuples, comb_no_prefix, comb_len_no_prefix, NULL);
-  thread_data->failure_callback(circuit, comb, comb_len, secret_deps, thread_data->data);
+  for (int i = 0; i < pool.size; i++) {
+    pthread_join(pool.threads[i], NULL);
+  }
+  free(pool.threads);
+  pool.threads = NULL;
+  pool.size = 0;
+  pool.shutdown = false;
+}
 
-  pthread_mutex_unlock(thread_data->mutex);
+void free_verification_resources() {
+  shutdown_pool();
+  free_thread_scratches();
 }
 
 // A wrapper for _verify_tuples that will automatically parallelize the computation.
+// Verifies the |total_tuples| tuples (without prefix) of size
+// |comb_len| starting at rank |first_rank|, using the worker pool if
+// it is available. The other parameters are those of
+// _verify_tuples_parallel.
+static int verify_tuple_range(const Circuit* circuit, int cores, int t_in,
+                              VarVector* prefix, int comb_len, int max_len,
+                              const DimRedData* dim_red_data, bool has_random,
+                              uint64_t first_rank, uint64_t total_tuples,
+                              bool include_outputs, Dependency shares_to_ignore,
+                              bool PINI, bool stop_at_first_failure,
+                              bool only_one_tuple, Trie* incompr_tuples,
+                              void (failure_callback)(const Circuit*,Comb*, int, SecretDep*, void*),
+                              void* data,
+                              const FailureAccumulator* accumulator) {
+  int real_comb_len = comb_len - (prefix ? prefix->length : 0);
+  // Tuples (without prefix) are generated by next_comb among the
+  // variables [0, vars_in_tuples).
+  int vars_in_tuples = include_outputs ? circuit->deps->length : circuit->length;
+
+  if (total_tuples == 0) return 0;
+
+  if (cores == 1 || pthread_mutex_trylock(&pool_submit_mutex) != 0) {
+    // Even on a single thread, the failures go through |accumulator|,
+    // which may count them more efficiently than |data| (see
+    // CoeffHistogram in coeffs.h).
+    void* thread_data = accumulator ? accumulator->make(data) : data;
+    Comb* first_tuple = unrank(vars_in_tuples, real_comb_len, first_rank);
+    int failure_count = _verify_tuples(circuit, t_in, prefix, comb_len, max_len,
+                                       dim_red_data, has_random, first_tuple, total_tuples,
+                                       include_outputs, shares_to_ignore, PINI,
+                                       stop_at_first_failure, only_one_tuple,
+                                       NULL, incompr_tuples, failure_callback, thread_data);
+    free(first_tuple);
+    if (accumulator) accumulator->merge(data, thread_data);
+    return failure_count;
+  }
+
+  // Initializing threads data
+  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+  int stop = 0;
+
+  // Without |accumulator|, all threads call |failure_callback| on
+  // |data|, and need to be synchronized. With it, each thread
+  // accumulates its failures in its own data, which are merged into
+  // |data| once all threads are done.
+  struct thread_callback_data thread_data[cores];
+  for (int i = 0; i < cores; i++) {
+    thread_data[i] = (struct thread_callback_data) {
+      .data = accumulator ? accumulator->make(data) : data,
+      .failure_callback = failure_callback,
+      .mutex = accumulator ? NULL : &mutex,
+      .failure_count = 0,
+      .stop_at_first_failure = stop_at_first_failure,
+      .stop = &stop
+    };
+  }
+
+  struct tuple_range ranges[cores];
+  for (int i = 0; i < cores; i++) {
+    pthread_mutex_init(&ranges[i].mutex, NULL);
+    ranges[i].next = first_rank + total_tuples / cores * i +
+      min((uint64_t)i, total_tuples % cores);
+    ranges[i].end  = first_rank + total_tuples / cores * (i+1) +
+      min((uint64_t)i+1, total_tuples % cores);
+  }
+
+  struct parallel_verify_job job = {
+    .circuit = circuit,
+    .t_in = t_in,
+    .prefix = prefix,
+    .comb_len = comb_len,
+    .max_len = max_len,
+    .dim_red_data = dim_red_data,
+    .has_random = has_random,
+    .include_outputs = include_outputs,
+    .shares_to_ignore = shares_to_ignore,
+    .PINI = PINI,
+    .stop_at_first_failure = stop_at_first_failure,
+    .incompr_tuples = incompr_tuples,
+    .vars_in_tuples = vars_in_tuples,
+    .sub_comb_len = real_comb_len,
+    .chunk_size = max(total_tuples / ((uint64_t)cores * WORK_CHUNKS_PER_THREAD),
+                      MIN_TUPLES_PER_CHUNK),
+    .cores = cores,
+    .ranges = ranges,
+    .stop = &stop
+  };
+
+  double start_time = thread_report_enabled ? get_monotonic_time() : 0;
+
+  struct parallel_verify_worker workers[cores];
+  for (int i = 0; i < cores; i++) {
+    workers[i] = (struct parallel_verify_worker) {
+      .job = &job, .id = i, .callback_data = &thread_data[i]
+    };
+  }
+  run_workers_in_pool(workers, cores);
+  pthread_mutex_unlock(&pool_submit_mutex);
+
+  int failure_count = 0;
+  for (int i = 0; i < cores; i++) {
+    pthread_mutex_destroy(&ranges[i].mutex);
+    failure_count += thread_data[i].failure_count;
+    if (accumulator) accumulator->merge(data, thread_data[i].data);
+  }
+
+  if (thread_report_enabled) {
+    if (thread_report_len < cores) {
+      thread_report = realloc(thread_report, cores * sizeof(*thread_report));
+      memset(&thread_report[thread_report_len], 0,
+             (cores - thread_report_len) * sizeof(*thread_report));
+      thread_report_len = cores;
+    }
+    for (int i = 0; i < cores; i++) {
+      thread_report[i].tuples    += workers[i].usage.tuples;
+      thread_report[i].chunks    += workers[i].usage.chunks;
+      thread_report[i].steals    += workers[i].usage.steals;
+      thread_report[i].busy_time += workers[i].usage.busy_time;
+    }
+    thread_report_wall_time += get_monotonic_time() - start_time;
+    thread_report_calls++;
+  }
+
+  return failure_count;
+}
+
 int _verify_tuples_parallel(const Circuit* circuit, // The circuit
                             int cores, // How many threads to use
                             int t_in, // The number of shares that must be
@@ -1652,82 +2217,68 @@ int _verify_tuples_parallel(const Circuit* circuit, // The circuit
                             void (failure_callback)(const Circuit*,Comb*, int, SecretDep*, void*),
                             //     ^^^^^^^^^^^^^^^^
                             // The function to call when a failure is found
-                            void* data // additional data to pass to |failure_callback|
+                            void* data, // additional data to pass to |failure_callback|
+                            const FailureAccumulator* accumulator // Per-thread accumulation of
+                                                                  // the failures (or NULL)
                             ) {
-  if (cores == 1 || first_tuple != NULL) {
-    return _verify_tuples(circuit, t_in, prefix, comb_len, max_len,
-                          dim_red_data, has_random, first_tuple, tuple_count,
-                          include_outputs, shares_to_ignore, PINI,
-                          stop_at_first_failure, only_one_tuple,
-                          NULL, incompr_tuples, failure_callback, data);
-  }
+  if (cores == -1) cores = CORES_TO_USE_FOR_MULTITHREADING;
 
-  int max_in_prefix = 0;
-  if (prefix) {
-    for (int i = 0; i < prefix->length; i++) {
-      max_in_prefix = max(max_in_prefix, prefix->content[i]);
-    }
+  if (first_tuple != NULL) {
+    int failure_count = _verify_tuples(circuit, t_in, prefix, comb_len, max_len,
+                                       dim_red_data, has_random, first_tuple, tuple_count,
+                                       include_outputs, shares_to_ignore, PINI,
+                                       stop_at_first_failure, only_one_tuple,
+                                       NULL, incompr_tuples, failure_callback, data);
+    if (incompr_tuples) merge_local_tries(incompr_tuples, circuit->secret_count);
+    return failure_count;
   }
 
-  if (cores == -1) cores = CORES_TO_USE_FOR_MULTITHREADING;
   int real_comb_len = comb_len - (prefix ? prefix->length : 0);
-  int max_vars_in_tuples = include_outputs ? circuit->deps->length : circuit->length;
-  max_vars_in_tuples = max(max_in_prefix+1, max_vars_in_tuples);
-  int trie_size;
-  if (dim_red_data) {
-    trie_size = include_outputs ? dim_red_data->old_circuit->deps->length :
-      dim_red_data->old_circuit->length;
-    trie_size = max(max_vars_in_tuples, trie_size);
-  } else {
-    trie_size = max_vars_in_tuples;
-  }
-  uint64_t total_tuples = n_choose_k(real_comb_len, max_vars_in_tuples);
-  uint64_t tuples_per_core = total_tuples / cores;
-
-  // Initializing threads data
-  pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
-  Trie* seen_tuples = make_trie(trie_size);
+  int vars_in_tuples = include_outputs ? circuit->deps->length : circuit->length;
+  uint64_t first_rank = 0;
+  uint64_t end_rank = n_choose_k(real_comb_len, vars_in_tuples);
+  if (tuple_count != -1ULL) end_rank = min(end_rank, tuple_count);
+
+  // When sharded, only the tuples whose ranks are in the window of the
+  // current shard are considered.
+  if (is_sharded()) {
+    get_shard_window(end_rank, &first_rank, &end_rank);
+  }
+
+  // When checkpointing, the tuples are verified by segments, after
+  // each of which all the failures found so far have been merged into
+  // |data|: the checkpoint then only needs to record the rank of the
+  // end of the last completed segment. Callers without |accumulator|
+  // typically record failures in structures that checkpoints cannot
+  // save, and are thus verified in one go (see checkpoint_hold).
+  bool segmented = checkpoint_enabled() && accumulator != NULL && !stop_at_first_failure;
+  if (segmented) {
+    uint64_t resume_rank = checkpoint_resume_rank();
+    first_rank = max(first_rank, resume_rank);
+  }
+
+  bool tracked = stats_begin_enumeration(comb_len, end_rank - min(first_rank, end_rank));
   int failure_count = 0;
-
-  struct thread_callback_data thread_data = {
-    .data = data,
-    .failure_callback = failure_callback,
-    .seen_tuples = seen_tuples,
-    .mutex = &mutex,
-    .failure_count = &failure_count,
-    .prefix = prefix
-  };
-
-  pthread_t threads[cores];
-
-  for (int i = 0; i < cores; i++) {
-    first_tuple = unrank(max_vars_in_tuples, real_comb_len, tuples_per_core * i);
-    struct verify_tuples_args* args = malloc(sizeof(*args));
-    args->circuit = circuit;
-    args->t_in = t_in;
-    args->prefix = prefix;
-    args->comb_len = comb_len;
-    args->max_len = max_len;
-    args->dim_red_data = dim_red_data;
-    args->has_random = has_random;
-    args->first_tuple = first_tuple;
-    args->tuple_count = tuples_per_core + 1; // +1 needed to not forget any tuples
-    args->include_outputs = include_outputs;
-    args->shares_to_ignore = shares_to_ignore;
-    args->PINI = PINI;
-    args->stop_at_first_failure = stop_at_first_failure;
-    args->incompr_tuples = incompr_tuples;
-    args->failure_callback = thread_failure_callback;
-    args->data = (void*)&thread_data;
-
-    pthread_create(&threads[i], NULL, _verify_tuples_thread_start, (void*) args);
-  }
-
-  for (int i = 0; i < cores; i++) {
-    void* unused;
-    pthread_join(threads[i], &unused);
+  if (!segmented) {
+    failure_count = verify_tuple_range(circuit, cores, t_in, prefix, comb_len, max_len,
+                                       dim_red_data, has_random, first_rank, end_rank - first_rank,
+                                       include_outputs, shares_to_ignore, PINI,
+                                       stop_at_first_failure, only_one_tuple, incompr_tuples,
+                                       failure_callback, data, accumulator);
+  } else {
+    while (first_rank < end_rank) {
+      uint64_t segment_len = min(end_rank - first_rank, CHECKPOINT_SEGMENT_TUPLES);
+      failure_count += verify_tuple_range(circuit, cores, t_in, prefix, comb_len, max_len,
+                                          dim_red_data, has_random, first_rank, segment_len,
+                                          include_outputs, shares_to_ignore, PINI,
+                                          stop_at_first_failure, only_one_tuple, incompr_tuples,
+                                          failure_callback, data, accumulator);
+      first_rank += segment_len;
+      checkpoint_progress(first_rank);
+    }
   }
-
+  if (tracked) stats_end_enumeration();
+  if (incompr_tuples) merge_local_tries(incompr_tuples, circuit->secret_count);
   return failure_count;
 }
 
@@ -1783,7 +2334,9 @@ int find_all_failures(const Circuit* circuit, // The circuit
                       void (failure_callback)(const Circuit*,Comb*, int, SecretDep*, void*),
                       //     ^^^^^^^^^^^^^^^^
                       // The function to call when a failure is found
-                      void* data // additional data to pass to |failure_callback|
+                      void* data, // additional data to pass to |failure_callback|
+                      const FailureAccumulator* accumulator // Per-thread accumulation of
+                                                            // the failures (or NULL)
                       ) {
   return _verify_tuples_parallel(circuit, cores, t_in, prefix, comb_len,
                                  max_len, dim_red_data, has_random, first_tuple,
@@ -1791,7 +2344,7 @@ int find_all_failures(const Circuit* circuit, // The circuit
                                  include_outputs, shares_to_ignore, PINI,
                                  false, // stop at first failure
                                  false, // only_one_tuple
-                                 incompr_tuples, failure_callback, data);
+                                 incompr_tuples, failure_callback, data, accumulator);
 }
 
 // Finds the first failure of size |comb_len|, and calls
@@ -1824,7 +2377,8 @@ int find_first_failure(const Circuit* circuit, // The circuit
                                  include_outputs, shares_to_ignore, PINI,
                                  true, // stop at first failure
                                  false, // only_one_tuple
-                                 incompr_tuples, failure_callback, data);
+                                 incompr_tuples, failure_callback, data,
+                                 NULL); // accumulator
 }
 
 
@@ -1981,7 +2535,7 @@ int check_output_uniformity(const Circuit * circuit, BitDep** output_deps, Gauss
   int bit_correction_outputs_len = (deps->correction_outputs->length == 0) ? 0 : 1 + deps->correction_outputs->length / 64;
 
   for(int i=0; i< circuit->share_count; i++){
-    gauss_step(circuit, output_deps[i], output_deps, gauss_rands, bit_rand_len, bit_mult_len, 0, i);
+    gauss_step(output_deps[i], output_deps, gauss_rands, i);
     set_gauss_rand(output_deps, gauss_rands, i, bit_rand_len, deps->correction_outputs, bit_correction_outputs_len);
   }
 
@@ -2224,10 +2778,8 @@ static int is_failure_with_randoms_freeSNI_IOS(const Circuit* circuit,
 
   DependencyList* deps = circuit->deps;
   int random_count = circuit->random_count;
-  int mult_count = deps->mult_deps->length;
   int non_mult_deps_count = circuit->deps->first_mult_idx;
   int bit_rand_len = 1 + random_count / 64;
-  int bit_mult_len = (mult_count == 0) ? 0 :  1 + mult_count / 64;
 
   int bit_correction_outputs_len = (deps->correction_outputs->length == 0) ? 0 : 1 + deps->correction_outputs->length / 64;
 
@@ -2277,7 +2829,7 @@ static int is_failure_with_randoms_freeSNI_IOS(const Circuit* circuit,
 
       // Computing which secret shares are leaked
       for (int i = 0; i < local_deps_len; i++) {
-        memcpy(local_deps_copy[copy_size], local_deps[i], sizeof(*local_deps[i]));
+        copy_bit_dep(local_deps_copy[copy_size], local_deps[i]);
         for (int j = 0; j < bit_rand_len; j++) {
           local_deps_copy[copy_size]->randoms[j] = (local_deps[i]->randoms[j] & selected_randoms[j]) ^ local_deps[i]->randoms[j];
         }
@@ -2285,8 +2837,7 @@ static int is_failure_with_randoms_freeSNI_IOS(const Circuit* circuit,
       }
 
       for (int i = 0; i < copy_size; i++) {
-          gauss_step(circuit, local_deps_copy[i], local_deps_copy, gauss_rands_copy,
-                    bit_rand_len, bit_mult_len, 0, i);
+          gauss_step(local_deps_copy[i], local_deps_copy, gauss_rands_copy, i);
           set_gauss_rand(local_deps_copy, gauss_rands_copy, i, bit_rand_len, deps->correction_outputs, bit_correction_outputs_len);
       }
 
@@ -2334,7 +2885,6 @@ int _verify_tuples_freeSNI_IOS(const Circuit* circuit, // The circuit
   int secret_count        = circuit->secret_count;
   int random_count        = circuit->random_count;
   int mult_count          = deps->mult_deps->length;
-  int bit_mult_len = (mult_count == 0) ? 0 :  1 + mult_count / 64;
   int bit_rand_len = 1 + (random_count / 64);
   int last_var = circuit->length;
 
@@ -2362,12 +2912,13 @@ int _verify_tuples_freeSNI_IOS(const Circuit* circuit, // The circuit
   Dependency* secrets_xor[local_deps_max_size];
   choices[0] = -1;
 
+  BitDepLayout layout = get_bit_dep_layout(circuit);
 
   for(int i=0; i<local_deps_max_size; i++){
-    local_deps[i] = alloca(sizeof(**local_deps));
-    local_deps_copy[i] = alloca(sizeof(**local_deps_copy));
+    local_deps[i] = init_bit_dep_at(alloca(bit_dep_size(&layout)), &layout);
+    local_deps_copy[i] = init_bit_dep_at(alloca(bit_dep_size(&layout)), &layout);
 
-    local_deps_without_outs[i] = alloca(sizeof(**local_deps_without_outs));
+    local_deps_without_outs[i] = init_bit_dep_at(alloca(bit_dep_size(&layout)), &layout);
     secrets[i] = alloca(sizeof(**secrets));
     secrets_xor[i] = alloca(sizeof(**secrets_xor));
 
@@ -2392,7 +2943,7 @@ int _verify_tuples_freeSNI_IOS(const Circuit* circuit, // The circuit
   int local_deps_len_tmp;
 
   for(int i=0; i< (circuit->share_count)-1; i++){
-    memcpy(local_deps[i], output_deps[i], sizeof(*output_deps[i]));
+    copy_bit_dep(local_deps[i], output_deps[i]);
     memcpy(gauss_rands+i, output_gauss_rands+i, sizeof(gauss_rands[i]));
 
     local_deps_len++;
@@ -2423,13 +2974,11 @@ int _verify_tuples_freeSNI_IOS(const Circuit* circuit, // The circuit
 
       for (int dep_idx = 0; dep_idx < bit_dep_arr->length; dep_idx++) {
 
-        gauss_step(circuit, bit_dep_arr->content[dep_idx], local_deps, gauss_rands,
-                   bit_rand_len, bit_mult_len, 0, local_deps_len);
+        gauss_step(bit_dep_arr->content[dep_idx], local_deps, gauss_rands, local_deps_len);
         set_gauss_rand(local_deps, gauss_rands, local_deps_len, bit_rand_len, deps->correction_outputs, bit_correction_outputs_len);
 
         //without outs
-        gauss_step(circuit, bit_dep_arr->content[dep_idx], local_deps_without_outs, gauss_rands_without_outs,
-                   bit_rand_len, bit_mult_len, 0, local_deps_without_outs_len);
+        gauss_step(bit_dep_arr->content[dep_idx], local_deps_without_outs, gauss_rands_without_outs, local_deps_without_outs_len);
         set_gauss_rand(local_deps_without_outs, gauss_rands_without_outs, local_deps_without_outs_len, bit_rand_len, deps->correction_outputs, bit_correction_outputs_len);
 
 
@@ -19,6 +19,21 @@ typedef struct _gauss_rand {
   uint64_t mask;
 } GaussRand;
 
+// When finding failures with several threads, |failure_callback| is
+// normally called under a lock, since all threads share the same
+// |data|. If the failures only need to be accumulated (eg, to count
+// them in coefficients), an accumulator can be provided instead: each
+// thread then calls |failure_callback| on its own copy of |data|
+// (created by |make|), and these copies are merged back into |data|
+// (by |merge|) once all threads are done. |merge| should free the
+// thread's copy. Single-threaded enumerations use a copy as well, so
+// that |make| and |merge| can set up structures that only the copies
+// use (such as CoeffHistograms).
+typedef struct _failure_accumulator {
+  void* (*make)(void* data);
+  void (*merge)(void* data, void* thread_data);
+} FailureAccumulator;
+
 /* void factorize_inner_mults(const Circuit* c, Dependency** factorized_deps, MultDependency* mult); */
 /* void factorize_mults(const Circuit* c, Dependency** local_deps, */
 /*                      Dependency** deps1, Dependency** deps2, */
@@ -51,7 +66,10 @@ int find_all_failures(const Circuit* c,             // The circuit
                       void (failure_callback)(const Circuit*,Comb*, int, SecretDep*, void* data),
                       //     ^^^^^^^^^^^^^^^^
                       // The function to call when a failure is found
-                      void* data // additional data to pass to |failure_callback|
+                      void* data, // additional data to pass to |failure_callback|
+                      const FailureAccumulator* accumulator // Per-thread accumulation of
+                                                            // the failures (NULL to
+                                                            // serialize |failure_callback|)
                       );
 
 // Finds the first failure of size |comb_len|, and calls
@@ -111,6 +129,19 @@ int _verify_tuples(const Circuit* circuit, // The circuit
                    );
 
 
+// Enables (or disables) the collection of per-thread utilization
+// statistics during parallel verifications.
+void set_thread_report(bool enabled);
+
+// Prints the per-thread utilization statistics collected since the
+// start of the program (does nothing if they were not enabled).
+void print_thread_report();
+
+// Stops the threads used by the parallel verifications and frees the
+// scratch buffers of the current thread.
+void free_verification_resources();
+
+
 int check_output_uniformity(const Circuit * circuit, BitDep** output_deps, GaussRand * gauss_rands);
 
 int find_first_failure_freeSNI_IOS(const Circuit* c,             // The circuit
@@ -155,6 +155,14 @@ def print_test_CRPC (str1, filename) :
     sys.exit(1)
 
 
+def print_test_FILES (filename1, filename2) :
+  if (open(filename1, 'r').read() == open(filename2, 'r').read()) :
+    print("*** Passed ***")
+    sys.exit(0)
+  else :
+    print("*** Failed ***")
+    sys.exit(1)
+
   
 if __name__ == '__main__' :
   if (len(sys.argv) == 5) :
@@ -8,6 +8,7 @@ TEST_PATH_CPY=$TEST_PATH"/copy"
 TEST_PATH_MULT=$TEST_PATH"/mult"
 TEST_PATH_MULT_REF=$TEST_PATH"/mult-ref" 
 TEST_PATH_FAIL=$TEST_PATH"/fail"
+TEST_PATH_BIN="../gadgets/Bin"
 
 read -p "Press '1' for single core test, '2' for parallelized test : " para
 
@@ -19,6 +20,9 @@ RP_FILE="RP.txt"
 RPC_FILE="RPC.txt"
 CRPC_FILE="CRPC.txt"
 RPE_FILE="RPE.txt"
+FAULT_GADGET="fault_gadget.sage"
+RESUME_FILE="RESUME.txt"
+CHECKPOINT_FILE="checkpoint.txt"
 TEST="python3 test.py print_test_"
 
 declare -i CNT_PASS=0
@@ -348,37 +352,37 @@ update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_ADD_1 "RP -c 7 $CORES'"
-$EXEC $TEST_ADD_1 RP -c 7 $CORES|head -n 11 |tail -n 1 |cut -c -35 > $RP_FILE
+$EXEC $TEST_ADD_1 RP -c 7 $CORES|head -n 10 |tail -n 1 |cut -c -35 > $RP_FILE
 $TEST"NI" "[ 0, 0, 8, 324, 6166, 73204, 608984" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_ADD_2 "RP -c 5 $CORES'"
-$EXEC $TEST_ADD_2 RP -c 5 $CORES|head -n 11 |tail -n 1 |cut -c -19 > $RP_FILE
+$EXEC $TEST_ADD_2 RP -c 5 $CORES|head -n 10 |tail -n 1 |cut -c -19 > $RP_FILE
 $TEST"NI" "[ 0, 0, 0, 16, 1216" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_ADD_1 "RPC -c 5 -t 2 $CORES"
-$EXEC $TEST_ADD_1 RPC -c 5 -t 2 $CORES |head -n 11 |tail -n 1 > $RPC_FILE
+$EXEC $TEST_ADD_1 RPC -c 5 -t 2 $CORES |head -n 10 |tail -n 1 > $RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 1, 88, 2460, 37400, 67436, 67864, 44190, 20476, 6760, 1590, 240, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" $RPC_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_ADD_2 "RPC -c 4 -t 1 $CORES'"
-$EXEC $TEST_ADD_2 RPC -c 4 -t 1 $CORES |head -n 11 |tail -n 1 > $RPC_FILE
+$EXEC $TEST_ADD_2 RPC -c 4 -t 1 $CORES |head -n 10 |tail -n 1 > $RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 14, 1002, 35281, 40932, 25350, 7848, 1308, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" $RPC_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_ADD_2 "RPC -c 4 -t 3 $CORES'"
-$EXEC $TEST_ADD_2 RPC -c 4 -t 3 $CORES|head -n 11 |tail -n 1 > $RPC_FILE
+$EXEC $TEST_ADD_2 RPC -c 4 -t 3 $CORES|head -n 10 |tail -n 1 > $RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 1, 74, 2870, 3290, 2127, 744, 169, 18, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" $RPC_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_ADD_1 "RPE -c 3 -t 2 $CORES'"
-$EXEC $TEST_ADD_1 RPE -c 3 -t 2 $CORES |head -n 21 |tail -n 10 > $RPE_FILE
+$EXEC $TEST_ADD_1 RPE -c 3 -t 2 $CORES |head -n 20 |tail -n 10 > $RPE_FILE
 $TEST"RPE" "REP1- I1: [0, 0, 1, 64, 48, 25, 6, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I2: [0, 0, 1, 64, 48, 25, 6, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I1_and_I2: [0, 0, 1, 40, 24, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" "REP2- I1: [0, 0, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -388,7 +392,7 @@ update_cnt
 echo 
 
 echo "Check '"$EXEC $TEST_ADD_2 "RPE -c 4 -t 1 $CORES'"
-$EXEC $TEST_ADD_2 RPE -c 4 -t 1 $CORES |head -n 21 |tail -n 10 > $RPE_FILE
+$EXEC $TEST_ADD_2 RPE -c 4 -t 1 $CORES |head -n 20 |tail -n 10 > $RPE_FILE
 $TEST"RPE" "REP1- I1: [0, 0, 7, 501, 17665, 20466, 12675, 3924, 654, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I2: [0, 0, 7, 501, 17665, 20466, 12675, 3924, 654, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I1_and_I2: [0, 0, 0, 0, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" "REP2- I1: [0, 0, 7, 501, 17658, 20472, 12686, 3930, 655, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -416,31 +420,31 @@ update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_CPY_1 "RP -c 7 $CORES'"
-$EXEC $TEST_CPY_1 RP -c 7 $CORES |head -n 11 |tail -n 1 > $RP_FILE
+$EXEC $TEST_CPY_1 RP -c 7 $CORES |head -n 10 |tail -n 1 > $RP_FILE
 $TEST"NI" "[ 0, 0, 33, 1077, 16073, 147033, 933425, 3200627, 6850620, 10166528, 11140068, 9362095, 6173063, 3232923, 1350123, 447825, 116428, 23105, 3330, 315, 15, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 ]" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_CPY_2 "RP -c 6 $CORES'"
-$EXEC $TEST_CPY_2 RP -c 6 $CORES|head -n 11|tail -n 1 > $RP_FILE
+$EXEC $TEST_CPY_2 RP -c 6 $CORES|head -n 10 |tail -n 1 > $RP_FILE
 $TEST"NI" "[ 0, 0, 0, 111, 7248, 230677, 975654, 2151416, 3104838, 3210019, 2481544, 1463121, 661056, 226962, 57792, 10386, 1188, 66, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 ]" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_CPY_1 "RPC -c 3 -t 1 $CORES'"
-$EXEC $TEST_CPY_1 RPC -c 3 -t 1 $CORES|head -n 11 |tail -n 1 > $RPC_FILE
+$EXEC $TEST_CPY_1 RPC -c 3 -t 1 $CORES|head -n 10 |tail -n 1 > $RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 36, 1160, 2684, 3012, 1980, 802, 189, 21, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" $RPC_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_CPY_2 "RPC -c 4 -t 2 $CORES'"
-$EXEC $TEST_CPY_2 RPC -c 4 -t 2 $CORES |head -n 11 |tail -n 1 > $RPC_FILE
+$EXEC $TEST_CPY_2 RPC -c 4 -t 2 $CORES |head -n 10 |tail -n 1 > $RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 1, 227, 12417, 33996, 48513, 44096, 27395, 11722, 3360, 588, 49, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" $RPC_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_CPY_1 "RPE -c 5 -t 2 $CORES'"
-$EXEC $TEST_CPY_1 RPE -c 5 -t 2 $CORES |head -n 22 |tail -n 11 > $RPE_FILE
+$EXEC $TEST_CPY_1 RPE -c 5 -t 2 $CORES |head -n 21 |tail -n 11 > $RPE_FILE
 $TEST"RPE_COPY" "REP11 : [0, 0, 8, 377, 7857, 89674, 290646, 508176, 575606, 457332, 264127, 112023, 34471, 7393, 1005, 67, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP12 : [0, 0, 4, 205, 4316, 50333, 162278, 281367, 315725, 248415, 142072, 59692, 18212, 3879, 525, 35, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP21 : [0, 0, 4, 205, 4316, 50333, 162278, 281367, 315725, 248415, 142072, 59692, 18212, 3879, 525, 35, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -449,7 +453,7 @@ update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_CPY_1 "RPE -c 6 -t 1 $CORES'"
-$EXEC $TEST_CPY_1 RPE -c 6 -t 1 $CORES |head -n 22 |tail -n 11 > $RPE_FILE
+$EXEC $TEST_CPY_1 RPE -c 6 -t 1 $CORES |head -n 21 |tail -n 11 > $RPE_FILE
 $TEST"RPE_COPY" "REP11 : [0, 0, 43, 1421, 19842, 161244, 902958, 2716437, 5069315, 6524506, 6115608, 4320878, 2342582, 979616, 313804, 75325, 12935, 1440, 80, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP12 : [0, 0, 36, 1439, 21516, 174342, 957367, 2861337, 5331944, 6836275, 6393331, 4509988, 2441937, 1019932, 326338, 78250, 13426, 1494, 83, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP21 : [0, 0, 36, 1439, 21516, 174342, 957367, 2861337, 5331944, 6836275, 6393331, 4509988, 2441937, 1019932, 326338, 78250, 13426, 1494, 83, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -458,7 +462,7 @@ update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_CPY_2 "RPE -c 4 -t 3 $CORES'"
-$EXEC $TEST_CPY_2 RPE -c 4 -t 3 $CORES |head -n 22 |tail -n 11 > $RPE_FILE
+$EXEC $TEST_CPY_2 RPE -c 4 -t 3 $CORES |head -n 21 |tail -n 11 > $RPE_FILE
 $TEST"RPE_COPY" "REP11 : [0, 0, 8, 524, 17323, 37974, 41153, 26636, 11022, 2862, 444, 36, 3, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP12 : [0, 0, 4, 262, 8725, 19185, 20899, 13651, 5742, 1539, 255, 24, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP21 : [0, 0, 4, 262, 8725, 19185, 20899, 13651, 5742, 1539, 255, 24, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -467,7 +471,7 @@ update_cnt
 echo
  
 echo "Check '"$EXEC $TEST_CPY_2 "RPE -c 3 -t 4 $CORES'"
-$EXEC $TEST_CPY_2 RPE -c 3 -t 4 $CORES|head -n 22 |tail -n 11 > $RPE_FILE
+$EXEC $TEST_CPY_2 RPE -c 3 -t 4 $CORES|head -n 21 |tail -n 11 > $RPE_FILE
 $TEST"RPE_COPY" "REP11 : [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP12 : [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP21 : [0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -495,37 +499,37 @@ echo
 
 
 echo "Check '"$EXEC $TEST_MULT_1 "RP -c 4 $CORES'"
-$EXEC $TEST_MULT_1 RP -c 4 $CORES |head -n 11 |tail -n 1 |cut -c -19 >$RP_FILE
+$EXEC $TEST_MULT_1 RP -c 4 $CORES |head -n 10 |tail -n 1 |cut -c -19 >$RP_FILE
 $TEST"NI" "[ 0, 0, 1297, 58874" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_MULT_2 "RP -c 4 $CORES'"
-$EXEC $TEST_MULT_2 RP -c 4 $CORES |head -n 11 |tail -n 1 > $RP_FILE
+$EXEC $TEST_MULT_2 RP -c 4 $CORES |head -n 10 |tail -n 1 > $RP_FILE
 $TEST"NI" "[ 0, 0, 0, 37616, 261501, 1120722, 3542393, 8946853, 18804625, 33662029, 52056872, 70162009, 82836190, 85874100, 78186094, 62419814, 43551954, 26427118, 13854680, 6222762, 2368744, 753512, 196560, 40950, 6552, 756, 56, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 ]" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_MULT_1 "RPC -c 4 -t 1 $CORES'"
-$EXEC $TEST_MULT_1 RPC -c 4 -t 1 $CORES |head -n 11 |tail -n 1 |cut -c -32 >$RPC_FILE
+$EXEC $TEST_MULT_1 RPC -c 4 -t 1 $CORES |head -n 10 |tail -n 1 |cut -c -32 >$RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 415, 17546, 330916" $RPC_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_MULT_1 "RPC -c 3 -t 2 $CORES'"
-$EXEC $TEST_MULT_1 RPC -c 3 -t 2  $CORES |head -n 11 |tail -n 1 |cut -c -22 >$RPC_FILE
+$EXEC $TEST_MULT_1 RPC -c 3 -t 2  $CORES |head -n 10 |tail -n 1 |cut -c -22 >$RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 64, 4834" $RPC_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_MULT_2 "RPC -c 3 -t 3 $CORES'"
-$EXEC $TEST_MULT_2 RPC -c 3 -t 3  $CORES |head -n 11 |tail -n 1 >$RPC_FILE
+$EXEC $TEST_MULT_2 RPC -c 3 -t 3  $CORES |head -n 10 |tail -n 1 >$RPC_FILE
 $TEST"NI" "f(p) = [0, 0, 6, 1071, 2071, 2907, 2988, 2223, 1138, 386, 80, 8, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" $RPC_FILE
 update_cnt
 echo
 
 echo "Check'"$EXEC $TEST_MULT_2 "RPE -c 3 -t 1 $CORES'"
-$EXEC $TEST_MULT_2 RPE -c 3 -t 1  $CORES|head -n 21 |tail -n 10 > $RPE_FILE
+$EXEC $TEST_MULT_2 RPE -c 3 -t 1  $CORES|head -n 20 |tail -n 10 > $RPE_FILE
 $TEST"RPE" "REP1- I1: [0, 0, 758, 65294, 326710, 1065882, 2564492, 4894153, 7686092, 10120840, 11282696, 10688885, 8590946, 5818932, 3285918, 1524696, 570384, 167616, 37240, 5880, 588, 28, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I2: [0, 0, 762, 65608, 327202, 1066606, 2565192, 4894573, 7686232, 10120860, 11282696, 10688885, 8590946, 5818932, 3285918, 1524696, 570384, 167616, 37240, 5880, 588, 28, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I1_and_I2: [0, 0, 104, 19410, 68587, 176136, 327341, 462460, 508685, 436781, 289088, 144224, 52416, 13104, 2016, 144, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" "REP2- I1: [0, 0, 763, 66484, 328600, 1068244, 2566501, 4895276, 7686453, 10120891, 11282696, 10688885, 8590946, 5818932, 3285918, 1524696, 570384, 167616, 37240, 5880, 588, 28, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -535,7 +539,7 @@ update_cnt
 echo
 
 echo "Check'"$EXEC $TEST_MULT_1 "RPE -c 3 -t 2 $CORES'"
-$EXEC $TEST_MULT_1 RPE -c 3 -t 2 $CORES|head -n 21 |tail -n 10 > $RPE_FILE
+$EXEC $TEST_MULT_1 RPE -c 3 -t 2 $CORES|head -n 20 |tail -n 10 > $RPE_FILE
 $TEST"RPE" "REP1- I1: [0, 0, 46, 3261, 8735, 14024, 15861, 13872, 9988, 6156, 3233, 1387, 455, 105, 15, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I2: [0, 0, 64, 4020, 10129, 15650, 17012, 14374, 10116, 6172, 3233, 1387, 455, 105, 15, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I1_and_I2: [0, 0, 46, 2447, 6060, 8646, 8149, 5304, 2373, 712, 132, 12, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" "REP2- I1: [0, 0, 0, 1185, 3407, 6267, 8467, 9035, 7818, 5504, 3112, 1376, 455, 105, 15, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -564,19 +568,19 @@ update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_MULT_REF_3 "RP -c 4 $CORES'"
-$EXEC $TEST_MULT_REF_3 RP -c 4 $CORES|head -n 11 |tail -n 1 > $RP_FILE
+$EXEC $TEST_MULT_REF_3 RP -c 4 $CORES|head -n 10 |tail -n 1 > $RP_FILE
 $TEST"NI" "[ 0, 4, 976, 135728, 396664, 1117624, 2977172, 7223802, 15458972, 28718540, 46153384, 64328410, 78030792, 82577068, 76313552, 61549150, 43226064, 26331340, 13833400, 6219402, 2368408, 753496, 196560, 40950, 6552, 756, 56, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 ]" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_MULT_REF_2 "RP -c 5 $CORES'"
-$EXEC $TEST_MULT_REF_2 RP -c 5 $CORES|head -n 11 |tail -n 1 > $RP_FILE
+$EXEC $TEST_MULT_REF_2 RP -c 5 $CORES|head -n 10 |tail -n 1 > $RP_FILE
 $TEST"NI" "[ 0, 3, 1069, 109407, 6260007, 29266523, 84012360, 175214019, 284819843, 374288970, 406617885, 370568359, 286076919, 188228040, 105889388, 50956212, 20928807, 7298622, 2142651, 522642, 103845, 16284, 1908, 150, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 ]" $RP_FILE
 update_cnt
 echo
 
 echo "Check '"$EXEC $TEST_MULT_REF_2 "RPE -c 3 -t 2 $CORES'"
-$EXEC $TEST_MULT_REF_2 RPE -c 3 -t 2 $CORES |head -n 21 |tail -n 11 > $RPE_FILE
+$EXEC $TEST_MULT_REF_2 RPE -c 3 -t 2 $CORES |head -n 20 |tail -n 11 > $RPE_FILE
 $TEST"RPE" "REP1- I1: [1, 132, 8646, 374660, 929739, 1390746, 1466525, 1178856, 746433, 378890, 154263, 49998, 12610, 2370, 300, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I2: [0, 8, 1031, 65903, 185812, 318380, 380733, 342947, 241374, 134964, 60038, 21093, 5720, 1140, 150, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
 REP1- I1_and_I2: [0, 8, 1031, 65903, 185812, 318380, 380733, 342947, 241374, 134964, 60038, 21093, 5720, 1140, 150, 10, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]" "REP2- I1: [1, 132, 8646, 374660, 929739, 1390746, 1466525, 1178856, 746433, 378890, 154263, 49998, 12610, 2370, 300, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0]
@@ -585,6 +589,65 @@ REP2- I1_and_I2: [0, 0, 0, 512, 1920, 4320, 6760, 7992, 7380, 5380, 3090, 1374,
 update_cnt
 echo
 
+echo "************** Checking Gadget with Input Randoms **************"
+echo
+
+TEST_RAND_1=$TEST_PATH_BIN"/RP-Eurocrypt2021/mult_3_shares_test3.sage"
+
+echo "Check '"$EXEC $TEST_RAND_1 "RP -c 3 $CORES'"
+$EXEC $TEST_RAND_1 RP -c 3 $CORES |head -n 14 |tail -n 1 |cut -c -70 > $RP_FILE
+$TEST"NI" "f(p) = [ 0, 0, 662, 2670, 6570, 11135, 14067, 13680, 10355, 6090, 2739" $RP_FILE
+update_cnt
+echo
+
+echo "************** Checking Fault Properties **************"
+echo
+
+TEST_FAULT_1=$TEST_PATH_BIN"/ISW/mult/gadget_mult_3_shares.sage"
+
+echo "Check '"$EXEC $TEST_FAULT_1 "CNI -k 2 -t 1 $CORES'"
+$EXEC $TEST_FAULT_1 CNI -k 2 -t 1 $CORES |tail -n 3 |head -n 1 > $NI_FILE
+$TEST"NI" "Gadget is (1,2)-CNI" $NI_FILE
+update_cnt
+echo
+
+# CRPC reads its fault scenarios from a file next to the gadget and
+# writes its coefficients there, so it runs on a copy of the gadget.
+echo "Check '"$EXEC $TEST_FAULT_1 "CRPC -k 1 -c 2 -t 1 $CORES'"
+cp $TEST_FAULT_1 $FAULT_GADGET
+printf "0\n0 0\n" > $FAULT_GADGET"_faulty_scenarios_k1_f1_CRPC"
+$EXEC $FAULT_GADGET CRPC -k 1 -c 2 -t 1 $CORES > /dev/null
+md5sum $FAULT_GADGET"_t1_k1_c2_f1.CRPC_coeffs" |cut -c -32 > $CRPC_FILE
+$TEST"NI" "cb1a6aa1585fe72fcd957d27c2626a42" $CRPC_FILE
+update_cnt
+echo
+
+echo "************** Checking Checkpoint and Resume **************"
+echo
+
+TEST_CKPT_1=$TEST_PATH_BIN"/ISW/mult/gadget_mult_4_shares.sage"
+
+# The verification is killed as soon as it has saved a checkpoint, then
+# resumed: its coefficients must match those of an uninterrupted run.
+# Checkpoints are renamed into place once written, so the file is
+# complete as soon as it exists.
+echo "Check '"$EXEC $TEST_CKPT_1 "RPE -c 5 -t 1 $CORES' interrupted and resumed"
+rm -f $CHECKPOINT_FILE
+$EXEC $TEST_CKPT_1 RPE -c 5 -t 1 $CORES |grep "\[" > $RPE_FILE
+$EXEC $TEST_CKPT_1 RPE -c 5 -t 1 $CORES --checkpoint $CHECKPOINT_FILE --checkpoint-interval 0 > /dev/null &
+pid=$!
+while kill -0 $pid 2> /dev/null && [ ! -f $CHECKPOINT_FILE ]; do sleep 0.01; done
+kill -9 $pid 2> /dev/null
+wait $pid 2> /dev/null
+if [ -f $CHECKPOINT_FILE ]; then
+  $EXEC $TEST_CKPT_1 RPE -c 5 -t 1 $CORES --checkpoint $CHECKPOINT_FILE --resume |grep "\[" > $RESUME_FILE
+else
+  echo "The verification completed before being interrupted." > $RESUME_FILE
+fi
+$TEST"FILES" $RPE_FILE $RESUME_FILE
+update_cnt
+echo
+
 end=$(date +%s)
 
 echo "***************************** End of the test *****************************"
@@ -598,6 +661,9 @@ rm $RPE_FILE
 rm $RPC_FILE
 rm $RP_FILE
 rm $CRPC_FILE
+rm -f $FAULT_GADGET*
+rm $RESUME_FILE
+rm -f $CHECKPOINT_FILE $CHECKPOINT_FILE".tmp"
 
 
 